@@ -0,0 +1,261 @@
+/*
+ * gsam-leak-check.cc
+ *
+ *  Runs join and leave cycles of the group members on a lan. Every group
+ *  member joins every group through its GsamApplication, so igmp runs gsam
+ *  with the querier, and leaves them again, which deletes the kek sa of each
+ *  group on both ends. The first cycle builds what stays, the init sessions
+ *  with the querier and the groups of the querier. After every later cycle
+ *  the pooled objects in use, the occupied spis and the gsa push ids summed
+ *  over all nodes have to be back at what the first cycle left. At the end
+ *  destroying the simulation has to free every pooled object.
+ *
+ *  ./waf --run "gsam-leak-check --cycles=20 --groups=5 --stay=30 --settle=60"
+ */
+
+#include "ns3/applications-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/ipsec.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace ns3;
+
+static void
+GetObjectsInUse (std::vector<uint64_t>& retval)
+{
+	retval.clear ();
+	retval.push_back (GsamObjectPool<GsamInitSession>::GetNumberOfObjectsInUse ());
+	retval.push_back (GsamObjectPool<GsamSession>::GetNumberOfObjectsInUse ());
+	retval.push_back (GsamObjectPool<GsaPushSession>::GetNumberOfObjectsInUse ());
+	retval.push_back (GsamObjectPool<GsamSessionGroup>::GetNumberOfObjectsInUse ());
+	retval.push_back (GsamObjectPool<IpSecPolicyEntry>::GetNumberOfObjectsInUse ());
+	retval.push_back (GsamObjectPool<IpSecSADatabase>::GetNumberOfObjectsInUse ());
+	retval.push_back (GsamObjectPool<IpSecSAEntry>::GetNumberOfObjectsInUse ());
+}
+
+static void
+GetIdsInUse (const NodeContainer& nodes, std::vector<uint64_t>& retval)
+{
+	retval.assign (3, 0);
+	for (uint32_t i = 0; i < nodes.GetN (); i++)
+	{
+		Ptr<GsamInfo> info = GsamL4Protocol::GetGsam (nodes.Get (i))->GetIpSecDatabase ()->GetInfo ();
+		retval[0] += info->GetNumberOfOccupiedGsamSpis ();
+		retval[1] += info->GetNumberOfOccupiedIpsecSpis ();
+		retval[2] += info->GetNumberOfOccupiedGsaPushIds ();
+	}
+}
+
+static bool
+Check (const std::string& name, const std::vector<uint64_t>& baseline, const std::vector<uint64_t>& current)
+{
+	bool retval = true;
+	for (uint32_t i = 0; i < baseline.size (); i++)
+	{
+		if (baseline[i] != current[i])
+		{
+			std::cout << name << " " << i << " baseline " << baseline[i] << " now " << current[i] << std::endl;
+			retval = false;
+		}
+	}
+	return retval;
+}
+
+static void
+JoinAll (std::vector<Ptr<GsamApplication> > gm_apps, std::vector<Ipv4Address> groups)
+{
+	for (uint32_t i = 0; i < gm_apps.size (); i++)
+	{
+		for (uint32_t j = 0; j < groups.size (); j++)
+		{
+			gm_apps[i]->Join (groups[j]);
+		}
+	}
+}
+
+static void
+LeaveAll (std::vector<Ptr<GsamApplication> > gm_apps, std::vector<Ipv4Address> groups)
+{
+	for (uint32_t i = 0; i < gm_apps.size (); i++)
+	{
+		for (uint32_t j = 0; j < groups.size (); j++)
+		{
+			gm_apps[i]->Leave (groups[j]);
+		}
+	}
+}
+
+static std::vector<uint64_t> g_baseline_objects;
+static std::vector<uint64_t> g_baseline_ids;
+static uint64_t g_peak_objects = 0;
+static bool g_leak = false;
+
+static void
+CountPeak (void)
+{
+	std::vector<uint64_t> objects;
+	GetObjectsInUse (objects);
+	uint64_t in_use = 0;
+	for (uint32_t i = 0; i < objects.size (); i++)
+	{
+		in_use += objects[i];
+	}
+	if (in_use > g_peak_objects)
+	{
+		g_peak_objects = in_use;
+	}
+}
+
+static void
+CheckCycle (NodeContainer nodes, uint32_t cycle)
+{
+	std::vector<uint64_t> objects;
+	std::vector<uint64_t> ids;
+	GetObjectsInUse (objects);
+	GetIdsInUse (nodes, ids);
+
+	if (0 == cycle)
+	{
+		//what the first cycle leaves stays for good
+		g_baseline_objects = objects;
+		g_baseline_ids = ids;
+		return;
+	}
+
+	bool objects_ok = Check ("objects in use", g_baseline_objects, objects);
+	bool ids_ok = Check ("ids in use", g_baseline_ids, ids);
+	if ((false == objects_ok) || (false == ids_ok))
+	{
+		std::cout << "leak after cycle " << cycle << std::endl;
+		g_leak = true;
+		Simulator::Stop ();
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	uint32_t n_cycles = 20;
+	uint32_t n_groups = 5;
+	double stay_seconds = 30;
+	double settle_seconds = 60;
+
+	CommandLine cmd;
+	cmd.AddValue ("cycles", "Number of join and leave cycles", n_cycles);
+	cmd.AddValue ("groups", "Number of secure groups every group member joins per cycle", n_groups);
+	cmd.AddValue ("stay", "Seconds the group members stay in the groups", stay_seconds);
+	cmd.AddValue ("settle", "Seconds from the leaves to the check, the leaves have to be through by then", settle_seconds);
+	cmd.Parse (argc, argv);
+
+	if ((0 == n_cycles) || (0 == n_groups))
+	{
+		std::cout << "cycles and groups have to be positive" << std::endl;
+		return 1;
+	}
+
+	Time::SetResolution (Time::NS);
+
+	NodeContainer nodes;
+	nodes.Create (GsamConfig::GetSingleton()->GetNumberOfNodes());
+
+	CsmaHelper csma;
+	csma.SetChannelAttribute ("DataRate", StringValue ("5Mbps"));
+	csma.SetChannelAttribute ("Delay", TimeValue (NanoSeconds (2)));
+
+	InternetStackHelperMulticast stack;
+	stack.Install (nodes);
+
+	Ipv4AddressHelperMulticast address;
+	address.SetBase ("10.1.1.0", "255.255.255.0");
+
+	NetDeviceContainer devices;
+	devices.Add(csma.Install(nodes));
+
+	Ipv4InterfaceContainerMulticast interfaces = address.Assign (devices);
+
+	GsamConfig::GetSingleton()->SetupIgmpAndGsam(interfaces, GsamConfig::GetSingleton()->GetNumberOfNqs());
+
+	std::vector<Ipv4Address> groups;
+	for (uint32_t i = 0; i < n_groups; i++)
+	{
+		groups.push_back (GsamConfig::GetSingleton()->GetAnUnusedSecGrpAddress());
+	}
+
+	double cycle_seconds = stay_seconds + settle_seconds;
+	double start_seconds = GsamConfig::GetSingleton()->GetGmJoinTimeInSeconds().GetSeconds();
+	Time end_time = Seconds (start_seconds + cycle_seconds * (n_cycles + 1));
+
+	std::vector<Ptr<GsamApplication> > gm_apps;
+
+	for (uint32_t i = 0; i < nodes.GetN(); i++)
+	{
+		//the q and the nqs go about as usual, the group members only join when told to
+		Ptr<GsamApplication> app = CreateObject<GsamApplication> ();
+		app->SetEventsNumber(0);
+		app->SetStartTime(Seconds(0.));
+		app->SetStopTime(end_time);
+		nodes.Get(i)->AddApplication(app);
+		if (Igmpv3L4Protocol::GROUP_MEMBER == Igmpv3L4Protocol::GetIgmp(nodes.Get(i))->GetRole())
+		{
+			gm_apps.push_back(app);
+		}
+	}
+
+	Ipv4GlobalRoutingHelperMulticast::PopulateRoutingTables ();
+
+	//the first cycle sets the baseline, the rest are checked against it
+	for (uint32_t cycle = 0; cycle <= n_cycles; cycle++)
+	{
+		double join_seconds = start_seconds + cycle_seconds * cycle;
+		double leave_seconds = join_seconds + stay_seconds;
+		Simulator::Schedule (Seconds (join_seconds), &JoinAll, gm_apps, groups);
+		Simulator::Schedule (Seconds (leave_seconds - 0.001), &CountPeak);
+		Simulator::Schedule (Seconds (leave_seconds), &LeaveAll, gm_apps, groups);
+		Simulator::Schedule (Seconds (join_seconds + cycle_seconds - 0.001), &CheckCycle, nodes, cycle);
+	}
+
+	SystemWallClockMs clock;
+	clock.Start ();
+	Simulator::Stop (end_time);
+	Simulator::Run ();
+	uint32_t n_gms = gm_apps.size ();
+	gm_apps.clear ();
+	Simulator::Destroy ();
+	int64_t elapsed = clock.End ();
+
+	if (true == g_leak)
+	{
+		return 1;
+	}
+
+	std::vector<uint64_t> nothing (g_baseline_objects.size (), 0);
+	std::vector<uint64_t> objects;
+	GetObjectsInUse (objects);
+	if (false == Check ("objects after teardown", nothing, objects))
+	{
+		std::cout << "leak after teardown" << std::endl;
+		return 1;
+	}
+
+	struct rusage usage;
+	getrusage (RUSAGE_SELF, &usage);
+
+	std::cout << "cycles " << n_cycles
+			<< " group members " << n_gms
+			<< " groups " << n_groups
+			<< " wall " << elapsed << " ms"
+			<< " peak pooled objects " << g_peak_objects
+			<< " peak rss " << (usage.ru_maxrss / 1024) << " MB"
+			<< " no leaks" << std::endl;
+
+	return 0;
+}
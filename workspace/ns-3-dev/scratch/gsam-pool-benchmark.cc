@@ -0,0 +1,140 @@
+/*
+ * gsam-pool-benchmark.cc
+ *
+ *  Builds the state the querier keeps for a number of joins: per join an
+ *  init session with its init sa, a session with its kek sa, a gsa push
+ *  session and an inbound gsa, per group a session group with its policy,
+ *  both sa databases of the policy and an outbound gsa. Everything is kept
+ *  alive like on the querier, then the pooled allocations per join and the
+ *  peak rss are reported.
+ *
+ *  ./waf --run "gsam-pool-benchmark --joins=100000 --groups=1000"
+ */
+
+#include "ns3/internet-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/ipsec.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace ns3;
+
+template <typename T>
+static uint64_t
+PrintPool (const std::string& name, uint32_t n_joins)
+{
+	uint64_t allocations = GsamObjectPool<T>::GetNumberOfAllocations ();
+	std::cout << name
+			<< " allocations " << allocations
+			<< " per join " << ((double) allocations / n_joins)
+			<< " in use " << GsamObjectPool<T>::GetNumberOfObjectsInUse ()
+			<< " slabs " << GsamObjectPool<T>::GetNumberOfSlabs ()
+			<< std::endl;
+	return allocations;
+}
+
+template <typename T>
+static uint64_t
+GetSlabs (void)
+{
+	return GsamObjectPool<T>::GetNumberOfSlabs ();
+}
+
+int
+main (int argc, char *argv[])
+{
+	uint32_t n_joins = 100000;
+	uint32_t n_groups = 1000;
+
+	CommandLine cmd;
+	cmd.AddValue ("joins", "Number of joins the querier keeps state for", n_joins);
+	cmd.AddValue ("groups", "Number of secure groups the joins are spread over", n_groups);
+	cmd.Parse (argc, argv);
+
+	if ((0 == n_joins) || (0 == n_groups))
+	{
+		std::cout << "joins and groups have to be positive" << std::endl;
+		return 1;
+	}
+
+	Ptr<IpSecDatabase> database = Create<IpSecDatabase> ();
+	std::vector<Ptr<GsaPushSession> > push_sessions;
+
+	SystemWallClockMs clock;
+	clock.Start ();
+	for (uint32_t i = 0; i < n_joins; i++)
+	{
+		Ipv4Address peer (0x0a000001 + i);
+		Ipv4Address group (0xe1000000 + (i % n_groups));
+
+		//as GsamL4Protocol::HandleIkeSaInitInvitation does, the session counts itself half-open
+		Ptr<GsamInitSession> init_session = database->CreateInitSession (peer);
+		init_session->SetSessionRole (GsamInitSession::RESPONDER);
+		init_session->EtablishGsamInitSa ();
+		init_session->SetInitSaInitiatorSpi (i + 1);
+		init_session->SetInitSaResponderSpi (database->GetInfo ()->RegisterGsamSpi ());
+		//the ike_auth arrived, it counts itself out again
+		init_session->SetMessageId (1);
+
+		Ptr<GsamSession> session = database->CreateSession (init_session, group);
+		session->EtablishGsamKekSa ();
+		session->SetKekSaInitiatorSpi (i + 1);
+		session->SetKekSaResponderSpi (database->GetInfo ()->RegisterGsamSpi ());
+
+		Ptr<GsamSessionGroup> session_group = database->GetSessionGroup (group);
+		session_group->PushBackSession (session);
+		if (0 == session_group->GetRelatedPolicy ())
+		{
+			session_group->EtablishPolicy (group, GsamConfig::GetDefaultIpsecProtocolId (), IpSec::PROTECT, GsamConfig::GetDefaultIpsecMode ());
+			session_group->GetRelatedPolicy ()->GetOutboundSAD ()->CreateIpSecSAEntry (database->GetInfo ()->RegisterIpsecSpi ());
+		}
+		session_group->GetRelatedPolicy ()->GetInboundSAD ()->CreateIpSecSAEntry (database->GetInfo ()->RegisterIpsecSpi ());
+
+		push_sessions.push_back (database->CreateGsaPushSession ());
+	}
+	int64_t elapsed = clock.End ();
+
+	if (0 != database->GetNumberOfHalfOpenInitSessions ())
+	{
+		std::cout << "half-open init sessions left " << database->GetNumberOfHalfOpenInitSessions () << std::endl;
+		return 1;
+	}
+
+	uint64_t allocations = 0;
+	allocations += PrintPool<GsamInitSession> ("GsamInitSession", n_joins);
+	allocations += PrintPool<GsamSession> ("GsamSession", n_joins);
+	allocations += PrintPool<GsaPushSession> ("GsaPushSession", n_joins);
+	allocations += PrintPool<GsamSessionGroup> ("GsamSessionGroup", n_joins);
+	allocations += PrintPool<IpSecPolicyEntry> ("IpSecPolicyEntry", n_joins);
+	allocations += PrintPool<IpSecSADatabase> ("IpSecSADatabase", n_joins);
+	allocations += PrintPool<IpSecSAEntry> ("IpSecSAEntry", n_joins);
+
+	uint64_t slabs = GetSlabs<GsamInitSession> () +
+			GetSlabs<GsamSession> () +
+			GetSlabs<GsaPushSession> () +
+			GetSlabs<GsamSessionGroup> () +
+			GetSlabs<IpSecPolicyEntry> () +
+			GetSlabs<IpSecSADatabase> () +
+			GetSlabs<IpSecSAEntry> ();
+
+	struct rusage usage;
+	getrusage (RUSAGE_SELF, &usage);
+
+	std::cout << "joins " << n_joins
+			<< " groups " << n_groups
+			<< " wall " << elapsed << " ms"
+			<< " pooled allocations per join " << ((double) allocations / n_joins)
+			<< " heap allocations by pools per join " << ((double) slabs / n_joins)
+			<< " peak rss " << (usage.ru_maxrss / 1024) << " MB"
+			<< std::endl;
+
+	push_sessions.clear ();
+	Simulator::Destroy ();
+	return 0;
+}
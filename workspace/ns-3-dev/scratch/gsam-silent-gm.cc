@@ -0,0 +1,251 @@
+/*
+ * gsam-silent-gm.cc
+ *
+ *  One group member joins a secure group and then never answers the gsa
+ *  push of the querier, its device drops every informational and
+ *  create_child_sa exchange it receives. The other group members join the
+ *  same group right after it, so their pushes wait behind the one to the
+ *  silent group member. Once the querier gives up on the silent group member
+ *  it has to drop that push and push the group to everyone else. At the
+ *  check every other group member has to hold its gsa pair on the querier
+ *  and no push of the group may be left in flight.
+ *
+ *  ./waf --run "gsam-silent-gm --lag=0.5 --settle=30"
+ */
+
+#include "ns3/applications-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/command-line.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/ethernet-trailer.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/udp-l4-protocol-multicast.h"
+#include "ns3/gsam.h"
+#include "ns3/ipsec.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace ns3;
+
+//drops the phase two requests of gsam on the way in, phase one still goes through
+class GsamPhaseTwoDropModel : public ErrorModel
+{
+public:
+	static TypeId GetTypeId (void);
+	GsamPhaseTwoDropModel ();
+	uint32_t GetNumberOfDrops (void) const;
+private:
+	virtual bool DoCorrupt (Ptr<Packet> packet);
+	virtual void DoReset (void);
+	uint32_t m_num_drops;
+};
+
+TypeId
+GsamPhaseTwoDropModel::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("GsamPhaseTwoDropModel")
+		.SetParent<ErrorModel> ()
+		.AddConstructor<GsamPhaseTwoDropModel> ();
+	return tid;
+}
+
+GsamPhaseTwoDropModel::GsamPhaseTwoDropModel ()
+	: m_num_drops (0)
+{
+}
+
+uint32_t
+GsamPhaseTwoDropModel::GetNumberOfDrops (void) const
+{
+	return this->m_num_drops;
+}
+
+bool
+GsamPhaseTwoDropModel::DoCorrupt (Ptr<Packet> packet)
+{
+	Ptr<Packet> copy = packet->Copy ();
+
+	EthernetTrailer trailer;
+	copy->RemoveTrailer (trailer);
+	EthernetHeader ethernet_header (false);
+	copy->RemoveHeader (ethernet_header);
+	if (0x0800 != ethernet_header.GetLengthType ())
+	{
+		return false;
+	}
+
+	Ipv4Header ipv4_header;
+	copy->RemoveHeader (ipv4_header);
+	if (UdpL4ProtocolMulticast::PROT_NUMBER != ipv4_header.GetProtocol ())
+	{
+		return false;
+	}
+
+	UdpHeader udp_header;
+	copy->RemoveHeader (udp_header);
+	if (GsamL4Protocol::PROT_NUMBER != udp_header.GetDestinationPort ())
+	{
+		return false;
+	}
+
+	IkeHeader ike_header;
+	copy->RemoveHeader (ike_header);
+	if ((IkeHeader::INFORMATIONAL != ike_header.GetExchangeType ()) &&
+		(IkeHeader::CREATE_CHILD_SA != ike_header.GetExchangeType ()))
+	{
+		return false;
+	}
+
+	this->m_num_drops++;
+	return true;
+}
+
+void
+GsamPhaseTwoDropModel::DoReset (void)
+{
+	this->m_num_drops = 0;
+}
+
+static void
+Join (Ptr<GsamApplication> app, Ipv4Address group)
+{
+	app->Join (group);
+}
+
+static bool g_pass = false;
+
+static void
+Check (Ptr<Node> q_node, Ipv4Address group, uint32_t n_answering_gms)
+{
+	Ptr<IpSecDatabase> database = GsamL4Protocol::GetGsam (q_node)->GetIpSecDatabase ();
+
+	uint32_t n_gsa_pairs = 0;
+	const std::list<Ptr<GsamSession> >& lst_sessions = database->GetSessionGroup (group)->GetSessionsConst ();
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = lst_sessions.begin();
+			const_it != lst_sessions.end();
+			const_it++)
+	{
+		if (0 != (*const_it)->GetRelatedGsaR ())
+		{
+			n_gsa_pairs++;
+		}
+	}
+
+	bool in_flight = database->IsGsaPushInFlight (group);
+
+	std::cout << "group members answering " << n_answering_gms
+			<< " gsa pairs on the querier " << n_gsa_pairs
+			<< " push in flight " << (in_flight ? "yes" : "no") << std::endl;
+
+	g_pass = ((n_answering_gms == n_gsa_pairs) && (false == in_flight));
+	Simulator::Stop ();
+}
+
+int
+main (int argc, char *argv[])
+{
+	double lag_seconds = 0.5;
+	double settle_seconds = 30;
+
+	CommandLine cmd;
+	cmd.AddValue ("lag", "Seconds the other group members join after the silent one", lag_seconds);
+	cmd.AddValue ("settle", "Seconds from giving up on the silent group member to the check", settle_seconds);
+	cmd.Parse (argc, argv);
+
+	Time::SetResolution (Time::NS);
+
+	NodeContainer nodes;
+	nodes.Create (GsamConfig::GetSingleton()->GetNumberOfNodes());
+
+	CsmaHelper csma;
+	csma.SetChannelAttribute ("DataRate", StringValue ("5Mbps"));
+	csma.SetChannelAttribute ("Delay", TimeValue (NanoSeconds (2)));
+
+	InternetStackHelperMulticast stack;
+	stack.Install (nodes);
+
+	Ipv4AddressHelperMulticast address;
+	address.SetBase ("10.1.1.0", "255.255.255.0");
+
+	NetDeviceContainer devices;
+	devices.Add(csma.Install(nodes));
+
+	Ipv4InterfaceContainerMulticast interfaces = address.Assign (devices);
+
+	GsamConfig::GetSingleton()->SetupIgmpAndGsam(interfaces, GsamConfig::GetSingleton()->GetNumberOfNqs());
+
+	Ipv4Address group = GsamConfig::GetSingleton()->GetAnUnusedSecGrpAddress();
+
+	double join_seconds = GsamConfig::GetSingleton()->GetGmJoinTimeInSeconds().GetSeconds();
+	//the first push goes out on the join, every retransmission and the give up wait one timeout each
+	double give_up_seconds = GsamConfig::GetSingleton()->GetDefaultRetransmitTimeoutInSeconds().GetSeconds() *
+								(GsamConfig::GetSingleton()->GetNumberOfRetransmission() + 2);
+	Time check_time = Seconds (join_seconds + lag_seconds + give_up_seconds + settle_seconds);
+
+	Ptr<Node> q_node = 0;
+	std::vector<Ptr<GsamApplication> > gm_apps;
+	Ptr<GsamPhaseTwoDropModel> drop_model = 0;
+
+	for (uint32_t i = 0; i < nodes.GetN(); i++)
+	{
+		Ptr<GsamApplication> app = CreateObject<GsamApplication> ();
+		app->SetEventsNumber(0);
+		app->SetStartTime(Seconds(0.));
+		app->SetStopTime(check_time + Seconds (1));
+		nodes.Get(i)->AddApplication(app);
+
+		Igmpv3L4Protocol::ROLE role = Igmpv3L4Protocol::GetIgmp(nodes.Get(i))->GetRole();
+		if (Igmpv3L4Protocol::QUERIER == role)
+		{
+			q_node = nodes.Get(i);
+		}
+		else if (Igmpv3L4Protocol::GROUP_MEMBER == role)
+		{
+			if (0 == drop_model)
+			{
+				//the first group member goes silent and joins ahead of the rest
+				drop_model = CreateObject<GsamPhaseTwoDropModel> ();
+				devices.Get(i)->SetAttribute ("ReceiveErrorModel", PointerValue (drop_model));
+				Simulator::Schedule (Seconds (join_seconds), &Join, app, group);
+			}
+			else
+			{
+				Simulator::Schedule (Seconds (join_seconds + lag_seconds), &Join, app, group);
+			}
+			gm_apps.push_back(app);
+		}
+	}
+
+	if ((0 == q_node) || (gm_apps.size () < 2))
+	{
+		std::cout << "needs a querier and at least two group members" << std::endl;
+		return 1;
+	}
+
+	Ipv4GlobalRoutingHelperMulticast::PopulateRoutingTables ();
+
+	Simulator::Schedule (check_time, &Check, q_node, group, (uint32_t)(gm_apps.size () - 1));
+
+	Simulator::Stop (check_time + Seconds (1));
+	Simulator::Run ();
+	uint32_t n_drops = drop_model->GetNumberOfDrops ();
+	gm_apps.clear ();
+	Simulator::Destroy ();
+
+	std::cout << "requests dropped at the silent group member " << n_drops << std::endl;
+
+	if ((false == g_pass) || (0 == n_drops))
+	{
+		std::cout << "joins behind the silent group member did not complete" << std::endl;
+		return 1;
+	}
+
+	std::cout << "joins behind the silent group member completed" << std::endl;
+
+	return 0;
+}
@@ -18,6 +18,10 @@
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/command-line.h"
+#include "ns3/stats-module.h"
+
+#include <iostream>
+#include <vector>
 
 using namespace ns3;
 
@@ -25,7 +29,16 @@ int
 main (int argc, char *argv[])
 {
 
+	bool static_arp = false;
+	std::string data_rate = "0bps";
+	uint32_t packet_size = 512;
+	double churn_interval = 0;
+
 	CommandLine cmd;
+	cmd.AddValue ("staticArp", "Pre-populate the ARP caches so joins do not wait for ARP", static_arp);
+	cmd.AddValue ("dataRate", "Rate the querier sends data to every secure group, 0bps for none", data_rate);
+	cmd.AddValue ("packetSize", "Size of the data packets in bytes", packet_size);
+	cmd.AddValue ("churnInterval", "Mean seconds a group member stays in or out of a group, 0 for no churn", churn_interval);
 
 	cmd.Parse (argc, argv);
 
@@ -80,8 +93,24 @@ main (int argc, char *argv[])
 
 	Ipv4InterfaceContainerMulticast interfaces = address.Assign (devices);
 
+	if (static_arp)
+	{
+		InternetStackHelperMulticast::PopulateArpCache (interfaces);
+	}
+
 	GsamConfig::GetSingleton()->SetupIgmpAndGsam(interfaces, GsamConfig::GetSingleton()->GetNumberOfNqs());
 
+	bool data_plane = (DataRate (data_rate).GetBitRate() > 0) || (churn_interval > 0);
+	if (data_plane)
+	{
+		//the querier sends the data packets out of its lan device
+		uint32_t q_id = GsamConfig::GetSingleton()->GetNodeIdByAddress(GsamConfig::GetSingleton()->GetQAddress());
+		Ipv4StaticRoutingHelperMulticast multicast;
+		multicast.SetDefaultMulticastRoute(nodes.Get(q_id), devices.Get(q_id));
+	}
+
+	std::vector<Ptr<GsamApplication> > apps;
+
 	if (nodes.GetN() > 0)
 	{
 
@@ -89,11 +118,15 @@ main (int argc, char *argv[])
 		{
 			ObjectFactory factory;
 			factory.SetTypeId(GsamApplication::GetTypeId());
+			factory.Set("DataRate", DataRateValue (DataRate (data_rate)));
+			factory.Set("PacketSize", UintegerValue (packet_size));
+			factory.Set("ChurnInterval", TimeValue (Seconds (churn_interval)));
 			Ptr<Application> app = factory.Create<GsamApplication>();
 			DynamicCast<GsamApplication>(app)->SetEventsNumber(GsamConfig::GetSingleton()->GetGmJoinEventNumber());
 			app->SetStartTime(Seconds(0.));
 			app->SetStopTime(Seconds(double(simulation_seconds)));
 			nodes.Get(i)->AddApplication(app);
+			apps.push_back(DynamicCast<GsamApplication>(app));
 		}
 
 		/* The follow chunk will cause nodes other than node1 dont have any socket
@@ -109,7 +142,37 @@ main (int argc, char *argv[])
 
 	Ipv4GlobalRoutingHelperMulticast::PopulateRoutingTables ();
 
+	if (data_plane)
+	{
+		FileHelper delays;
+		delays.ConfigureFile ("gsam-rx-delay", FileAggregator::FORMATTED);
+		delays.Set2dFormat ("%.9e\t%.9e");
+		delays.WriteProbe ("ns3::TimeProbe",
+				"/NodeList/*/ApplicationList/*/$ns3::GsamApplication/RxDelay",
+				"Output");
+
+		FileHelper bytes;
+		bytes.ConfigureFile ("gsam-rx-bytes", FileAggregator::FORMATTED);
+		bytes.Set2dFormat ("%.9e\t%.0f");
+		bytes.WriteProbe ("ns3::ApplicationPacketProbe",
+				"/NodeList/*/ApplicationList/*/$ns3::GsamApplication/Rx",
+				"OutputBytes");
+	}
+
 	Simulator::Run ();
+
+	if (data_plane)
+	{
+		uint32_t received = 0;
+		uint32_t lost = 0;
+		for (std::vector<Ptr<GsamApplication> >::const_iterator it = apps.begin (); it != apps.end (); it++)
+		{
+			received += (*it)->GetReceived ();
+			lost += (*it)->GetLost ();
+		}
+		std::cout << "data packets received " << received << " lost " << lost << std::endl;
+	}
+
 	Simulator::Destroy ();
 	return 0;
 }
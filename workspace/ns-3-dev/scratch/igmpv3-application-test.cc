@@ -106,9 +106,11 @@ main (int argc, char *argv[])
 	Simulator::Destroy ();
 	GsamConfig::GetSingleton()->LogNonsecGroupAverageDelay();
 	GsamConfig::GetSingleton()->LogSecGroupAverageDelay();
+	GsamConfig::GetSingleton()->LogRekeyStatistics();
 	GsamConfig::GetSingleton()->PlotSecGroupDelay();
 	GsamConfig::GetSingleton()->PlotSecGroupDelayInRange (Seconds (10.0));
 	GsamConfig::GetSingleton()->PlotSecGroupDelayInRange (Seconds (1.0));
+	GsamConfig::GetSingleton()->PlotSecGroupDelayHistogram (MilliSeconds (100));
 	GsamConfig::GetSingleton()->PlotNonsecGroupDelay();
 //	GsamConfig::GetSingleton()->LogALlJoinWorstDelay(GsamConfig::GetSingleton()->GetNumberOfNodes() - GsamConfig::GetSingleton()->GetNumberOfNqs() - 1);
 	GsamConfig::GetSingleton()->LogALlJoinAverageAndWorstDelay(GsamConfig::GetSingleton()->GetSpiRejectPropability());
@@ -0,0 +1,125 @@
+/*
+ * multicast-fanout-benchmark.cc
+ *
+ *  Measures the cost of Ipv4L3ProtocolMulticast::IpMulticastForward on a
+ *  single router with many ports. One port receives a stream of UDP packets
+ *  addressed to a multicast group, a static multicast route copies them onto
+ *  every other port.
+ *
+ *  ./waf --run "multicast-fanout-benchmark --ports=64 --packets=10000"
+ */
+
+#include "ns3/csma-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <iostream>
+
+using namespace ns3;
+
+static uint32_t g_transmitted = 0;
+
+static void
+SendPacket (Ptr<Socket> socket, uint32_t size, uint32_t remaining, Time interval)
+{
+	socket->Send (Create<Packet> (size));
+	if (remaining > 1)
+	{
+		Simulator::Schedule (interval, &SendPacket, socket, size, remaining - 1, interval);
+	}
+}
+
+static void
+CountTx (Ptr<const Packet> packet, Ptr<Ipv4Multicast> ipv4, uint32_t interface)
+{
+	g_transmitted++;
+}
+
+int
+main (int argc, char *argv[])
+{
+	uint32_t ports = 64;
+	uint32_t packets = 10000;
+	uint32_t size = 512;
+
+	CommandLine cmd;
+	cmd.AddValue ("ports", "Number of router ports, one of them is the input", ports);
+	cmd.AddValue ("packets", "Number of multicast packets sent into the router", packets);
+	cmd.AddValue ("size", "UDP payload size in bytes", size);
+	cmd.Parse (argc, argv);
+
+	if (ports < 2)
+	{
+		std::cout << "ports has to be at least 2, one input and one output" << std::endl;
+		return 1;
+	}
+
+	Time::SetResolution (Time::NS);
+
+	Ptr<Node> router = CreateObject<Node> ();
+	NodeContainer hosts;
+	hosts.Create (ports);
+
+	NodeContainer all (router);
+	all.Add (hosts);
+
+	InternetStackHelperMulticast stack;
+	stack.Install (all);
+
+	CsmaHelper csma;
+	csma.SetChannelAttribute ("DataRate", StringValue ("1Gbps"));
+	csma.SetChannelAttribute ("Delay", TimeValue (MicroSeconds (1)));
+
+	Ipv4AddressHelperMulticast address;
+	address.SetBase ("10.0.0.0", "255.255.255.0");
+
+	NetDeviceContainer routerDevices;
+	NetDeviceContainer hostDevices;
+	for (uint32_t i = 0; i < ports; i++)
+	{
+		NetDeviceContainer link = csma.Install (NodeContainer (router, hosts.Get (i)));
+		routerDevices.Add (link.Get (0));
+		hostDevices.Add (link.Get (1));
+		address.Assign (link);
+		address.NewNetwork ();
+	}
+
+	Ipv4Address source ("10.0.0.2");
+	Ipv4Address group ("225.1.2.4");
+
+	Ipv4StaticRoutingHelperMulticast multicast;
+	NetDeviceContainer outputs;
+	for (uint32_t i = 1; i < ports; i++)
+	{
+		outputs.Add (routerDevices.Get (i));
+	}
+	multicast.AddMulticastRoute (router, source, group, routerDevices.Get (0), outputs);
+	multicast.SetDefaultMulticastRoute (hosts.Get (0), hostDevices.Get (0));
+
+	Ptr<Socket> socket = Socket::CreateSocket (hosts.Get (0), UdpSocketFactory::GetTypeId ());
+	socket->Connect (InetSocketAddress (group, 9));
+
+	router->GetObject<Ipv4L3ProtocolMulticast> ()->TraceConnectWithoutContext ("Tx", MakeCallback (&CountTx));
+
+	Simulator::Schedule (Seconds (1.0), &SendPacket, socket, size, packets, MicroSeconds (50));
+
+	SystemWallClockMs clock;
+	clock.Start ();
+	Simulator::Run ();
+	int64_t elapsed = clock.End ();
+	Simulator::Destroy ();
+
+	std::cout << "ports " << ports
+			<< " packets " << packets
+			<< " copies " << g_transmitted
+			<< " wall " << elapsed << " ms";
+	if (g_transmitted > 0)
+	{
+		std::cout << " per-copy " << (elapsed * 1000.0) / g_transmitted << " us";
+	}
+	std::cout << std::endl;
+	return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * route-lookup-benchmark.cc
+ *
+ *  Measures Ipv4GlobalRoutingMulticast::RouteOutput on a large forwarding
+ *  table. The table holds random host and network routes out of one
+ *  point-to-point interface, the destinations looked up are random too so
+ *  some of them only match short prefixes or nothing at all.
+ *
+ *  ./waf --run "route-lookup-benchmark --routes=100000 --lookups=1000000"
+ */
+
+#include "ns3/internet-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+	uint32_t n_routes = 100000;
+	uint32_t n_lookups = 1000000;
+	bool ecmp = false;
+
+	CommandLine cmd;
+	cmd.AddValue ("routes", "Number of routes in the table, half host and half network routes", n_routes);
+	cmd.AddValue ("lookups", "Number of lookups timed", n_lookups);
+	cmd.AddValue ("ecmp", "Pick among equal cost routes at random", ecmp);
+	cmd.Parse (argc, argv);
+
+	NodeContainer nodes;
+	nodes.Create (2);
+
+	InternetStackHelperMulticast stack;
+	stack.Install (nodes);
+
+	PointToPointHelper p2p;
+	Ipv4AddressHelperMulticast address;
+	address.SetBase ("192.168.0.0", "255.255.255.252");
+	address.Assign (p2p.Install (nodes));
+
+	Ptr<Ipv4GlobalRoutingMulticast> routing = CreateObject<Ipv4GlobalRoutingMulticast> ();
+	routing->SetAttribute ("RandomEcmpRouting", BooleanValue (ecmp));
+	routing->SetIpv4 (nodes.Get (0)->GetObject<Ipv4Multicast> ());
+
+	Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+	Ipv4Address gateway ("192.168.0.2");
+
+	SystemWallClockMs clock;
+	clock.Start ();
+	for (uint32_t i = 0; i < n_routes; i++)
+	{
+		Ipv4Address dest (random->GetInteger (0, 0xdfffffff));
+		if (i % 2 == 0)
+		{
+			routing->AddHostRouteTo (dest, gateway, 1);
+		}
+		else
+		{
+			uint32_t length = random->GetInteger (8, 30);
+			Ipv4Mask mask (0xffffffff << (32 - length));
+			routing->AddNetworkRouteTo (dest.CombineMask (mask), mask, gateway, 1);
+		}
+	}
+	int64_t build = clock.End ();
+
+	// draw the destinations up front so only the lookups are timed
+	std::vector<Ipv4Address> destinations;
+	for (uint32_t i = 0; i < n_lookups; i++)
+	{
+		destinations.push_back (Ipv4Address (random->GetInteger (0, 0xdfffffff)));
+	}
+
+	Ptr<Packet> packet = Create<Packet> ();
+	Ipv4Header header;
+	Socket::SocketErrno sockerr;
+	uint32_t found = 0;
+
+	clock.Start ();
+	for (uint32_t i = 0; i < n_lookups; i++)
+	{
+		header.SetDestination (destinations[i]);
+		if (routing->RouteOutput (packet, header, 0, sockerr) != 0)
+		{
+			found++;
+		}
+	}
+	int64_t elapsed = clock.End ();
+
+	std::cout << "routes " << routing->GetNRoutes ()
+			<< " build " << build << " ms"
+			<< " lookups " << n_lookups
+			<< " found " << found
+			<< " wall " << elapsed << " ms";
+	if (elapsed > 0)
+	{
+		std::cout << " rate " << (n_lookups / elapsed) << " lookups/ms";
+	}
+	std::cout << std::endl;
+
+	Simulator::Destroy ();
+	return 0;
+}
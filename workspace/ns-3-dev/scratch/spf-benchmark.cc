@@ -0,0 +1,190 @@
+/*
+ * spf-benchmark.cc
+ *
+ *  Measures Ipv4GlobalRoutingHelperMulticast::PopulateRoutingTables, which
+ *  runs one SPF calculation per router, on point-to-point topologies of
+ *  increasing size. The ring topology has random chords so it stays
+ *  connected while giving the SPF several equal and unequal cost paths; the
+ *  grid topology links every router to its right and lower neighbour, which
+ *  gives many equal cost paths.
+ *
+ *  ./waf --run "spf-benchmark --routers=1000,5000,20000 --chords=1 --threads=4"
+ *  ./waf --run "spf-benchmark --topology=grid --routers=2025"
+ *
+ *  With --churn, random router interfaces are then taken down and up again,
+ *  updating the routes after each change, with or without --incremental.
+ *
+ *  ./waf --run "spf-benchmark --routers=1000 --churn=50 --incremental=1"
+ */
+
+#include "ns3/internet-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace ns3;
+
+static void
+BuildGrid (uint32_t n_routers)
+{
+	// the largest square grid that fits
+	uint32_t side = 1;
+	while ((side + 1) * (side + 1) <= n_routers)
+	{
+		side++;
+	}
+
+	NodeContainer routers;
+	routers.Create (side * side);
+
+	InternetStackHelperMulticast stack;
+	stack.Install (routers);
+
+	PointToPointHelper p2p;
+	p2p.SetDeviceAttribute ("DataRate", StringValue ("1Gbps"));
+	p2p.SetChannelAttribute ("Delay", StringValue ("1ms"));
+
+	Ipv4AddressHelperMulticast address;
+	address.SetBase ("10.0.0.0", "255.255.255.252");
+
+	for (uint32_t row = 0; row < side; row++)
+	{
+		for (uint32_t col = 0; col < side; col++)
+		{
+			uint32_t i = row * side + col;
+			if (col + 1 < side)
+			{
+				address.Assign (p2p.Install (routers.Get (i), routers.Get (i + 1)));
+				address.NewNetwork ();
+			}
+			if (row + 1 < side)
+			{
+				address.Assign (p2p.Install (routers.Get (i), routers.Get (i + side)));
+				address.NewNetwork ();
+			}
+		}
+	}
+}
+
+static void
+BuildRing (uint32_t n_routers, uint32_t chords_per_router)
+{
+	NodeContainer routers;
+	routers.Create (n_routers);
+
+	InternetStackHelperMulticast stack;
+	stack.Install (routers);
+
+	PointToPointHelper p2p;
+	p2p.SetDeviceAttribute ("DataRate", StringValue ("1Gbps"));
+	p2p.SetChannelAttribute ("Delay", StringValue ("1ms"));
+
+	Ipv4AddressHelperMulticast address;
+	address.SetBase ("10.0.0.0", "255.255.255.252");
+
+	Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+
+	for (uint32_t i = 0; i < n_routers; i++)
+	{
+		address.Assign (p2p.Install (routers.Get (i), routers.Get ((i + 1) % n_routers)));
+		address.NewNetwork ();
+		for (uint32_t c = 0; c < chords_per_router; c++)
+		{
+			uint32_t peer = random->GetInteger (0, n_routers - 1);
+			if (peer == i)
+			{
+				continue;
+			}
+			address.Assign (p2p.Install (routers.Get (i), routers.Get (peer)));
+			address.NewNetwork ();
+		}
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	std::string routers_arg = "1000,5000,20000";
+	uint32_t chords = 1;
+	uint32_t threads = 1;
+	std::string topology = "ring";
+	uint32_t churn = 0;
+	bool incremental = false;
+
+	CommandLine cmd;
+	cmd.AddValue ("routers", "Comma separated topology sizes", routers_arg);
+	cmd.AddValue ("chords", "Random extra links per router", chords);
+	cmd.AddValue ("threads", "Threads used for the SPF calculations", threads);
+	cmd.AddValue ("topology", "ring or grid; grids are rounded down to a square", topology);
+	cmd.AddValue ("churn", "Interfaces taken down and up again after populating", churn);
+	cmd.AddValue ("incremental", "Only recompute the routes a change affects", incremental);
+	cmd.Parse (argc, argv);
+
+	Config::SetGlobal ("GlobalRoutingSpfThreads", UintegerValue (threads));
+	Config::SetGlobal ("GlobalRoutingIncrementalSpf", BooleanValue (incremental));
+
+	std::vector<uint32_t> sizes;
+	std::istringstream sizes_stream (routers_arg);
+	std::string size_text;
+	while (std::getline (sizes_stream, size_text, ','))
+	{
+		sizes.push_back (atoi (size_text.c_str ()));
+	}
+
+	for (std::vector<uint32_t>::const_iterator it = sizes.begin (); it != sizes.end (); it++)
+	{
+		RngSeedManager::SetRun (1);
+		if (topology == "grid")
+		{
+			BuildGrid (*it);
+		}
+		else
+		{
+			BuildRing (*it, chords);
+		}
+
+		SystemWallClockMs clock;
+		clock.Start ();
+		Ipv4GlobalRoutingHelperMulticast::PopulateRoutingTables ();
+		int64_t elapsed = clock.End ();
+
+		std::cout << topology
+				<< " routers " << NodeList::GetNNodes ()
+				<< " chords " << chords
+				<< " threads " << threads
+				<< " populate " << elapsed << " ms" << std::endl;
+
+		if (churn > 0)
+		{
+			Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+			clock.Start ();
+			for (uint32_t c = 0; c < churn; c++)
+			{
+				Ptr<Node> node = NodeList::GetNode (random->GetInteger (0, NodeList::GetNNodes () - 1));
+				Ptr<Ipv4Multicast> ipv4 = node->GetObject<Ipv4Multicast> ();
+				// interface 0 is the loopback
+				uint32_t interface = random->GetInteger (1, ipv4->GetNInterfaces () - 1);
+				ipv4->SetDown (interface);
+				Ipv4GlobalRoutingHelperMulticast::RecomputeRoutingTables (node);
+				ipv4->SetUp (interface);
+				Ipv4GlobalRoutingHelperMulticast::RecomputeRoutingTables (node);
+			}
+			int64_t churned = clock.End ();
+			std::cout << "  churn " << churn
+					<< " incremental " << incremental
+					<< " update " << churned << " ms"
+					<< " per change " << churned / (2.0 * churn) << " ms" << std::endl;
+		}
+
+		Simulator::Destroy ();
+		// the next topology reuses the same address range
+		Ipv4AddressGenerator::Reset ();
+	}
+	return 0;
+}
@@ -7,6 +7,14 @@
 
 #include "gsam-application.h"
 #include "ns3/ipsec.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/udp-socket-impl-multicast.h"
+#include "ns3/ipv4-l3-protocol-multicast.h"
+#include "ns3/loopback-net-device.h"
 #include <iostream>
 
 namespace ns3 {
@@ -22,17 +30,54 @@ GsamApplication::GetTypeId(void)
 	static TypeId tid = TypeId ("ns3::GsamApplication")
 	    		.SetParent<Application> ()
 				//.SetGroupName("Applications")
-				.AddConstructor<GsamApplication> ();
+				.AddConstructor<GsamApplication> ()
+				.AddAttribute ("DataRate",
+						"Rate the querier sends data packets to every secure group in use, 0 for no data traffic.",
+						DataRateValue (DataRate ("0bps")),
+						MakeDataRateAccessor (&GsamApplication::m_data_rate),
+						MakeDataRateChecker ())
+				.AddAttribute ("PacketSize",
+						"Size of the data packets, sequence number and timestamp included.",
+						UintegerValue (512),
+						MakeUintegerAccessor (&GsamApplication::m_packet_size),
+						MakeUintegerChecker<uint32_t> (12))
+				.AddAttribute ("DataPort",
+						"UDP port of the data packets.",
+						UintegerValue (5000),
+						MakeUintegerAccessor (&GsamApplication::m_data_port),
+						MakeUintegerChecker<uint16_t> ())
+				.AddAttribute ("ChurnInterval",
+						"Mean of the exponentially distributed time a group member stays in a group before leaving, "
+						"and stays out before rejoining. 0 for no churn.",
+						TimeValue (Seconds (0)),
+						MakeTimeAccessor (&GsamApplication::m_churn_interval),
+						MakeTimeChecker ())
+				.AddTraceSource ("Tx",
+						"A data packet is sent to a group.",
+						MakeTraceSourceAccessor (&GsamApplication::m_tx_trace),
+						"ns3::Packet::TracedCallback")
+				.AddTraceSource ("Rx",
+						"A data packet is received from a group, with the address of its sender.",
+						MakeTraceSourceAccessor (&GsamApplication::m_rx_trace),
+						"ns3::Packet::AddressTracedCallback")
+				.AddTraceSource ("RxDelay",
+						"One way delay of a data packet received.",
+						MakeTraceSourceAccessor (&GsamApplication::m_rx_delay_trace),
+						"ns3::Time::TracedCallback");
 	return tid;
 }
 
 GsamApplication::GsamApplication()
   :  m_ptr_igmp (0),
 	 m_ptr_gsam (0),
-	 m_num_events (0)
+	 m_num_events (0),
+	 m_packet_size (512),
+	 m_data_port (5000),
+	 m_data_socket (0),
+	 m_received (0),
+	 m_lost (0)
 {
-	// TODO Auto-generated constructor stub
-
+	this->m_churn_random = CreateObject<ExponentialRandomVariable> ();
 }
 
 GsamApplication::~GsamApplication()
@@ -71,6 +116,27 @@ GsamApplication::StopApplication (void)
 {
 	NS_LOG_FUNCTION (this);
 	this->m_event_current.Cancel();
+	this->m_event_send.Cancel();
+	if (0 != this->m_data_socket)
+	{
+		this->m_data_socket->Close();
+		this->m_data_socket = 0;
+	}
+	for (	std::map<Ipv4Address, Membership>::iterator it = this->m_map_memberships.begin();
+			it != this->m_map_memberships.end();
+			it++)
+	{
+		Membership& membership = it->second;
+		membership.m_event_churn.Cancel();
+		if (true == membership.m_joined)
+		{
+			this->CloseMembershipPeriod(membership);
+		}
+		//closing leaves the group
+		membership.m_socket->Close();
+		membership.m_socket = 0;
+	}
+	this->m_map_memberships.clear();
 }
 
 void
@@ -87,6 +153,31 @@ GsamApplication::GetEventsNumber (void)
 	return this->m_num_events;
 }
 
+uint32_t
+GsamApplication::GetReceived (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_received;
+}
+
+uint32_t
+GsamApplication::GetLost (void) const
+{
+	NS_LOG_FUNCTION (this);
+	uint32_t retval = this->m_lost;
+	for (	std::map<Ipv4Address, Membership>::const_iterator const_it = this->m_map_memberships.begin();
+			const_it != this->m_map_memberships.end();
+			const_it++)
+	{
+		const Membership& membership = const_it->second;
+		if ((true == membership.m_joined) && (true == membership.m_any_received))
+		{
+			retval += (membership.m_max_seq - membership.m_first_seq + 1) - membership.m_received;
+		}
+	}
+	return retval;
+}
+
 void
 GsamApplication::Initialization (void)
 {
@@ -166,7 +257,10 @@ GsamApplication::GenerateEvent (void)
 	NS_LOG_FUNCTION (this);
 	if (this->m_ptr_igmp->GetRole() == Igmpv3L4Protocol::QUERIER)
 	{
-
+		if (0 < this->m_data_rate.GetBitRate())
+		{
+			this->SendData();
+		}
 	}
 	else if (this->m_ptr_igmp->GetRole() == Igmpv3L4Protocol::NONQUERIER)
 	{
@@ -179,7 +273,18 @@ GsamApplication::GenerateEvent (void)
 	}
 	else if (this->m_ptr_igmp->GetRole() == Igmpv3L4Protocol::GROUP_MEMBER)
 	{
-		if (0 < this->m_num_events)
+		if ((0 < this->m_num_events) && (true == this->IsDataPlaneEnabled()))
+		{
+			//join through igmp, which runs gsam for a secure group
+			this->Join(GsamConfig::GetSingleton()->GetAnUnusedSecGrpAddress());
+			this->m_num_events--;
+			if (0 < this->m_num_events)
+			{
+				Time delay = GsamConfig::GetSingleton()->GetGmJoinIntervalInSeconds();
+				this->m_event_current = Simulator::Schedule(delay, &GsamApplication::GenerateEvent, this);
+			}
+		}
+		else if (0 < this->m_num_events)
 		{
 			//join
 			Ptr<GsamL4Protocol> gsam = this->GetGsam();
@@ -212,4 +317,190 @@ GsamApplication::GenerateEvent (void)
 
 }
 
+bool
+GsamApplication::IsDataPlaneEnabled (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return (0 < this->m_data_rate.GetBitRate()) || (false == this->m_churn_interval.IsZero());
+}
+
+uint32_t
+GsamApplication::GetDataInterface (void) const
+{
+	NS_LOG_FUNCTION (this);
+	Ptr<Ipv4L3ProtocolMulticast> ipv4l3 = this->GetNode()->GetObject<Ipv4L3ProtocolMulticast> ();
+	for (uint32_t i = this->GetNode()->GetNDevices(); i > 0; i--)
+	{
+		Ptr<NetDevice> device = this->GetNode()->GetDevice(i - 1);
+		if (device->GetInstanceTypeId() != LoopbackNetDevice::GetTypeId())
+		{
+			//the first real device
+			return ipv4l3->GetInterfaceForDevice(device);
+		}
+	}
+	NS_ASSERT (false);
+	return 0;
+}
+
+Ptr<Socket>
+GsamApplication::GetDataSocket (void)
+{
+	NS_LOG_FUNCTION (this);
+	if (0 == this->m_data_socket)
+	{
+		this->m_data_socket = Socket::CreateSocket(this->GetNode(), UdpSocketFactory::GetTypeId());
+		this->m_data_socket->Bind();
+	}
+	return this->m_data_socket;
+}
+
+void
+GsamApplication::SendData (void)
+{
+	NS_LOG_FUNCTION (this);
+	Ptr<Socket> socket = this->GetDataSocket();
+	std::list<Ipv4Address> group_addresses;
+	GsamConfig::GetSingleton()->GetUsedSecGrpAddresses(group_addresses);
+	for (	std::list<Ipv4Address>::const_iterator const_it = group_addresses.begin();
+			const_it != group_addresses.end();
+			const_it++)
+	{
+		SeqTsHeader seqts;
+		seqts.SetSeq(this->m_map_tx_seqs[*const_it]++);
+		Ptr<Packet> packet = Create<Packet> (this->m_packet_size - seqts.GetSerializedSize());
+		packet->AddHeader(seqts);
+		this->m_tx_trace(packet);
+		if (0 > socket->SendTo(packet, 0, InetSocketAddress(*const_it, this->m_data_port)))
+		{
+			NS_LOG_WARN ("Node: " << this->m_node->GetId() << " cannot send data to group " << *const_it << ", error " << socket->GetErrno());
+		}
+	}
+	Time interval = Seconds(this->m_packet_size * 8 / static_cast<double>(this->m_data_rate.GetBitRate()));
+	this->m_event_send = Simulator::Schedule(interval, &GsamApplication::SendData, this);
+}
+
+void
+GsamApplication::ReceiveData (Ptr<Socket> socket)
+{
+	NS_LOG_FUNCTION (this << socket);
+	Address local;
+	socket->GetSockName(local);
+	Ipv4Address group_address = InetSocketAddress::ConvertFrom(local).GetIpv4();
+	std::map<Ipv4Address, Membership>::iterator it = this->m_map_memberships.find(group_address);
+	NS_ASSERT (this->m_map_memberships.end() != it);
+	Membership& membership = it->second;
+
+	Ptr<Packet> packet;
+	Address from;
+	while ((packet = socket->RecvFrom(from)))
+	{
+		if (false == membership.m_joined)
+		{
+			//left the group, this one was already on its way
+			continue;
+		}
+		SeqTsHeader seqts;
+		if (packet->GetSize() < seqts.GetSerializedSize())
+		{
+			continue;
+		}
+		packet->PeekHeader(seqts);
+		uint32_t seq = seqts.GetSeq();
+		if (false == membership.m_any_received)
+		{
+			membership.m_any_received = true;
+			membership.m_first_seq = seq;
+			membership.m_max_seq = seq;
+		}
+		else if (seq < membership.m_first_seq)
+		{
+			//late packet from before the first one of this period
+			continue;
+		}
+		else if (seq > membership.m_max_seq)
+		{
+			membership.m_max_seq = seq;
+		}
+		membership.m_received++;
+		this->m_received++;
+		this->m_rx_trace(packet, from);
+		this->m_rx_delay_trace(Simulator::Now() - seqts.GetTs());
+	}
+}
+
+void
+GsamApplication::Join (Ipv4Address group_address)
+{
+	NS_LOG_FUNCTION (this << group_address);
+	std::map<Ipv4Address, Membership>::iterator it = this->m_map_memberships.find(group_address);
+	if (this->m_map_memberships.end() == it)
+	{
+		Membership membership;
+		membership.m_joined = false;
+		membership.m_socket = Socket::CreateSocket(this->GetNode(), UdpSocketFactory::GetTypeId());
+		membership.m_socket->Bind(InetSocketAddress(group_address, this->m_data_port));
+		membership.m_socket->SetRecvCallback(MakeCallback(&GsamApplication::ReceiveData, this));
+		it = this->m_map_memberships.insert(std::pair<Ipv4Address, Membership>(group_address, membership)).first;
+	}
+	Membership& membership = it->second;
+	NS_ASSERT (false == membership.m_joined);
+	membership.m_joined = true;
+	membership.m_any_received = false;
+	membership.m_first_seq = 0;
+	membership.m_max_seq = 0;
+	membership.m_received = 0;
+
+	GsamConfig::GetSingleton()->LogJoinStart(this->m_node->GetId(), group_address);
+
+	Ptr<UdpSocketImplMulticast> udp = DynamicCast<UdpSocketImplMulticast>(membership.m_socket);
+	udp->IPMulticastListen(	this->GetDataInterface(),
+							group_address,
+							ns3::EXCLUDE,
+							std::list<Ipv4Address> (),
+							GsamConfig::GetSingleton()->IsGroupAddressSecureGroup(group_address));
+
+	if (false == this->m_churn_interval.IsZero())
+	{
+		Time delay = Seconds(this->m_churn_random->GetValue(this->m_churn_interval.GetSeconds(), 0));
+		membership.m_event_churn = Simulator::Schedule(delay, &GsamApplication::Leave, this, group_address);
+	}
+}
+
+void
+GsamApplication::Leave (Ipv4Address group_address)
+{
+	NS_LOG_FUNCTION (this << group_address);
+	std::map<Ipv4Address, Membership>::iterator it = this->m_map_memberships.find(group_address);
+	NS_ASSERT (this->m_map_memberships.end() != it);
+	Membership& membership = it->second;
+	NS_ASSERT (true == membership.m_joined);
+	this->CloseMembershipPeriod(membership);
+	membership.m_joined = false;
+
+	//an include mode membership without sources is a leave
+	Ptr<UdpSocketImplMulticast> udp = DynamicCast<UdpSocketImplMulticast>(membership.m_socket);
+	udp->IPMulticastListen(	this->GetDataInterface(),
+							group_address,
+							ns3::INCLUDE,
+							std::list<Ipv4Address> ());
+
+	if (false == this->m_churn_interval.IsZero())
+	{
+		Time delay = Seconds(this->m_churn_random->GetValue(this->m_churn_interval.GetSeconds(), 0));
+		membership.m_event_churn = Simulator::Schedule(delay, &GsamApplication::Join, this, group_address);
+	}
+}
+
+void
+GsamApplication::CloseMembershipPeriod (Membership& membership)
+{
+	NS_LOG_FUNCTION (this);
+	if (true == membership.m_any_received)
+	{
+		this->m_lost += (membership.m_max_seq - membership.m_first_seq + 1) - membership.m_received;
+	}
+	membership.m_any_received = false;
+	membership.m_received = 0;
+}
+
 } /* namespace ns3 */
@@ -7,7 +7,14 @@
 
 #include "ns3/gsam-l4-protocol.h"
 #include "ns3/event-id.h"
+#include "ns3/data-rate.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/socket.h"
+#include "ns3/address.h"
 #include <list>
+#include <map>
 
 #ifndef SRC_APPLICATIONS_MODEL_GSAM_APPLICATION_H_
 #define SRC_APPLICATIONS_MODEL_GSAM_APPLICATION_H_
@@ -45,16 +52,68 @@ private:
 public:	//features
 	void SetEventsNumber (uint8_t events_number);
 	uint8_t GetEventsNumber (void);
+	/**
+	 * \returns the number of data packets received while being a member of their group
+	 */
+	uint32_t GetReceived (void) const;
+	/**
+	 * \returns the number of data packets sent to a group while being a member of it but never received
+	 */
+	uint32_t GetLost (void) const;
+	/**
+	 * \brief Listen to a group through igmp, gsam runs first for a secure group
+	 */
+	void Join (Ipv4Address group_address);
+	/**
+	 * \brief Stop listening to a group, a secure group also tears down its gsam session
+	 */
+	void Leave (Ipv4Address group_address);
 private:	//self-defined
+  /**
+   * \brief Reception state of one secure group on a group member.
+   *
+   * Sequence numbers are counted per membership period, so packets sent
+   * while the member had left the group are not taken as lost.
+   */
+  struct Membership
+  {
+    bool m_joined;	//!< currently a member
+    bool m_any_received;	//!< something was received in this membership period
+    uint32_t m_first_seq;	//!< first sequence number received in this membership period
+    uint32_t m_max_seq;	//!< highest sequence number received in this membership period
+    uint32_t m_received;	//!< packets received in this membership period
+    Ptr<Socket> m_socket;	//!< socket bound to the group and the data port
+    EventId m_event_churn;	//!< next leave or rejoin
+  };
   void Initialization (void);
   Ptr<GsamL4Protocol> GetGsam (void) const;
   Ptr<Igmpv3L4Protocol> GetIgmp (void) const;
   void GenerateEvent (void);
+  bool IsDataPlaneEnabled (void) const;
+  Ptr<Socket> GetDataSocket (void);
+  uint32_t GetDataInterface (void) const;
+  void SendData (void);
+  void ReceiveData (Ptr<Socket> socket);
+  void CloseMembershipPeriod (Membership& membership);
 private:
   Ptr<Igmpv3L4Protocol> m_ptr_igmp;
   Ptr<GsamL4Protocol> m_ptr_gsam;
   EventId m_event_current;
   uint8_t m_num_events;
+  DataRate m_data_rate;	//!< rate the querier sends to every secure group
+  uint32_t m_packet_size;	//!< size of the data packets, sequence and timestamp header included
+  uint16_t m_data_port;	//!< UDP port of the data packets
+  Time m_churn_interval;	//!< mean of the exponential membership and absence times of a group member, 0 for no churn
+  Ptr<ExponentialRandomVariable> m_churn_random;
+  Ptr<Socket> m_data_socket;	//!< sending socket, querier
+  EventId m_event_send;
+  std::map<Ipv4Address, uint32_t> m_map_tx_seqs;	//!< next sequence number per group, querier
+  std::map<Ipv4Address, Membership> m_map_memberships;	//!< reception state per group, group member
+  uint32_t m_received;
+  uint32_t m_lost;
+  TracedCallback<Ptr<const Packet> > m_tx_trace;	//!< data packet sent
+  TracedCallback<Ptr<const Packet>, const Address &> m_rx_trace;	//!< data packet received
+  TracedCallback<Time> m_rx_delay_trace;	//!< one way delay of a data packet received
 };
 
 } /* namespace ns3 */
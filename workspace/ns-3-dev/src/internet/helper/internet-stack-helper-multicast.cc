@@ -164,6 +164,9 @@
 #include "ns3/node-list.h"
 #include "ns3/core-config.h"
 #include "ns3/arp-l3-protocol-multicast.h"
+#include "ns3/arp-cache-multicast.h"
+#include "ns3/ipv4-interface-multicast.h"
+#include "ns3/channel.h"
 #include "internet-stack-helper-multicast.h"
 #include "ns3/ipv4-global-routing-multicast.h"
 #include "ns3/ipv4-list-routing-helper-multicast.h"
@@ -177,6 +180,7 @@
 #include "ns3/global-router-interface-multicast.h"
 #include <limits>
 #include <map>
+#include <vector>
 
 namespace ns3 {
 
@@ -334,6 +338,61 @@ void InternetStackHelperMulticast::SetIpv6NsRsJitter (bool enable)
   m_ipv6NsRsJitterEnabled = enable;
 }
 
+namespace {
+
+/// An address on a channel, and the ARP cache of its interface
+struct Neighbor
+{
+  Ptr<ArpCacheMulticast> cache; //!< ARP cache of the interface holding the address
+  Ipv4Address address;          //!< the address
+  Address macAddress;           //!< MAC address of the interface
+};
+
+} // anonymous namespace
+
+void
+InternetStackHelperMulticast::PopulateArpCache (const Ipv4InterfaceContainerMulticast &interfaces)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  std::map<Ptr<Channel>, std::vector<Neighbor> > channels;
+
+  for (Ipv4InterfaceContainerMulticast::Iterator i = interfaces.Begin (); i != interfaces.End (); i++)
+    {
+      Ptr<Ipv4L3ProtocolMulticast> ipv4 = i->first->GetObject<Ipv4L3ProtocolMulticast> ();
+      NS_ASSERT_MSG (ipv4 != 0, "InternetStackHelperMulticast::PopulateArpCache (): No Ipv4L3ProtocolMulticast");
+      Ptr<Ipv4InterfaceMulticast> interface = ipv4->GetInterface (i->second);
+      Ptr<NetDevice> device = interface->GetDevice ();
+      if (!device->NeedsArp () || device->GetChannel () == 0 || interface->GetArpCache () == 0)
+        {
+          continue;
+        }
+      std::vector<Neighbor> &neighbors = channels[device->GetChannel ()];
+      for (uint32_t j = 0; j < interface->GetNAddresses (); j++)
+        {
+          Neighbor neighbor;
+          neighbor.cache = interface->GetArpCache ();
+          neighbor.address = interface->GetAddress (j).GetLocal ();
+          neighbor.macAddress = device->GetAddress ();
+          neighbors.push_back (neighbor);
+        }
+    }
+
+  for (std::map<Ptr<Channel>, std::vector<Neighbor> >::iterator c = channels.begin (); c != channels.end (); c++)
+    {
+      std::vector<Neighbor> &neighbors = c->second;
+      for (std::vector<Neighbor>::iterator a = neighbors.begin (); a != neighbors.end (); a++)
+        {
+          for (std::vector<Neighbor>::iterator b = neighbors.begin (); b != neighbors.end (); b++)
+            {
+              if (a->cache != b->cache)
+                {
+                  a->cache->AddPermanent (b->address, b->macAddress);
+                }
+            }
+        }
+    }
+}
+
 int64_t
 InternetStackHelperMulticast::AssignStreams (NodeContainer c, int64_t stream)
 {
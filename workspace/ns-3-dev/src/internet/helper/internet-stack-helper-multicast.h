@@ -29,6 +29,7 @@
 #include "ns3/ipv4-l3-protocol-multicast.h"
 #include "ns3/ipv6-l3-protocol.h"
 #include "internet-trace-helper-multicast.h"
+#include "ipv4-interface-container-multicast.h"
 
 namespace ns3 {
 
@@ -198,6 +199,20 @@ public:
    */
   void SetIpv6NsRsJitter (bool enable);
 
+  /**
+   * \brief Pre-populate the ARP caches of interfaces sharing a channel.
+   *
+   * Every interface of the container gets a permanent ARP entry for each
+   * address of the other interfaces of the container on the same channel,
+   * so traffic between them never waits for an ARP resolution.  Meant for
+   * large experiments that should not measure ARP; interfaces on devices
+   * that do not need ARP are skipped.  The entries go away if the cache
+   * is flushed on a link change.
+   *
+   * \param interfaces the interfaces, with their addresses assigned
+   */
+  static void PopulateArpCache (const Ipv4InterfaceContainerMulticast &interfaces);
+
   /**
   * Assign a fixed random variable stream number to the random variables
   * used by this model.  Return the number of streams (possibly zero) that
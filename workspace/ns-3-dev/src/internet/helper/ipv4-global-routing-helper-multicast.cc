@@ -70,6 +70,11 @@ Ipv4GlobalRoutingHelperMulticast::RecomputeRoutingTables (void)
   GlobalRouteManagerMulticast::BuildGlobalRoutingDatabase ();
   GlobalRouteManagerMulticast::InitializeRoutes ();
 }
+void 
+Ipv4GlobalRoutingHelperMulticast::RecomputeRoutingTables (Ptr<Node> node)
+{
+  GlobalRouteManagerMulticast::UpdateRoutes (node);
+}
 
 
 } // namespace ns3
@@ -82,6 +82,18 @@ public:
    *
    */
   static void RecomputeRoutingTables (void);
+  /**
+   * \brief Update the routes after the interfaces or addresses of one node
+   * changed.
+   *
+   * With the "GlobalRoutingIncrementalSpf" global value set before
+   * PopulateRoutingTables(), only the LSAs around the node are originated
+   * again and only the roots that depend on them are recomputed.  Otherwise
+   * this is the same as RecomputeRoutingTables().
+   *
+   * \param node the node that changed
+   */
+  static void RecomputeRoutingTables (Ptr<Node> node);
 private:
   /**
    * \brief Assignment operator declared private and not implemented to disallow
@@ -70,7 +70,8 @@ ArpCacheMulticast::GetTypeId (void)
                    MakeUintegerAccessor (&ArpCacheMulticast::m_maxRetries),
                    MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("PendingQueueSize",
-                   "The size of the queue for packets pending an arp reply.",
+                   "The size of the queue for packets pending an arp reply, "
+                   "per entry.  Packets beyond it are dropped and counted.",
                    UintegerValue (3),
                    MakeUintegerAccessor (&ArpCacheMulticast::m_pendingQueueSize),
                    MakeUintegerChecker<uint32_t> ())
@@ -85,7 +86,8 @@ ArpCacheMulticast::GetTypeId (void)
 
 ArpCacheMulticast::ArpCacheMulticast ()
   : m_device (0), 
-    m_interface (0)
+    m_interface (0),
+    m_pendingDrops (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -222,6 +224,7 @@ ArpCacheMulticast::HandleWaitReplyTimeout (void)
               Ptr<Packet> pending = entry->DequeuePending ();
               while (pending != 0)
                 {
+                  m_pendingDrops++;
                   m_dropTrace (pending);
                   pending = entry->DequeuePending ();
                 }
@@ -243,6 +246,7 @@ ArpCacheMulticast::Flush (void)
   NS_LOG_FUNCTION (this);
   for (CacheI i = m_arpCache.begin (); i != m_arpCache.end (); i++) 
     {
+      m_pendingDrops += (*i).second->GetNPending ();
       delete (*i).second;
     }
   m_arpCache.erase (m_arpCache.begin (), m_arpCache.end ());
@@ -253,6 +257,31 @@ ArpCacheMulticast::Flush (void)
     }
 }
 
+ArpCacheMulticast::Entry *
+ArpCacheMulticast::AddPermanent (Ipv4Address to, Address macAddress)
+{
+  NS_LOG_FUNCTION (this << to << macAddress);
+  ArpCacheMulticast::Entry *entry = Lookup (to);
+  if (entry == 0)
+    {
+      entry = Add (to);
+    }
+  else if (entry->IsWaitReply ())
+    {
+      // the reply will resolve it and send the pending packets
+      return entry;
+    }
+  entry->SetMacAddresss (macAddress);
+  entry->MarkPermanent ();
+  return entry;
+}
+
+uint32_t
+ArpCacheMulticast::GetPendingDrops (void) const
+{
+  return m_pendingDrops;
+}
+
 void
 ArpCacheMulticast::PrintArpCache (Ptr<OutputStreamWrapper> stream)
 {
@@ -297,10 +326,10 @@ ArpCacheMulticast::Entry *
 ArpCacheMulticast::Lookup (Ipv4Address to)
 {
   NS_LOG_FUNCTION (this << to);
-  if (m_arpCache.find (to) != m_arpCache.end ()) 
+  CacheI i = m_arpCache.find (to);
+  if (i != m_arpCache.end ()) 
     {
-      ArpCacheMulticast::Entry *entry = m_arpCache[to];
-      return entry;
+      return i->second;
     }
   return 0;
 }
@@ -322,15 +351,14 @@ ArpCacheMulticast::Remove (ArpCacheMulticast::Entry *entry)
 {
   NS_LOG_FUNCTION (this << entry);
   
-  for (CacheI i = m_arpCache.begin (); i != m_arpCache.end (); i++)
+  CacheI i = m_arpCache.find (entry->GetIpv4Address ());
+  if (i != m_arpCache.end () && (*i).second == entry)
     {
-      if ((*i).second == entry)
-        {
-          m_arpCache.erase (i);
-          entry->ClearPendingPacket (); //clear the pending packets for entry's ipaddress
-          delete entry;
-          return;
-        }
+      m_arpCache.erase (i);
+      m_pendingDrops += entry->GetNPending ();
+      entry->ClearPendingPacket (); //clear the pending packets for entry's ipaddress
+      delete entry;
+      return;
     }
   NS_LOG_WARN ("Entry not found in this ARP Cache");
 }
@@ -409,6 +437,7 @@ ArpCacheMulticast::Entry::UpdateWaitReply (Ptr<Packet> waiting)
    */
   if (m_pending.size () >= m_arp->m_pendingQueueSize)
     {
+      m_arp->m_pendingDrops++;
       return false;
     }
   m_pending.push_back (waiting);
@@ -497,6 +526,18 @@ ArpCacheMulticast::Entry::DequeuePending (void)
       return p;
     }
 }
+void
+ArpCacheMulticast::Entry::DequeueAllPending (std::list<Ptr<Packet> > &packets)
+{
+  NS_LOG_FUNCTION (this);
+  packets.splice (packets.end (), m_pending);
+}
+uint32_t
+ArpCacheMulticast::Entry::GetNPending (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_pending.size ();
+}
 void 
 ArpCacheMulticast::Entry::ClearPendingPacket (void)
 {
@@ -160,6 +160,29 @@ public:
    */
   void Flush (void);
 
+  /**
+   * \brief Add a permanent entry.
+   *
+   * Used to pre-populate the cache so that no ARP request is ever sent for
+   * the address.  An entry already waiting for a reply is left alone.
+   *
+   * \param to the IPv4 address
+   * \param macAddress the MAC address of to
+   * \return the entry
+   */
+  ArpCacheMulticast::Entry *AddPermanent (Ipv4Address to, Address macAddress);
+
+  /**
+   * \brief Get the number of packets dropped while pending a resolution.
+   *
+   * Counts the packets refused because the pending queue of their entry
+   * was full, and the packets queued when the resolution failed or the
+   * cache was flushed.
+   *
+   * \return the number of dropped packets
+   */
+  uint32_t GetPendingDrops (void) const;
+
   /**
    * \brief Print the ARP cache entries
    *
@@ -245,6 +268,18 @@ public:
      *            packets are pending.
      */
     Ptr<Packet> DequeuePending (void);
+    /**
+     * \brief Move all the pending packets to the end of a list.
+     *
+     * Lets a resolved entry transmit its whole queue at once.
+     *
+     * \param packets the list receiving the packets, in queuing order
+     */
+    void DequeueAllPending (std::list<Ptr<Packet> > &packets);
+    /**
+     * \returns the number of pending packets
+     */
+    uint32_t GetNPending (void) const;
     /**
      * \brief Clear the pending packet list
      */
@@ -322,6 +357,7 @@ private:
    */
   void HandleWaitReplyTimeout (void);
   uint32_t m_pendingQueueSize; //!< number of packets waiting for a resolution
+  uint32_t m_pendingDrops; //!< number of packets dropped while waiting for a resolution
   Cache m_arpCache; //!< the ARP cache
   TracedCallback<Ptr<const Packet> > m_dropTrace; //!< trace for packets dropped by the ARP cache queue
 };
@@ -229,12 +229,16 @@ ArpL3ProtocolMulticast::Receive (Ptr<NetDevice> device, Ptr<const Packet> p, uin
                                        << " for waiting entry -- flush");
                   Address from_mac = arp.GetSourceHardwareAddress ();
                   entry->MarkAlive (from_mac);
-                  Ptr<Packet> pending = entry->DequeuePending ();
-                  while (pending != 0)
+                  // The address is resolved now, hand the whole queue to
+                  // the device instead of resolving it again per packet
+                  std::list<Ptr<Packet> > pending;
+                  entry->DequeueAllPending (pending);
+                  if (cache->GetInterface ()->IsUp ())
                     {
-                      cache->GetInterface ()->Send (pending,
-                                                    arp.GetSourceIpv4Address ());
-                      pending = entry->DequeuePending ();
+                      for (std::list<Ptr<Packet> >::iterator i = pending.begin (); i != pending.end (); i++)
+                        {
+                          device->Send (*i, from_mac, Ipv4L3ProtocolMulticast::PROT_NUMBER);
+                        }
                     }
                 } 
               else 
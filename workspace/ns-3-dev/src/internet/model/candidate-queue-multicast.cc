@@ -51,22 +51,26 @@ operator<< (std::ostream& os, const CandidateQueueMulticast& q)
 {
   typedef CandidateQueueMulticast::CandidateList_t List_t;
   typedef List_t::const_iterator CIter_t;
-  const CandidateQueueMulticast::CandidateList_t& list = q.m_candidates;
+  // print in pop order rather than heap order
+  List_t list = q.m_candidates;
+  std::sort (list.begin (), list.end (), &CandidateQueueMulticast::CompareCandidate);
 
   os << "*** CandidateQueueMulticast Begin (<id, distance, LSA-type>) ***" << std::endl;
   for (CIter_t iter = list.begin (); iter != list.end (); iter++)
     {
       os << "<" 
-      << (*iter)->GetVertexId () << ", "
-      << (*iter)->GetDistanceFromRoot () << ", "
-      << (*iter)->GetVertexType () << ">" << std::endl;
+      << iter->m_vertex->GetVertexId () << ", "
+      << iter->m_vertex->GetDistanceFromRoot () << ", "
+      << iter->m_vertex->GetVertexType () << ">" << std::endl;
     }
   os << "*** CandidateQueueMulticast End ***";
   return os;
 }
 
 CandidateQueueMulticast::CandidateQueueMulticast()
-  : m_candidates ()
+  : m_candidates (),
+    m_index (),
+    m_sequence (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -87,18 +91,23 @@ CandidateQueueMulticast::Clear (void)
       delete p;
       p = 0;
     }
+  m_sequence = 0;
 }
 
 void
 CandidateQueueMulticast::Push (SPFVertexMulticast *vNew)
 {
   NS_LOG_FUNCTION (this << vNew);
+  NS_ASSERT_MSG (m_index.find (vNew->GetVertexId ()) == m_index.end (),
+                 "Vertex " << vNew->GetVertexId () << " is already a candidate");
 
-  CandidateList_t::iterator i = std::upper_bound (
-      m_candidates.begin (), m_candidates.end (), vNew,
-      &CandidateQueueMulticast::CompareSPFVertex
-      );
-  m_candidates.insert (i, vNew);
+  Candidate candidate;
+  candidate.m_vertex = vNew;
+  candidate.m_sequence = m_sequence++;
+  m_candidates.push_back (candidate);
+  uint32_t pos = m_candidates.size () - 1;
+  m_index[vNew->GetVertexId ()] = pos;
+  SiftUp (pos);
 }
 
 SPFVertexMulticast *
@@ -110,8 +119,14 @@ CandidateQueueMulticast::Pop (void)
       return 0;
     }
 
-  SPFVertexMulticast *v = m_candidates.front ();
-  m_candidates.pop_front ();
+  SPFVertexMulticast *v = m_candidates.front ().m_vertex;
+  Swap (0, m_candidates.size () - 1);
+  m_candidates.pop_back ();
+  m_index.erase (v->GetVertexId ());
+  if (!m_candidates.empty ())
+    {
+      SiftDown (0);
+    }
   return v;
 }
 
@@ -124,7 +139,7 @@ CandidateQueueMulticast::Top (void) const
       return 0;
     }
 
-  return m_candidates.front ();
+  return m_candidates.front ().m_vertex;
 }
 
 bool
@@ -145,18 +160,13 @@ SPFVertexMulticast *
 CandidateQueueMulticast::Find (const Ipv4Address addr) const
 {
   NS_LOG_FUNCTION (this);
-  CandidateList_t::const_iterator i = m_candidates.begin ();
-
-  for (; i != m_candidates.end (); i++)
+  CandidateIndex_t::const_iterator i = m_index.find (addr);
+  if (i == m_index.end ())
     {
-      SPFVertexMulticast *v = *i;
-      if (v->GetVertexId () == addr)
-        {
-          return v;
-        }
+      return 0;
     }
 
-  return 0;
+  return m_candidates[i->second].m_vertex;
 }
 
 void
@@ -164,11 +174,100 @@ CandidateQueueMulticast::Reorder (void)
 {
   NS_LOG_FUNCTION (this);
 
-  m_candidates.sort (&CandidateQueueMulticast::CompareSPFVertex);
+  // Any number of distances may have changed, rebuild the heap bottom up
+  for (uint32_t pos = m_candidates.size () / 2; pos > 0; pos--)
+    {
+      SiftDown (pos - 1);
+    }
   NS_LOG_LOGIC ("After reordering the CandidateQueueMulticast");
   NS_LOG_LOGIC (*this);
 }
 
+void
+CandidateQueueMulticast::DecreaseKey (SPFVertexMulticast *v)
+{
+  NS_LOG_FUNCTION (this << v);
+
+  CandidateIndex_t::iterator i = m_index.find (v->GetVertexId ());
+  NS_ASSERT_MSG (i != m_index.end (), "Vertex " << v->GetVertexId () << " is not a candidate");
+  uint32_t pos = i->second;
+  NS_ASSERT (m_candidates[pos].m_vertex == v);
+
+  // The vertex reached its new distance now, so it queues behind the
+  // vertices already at that distance, as a stable re-sort would do
+  m_candidates[pos].m_sequence = m_sequence++;
+  SiftUp (pos);
+  NS_LOG_LOGIC ("After decreasing the key of " << v->GetVertexId ());
+  NS_LOG_LOGIC (*this);
+}
+
+void
+CandidateQueueMulticast::SiftUp (uint32_t pos)
+{
+  while (pos > 0)
+    {
+      uint32_t parent = (pos - 1) / 2;
+      if (!CompareCandidate (m_candidates[pos], m_candidates[parent]))
+        {
+          break;
+        }
+      Swap (pos, parent);
+      pos = parent;
+    }
+}
+
+void
+CandidateQueueMulticast::SiftDown (uint32_t pos)
+{
+  uint32_t size = m_candidates.size ();
+  while (true)
+    {
+      uint32_t left = 2 * pos + 1;
+      uint32_t right = left + 1;
+      uint32_t first = pos;
+      if (left < size && CompareCandidate (m_candidates[left], m_candidates[first]))
+        {
+          first = left;
+        }
+      if (right < size && CompareCandidate (m_candidates[right], m_candidates[first]))
+        {
+          first = right;
+        }
+      if (first == pos)
+        {
+          break;
+        }
+      Swap (pos, first);
+      pos = first;
+    }
+}
+
+void
+CandidateQueueMulticast::Swap (uint32_t a, uint32_t b)
+{
+  if (a == b)
+    {
+      return;
+    }
+  std::swap (m_candidates[a], m_candidates[b]);
+  m_index[m_candidates[a].m_vertex->GetVertexId ()] = a;
+  m_index[m_candidates[b].m_vertex->GetVertexId ()] = b;
+}
+
+bool
+CandidateQueueMulticast::CompareCandidate (const Candidate& c1, const Candidate& c2)
+{
+  if (CompareSPFVertex (c1.m_vertex, c2.m_vertex))
+    {
+      return true;
+    }
+  if (CompareSPFVertex (c2.m_vertex, c1.m_vertex))
+    {
+      return false;
+    }
+  return c1.m_sequence < c2.m_sequence;
+}
+
 /*
  * In this implementation, SPFVertexMulticast follows the ordering where
  * a vertex is ranked first if its GetDistanceFromRoot () is smaller;
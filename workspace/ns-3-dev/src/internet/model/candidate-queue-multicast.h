@@ -22,8 +22,9 @@
 #define CANDIDATE_QUEUE_MULTICAST_H
 
 #include <stdint.h>
-#include <list>
+#include <vector>
 #include "ns3/ipv4-address.h"
+#include "ns3/sgi-hashmap.h"
 
 namespace ns3 {
 
@@ -43,8 +44,13 @@ class SPFVertexMulticast;
  *
  * Although a STL priority_queue almost does what we want, the requirement
  * for a Find () operation, the dynamic nature of the data and the derived
- * requirement for a Reorder () operation led us to implement this simple 
- * enhanced priority queue.
+ * requirement for a DecreaseKey () operation led us to implement this
+ * indexed binary heap.  Push, Pop and DecreaseKey are O(log n), Find is a
+ * hash lookup on the vertex id.
+ *
+ * Vertices of equal distance keep the order of the former sorted list
+ * implementation: a NetworkLSA is popped before a RouterLSA, and otherwise
+ * the vertex that reached that distance first is popped first.
  */
 class CandidateQueueMulticast
 {
@@ -152,6 +158,19 @@ public:
  */
   void Reorder (void);
 
+/**
+ * @brief Restore the priority scheme after the distance of one vertex in
+ * the queue has been lowered.
+ *
+ * This is the O(log n) counterpart of Reorder () for the common case of
+ * SPFNexthopCalculation () finding a shorter path to a single candidate.
+ *
+ * @see SPFVertexMulticast
+ * @param v The Shortest Path First Vertex, already in the queue, whose
+ * m_distanceFromRoot has been lowered.
+ */
+  void DecreaseKey (SPFVertexMulticast *v);
+
 private:
 /**
  * Candidate Queue copy construction is disallowed (not implemented) to 
@@ -182,8 +201,52 @@ private:
  */
   static bool CompareSPFVertex (const SPFVertexMulticast* v1, const SPFVertexMulticast* v2);
 
-  typedef std::list<SPFVertexMulticast*> CandidateList_t; //!< container of SPFVertexMulticast pointers
+  /**
+   * \brief A vertex in the heap, with the order in which it reached its
+   * current distance.
+   */
+  struct Candidate
+  {
+    SPFVertexMulticast *m_vertex; //!< the candidate vertex
+    uint64_t m_sequence;          //!< tie breaker among equal vertices, lower first
+  };
+
+/**
+ * \brief return true if c1 should be popped before c2
+ *
+ * CompareSPFVertex () with the sequence number as the final tie breaker.
+ *
+ * \param c1 first operand
+ * \param c2 second operand
+ * \return True if c1 should be popped before c2; false otherwise
+ */
+  static bool CompareCandidate (const Candidate& c1, const Candidate& c2);
+
+/**
+ * \brief Move the candidate at the given heap position towards the top.
+ * \param pos heap position
+ */
+  void SiftUp (uint32_t pos);
+
+/**
+ * \brief Move the candidate at the given heap position towards the bottom.
+ * \param pos heap position
+ */
+  void SiftDown (uint32_t pos);
+
+/**
+ * \brief Swap two heap positions and update the position index.
+ * \param a first heap position
+ * \param b second heap position
+ */
+  void Swap (uint32_t a, uint32_t b);
+
+  typedef std::vector<Candidate> CandidateList_t; //!< binary heap of candidates
+  typedef sgi::hash_map<Ipv4Address, uint32_t, Ipv4AddressHash> CandidateIndex_t; //!< vertex id to heap position
+
   CandidateList_t m_candidates;  //!< SPFVertexMulticast candidates
+  CandidateIndex_t m_index;      //!< heap position of each candidate
+  uint64_t m_sequence;           //!< next tie breaker sequence number
 
   /**
    * \brief Stream insertion operator.
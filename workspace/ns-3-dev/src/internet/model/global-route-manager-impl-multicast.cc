@@ -26,6 +26,8 @@
 #include <vector>
 #include <queue>
 #include <algorithm>
+#include <iterator>
+#include <map>
 #include <iostream>
 #include "ns3/assert.h"
 #include "ns3/fatal-error.h"
@@ -35,6 +37,17 @@
 #include "ns3/ipv4-routing-protocol-multicast.h"
 #include "ns3/ipv4-list-routing-multicast.h"
 #include "ns3/mpi-interface.h"
+#include "ns3/global-value.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/channel.h"
+#include "ns3/net-device.h"
+#include "ns3/bridge-net-device.h"
+#include "ns3/core-config.h"
+#ifdef HAVE_PTHREAD_H
+#include "ns3/system-thread.h"
+#include "ns3/system-mutex.h"
+#endif
 #include "global-router-interface-multicast.h"
 #include "global-route-manager-impl-multicast.h"
 #include "candidate-queue-multicast.h"
@@ -47,6 +60,214 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("GlobalRouteManagerImplMulticast");
 
+/**
+ * \brief Number of threads the SPF calculations of InitializeRoutes () are
+ * spread over.  Only honoured when ns-3 is built with threading support;
+ * debug logging from several threads is interleaved.
+ */
+static GlobalValue g_spfThreads ("GlobalRoutingSpfThreads",
+                                 "The number of threads used to calculate the global routes",
+                                 UintegerValue (1),
+                                 MakeUintegerChecker<uint32_t> (1));
+
+/**
+ * \brief Keep the SPF tree and routes of every root after InitializeRoutes (),
+ * so UpdateRoutes () can recompute only what a change affects.  Costs memory
+ * in the order of the number of routers squared.
+ */
+static GlobalValue g_incrementalSpf ("GlobalRoutingIncrementalSpf",
+                                     "Keep the SPF trees so interface events only recompute the affected routes",
+                                     BooleanValue (false),
+                                     MakeBooleanChecker ());
+
+/**
+ * \brief A link of an LSA to another vertex, as the SPF calculation follows
+ * it.
+ */
+struct SPFEdgeMulticast
+{
+  Ipv4Address m_neighbor; //!< vertex id of the other end
+  Ipv4Address m_data;     //!< link data
+  uint16_t m_metric;      //!< cost of the link
+
+  /**
+   * \brief Order by neighbor, link data and metric.
+   * \param e the other link
+   * \returns true if this link comes first
+   */
+  bool operator< (const SPFEdgeMulticast& e) const
+  {
+    if (m_neighbor != e.m_neighbor)
+      {
+        return m_neighbor < e.m_neighbor;
+      }
+    if (m_data != e.m_data)
+      {
+        return m_data < e.m_data;
+      }
+    return m_metric < e.m_metric;
+  }
+};
+
+/**
+ * \brief Get the links of an LSA to other vertices, sorted.
+ * \param lsa the LSA
+ * \param edges the links
+ */
+static void
+GetSPFEdges (GlobalRoutingLSAMulticast* lsa, std::vector<SPFEdgeMulticast>& edges)
+{
+  if (lsa->GetLSType () == GlobalRoutingLSAMulticast::NetworkLSA)
+    {
+      for (uint32_t i = 0; i < lsa->GetNAttachedRouters (); i++)
+        {
+          SPFEdgeMulticast e;
+          e.m_neighbor = lsa->GetAttachedRouter (i);
+          e.m_metric = 0;
+          edges.push_back (e);
+        }
+    }
+  else
+    {
+      for (uint32_t i = 0; i < lsa->GetNLinkRecords (); i++)
+        {
+          GlobalRoutingLinkRecordMulticast* l = lsa->GetLinkRecord (i);
+          if (l->GetLinkType () == GlobalRoutingLinkRecordMulticast::PointToPoint
+              || l->GetLinkType () == GlobalRoutingLinkRecordMulticast::TransitNetwork)
+            {
+              SPFEdgeMulticast e;
+              e.m_neighbor = l->GetLinkId ();
+              e.m_data = l->GetLinkData ();
+              e.m_metric = l->GetMetric ();
+              edges.push_back (e);
+            }
+        }
+    }
+  std::sort (edges.begin (), edges.end ());
+}
+
+/**
+ * \brief Compare two LSAs as the SPF calculation sees them.
+ * \param a an LSA
+ * \param b another LSA
+ * \returns true if both describe the same links and networks
+ */
+static bool
+SameLSA (GlobalRoutingLSAMulticast* a, GlobalRoutingLSAMulticast* b)
+{
+  if (a->GetLSType () != b->GetLSType ()
+      || a->GetLinkStateId () != b->GetLinkStateId ()
+      || a->GetAdvertisingRouter () != b->GetAdvertisingRouter ()
+      || a->GetNetworkLSANetworkMask () != b->GetNetworkLSANetworkMask ()
+      || a->GetNAttachedRouters () != b->GetNAttachedRouters ()
+      || a->GetNLinkRecords () != b->GetNLinkRecords ())
+    {
+      return false;
+    }
+  for (uint32_t i = 0; i < a->GetNAttachedRouters (); i++)
+    {
+      if (a->GetAttachedRouter (i) != b->GetAttachedRouter (i))
+        {
+          return false;
+        }
+    }
+  for (uint32_t i = 0; i < a->GetNLinkRecords (); i++)
+    {
+      GlobalRoutingLinkRecordMulticast* la = a->GetLinkRecord (i);
+      GlobalRoutingLinkRecordMulticast* lb = b->GetLinkRecord (i);
+      if (la->GetLinkType () != lb->GetLinkType ()
+          || la->GetLinkId () != lb->GetLinkId ()
+          || la->GetLinkData () != lb->GetLinkData ()
+          || la->GetMetric () != lb->GetMetric ())
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+/**
+ * \brief Find the cheapest link of an LSA to a vertex.
+ * \param lsa the LSA
+ * \param neighbor vertex id of the other end
+ * \param metric set to the cost of the link
+ * \returns true if the LSA has a link to neighbor
+ */
+static bool
+GetSPFEdgeMetric (GlobalRoutingLSAMulticast* lsa, Ipv4Address neighbor, uint16_t& metric)
+{
+  std::vector<SPFEdgeMulticast> edges;
+  GetSPFEdges (lsa, edges);
+  bool found = false;
+  for (std::vector<SPFEdgeMulticast>::const_iterator i = edges.begin (); i != edges.end (); i++)
+    {
+      if (i->m_neighbor == neighbor && (!found || i->m_metric < metric))
+        {
+          metric = i->m_metric;
+          found = true;
+        }
+    }
+  return found;
+}
+
+/**
+ * \brief Test if a node bridges some of its devices.
+ * \param node the node
+ * \returns true if the node has a BridgeNetDevice
+ */
+static bool
+IsBridge (Ptr<Node> node)
+{
+  for (uint32_t i = 0; i < node->GetNDevices (); i++)
+    {
+      if (DynamicCast<BridgeNetDevice> (node->GetDevice (i)) != 0)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+/**
+ * \brief The roots left to calculate, shared by the SPF workers.
+ */
+class SPFWorkQueueMulticast
+{
+public:
+  /**
+   * \brief Constructor
+   * \param jobs the roots to hand out, in order
+   */
+  SPFWorkQueueMulticast (std::vector<GlobalRouteManagerImplMulticast::SPFRootJob>& jobs)
+    : m_jobs (jobs),
+      m_next (0)
+  {
+  }
+
+  /**
+   * \brief Take the next root to calculate.
+   * \returns the root job, or 0 once all roots have been handed out
+   */
+  GlobalRouteManagerImplMulticast::SPFRootJob* Next (void)
+  {
+#ifdef HAVE_PTHREAD_H
+    CriticalSection cs (m_mutex);
+#endif
+    if (m_next == m_jobs.size ())
+      {
+        return 0;
+      }
+    return &m_jobs[m_next++];
+  }
+
+private:
+  std::vector<GlobalRouteManagerImplMulticast::SPFRootJob>& m_jobs; //!< the roots
+  uint32_t m_next; //!< index of the next root to hand out
+#ifdef HAVE_PTHREAD_H
+  SystemMutex m_mutex; //!< protects m_next
+#endif
+};
+
 /**
  * \brief Stream insertion operator.
  *
@@ -474,6 +695,20 @@ GlobalRouteManagerLSDBMulticast::Insert (Ipv4Address addr, GlobalRoutingLSAMulti
     }
 }
 
+GlobalRoutingLSAMulticast*
+GlobalRouteManagerLSDBMulticast::Remove (Ipv4Address addr)
+{
+  NS_LOG_FUNCTION (this << addr);
+  LSDBMap_t::iterator i = m_database.find (addr);
+  if (i == m_database.end ())
+    {
+      return 0;
+    }
+  GlobalRoutingLSAMulticast* lsa = i->second;
+  m_database.erase (i);
+  return lsa;
+}
+
 GlobalRoutingLSAMulticast*
 GlobalRouteManagerLSDBMulticast::GetExtLSA (uint32_t index) const
 {
@@ -495,13 +730,10 @@ GlobalRouteManagerLSDBMulticast::GetLSA (Ipv4Address addr) const
 //
 // Look up an LSA by its address.
 //
-  LSDBMap_t::const_iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
+  LSDBMap_t::const_iterator i = m_database.find (addr);
+  if (i != m_database.end ())
     {
-      if (i->first == addr)
-        {
-          return i->second;
-        }
+      return i->second;
     }
   return 0;
 }
@@ -539,16 +771,32 @@ GlobalRouteManagerLSDBMulticast::GetLSAByLinkData (Ipv4Address addr) const
 
 GlobalRouteManagerImplMulticast::GlobalRouteManagerImplMulticast () 
   :
-    m_spfroot (0)
+    m_spfroot (0),
+    m_ownsLsdb (true),
+    m_spfJob (0),
+    m_spfQueue (0),
+    m_keepSPFTrees (false)
 {
   NS_LOG_FUNCTION (this);
   m_lsdb = new GlobalRouteManagerLSDBMulticast ();
 }
 
+GlobalRouteManagerImplMulticast::GlobalRouteManagerImplMulticast (GlobalRouteManagerLSDBMulticast* lsdb)
+  :
+    m_spfroot (0),
+    m_lsdb (lsdb),
+    m_ownsLsdb (false),
+    m_spfJob (0),
+    m_spfQueue (0),
+    m_keepSPFTrees (false)
+{
+  NS_LOG_FUNCTION (this << lsdb);
+}
+
 GlobalRouteManagerImplMulticast::~GlobalRouteManagerImplMulticast ()
 {
   NS_LOG_FUNCTION (this);
-  if (m_lsdb)
+  if (m_lsdb && m_ownsLsdb)
     {
       delete m_lsdb;
     }
@@ -578,19 +826,8 @@ GlobalRouteManagerImplMulticast::DeleteGlobalRoutes ()
         {
           continue;
         }
-      Ptr<Ipv4GlobalRoutingMulticast> gr = router->GetRoutingProtocol ();
-      uint32_t j = 0;
-      uint32_t nRoutes = gr->GetNRoutes ();
-      NS_LOG_LOGIC ("Deleting " << gr->GetNRoutes ()<< " routes from node " << node->GetId ());
-      // Each time we delete route 0, the route index shifts downward
-      // We can delete all routes if we delete the route numbered 0
-      // nRoutes times
-      for (j = 0; j < nRoutes; j++)
-        {
-          NS_LOG_LOGIC ("Deleting global route " << j << " from node " << node->GetId ());
-          gr->RemoveRoute (0);
-        }
-      NS_LOG_LOGIC ("Deleted " << j << " global routes from node "<< node->GetId ());
+      NS_LOG_LOGIC ("Deleting global routes from node " << node->GetId ());
+      RemoveAllRoutes (router->GetRoutingProtocol ());
     }
   if (m_lsdb)
     {
@@ -598,6 +835,25 @@ GlobalRouteManagerImplMulticast::DeleteGlobalRoutes ()
       delete m_lsdb;
       m_lsdb = new GlobalRouteManagerLSDBMulticast ();
     }
+  m_routers.clear ();
+  m_spfRoots.clear ();
+  m_keepSPFTrees = false;
+}
+
+void
+GlobalRouteManagerImplMulticast::RemoveAllRoutes (Ptr<Ipv4GlobalRoutingMulticast> routing)
+{
+  NS_LOG_FUNCTION (routing);
+  uint32_t j = 0;
+  uint32_t nRoutes = routing->GetNRoutes ();
+  // Each time we delete route 0, the route index shifts downward
+  // We can delete all routes if we delete the route numbered 0
+  // nRoutes times
+  for (j = 0; j < nRoutes; j++)
+    {
+      routing->RemoveRoute (0);
+    }
+  NS_LOG_LOGIC ("Deleted " << j << " global routes");
 }
 
 //
@@ -630,6 +886,15 @@ GlobalRouteManagerImplMulticast::BuildGlobalRoutingDatabase ()
         {
           continue;
         }
+      AddRouterInfo (node, rtr);
+      OriginateLSAs (rtr, m_routers[rtr->GetRouterId ()]);
+    }
+}
+
+void
+GlobalRouteManagerImplMulticast::OriginateLSAs (Ptr<GlobalRouterMulticast> rtr, RouterInfo& info)
+{
+  NS_LOG_FUNCTION (this << rtr);
 //
 // You must call DiscoverLSAs () before trying to use any routing info or to
 // update LSAs.  DiscoverLSAs () drives the process of discovering routes in
@@ -638,24 +903,36 @@ GlobalRouteManagerImplMulticast::BuildGlobalRoutingDatabase ()
 // DiscoverLSAs () will get zero as the number since no routes have been 
 // found.
 //
-      Ptr<Ipv4GlobalRoutingMulticast> grouting = rtr->GetRoutingProtocol ();
-      uint32_t numLSAs = rtr->DiscoverLSAs ();
-      NS_LOG_LOGIC ("Found " << numLSAs << " LSAs");
+  uint32_t numLSAs = rtr->DiscoverLSAs ();
+  NS_LOG_LOGIC ("Found " << numLSAs << " LSAs");
 
-      for (uint32_t j = 0; j < numLSAs; ++j)
-        {
-          GlobalRoutingLSAMulticast* lsa = new GlobalRoutingLSAMulticast ();
+  info.m_lsas.clear ();
+  info.m_externalLSAs = false;
+  for (uint32_t j = 0; j < numLSAs; ++j)
+    {
+      GlobalRoutingLSAMulticast* lsa = new GlobalRoutingLSAMulticast ();
 //
 // This is the call to actually fetch a Link State Advertisement from the 
 // router.
 //
-          rtr->GetLSA (j, *lsa);
-          NS_LOG_LOGIC (*lsa);
+      rtr->GetLSA (j, *lsa);
+      NS_LOG_LOGIC (*lsa);
 //
-// Write the newly discovered link state advertisement to the database.
+// Remember which LSAs the router originated, so they can be replaced when
+// the router changes.
 //
-          m_lsdb->Insert (lsa->GetLinkStateId (), lsa); 
+      if (lsa->GetLSType () == GlobalRoutingLSAMulticast::ASExternalLSAs)
+        {
+          info.m_externalLSAs = true;
         }
+      else
+        {
+          info.m_lsas.push_back (lsa->GetLinkStateId ());
+        }
+//
+// Write the newly discovered link state advertisement to the database.
+//
+      m_lsdb->Insert (lsa->GetLinkStateId (), lsa); 
     }
 }
 
@@ -693,41 +970,612 @@ GlobalRouteManagerImplMulticast::BuildGlobalRoutingDatabase ()
 // list becomes empty. 
 //
 void
-GlobalRouteManagerImplMulticast::InitializeRoutes ()
+GlobalRouteManagerImplMulticast::InitializeRoutes ()
+{
+  NS_LOG_FUNCTION (this);
+//
+// Walk the list of nodes in the system and collect the roots.  Everything
+// the SPF calculations need from the nodes was gathered, on the main thread,
+// by BuildGlobalRoutingDatabase (), so the calculations only read the LSDB
+// and m_routers.
+//
+  NS_LOG_INFO ("About to start SPF calculation");
+  BooleanValue incremental;
+  g_incrementalSpf.GetValue (incremental);
+  m_keepSPFTrees = incremental.Get ();
+  m_spfRoots.clear ();
+  std::vector<SPFRootJob> jobs;
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<Node> node = *i;
+//
+// Look for the GlobalRouterMulticast interface that indicates that the node is
+// participating in routing.
+//
+      Ptr<GlobalRouterMulticast> rtr = 
+        node->GetObject<GlobalRouterMulticast> ();
+
+      uint32_t systemId = MpiInterface::GetSystemId ();
+      // Ignore nodes that are not assigned to our systemId (distributed sim)
+      if (node->GetSystemId () != systemId) 
+        {
+          continue;
+        }
+
+//
+// if the node has a global router interface, then run the global routing
+// algorithms.
+//
+      if (rtr && rtr->GetNumLSAs () )
+        {
+          SPFRootJob job;
+          job.m_routerId = rtr->GetRouterId ();
+          job.m_router = GetRouterInfo (job.m_routerId);
+          job.m_keepTree = m_keepSPFTrees;
+          jobs.push_back (job);
+        }
+    }
+  RunSPFJobs (jobs);
+  NS_LOG_INFO ("Finished SPF calculation");
+}
+
+void
+GlobalRouteManagerImplMulticast::RunSPFJobs (std::vector<SPFRootJob>& jobs)
+{
+  NS_LOG_FUNCTION (this << jobs.size ());
+  UintegerValue threads;
+  g_spfThreads.GetValue (threads);
+  uint32_t nThreads = std::min<uint32_t> (threads.Get (), jobs.size ());
+#ifndef HAVE_PTHREAD_H
+  nThreads = 1;
+#endif
+
+  if (nThreads <= 1)
+    {
+      for (std::vector<SPFRootJob>::iterator it = jobs.begin (); it != jobs.end (); it++)
+        {
+          SPFCompute (*it);
+          InstallSPFRoutes (*it);
+        }
+    }
+#ifdef HAVE_PTHREAD_H
+  else
+    {
+      NS_LOG_LOGIC ("Spreading " << jobs.size () << " SPF calculations over " << nThreads << " threads");
+      SPFWorkQueueMulticast queue (jobs);
+      std::vector<GlobalRouteManagerImplMulticast*> workers;
+      std::vector<Ptr<SystemThread> > workerThreads;
+      for (uint32_t i = 0; i < nThreads; i++)
+        {
+          GlobalRouteManagerImplMulticast* worker = new GlobalRouteManagerImplMulticast (m_lsdb);
+          worker->m_spfQueue = &queue;
+          workers.push_back (worker);
+          workerThreads.push_back (Create<SystemThread> (MakeCallback (&GlobalRouteManagerImplMulticast::RunSPFWorker, worker)));
+          workerThreads.back ()->Start ();
+        }
+      for (uint32_t i = 0; i < nThreads; i++)
+        {
+          workerThreads[i]->Join ();
+          delete workers[i];
+        }
+//
+// Each root only writes its own forwarding table, so installing in root
+// order gives the same tables as the serial calculation.
+//
+      for (std::vector<SPFRootJob>::iterator it = jobs.begin (); it != jobs.end (); it++)
+        {
+          InstallSPFRoutes (*it);
+        }
+    }
+#endif
+  if (m_keepSPFTrees)
+    {
+      for (std::vector<SPFRootJob>::iterator it = jobs.begin (); it != jobs.end (); it++)
+        {
+          SPFRootJob& kept = m_spfRoots[it->m_routerId];
+          kept.m_routerId = it->m_routerId;
+          kept.m_router = it->m_router;
+          kept.m_keepTree = true;
+          kept.m_stub = it->m_stub;
+          kept.m_routes.swap (it->m_routes);
+          kept.m_tree.swap (it->m_tree);
+        }
+    }
+}
+
+void
+GlobalRouteManagerImplMulticast::AddRouterInfo (Ptr<Node> node, Ptr<GlobalRouterMulticast> rtr)
+{
+  NS_LOG_FUNCTION (this << node << rtr);
+  RouterInfo& info = m_routers[rtr->GetRouterId ()];
+  info.m_node = node;
+  info.m_routing = rtr->GetRoutingProtocol ();
+  NS_ASSERT (info.m_routing);
+//
+// Routing information is updated using the Ipv4Multicast interface.  If the
+// node is acting as an IP version 4 router, it should absolutely have one.
+// Remember its addresses in interface order, which is the order
+// GetInterfaceForPrefix () searches them in.
+//
+  info.m_ipv4 = node->GetObject<Ipv4Multicast> ();
+  NS_ASSERT_MSG (info.m_ipv4, 
+                 "GlobalRouteManagerImplMulticast::AddRouterInfo (): "
+                 "GetObject for <Ipv4Multicast> interface failed");
+  for (uint32_t i = 0; i < info.m_ipv4->GetNInterfaces (); i++)
+    {
+      for (uint32_t j = 0; j < info.m_ipv4->GetNAddresses (i); j++)
+        {
+          Ipv4Address local = info.m_ipv4->GetAddress (i, j).GetLocal ();
+          info.m_addresses.push_back (std::make_pair (local, i));
+          // keep the first interface, as the in order search would
+          info.m_addressIndex.insert (std::make_pair (local, i));
+        }
+    }
+}
+
+const GlobalRouteManagerImplMulticast::RouterInfo*
+GlobalRouteManagerImplMulticast::GetRouterInfo (Ipv4Address routerId) const
+{
+  RouterMap_t::const_iterator i = m_routers.find (routerId);
+  if (i == m_routers.end ())
+    {
+      return 0;
+    }
+  return &i->second;
+}
+
+void
+GlobalRouteManagerImplMulticast::InstallSPFRoutes (SPFRootJob& job) const
+{
+  NS_LOG_FUNCTION (this << job.m_routerId);
+  if (job.m_router == 0)
+    {
+      NS_LOG_LOGIC ("No node with router id " << job.m_routerId << ", dropping " << job.m_routes.size () << " routes");
+    }
+  else
+    {
+      for (std::vector<SPFRoute>::const_iterator it = job.m_routes.begin (); it != job.m_routes.end (); it++)
+        {
+          switch (it->m_type)
+            {
+            case SPFRoute::HostRoute:
+              job.m_router->m_routing->AddHostRouteTo (it->m_dest, it->m_nextHop, it->m_outIf);
+              break;
+            case SPFRoute::NetworkRoute:
+              job.m_router->m_routing->AddNetworkRouteTo (it->m_dest, it->m_mask, it->m_nextHop, it->m_outIf);
+              break;
+            case SPFRoute::ASExternalRoute:
+              job.m_router->m_routing->AddASExternalRouteTo (it->m_dest, it->m_mask, it->m_nextHop, it->m_outIf);
+              break;
+            default:
+              NS_ASSERT_MSG (0, "illegal SPFRoute type");
+            }
+        }
+    }
+  if (!job.m_keepTree)
+    {
+      std::vector<SPFRoute> ().swap (job.m_routes);
+    }
+}
+
+void
+GlobalRouteManagerImplMulticast::RunSPFWorker (void)
+{
+  NS_LOG_FUNCTION (this);
+  SPFRootJob* job;
+  while ((job = m_spfQueue->Next ()) != 0)
+    {
+      SPFCompute (*job);
+    }
+}
+
+void
+GlobalRouteManagerImplMulticast::RecomputeAllRoutes (void)
+{
+  NS_LOG_FUNCTION (this);
+  DeleteGlobalRoutes ();
+  BuildGlobalRoutingDatabase ();
+  InitializeRoutes ();
+}
+
+void
+GlobalRouteManagerImplMulticast::UpdateRoutes (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (this << node);
+  Ptr<GlobalRouterMulticast> rtr = node->GetObject<GlobalRouterMulticast> ();
+  if (!m_keepSPFTrees || rtr == 0)
+    {
+      NS_LOG_LOGIC ("No SPF trees kept, recomputing all routes");
+      RecomputeAllRoutes ();
+      return;
+    }
+//
+// The LSAs that can change are those of the node and of the routers it
+// shares a channel with: their point-to-point links and the network LSA of
+// a shared broadcast link, wherever the designated router is.  Bridged links
+// reach further than one channel, so leave them to a full recomputation.
+//
+  std::vector<Ptr<Node> > nodes;
+  nodes.push_back (node);
+  for (uint32_t i = 0; i < node->GetNDevices (); i++)
+    {
+      Ptr<Channel> channel = node->GetDevice (i)->GetChannel ();
+      if (channel == 0)
+        {
+          continue;
+        }
+      for (uint32_t j = 0; j < channel->GetNDevices (); j++)
+        {
+          Ptr<Node> peer = channel->GetDevice (j)->GetNode ();
+          if (peer->GetObject<GlobalRouterMulticast> () != 0
+              && std::find (nodes.begin (), nodes.end (), peer) == nodes.end ())
+            {
+              nodes.push_back (peer);
+            }
+        }
+    }
+  std::vector<Ipv4Address> routerIds;
+  for (std::vector<Ptr<Node> >::const_iterator i = nodes.begin (); i != nodes.end (); i++)
+    {
+      Ipv4Address id = (*i)->GetObject<GlobalRouterMulticast> ()->GetRouterId ();
+      RouterMap_t::const_iterator info = m_routers.find (id);
+      if (IsBridge (*i) || info == m_routers.end () || info->second.m_externalLSAs)
+        {
+          NS_LOG_LOGIC ("Router " << id << " is new, bridged or has external routes, recomputing all routes");
+          RecomputeAllRoutes ();
+          return;
+        }
+      routerIds.push_back (id);
+    }
+//
+// Take the LSAs of these routers out of the LSDB, then have the routers
+// originate them again.  All old LSAs go first, as a network LSA may move
+// from one router to another.
+//
+  typedef std::map<Ipv4Address, GlobalRoutingLSAMulticast*> LSAMap_t;
+  LSAMap_t oldLSAs;
+  LSAMap_t newLSAs;
+  for (std::vector<Ipv4Address>::const_iterator i = routerIds.begin (); i != routerIds.end (); i++)
+    {
+      const RouterInfo& info = m_routers[*i];
+      for (std::vector<Ipv4Address>::const_iterator j = info.m_lsas.begin (); j != info.m_lsas.end (); j++)
+        {
+          oldLSAs[*j] = m_lsdb->Remove (*j);
+        }
+      m_routers.erase (*i);
+    }
+  bool externals = false;
+  for (std::vector<Ptr<Node> >::const_iterator i = nodes.begin (); i != nodes.end (); i++)
+    {
+      Ptr<GlobalRouterMulticast> r = (*i)->GetObject<GlobalRouterMulticast> ();
+      AddRouterInfo (*i, r);
+      RouterInfo& info = m_routers[r->GetRouterId ()];
+      OriginateLSAs (r, info);
+      externals = externals || info.m_externalLSAs;
+      for (std::vector<Ipv4Address>::const_iterator j = info.m_lsas.begin (); j != info.m_lsas.end (); j++)
+        {
+          newLSAs[*j] = m_lsdb->GetLSA (*j);
+        }
+    }
+  if (externals)
+    {
+      NS_LOG_LOGIC ("External routes appeared, recomputing all routes");
+      for (LSAMap_t::iterator i = oldLSAs.begin (); i != oldLSAs.end (); i++)
+        {
+          delete i->second;
+        }
+      RecomputeAllRoutes ();
+      return;
+    }
+
+  std::vector<Ipv4Address> changed;
+  for (LSAMap_t::const_iterator i = oldLSAs.begin (); i != oldLSAs.end (); i++)
+    {
+      LSAMap_t::const_iterator j = newLSAs.find (i->first);
+      if (j == newLSAs.end () || !SameLSA (i->second, j->second))
+        {
+          changed.push_back (i->first);
+        }
+    }
+  for (LSAMap_t::const_iterator j = newLSAs.begin (); j != newLSAs.end (); j++)
+    {
+      if (oldLSAs.find (j->first) == oldLSAs.end ())
+        {
+          changed.push_back (j->first);
+        }
+    }
+  NS_LOG_LOGIC (changed.size () << " of " << oldLSAs.size () << " LSAs changed");
+//
+// Sort the roots, in node order, into those that must run their SPF
+// calculation again and those where only the routes found at the changed
+// vertices need to be redone.  The routers that changed always run it, as
+// their interfaces and addresses may have changed too.
+//
+  std::vector<SPFRootJob> jobs;
+  uint32_t nPartial = 0;
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<GlobalRouterMulticast> r = (*i)->GetObject<GlobalRouterMulticast> ();
+      if ((*i)->GetSystemId () != MpiInterface::GetSystemId () || r == 0 || r->GetNumLSAs () == 0)
+        {
+          continue;
+        }
+      Ipv4Address id = r->GetRouterId ();
+      if (GetRouterInfo (id) == 0)
+        {
+          NS_LOG_LOGIC ("Router " << id << " is new, recomputing all routes");
+          for (LSAMap_t::iterator j = oldLSAs.begin (); j != oldLSAs.end (); j++)
+            {
+              delete j->second;
+            }
+          RecomputeAllRoutes ();
+          return;
+        }
+      SPFRootMap_t::iterator kept = m_spfRoots.find (id);
+      bool full = kept == m_spfRoots.end ()
+        || std::find (routerIds.begin (), routerIds.end (), id) != routerIds.end ();
+      std::vector<Ipv4Address> vertices;
+      for (std::vector<Ipv4Address>::const_iterator c = changed.begin (); c != changed.end () && !full; c++)
+        {
+          bool inTree = kept->second.m_tree.find (*c) != kept->second.m_tree.end ();
+          LSAMap_t::const_iterator oldLsa = oldLSAs.find (*c);
+          LSAMap_t::const_iterator newLsa = newLSAs.find (*c);
+          if (kept->second.m_stub)
+            {
+              full = inTree;
+            }
+          else if (SPFTreeChanged (kept->second,
+                                   oldLsa == oldLSAs.end () ? 0 : oldLsa->second,
+                                   newLsa == newLSAs.end () ? 0 : newLsa->second))
+            {
+              full = true;
+            }
+          else if (inTree && newLsa != newLSAs.end ())
+            {
+              vertices.push_back (*c);
+            }
+        }
+      if (full)
+        {
+          if (kept != m_spfRoots.end ())
+            {
+              m_spfRoots.erase (kept);
+            }
+          SPFRootJob job;
+          job.m_routerId = id;
+          job.m_router = GetRouterInfo (id);
+          job.m_keepTree = true;
+          RemoveAllRoutes (job.m_router->m_routing);
+          jobs.push_back (job);
+        }
+      else if (!vertices.empty ())
+        {
+          kept->second.m_router = GetRouterInfo (id);
+          SPFUpdateVertexRoutes (kept->second, vertices);
+          RemoveAllRoutes (kept->second.m_router->m_routing);
+          InstallSPFRoutes (kept->second);
+          nPartial++;
+        }
+    }
+  NS_LOG_INFO ("Updating routes of " << node->GetId () << ": " << jobs.size () << " roots recalculated, "
+               << nPartial << " roots patched");
+  RunSPFJobs (jobs);
+
+  for (LSAMap_t::iterator i = oldLSAs.begin (); i != oldLSAs.end (); i++)
+    {
+      delete i->second;
+    }
+}
+
+bool
+GlobalRouteManagerImplMulticast::SPFTreeChanged (const SPFRootJob& job, GlobalRoutingLSAMulticast* oldLsa, GlobalRoutingLSAMulticast* newLsa) const
+{
+  NS_LOG_FUNCTION (this << job.m_routerId << oldLsa << newLsa);
+  std::vector<SPFEdgeMulticast> oldEdges;
+  std::vector<SPFEdgeMulticast> newEdges;
+  if (oldLsa != 0)
+    {
+      GetSPFEdges (oldLsa, oldEdges);
+    }
+  if (newLsa != 0)
+    {
+      GetSPFEdges (newLsa, newEdges);
+    }
+  Ipv4Address id = oldLsa != 0 ? oldLsa->GetLinkStateId () : newLsa->GetLinkStateId ();
+  SPFTree_t::const_iterator x = job.m_tree.find (id);
+//
+// A link that is gone, or costs more now, matters if it joined the vertex
+// to a parent or a child in the tree.
+//
+  std::vector<SPFEdgeMulticast> removed;
+  std::set_difference (oldEdges.begin (), oldEdges.end (), newEdges.begin (), newEdges.end (),
+                       std::back_inserter (removed));
+  for (std::vector<SPFEdgeMulticast>::const_iterator e = removed.begin (); e != removed.end () && x != job.m_tree.end (); e++)
+    {
+      SPFTree_t::const_iterator w = job.m_tree.find (e->m_neighbor);
+      if (w == job.m_tree.end ())
+        {
+          continue;
+        }
+      if (std::find (w->second.m_parents.begin (), w->second.m_parents.end (), id) != w->second.m_parents.end ()
+          || std::find (x->second.m_parents.begin (), x->second.m_parents.end (), e->m_neighbor) != x->second.m_parents.end ())
+        {
+          NS_LOG_LOGIC ("Tree link " << id << " - " << e->m_neighbor << " changed");
+          return true;
+        }
+    }
+//
+// A link that is new, or costs less now, matters if it makes a path to
+// either end at least as short as the one in the tree.  The link can be
+// followed both ways once both ends list it.
+//
+  std::vector<SPFEdgeMulticast> added;
+  std::set_difference (newEdges.begin (), newEdges.end (), oldEdges.begin (), oldEdges.end (),
+                       std::back_inserter (added));
+  for (std::vector<SPFEdgeMulticast>::const_iterator e = added.begin (); e != added.end (); e++)
+    {
+      SPFTree_t::const_iterator w = job.m_tree.find (e->m_neighbor);
+      if (x == job.m_tree.end () && w == job.m_tree.end ())
+        {
+          continue;
+        }
+      if (x == job.m_tree.end () || w == job.m_tree.end ())
+        {
+          NS_LOG_LOGIC ("Link " << id << " - " << e->m_neighbor << " may extend the tree");
+          return true;
+        }
+      if (x->second.m_distance + e->m_metric <= w->second.m_distance)
+        {
+          NS_LOG_LOGIC ("Link " << id << " - " << e->m_neighbor << " is a shortest path");
+          return true;
+        }
+      GlobalRoutingLSAMulticast* wLsa = m_lsdb->GetLSA (e->m_neighbor);
+      uint16_t back = 0;
+      if (wLsa != 0 && GetSPFEdgeMetric (wLsa, id, back)
+          && w->second.m_distance + back <= x->second.m_distance)
+        {
+          NS_LOG_LOGIC ("Link " << e->m_neighbor << " - " << id << " is a shortest path");
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+GlobalRouteManagerImplMulticast::SPFUpdateVertexRoutes (SPFRootJob& job, const std::vector<Ipv4Address>& vertices)
 {
-  NS_LOG_FUNCTION (this);
+  NS_LOG_FUNCTION (this << job.m_routerId << vertices.size ());
 //
-// Walk the list of nodes in the system.
+// Drop the routes found at the vertices.  External routes only depend on
+// the exit directions to the vertex, which did not change.
 //
-  NS_LOG_INFO ("About to start SPF calculation");
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+  std::vector<SPFRoute> routes;
+  for (std::vector<SPFRoute>::const_iterator i = job.m_routes.begin (); i != job.m_routes.end (); i++)
     {
-      Ptr<Node> node = *i;
+      if (i->m_type == SPFRoute::ASExternalRoute
+          || std::find (vertices.begin (), vertices.end (), i->m_origin) == vertices.end ())
+        {
+          routes.push_back (*i);
+        }
+    }
+  job.m_routes.swap (routes);
 //
-// Look for the GlobalRouterMulticast interface that indicates that the node is
-// participating in routing.
+// And find them again from the new LSAs, the way the SPF calculation adds
+// them when it reaches each vertex.
 //
-      Ptr<GlobalRouterMulticast> rtr = 
-        node->GetObject<GlobalRouterMulticast> ();
-
-      uint32_t systemId = MpiInterface::GetSystemId ();
-      // Ignore nodes that are not assigned to our systemId (distributed sim)
-      if (node->GetSystemId () != systemId) 
+  m_spfJob = &job;
+  m_spfroot = new SPFVertexMulticast (m_lsdb->GetLSA (job.m_routerId));
+  for (std::vector<Ipv4Address>::const_iterator i = vertices.begin (); i != vertices.end (); i++)
+    {
+      SPFTree_t::const_iterator tv = job.m_tree.find (*i);
+      NS_ASSERT (tv != job.m_tree.end ());
+      GlobalRoutingLSAMulticast* lsa = m_lsdb->GetLSA (*i);
+      SPFVertexMulticast v (lsa);
+      for (std::vector<SPFVertexMulticast::NodeExit_t>::const_iterator e = tv->second.m_exits.begin ();
+           e != tv->second.m_exits.end (); e++)
         {
-          continue;
+          SPFVertexMulticast exit;
+          exit.SetRootExitDirection (*e);
+          v.MergeRootExitDirections (&exit);
+        }
+      if (v.GetVertexType () == SPFVertexMulticast::VertexRouter)
+        {
+          SPFIntraAddRouter (&v);
+          for (uint32_t j = 0; j < lsa->GetNLinkRecords (); j++)
+            {
+              GlobalRoutingLinkRecordMulticast *l = lsa->GetLinkRecord (j);
+              if (l->GetLinkType () == GlobalRoutingLinkRecordMulticast::StubNetwork)
+                {
+                  SPFIntraAddStub (l, &v);
+                }
+            }
         }
+      else if (v.GetVertexType () == SPFVertexMulticast::VertexNetwork)
+        {
+          SPFIntraAddTransit (&v);
+        }
+      else
+        {
+          NS_ASSERT_MSG (0, "illegal SPFVertexMulticast type");
+        }
+    }
+  delete m_spfroot;
+  m_spfroot = 0;
+  m_spfJob = 0;
+}
 
-//
-// if the node has a global router interface, then run the global routing
-// algorithms.
-//
-      if (rtr && rtr->GetNumLSAs () )
+void
+GlobalRouteManagerImplMulticast::RecordSPFTreeVertex (SPFVertexMulticast* v)
+{
+  NS_LOG_FUNCTION (this << v);
+  SPFTreeVertex& tv = m_spfJob->m_tree[v->GetVertexId ()];
+  tv.m_distance = v->GetDistanceFromRoot ();
+  tv.m_parents.clear ();
+  tv.m_exits.clear ();
+  for (uint32_t i = 0; v->GetParent (i) != 0; i++)
+    {
+      tv.m_parents.push_back (v->GetParent (i)->GetVertexId ());
+    }
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      tv.m_exits.push_back (v->GetRootExitDirection (i));
+    }
+}
+
+GlobalRoutingLSAMulticast::SPFStatus
+GlobalRouteManagerImplMulticast::GetSPFStatus (GlobalRoutingLSAMulticast* lsa) const
+{
+  SPFStatusMap_t::const_iterator i = m_spfStatus.find (lsa->GetLinkStateId ());
+  if (i == m_spfStatus.end ())
+    {
+      return GlobalRoutingLSAMulticast::LSA_SPF_NOT_EXPLORED;
+    }
+  return i->second;
+}
+
+void
+GlobalRouteManagerImplMulticast::SetSPFStatus (GlobalRoutingLSAMulticast* lsa, GlobalRoutingLSAMulticast::SPFStatus status)
+{
+  m_spfStatus[lsa->GetLinkStateId ()] = status;
+}
+
+void
+GlobalRouteManagerImplMulticast::AddSPFRoutes (SPFRoute::RouteType_e type, Ipv4Address dest, Ipv4Mask mask, SPFVertexMulticast* v)
+{
+  NS_LOG_FUNCTION (this << type << dest << mask << v);
+  // walk through all available exit directions due to ECMP,
+  // and add a route for each of the exit direction toward
+  // the vertex 'v'
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      SPFVertexMulticast::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
+      if (outIf >= 0)
         {
-          SPFCalculate (rtr->GetRouterId ());
+          SPFRoute route;
+          route.m_type = type;
+          route.m_dest = dest;
+          route.m_mask = mask;
+          route.m_nextHop = nextHop;
+          route.m_outIf = outIf;
+          route.m_origin = v->GetVertexId ();
+          m_spfJob->m_routes.push_back (route);
+          NS_LOG_LOGIC ("(Route " << i << ") Router " << m_spfJob->m_routerId <<
+                        " add route to " << dest << "/" << mask <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
+        }
+      else
+        {
+          NS_LOG_LOGIC ("(Route " << i << ") Router " << m_spfJob->m_routerId <<
+                        " NOT able to add route to " << dest << "/" << mask <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative " << outIf);
         }
     }
-  NS_LOG_INFO ("Finished SPF calculation");
 }
 
 //
@@ -836,7 +1684,7 @@ GlobalRouteManagerImplMulticast::SPFNext (SPFVertexMulticast* v, CandidateQueueM
 // If the link is to a router that is already in the shortest path first tree
 // then we have it covered -- ignore it.
 //
-      if (w_lsa->GetStatus () == GlobalRoutingLSAMulticast::LSA_SPF_IN_SPFTREE) 
+      if (GetSPFStatus (w_lsa) == GlobalRoutingLSAMulticast::LSA_SPF_IN_SPFTREE) 
         {
           NS_LOG_LOGIC ("Skipping ->  LSA "<< 
                         w_lsa->GetLinkStateId () << " already in SPF tree");
@@ -861,7 +1709,7 @@ GlobalRouteManagerImplMulticast::SPFNext (SPFVertexMulticast* v, CandidateQueueM
       NS_LOG_LOGIC ("Considering w_lsa " << w_lsa->GetLinkStateId ());
 
 // Is there already vertex w in candidate list?
-      if (w_lsa->GetStatus () == GlobalRoutingLSAMulticast::LSA_SPF_NOT_EXPLORED)
+      if (GetSPFStatus (w_lsa) == GlobalRoutingLSAMulticast::LSA_SPF_NOT_EXPLORED)
         {
 // Calculate nexthop to w
 // We need to figure out how to actually get to the new router represented
@@ -873,7 +1721,7 @@ GlobalRouteManagerImplMulticast::SPFNext (SPFVertexMulticast* v, CandidateQueueM
           w = new SPFVertexMulticast (w_lsa);
           if (SPFNexthopCalculation (v, w, l, distance))
             {
-              w_lsa->SetStatus (GlobalRoutingLSAMulticast::LSA_SPF_CANDIDATE);
+              SetSPFStatus (w_lsa, GlobalRoutingLSAMulticast::LSA_SPF_CANDIDATE);
 //
 // Push this new vertex onto the priority queue (ordered by distance from the
 // root node).
@@ -888,7 +1736,7 @@ GlobalRouteManagerImplMulticast::SPFNext (SPFVertexMulticast* v, CandidateQueueM
             NS_ASSERT_MSG (0, "SPFNexthopCalculation never " 
                            << "return false, but it does now!");
         }
-      else if (w_lsa->GetStatus () == GlobalRoutingLSAMulticast::LSA_SPF_CANDIDATE)
+      else if (GetSPFStatus (w_lsa) == GlobalRoutingLSAMulticast::LSA_SPF_CANDIDATE)
         {
 //
 // We have already considered the link represented by <w>.  What wse have to
@@ -960,7 +1808,7 @@ GlobalRouteManagerImplMulticast::SPFNext (SPFVertexMulticast* v, CandidateQueueM
 // If we've changed the cost to get to the vertex represented by <w>, we 
 // must reorder the priority queue keyed to that cost.
 //
-                  candidate.Reorder ();
+                  candidate.DecreaseKey (cw);
                 }
             } // new lower cost path found
         } // end W is already on the candidate list
@@ -1320,15 +2168,23 @@ GlobalRouteManagerImplMulticast::CheckForStubNode (Ipv4Address root)
               if (lr->GetLinkId () == myRouterId)
                 {
                   // Next hop is stored in the LinkID field of lr
-                  Ptr<GlobalRouterMulticast> router = rlsa->GetNode ()->GetObject<GlobalRouterMulticast> ();
-                  NS_ASSERT (router);
-                  Ptr<Ipv4GlobalRoutingMulticast> gr = router->GetRoutingProtocol ();
-                  NS_ASSERT (gr);
-                  gr->AddNetworkRouteTo (Ipv4Address ("0.0.0.0"), Ipv4Mask ("0.0.0.0"), lr->GetLinkData (), 
-                                         FindOutgoingInterfaceId (transitLink->GetLinkData ()));
+                  SPFRoute route;
+                  route.m_type = SPFRoute::NetworkRoute;
+                  route.m_dest = Ipv4Address ("0.0.0.0");
+                  route.m_mask = Ipv4Mask ("0.0.0.0");
+                  route.m_nextHop = lr->GetLinkData ();
+                  route.m_outIf = FindOutgoingInterfaceId (transitLink->GetLinkData ());
+                  route.m_origin = transitLink->GetLinkId ();
+                  m_spfJob->m_routes.push_back (route);
+                  if (m_spfJob->m_keepTree)
+                    {
+                      // the default route only depends on the link to the peer
+                      SPFTreeVertex& peer = m_spfJob->m_tree[transitLink->GetLinkId ()];
+                      peer.m_distance = transitLink->GetMetric ();
+                      peer.m_parents.push_back (myRouterId);
+                    }
                   NS_LOG_LOGIC ("Inserting default route for node " << myRouterId << " to next hop " << 
-                                lr->GetLinkData () << " via interface " << 
-                                FindOutgoingInterfaceId (transitLink->GetLinkData ()));
+                                lr->GetLinkData () << " via interface " << route.m_outIf);
                   return true;
                 }
             }
@@ -1337,17 +2193,38 @@ GlobalRouteManagerImplMulticast::CheckForStubNode (Ipv4Address root)
   return false;
 }
 
-// quagga ospf_spf_calculate
 void
 GlobalRouteManagerImplMulticast::SPFCalculate (Ipv4Address root)
 {
   NS_LOG_FUNCTION (this << root);
 
+  SPFRootJob job;
+  job.m_routerId = root;
+//
+// The node of the root may be missing; the unit tests calculate on an LSDB
+// without nodes.
+//
+  job.m_router = GetRouterInfo (root);
+  SPFCompute (job);
+  InstallSPFRoutes (job);
+}
+
+// quagga ospf_spf_calculate
+void
+GlobalRouteManagerImplMulticast::SPFCompute (SPFRootJob& job)
+{
+  Ipv4Address root = job.m_routerId;
+  NS_LOG_FUNCTION (this << root);
+
   SPFVertexMulticast *v;
 //
-// Initialize the Link State Database.
+// Initialize the per-root LSA status, the shared Link State Database is only
+// read.
 //
-  m_lsdb->Initialize ();
+  m_spfJob = &job;
+  m_spfStatus.clear ();
+  job.m_stub = false;
+  job.m_tree.clear ();
 //
 // The candidate queue is a priority queue of SPFVertexMulticast objects, with the top
 // of the queue being the closest vertex in terms of distance from the root
@@ -1367,7 +2244,11 @@ GlobalRouteManagerImplMulticast::SPFCalculate (Ipv4Address root)
 //
   m_spfroot= v;
   v->SetDistanceFromRoot (0);
-  v->GetLSA ()->SetStatus (GlobalRoutingLSAMulticast::LSA_SPF_IN_SPFTREE);
+  SetSPFStatus (v->GetLSA (), GlobalRoutingLSAMulticast::LSA_SPF_IN_SPFTREE);
+  if (job.m_keepTree)
+    {
+      RecordSPFTreeVertex (v);
+    }
   NS_LOG_LOGIC ("Starting SPFCalculate for node " << root);
 
 //
@@ -1377,10 +2258,13 @@ GlobalRouteManagerImplMulticast::SPFCalculate (Ipv4Address root)
 // reached.  Instead, short-circuit this computation and just install
 // a default route in the CheckForStubNode() method.
 //
-  if (NodeList::GetNNodes () > 0 && CheckForStubNode (root))
+  if (job.m_router != 0 && CheckForStubNode (root))
     {
       NS_LOG_LOGIC ("SPFCalculate truncated for stub node " << root);
+      job.m_stub = true;
       delete m_spfroot;
+      m_spfroot = 0;
+      m_spfJob = 0;
       return;
     }
 
@@ -1428,7 +2312,7 @@ GlobalRouteManagerImplMulticast::SPFCalculate (Ipv4Address root)
 // Update the status field of the vertex to indicate that it is in the SPF
 // tree.
 //
-      v->GetLSA ()->SetStatus (GlobalRoutingLSAMulticast::LSA_SPF_IN_SPFTREE);
+      SetSPFStatus (v->GetLSA (), GlobalRoutingLSAMulticast::LSA_SPF_IN_SPFTREE);
 //
 // The current vertex has a parent pointer.  By calling this rather oddly 
 // named method (blame quagga) we add the current vertex to the list of 
@@ -1437,6 +2321,10 @@ GlobalRouteManagerImplMulticast::SPFCalculate (Ipv4Address root)
 // to now.
 //
       SPFVertexAddParent (v);
+      if (job.m_keepTree)
+        {
+          RecordSPFTreeVertex (v);
+        }
 //
 // Note that when there is a choice of vertices closest to the root, network
 // vertices must be chosen before router vertices in order to necessarily
@@ -1444,12 +2332,10 @@ GlobalRouteManagerImplMulticast::SPFCalculate (Ipv4Address root)
 //
 // RFC2328 16.1. (4). 
 //
-// This is the method that actually adds the routes.  It'll walk the list
-// of nodes in the system, looking for the node corresponding to the router
-// ID of the root of the tree -- that is the router we're building the routes
-// for.  It looks for the Ipv4Multicast interface of that node and remembers it.  So
-// we are only actually adding routes to that one node at the root of the SPF 
-// tree.
+// This is the method that actually adds the routes.  They are collected in
+// the job of the root of the tree -- that is the router we're building the
+// routes for -- and written to the forwarding table of that one node once the
+// calculation is done.
 //
 // We're going to pop of a pointer to every vertex in the tree except the 
 // root in order of distance from the root.  For each of the vertices, we call
@@ -1502,6 +2388,7 @@ GlobalRouteManagerImplMulticast::SPFCalculate (Ipv4Address root)
 //
   delete m_spfroot;
   m_spfroot = 0;
+  m_spfJob = 0;
 }
 
 void
@@ -1555,110 +2442,23 @@ GlobalRouteManagerImplMulticast::SPFAddASExternal (GlobalRoutingLSAMulticast *ex
     }
   NS_LOG_LOGIC ("External is on remote host: " 
                 << extlsa->GetAdvertisingRouter () << "; installing");
-
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
 //
-// The router ID is accessible through the GlobalRouterMulticast interface, so we need
-// to QI for that interface.  If there's no GlobalRouterMulticast interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouterMulticast> rtr = node->GetObject<GlobalRouterMulticast> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouterMulticast interface on node " << node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
+// The routes are collected for the root of the SPF tree, whose vertex ID is
+// the router ID of the node we're going to write the routing information to.
 //
-// Routing information is updated using the Ipv4Multicast interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4Multicast interface.
+  NS_LOG_LOGIC ("Vertex ID = " << m_spfroot->GetVertexId ());
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "GlobalRouteManagerImplMulticast::SPFAddASExternal (): "
+                 "Expected valid LSA in SPFVertexMulticast* v");
+  Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = extlsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
 //
-          Ptr<Ipv4Multicast> ipv4 = node->GetObject<Ipv4Multicast> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImplMulticast::SPFIntraAddRouter (): "
-                         "QI for <Ipv4Multicast> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
+// The vertex <v> has the next hop addresses and outbound interface indexes
+// precalculated for us, through which the root node should send packets to
+// be forwarded to the external network; add a route for each of them.
 //
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImplMulticast::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertexMulticast* v");
-          Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = extlsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-
-//
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
-//
-          Ptr<GlobalRouterMulticast> router = node->GetObject<GlobalRouterMulticast> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRoutingMulticast> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertexMulticast::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddASExternalRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add external network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  AddSPFRoutes (SPFRoute::ASExternalRoute, tempip, tempmask, v);
 }
 
 
@@ -1719,123 +2519,28 @@ GlobalRouteManagerImplMulticast::SPFIntraAddStub (GlobalRoutingLinkRecordMultica
     }
   NS_LOG_LOGIC ("Stub is on remote host: " << v->GetVertexId () << "; installing");
 //
-// The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouterMulticast interface, so we need
-// to QI for that interface.  If there's no GlobalRouterMulticast interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouterMulticast> rtr = 
-        node->GetObject<GlobalRouterMulticast> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouterMulticast interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4Multicast interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4Multicast interface.
+// The routes are collected for the root of the SPF tree, whose vertex ID is
+// the router ID of the node we're going to write the routing information to.
 //
-          Ptr<Ipv4Multicast> ipv4 = node->GetObject<Ipv4Multicast> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImplMulticast::SPFIntraAddRouter (): "
-                         "QI for <Ipv4Multicast> interface failed");
+  NS_LOG_LOGIC ("Vertex ID = " << m_spfroot->GetVertexId ());
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "GlobalRouteManagerImplMulticast::SPFIntraAddStub (): "
+                 "Expected valid LSA in SPFVertexMulticast* v");
+  Ipv4Mask tempmask (l->GetLinkData ().Get ());
+  Ipv4Address tempip = l->GetLinkId ();
+  tempip = tempip.CombineMask (tempmask);
 //
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
+// The vertex <v> has the next hop addresses and outbound interface indexes
+// precalculated for us, through which the root node should send packets to
+// be forwarded to the stub network; add a route for each of them.
 //
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImplMulticast::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertexMulticast* v");
-          Ipv4Mask tempmask (l->GetLinkData ().Get ());
-          Ipv4Address tempip = l->GetLinkId ();
-          tempip = tempip.CombineMask (tempmask);
-//
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
-//
-
-          Ptr<GlobalRouterMulticast> router = node->GetObject<GlobalRouterMulticast> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRoutingMulticast> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertexMulticast::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  AddSPFRoutes (SPFRoute::NetworkRoute, tempip, tempmask, v);
 }
 
 //
 // Return the interface number corresponding to a given IP address and mask
-// This is a wrapper around GetInterfaceForPrefix(), but we first
-// have to find the right node pointer to pass to that function.
+// on the root node.  The addresses of the root are indexed by
+// BuildGlobalRoutingDatabase (), so no node is touched during the calculation.
 // If no such interface is found, return -1 (note:  unit test framework
 // for routing assumes -1 to be a legal return value)
 //
@@ -1844,69 +2549,42 @@ GlobalRouteManagerImplMulticast::FindOutgoingInterfaceId (Ipv4Address a, Ipv4Mas
 {
   NS_LOG_FUNCTION (this << a << amask);
 //
-// We have an IP address <a> and a vertex ID of the root of the SPF tree.
-// The question is what interface index does this address correspond to.
-// The answer is a little complicated since we have to find a pointer to
-// the node corresponding to the vertex ID, find the Ipv4Multicast interface on that
-// node in order to iterate the interfaces and find the one corresponding to
-// the address in question.
+// We have an IP address <a> and the root of the SPF tree.  The question is
+// what interface index does this address correspond to.  The addresses of
+// the root node were gathered in interface order when the database was
+// built, so this is the same search GetInterfaceForPrefix () does; host
+// addresses, the common case, are looked up in the address index instead.
 //
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-//
-// Walk the list of nodes in the system looking for the one corresponding to
-// the node at the root of the SPF tree.  This is the node for which we are
-// building the routing table.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  NS_ASSERT_MSG (m_spfJob, "GlobalRouteManagerImplMulticast::FindOutgoingInterfaceId (): Root job not set");
+  const RouterInfo* router = m_spfJob->m_router;
+  if (router == 0)
     {
-      Ptr<Node> node = *i;
-
-      Ptr<GlobalRouterMulticast> rtr = 
-        node->GetObject<GlobalRouterMulticast> ();
-//
-// If the node doesn't have a GlobalRouterMulticast interface it can't be the one
-// we're interested in.
-//
-      if (rtr == 0)
+      NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << m_spfJob->m_routerId);
+      return -1;
+    }
+  if (amask == Ipv4Mask::GetOnes ())
+    {
+      sgi::hash_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator i = router->m_addressIndex.find (a);
+      if (i != router->m_addressIndex.end ())
         {
-          continue;
+          return i->second;
         }
-
-      if (rtr->GetRouterId () == routerId)
+    }
+  else
+    {
+      for (std::vector<std::pair<Ipv4Address, uint32_t> >::const_iterator i = router->m_addresses.begin ();
+           i != router->m_addresses.end (); i++)
         {
-//
-// This is the node we're building the routing table for.  We're going to need
-// the Ipv4Multicast interface to look for the ipv4 interface index.  Since this node
-// is participating in routing IP version 4 packets, it certainly must have 
-// an Ipv4Multicast interface.
-//
-          Ptr<Ipv4Multicast> ipv4 = node->GetObject<Ipv4Multicast> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImplMulticast::FindOutgoingInterfaceId (): "
-                         "GetObject for <Ipv4Multicast> interface failed");
-//
-// Look through the interfaces on this node for one that has the IP address
-// we're looking for.  If we find one, return the corresponding interface
-// index, or -1 if not found.
-//
-          int32_t interface = ipv4->GetInterfaceForPrefix (a, amask);
-
-#if 0
-          if (interface < 0)
+          if (i->first.CombineMask (amask) == a.CombineMask (amask))
             {
-              NS_FATAL_ERROR ("GlobalRouteManagerImplMulticast::FindOutgoingInterfaceId(): "
-                              "Expected an interface associated with address a:" << a);
+              return i->second;
             }
-#endif 
-          return interface;
         }
     }
 //
 // Couldn't find it.
 //
-  NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << routerId);
+  NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find interface on root node " << m_spfJob->m_routerId);
   return -1;
 }
 
@@ -1935,69 +2613,22 @@ GlobalRouteManagerImplMulticast::SPFIntraAddRouter (SPFVertexMulticast* v)
                  "GlobalRouteManagerImplMulticast::SPFIntraAddRouter (): Root pointer not set");
 //
 // The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouterMulticast interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouterMulticast interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouterMulticast> rtr = 
-        node->GetObject<GlobalRouterMulticast> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouterMulticast interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4Multicast interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4Multicast interface.
+// going to write the actual routing table entries.  The routes are collected
+// in the job of that root and written once the calculation is done.
 //
-          Ptr<Ipv4Multicast> ipv4 = node->GetObject<Ipv4Multicast> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImplMulticast::SPFIntraAddRouter (): "
-                         "GetObject for <Ipv4Multicast> interface failed");
+  NS_LOG_LOGIC ("Vertex ID = " << m_spfroot->GetVertexId ());
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          GlobalRoutingLSAMulticast *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImplMulticast::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertexMulticast* v");
+  GlobalRoutingLSAMulticast *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImplMulticast::SPFIntraAddRouter (): "
+                 "Expected valid LSA in SPFVertexMulticast* v");
 
-          uint32_t nLinkRecords = lsa->GetNLinkRecords ();
+  uint32_t nLinkRecords = lsa->GetNLinkRecords ();
 //
 // Iterate through the link records on the vertex to which we're going to add
 // routes.  To make sure we're being clear, we're going to add routing table
@@ -2006,69 +2637,27 @@ GlobalRouteManagerImplMulticast::SPFIntraAddRouter (SPFVertexMulticast* v)
 // the local side of the point-to-point links found on the node described by
 // the vertex <v>.
 //
-          NS_LOG_LOGIC (" Node " << node->GetId () <<
-                        " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
-          for (uint32_t j = 0; j < nLinkRecords; ++j)
-            {
+  NS_LOG_LOGIC (" Router " << m_spfroot->GetVertexId () <<
+                " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
+  for (uint32_t j = 0; j < nLinkRecords; ++j)
+    {
 //
 // We are only concerned about point-to-point links
 //
-              GlobalRoutingLinkRecordMulticast *lr = lsa->GetLinkRecord (j);
-              if (lr->GetLinkType () != GlobalRoutingLinkRecordMulticast::PointToPoint)
-                {
-                  continue;
-                }
-//
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
-//
-              Ptr<GlobalRouterMulticast> router = node->GetObject<GlobalRouterMulticast> ();
-              if (router == 0)
-                {
-                  continue;
-                }
-              Ptr<Ipv4GlobalRoutingMulticast> gr = router->GetRoutingProtocol ();
-              NS_ASSERT (gr);
-              // walk through all available exit directions due to ECMP,
-              // and add host route for each of the exit direction toward
-              // the vertex 'v'
-              for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-                {
-                  SPFVertexMulticast::NodeExit_t exit = v->GetRootExitDirection (i);
-                  Ipv4Address nextHop = exit.first;
-                  int32_t outIf = exit.second;
-                  if (outIf >= 0)
-                    {
-                      gr->AddHostRouteTo (lr->GetLinkData (), nextHop,
-                                          outIf);
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " adding host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " and outgoing interface " << outIf);
-                    }
-                  else
-                    {
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " NOT able to add host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " since outgoing interface id is negative " << outIf);
-                    }
-                } // for all routes from the root the vertex 'v'
-            }
+      GlobalRoutingLinkRecordMulticast *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != GlobalRoutingLinkRecordMulticast::PointToPoint)
+        {
+          continue;
+        }
 //
-// Done adding the routes for the selected node.
+// We're going to add a host route to the host address found in the
+// m_linkData field of the point-to-point link record.  In the case of a
+// point-to-point link, this is the local IP address of the node connected to
+// the link.  The vertex <v> (corresponding to the node that has these links
+// and interfaces) has the next hop addresses and outbound interface indexes
+// precalculated for us, one for each of the exit directions due to ECMP.
 //
-          return;
-        }
+      AddSPFRoutes (SPFRoute::HostRoute, lr->GetLinkData (), Ipv4Mask::GetOnes (), v);
     }
 }
 void
@@ -2080,104 +2669,23 @@ GlobalRouteManagerImplMulticast::SPFIntraAddTransit (SPFVertexMulticast* v)
                  "GlobalRouteManagerImplMulticast::SPFIntraAddTransit (): Root pointer not set");
 //
 // The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouterMulticast interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouterMulticast interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouterMulticast> rtr = 
-        node->GetObject<GlobalRouterMulticast> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouterMulticast interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4Multicast interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4Multicast interface.
+// going to write the actual routing table entries.  The routes are collected
+// in the job of that root and written once the calculation is done.
 //
-          Ptr<Ipv4Multicast> ipv4 = node->GetObject<Ipv4Multicast> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImplMulticast::SPFIntraAddTransit (): "
-                         "GetObject for <Ipv4Multicast> interface failed");
+  NS_LOG_LOGIC ("Vertex ID = " << m_spfroot->GetVertexId ());
 //
 // Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          GlobalRoutingLSAMulticast *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImplMulticast::SPFIntraAddTransit (): "
-                         "Expected valid LSA in SPFVertexMulticast* v");
-          Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = lsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-          Ptr<GlobalRouterMulticast> router = node->GetObject<GlobalRouterMulticast> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRoutingMulticast> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all available exit directions due to ECMP,
-          // and add host route for each of the exit direction toward
-          // the vertex 'v'
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertexMulticast::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative " << outIf);
-                }
-            }
-        }
-    } 
+// adding the routes to.  For a network vertex this is the network LSA, which
+// carries the network address and mask.
+//
+  GlobalRoutingLSAMulticast *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImplMulticast::SPFIntraAddTransit (): "
+                 "Expected valid LSA in SPFVertexMulticast* v");
+  Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = lsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
+  AddSPFRoutes (SPFRoute::NetworkRoute, tempip, tempmask, v);
 }
 
 // Derived from quagga ospf_vertex_add_parents ()
@@ -30,6 +30,7 @@
 #include "ns3/object.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/sgi-hashmap.h"
 #include "global-router-interface-multicast.h"
 
 //added by Lin Chen
@@ -41,6 +42,8 @@ const uint32_t SPF_INFINITY_MULTICAST = 0xffffffff; //!< "infinite" distance bet
 
 class CandidateQueueMulticast;
 class Ipv4GlobalRoutingMulticast;
+class Ipv4Multicast;
+class SPFWorkQueueMulticast;
 
 /**
  * @brief Vertex used in shortest path first (SPF) computations. See \RFC{2328},
@@ -613,6 +616,18 @@ public:
  */
   void Insert (Ipv4Address addr, GlobalRoutingLSAMulticast* lsa);
 
+/**
+ * @brief Take the Link State Advertisement with the given link state ID
+ * (address) out of the Link State Database.
+ *
+ * The LSA is not deleted; it belongs to the caller afterwards.
+ *
+ * @param addr The IP address associated with the LSA.
+ * @returns A pointer to the Link State Advertisement, or 0 if there is no
+ * such LSA.
+ */
+  GlobalRoutingLSAMulticast* Remove (Ipv4Address addr);
+
 /**
  * @brief Look up the Link State Advertisement associated with the given
  * link state ID (address).
@@ -709,6 +724,18 @@ private:
  * and finally configure each of the node's forwarding tables.
  *
  * The design is guided by OSPFv2 \RFC{2328} section 16.1.1 and quagga ospfd.
+ *
+ * The SPF calculation of each root only reads the LSDB.  Its per-vertex
+ * state and the routes it finds are kept per calculation, so the roots can
+ * be spread over the number of threads given by the "GlobalRoutingSpfThreads"
+ * global value.  The routes are written into the nodes' forwarding tables by
+ * the main thread, in root order, once the calculations are done.
+ *
+ * If the "GlobalRoutingIncrementalSpf" global value is set, the SPF tree
+ * and routes of every root are kept, and UpdateRoutes () re-originates only
+ * the LSAs around a changed node.  Roots whose tree does not use a changed
+ * link only have the routes of the changed vertices redone; the others run
+ * their SPF calculation again.
  */
 class GlobalRouteManagerImplMulticast
 {
@@ -736,6 +763,20 @@ public:
  */
   virtual void InitializeRoutes ();
 
+/**
+ * @brief Bring the routes up to date after a change of the interfaces or
+ * addresses of a node.
+ *
+ * Re-originates the LSAs of the node and of the routers sharing a channel
+ * with it, patches them into the LSDB and recomputes the routes of the
+ * roots that depend on the LSAs that changed.  Falls back to recomputing
+ * all routes when no SPF trees were kept, or the change involves external
+ * routes or bridged links.
+ *
+ * @param node the node that changed
+ */
+  void UpdateRoutes (Ptr<Node> node);
+
 /**
  * @brief Debugging routine; allow client code to supply a pre-built LSDB
  */
@@ -767,8 +808,222 @@ private:
  */
   GlobalRouteManagerImplMulticast& operator= (GlobalRouteManagerImplMulticast& srmi);
 
+/**
+ * @brief Construct a worker sharing the given LSDB.  The worker does not
+ * own the LSDB and only runs SPF calculations on it.
+ *
+ * @param lsdb the Link State DataBase of the main implementation
+ */
+  GlobalRouteManagerImplMulticast (GlobalRouteManagerLSDBMulticast* lsdb);
+
+  friend class SPFWorkQueueMulticast;
+
+  /**
+   * \brief A route found by the SPF calculation, to be written into the
+   * forwarding table of the root.
+   */
+  struct SPFRoute
+  {
+    /// Which Ipv4GlobalRoutingMulticast method installs the route
+    enum RouteType_e {
+      HostRoute,       //!< AddHostRouteTo
+      NetworkRoute,    //!< AddNetworkRouteTo
+      ASExternalRoute  //!< AddASExternalRouteTo
+    };
+    RouteType_e m_type;    //!< route type
+    Ipv4Address m_dest;    //!< destination host or network
+    Ipv4Mask m_mask;       //!< destination mask, unused for host routes
+    Ipv4Address m_nextHop; //!< next hop
+    uint32_t m_outIf;      //!< outgoing interface
+    Ipv4Address m_origin;  //!< vertex the route was found at
+  };
+
+  /**
+   * \brief A vertex of the SPF tree of a root, as far as updating the
+   * routes of the root needs it.
+   */
+  struct SPFTreeVertex
+  {
+    uint32_t m_distance;                                //!< distance from the root
+    std::vector<Ipv4Address> m_parents;                 //!< vertex ids of the parents
+    std::vector<SPFVertexMulticast::NodeExit_t> m_exits; //!< exit directions of the root to the vertex
+  };
+
+  typedef sgi::hash_map<Ipv4Address, SPFTreeVertex, Ipv4AddressHash> SPFTree_t; //!< vertex id to SPF tree vertex
+
+  /**
+   * \brief What the SPF calculation needs to know about the node of a
+   * router, gathered once by BuildGlobalRoutingDatabase ().
+   */
+  struct RouterInfo
+  {
+    Ptr<Node> m_node;                          //!< the node
+    Ptr<Ipv4Multicast> m_ipv4;                 //!< IPv4 of the node
+    Ptr<Ipv4GlobalRoutingMulticast> m_routing; //!< forwarding table of the node
+    std::vector<std::pair<Ipv4Address, uint32_t> > m_addresses; //!< local addresses with their interface, in interface order
+    sgi::hash_map<Ipv4Address, uint32_t, Ipv4AddressHash> m_addressIndex; //!< local address to the first interface holding it
+    std::vector<Ipv4Address> m_lsas;           //!< link state ids of the LSAs the router originated
+    bool m_externalLSAs;                       //!< true if the router originated external LSAs
+  };
+
+  typedef sgi::hash_map<Ipv4Address, RouterInfo, Ipv4AddressHash> RouterMap_t; //!< router id to router
+
+  /**
+   * \brief Everything the SPF calculation of one root needs from, and hands
+   * back to, the node of that root.
+   *
+   * Filled and installed by the main thread; the SPF calculation itself only
+   * reads m_routerId, m_keepTree and the address tables of m_router, and
+   * fills in the rest.
+   */
+  struct SPFRootJob
+  {
+    SPFRootJob ()
+      : m_router (0),
+        m_keepTree (false),
+        m_stub (false)
+    {
+    }
+    Ipv4Address m_routerId;          //!< router id of the root
+    const RouterInfo* m_router;      //!< node of the root, null if there is no such node
+    std::vector<SPFRoute> m_routes;  //!< routes found for the root
+    bool m_keepTree;                 //!< true to record the SPF tree in m_tree
+    bool m_stub;                     //!< true if the root only got a default route
+    SPFTree_t m_tree;                //!< the SPF tree, if recorded
+  };
+
+  typedef sgi::hash_map<Ipv4Address, SPFRootJob, Ipv4AddressHash> SPFRootMap_t; //!< router id to the last calculation of the root
+
+  typedef sgi::hash_map<Ipv4Address, GlobalRoutingLSAMulticast::SPFStatus, Ipv4AddressHash> SPFStatusMap_t; //!< LSA link state id to SPF status
+
   SPFVertexMulticast* m_spfroot; //!< the root node
   GlobalRouteManagerLSDBMulticast* m_lsdb; //!< the Link State DataBase (LSDB) of the Global Route Manager
+  bool m_ownsLsdb; //!< false for workers sharing the LSDB of the main implementation
+  SPFStatusMap_t m_spfStatus; //!< SPF status of the LSAs for the current root
+  SPFRootJob* m_spfJob; //!< the root being calculated
+  SPFWorkQueueMulticast* m_spfQueue; //!< roots left to calculate, for workers
+  RouterMap_t m_routers; //!< routers of the simulation, built by BuildGlobalRoutingDatabase ()
+  bool m_keepSPFTrees; //!< true if m_spfRoots holds the SPF trees of all roots
+  SPFRootMap_t m_spfRoots; //!< last calculation of every root, for UpdateRoutes ()
+
+  /**
+   * \brief Discover the LSAs of a router and insert them into the LSDB.
+   * \param rtr the global router
+   * \param info the router, to record the LSAs in
+   */
+  void OriginateLSAs (Ptr<GlobalRouterMulticast> rtr, RouterInfo& info);
+
+  /**
+   * \brief Calculate the SPF trees of the given roots and install their
+   * routes, spreading the calculations over the SPF threads.
+   *
+   * The roots are kept in m_spfRoots afterwards if m_keepSPFTrees is set.
+   *
+   * \param jobs the roots
+   */
+  void RunSPFJobs (std::vector<SPFRootJob>& jobs);
+
+  /**
+   * \brief Redo the routes a root has through the given vertices, with the
+   * exit directions of its last calculation and the current LSAs.
+   * \param job the last calculation of the root
+   * \param vertices ids of the vertices
+   */
+  void SPFUpdateVertexRoutes (SPFRootJob& job, const std::vector<Ipv4Address>& vertices);
+
+  /**
+   * \brief Decide if a change of an LSA may move the SPF tree of a root.
+   *
+   * A change cannot move the tree when every link it removes or makes more
+   * expensive is off the tree, and every link it adds or makes cheaper is
+   * longer than the tree path it would compete with.
+   *
+   * \param job the last calculation of the root
+   * \param oldLsa the LSA before the change, or 0
+   * \param newLsa the LSA after the change, or 0
+   * \returns true if the root must run its SPF calculation again
+   */
+  bool SPFTreeChanged (const SPFRootJob& job, GlobalRoutingLSAMulticast* oldLsa, GlobalRoutingLSAMulticast* newLsa) const;
+
+  /**
+   * \brief Record a vertex in the SPF tree of the current root.
+   * \param v the vertex, just added to the tree
+   */
+  void RecordSPFTreeVertex (SPFVertexMulticast* v);
+
+  /**
+   * \brief Delete all routes, rebuild the LSDB and run the SPF calculation
+   * of every root.
+   */
+  void RecomputeAllRoutes (void);
+
+  /**
+   * \brief Remove all routes from a forwarding table.
+   * \param routing the forwarding table
+   */
+  static void RemoveAllRoutes (Ptr<Ipv4GlobalRoutingMulticast> routing);
+
+  /**
+   * \brief Remember the node of a router and index its local addresses.
+   * \param node the node
+   * \param rtr the global router of the node
+   */
+  void AddRouterInfo (Ptr<Node> node, Ptr<GlobalRouterMulticast> rtr);
+
+  /**
+   * \brief Look up the node of a router.
+   * \param routerId the router id
+   * \returns the router, or 0 if no node has that router id
+   */
+  const RouterInfo* GetRouterInfo (Ipv4Address routerId) const;
+
+  /**
+   * \brief Calculate the SPF tree of a root, collecting its routes in the job.
+   *
+   * Only reads the LSDB, so it may run concurrently for different jobs in
+   * different workers.
+   *
+   * \param job the root to calculate
+   */
+  void SPFCompute (SPFRootJob& job);
+
+  /**
+   * \brief Write the routes collected for a root into its forwarding table
+   * and release them, unless the root keeps its SPF tree.
+   *
+   * Must be called from the main thread.
+   *
+   * \param job the calculated root
+   */
+  void InstallSPFRoutes (SPFRootJob& job) const;
+
+  /**
+   * \brief Thread body of a worker: calculate roots until the queue is empty.
+   */
+  void RunSPFWorker (void);
+
+  /**
+   * \brief Get the SPF status of an LSA for the current root.
+   * \param lsa the LSA
+   * \returns the SPF status, LSA_SPF_NOT_EXPLORED if not visited yet
+   */
+  GlobalRoutingLSAMulticast::SPFStatus GetSPFStatus (GlobalRoutingLSAMulticast* lsa) const;
+
+  /**
+   * \brief Set the SPF status of an LSA for the current root.
+   * \param lsa the LSA
+   * \param status the new status
+   */
+  void SetSPFStatus (GlobalRoutingLSAMulticast* lsa, GlobalRoutingLSAMulticast::SPFStatus status);
+
+  /**
+   * \brief Collect a route of the vertex for every exit direction of the root.
+   * \param type route type
+   * \param dest destination host or network
+   * \param mask destination mask
+   * \param v the vertex the destination hangs off
+   */
+  void AddSPFRoutes (SPFRoute::RouteType_e type, Ipv4Address dest, Ipv4Mask mask, SPFVertexMulticast* v);
 
   /**
    * \brief Test if a node is a stub, from an OSPF sense.
@@ -783,7 +1038,8 @@ private:
   bool CheckForStubNode (Ipv4Address root);
 
   /**
-   * \brief Calculate the shortest path first (SPF) tree
+   * \brief Calculate the shortest path first (SPF) tree of one root and
+   * install its routes
    *
    * Equivalent to quagga ospf_spf_calculate
    * \param root the root node
@@ -936,8 +1192,10 @@ private:
   /**
    * \brief Return the interface number corresponding to a given IP address and mask
    *
-   * This is a wrapper around GetInterfaceForPrefix(), but we first
-   * have to find the right node pointer to pass to that function.
+   * Searches the addresses of the root node, gathered by
+   * BuildGlobalRoutingDatabase(), the way GetInterfaceForPrefix() does.
+   * Host lookups are a hash lookup, other prefixes a scan of the root's
+   * addresses.
    * If no such interface is found, return -1 (note:  unit test framework
    * for routing assumes -1 to be a legal return value)
    *
@@ -946,7 +1204,7 @@ private:
    * \return the outgoing interface number
    */
   int32_t FindOutgoingInterfaceId (Ipv4Address a, 
-                                   Ipv4Mask amask = Ipv4Mask ("255.255.255.255"));
+                                   Ipv4Mask amask = Ipv4Mask::GetOnes ());
 };
 
 } // namespace ns3
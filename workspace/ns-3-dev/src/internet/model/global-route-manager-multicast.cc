@@ -58,6 +58,14 @@ GlobalRouteManagerMulticast::InitializeRoutes (void)
   InitializeRoutes ();
 }
 
+void
+GlobalRouteManagerMulticast::UpdateRoutes (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (node);
+  SimulationSingleton<GlobalRouteManagerImplMulticast>::Get ()->
+  UpdateRoutes (node);
+}
+
 uint32_t
 GlobalRouteManagerMulticast::AllocateRouterId (void)
 {
@@ -22,8 +22,12 @@
 #ifndef GLOBAL_ROUTE_MANAGER_MULTICAST_H
 #define GLOBAL_ROUTE_MANAGER_MULTICAST_H
 
+#include "ns3/ptr.h"
+
 namespace ns3 {
 
+class Node;
+
 /**
  * @brief A global global router
  *
@@ -62,6 +66,15 @@ public:
  */
   static void InitializeRoutes ();
 
+/**
+ * @brief Recompute the routes that a change of the interfaces or addresses
+ * of a node affects.  Recomputes all routes unless the
+ * "GlobalRoutingIncrementalSpf" global value was set when the routes were
+ * initialized.
+ * @param node the node that changed
+ */
+  static void UpdateRoutes (Ptr<Node> node);
+
 private:
 /**
  * @brief Global Route Manager copy construction is disallowed.  There's no 
@@ -0,0 +1,455 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 CONCORDIA UNIVERSITY
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Lin Chen <c_lin13@encs.concordia.ca>
+ */
+
+#include "gsam-crypto.h"
+#include "ns3/assert.h"
+#include <cstdlib>
+
+namespace ns3 {
+
+/********************************************************
+ *        sha-256, fips 180-4
+ ********************************************************/
+
+static const uint32_t g_sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t
+Sha256Rotr (uint32_t x, uint32_t n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static void
+Sha256Block (uint32_t state[8], const uint8_t block[64])
+{
+	uint32_t w[64];
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		w[i] = 	(((uint32_t)block[4 * i]) << 24) |
+				(((uint32_t)block[4 * i + 1]) << 16) |
+				(((uint32_t)block[4 * i + 2]) << 8) |
+				((uint32_t)block[4 * i + 3]);
+	}
+	for (uint32_t i = 16; i < 64; i++)
+	{
+		uint32_t s0 = Sha256Rotr(w[i - 15], 7) ^ Sha256Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = Sha256Rotr(w[i - 2], 17) ^ Sha256Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t e = state[4];
+	uint32_t f = state[5];
+	uint32_t g = state[6];
+	uint32_t h = state[7];
+
+	for (uint32_t i = 0; i < 64; i++)
+	{
+		uint32_t s1 = Sha256Rotr(e, 6) ^ Sha256Rotr(e, 11) ^ Sha256Rotr(e, 25);
+		uint32_t ch = (e & f) ^ ((~e) & g);
+		uint32_t temp1 = h + s1 + ch + g_sha256_k[i] + w[i];
+		uint32_t s0 = Sha256Rotr(a, 2) ^ Sha256Rotr(a, 13) ^ Sha256Rotr(a, 22);
+		uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+		uint32_t temp2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + temp1;
+		d = c;
+		c = b;
+		b = a;
+		a = temp1 + temp2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+/********************************************************
+ *        field arithmetic mod 2^255 - 19, rfc 7748
+ *        16 limbs of 16 bits, as in tweetnacl
+ ********************************************************/
+
+typedef int64_t GsamGf[16];
+
+static const GsamGf g_gf_121665 = {0xDB41, 1};
+
+static void
+GfCarry (GsamGf o)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		o[i] += ((int64_t)1 << 16);
+		int64_t c = o[i] >> 16;
+		//the carry out of the top limb wraps around as 38 = 2 * 19
+		o[(i + 1) * (i < 15)] += c - 1 + 37 * (c - 1) * (i == 15);
+		o[i] -= c << 16;
+	}
+}
+
+static void
+GfSelect (GsamGf p, GsamGf q, int64_t b)
+{
+	//constant time swap if b is 1
+	int64_t c = ~(b - 1);
+	for (int i = 0; i < 16; i++)
+	{
+		int64_t t = c & (p[i] ^ q[i]);
+		p[i] ^= t;
+		q[i] ^= t;
+	}
+}
+
+static void
+GfPack (uint8_t o[32], const GsamGf n)
+{
+	GsamGf m;
+	GsamGf t;
+	for (int i = 0; i < 16; i++)
+	{
+		t[i] = n[i];
+	}
+	GfCarry(t);
+	GfCarry(t);
+	GfCarry(t);
+	for (int j = 0; j < 2; j++)
+	{
+		m[0] = t[0] - 0xffed;
+		for (int i = 1; i < 15; i++)
+		{
+			m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+			m[i - 1] &= 0xffff;
+		}
+		m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+		int64_t b = (m[15] >> 16) & 1;
+		m[14] &= 0xffff;
+		GfSelect(t, m, 1 - b);
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		o[2 * i] = t[i] & 0xff;
+		o[2 * i + 1] = t[i] >> 8;
+	}
+}
+
+static void
+GfUnpack (GsamGf o, const uint8_t n[32])
+{
+	for (int i = 0; i < 16; i++)
+	{
+		o[i] = n[2 * i] + (((int64_t)n[2 * i + 1]) << 8);
+	}
+	o[15] &= 0x7fff;
+}
+
+static void
+GfAdd (GsamGf o, const GsamGf a, const GsamGf b)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		o[i] = a[i] + b[i];
+	}
+}
+
+static void
+GfSub (GsamGf o, const GsamGf a, const GsamGf b)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		o[i] = a[i] - b[i];
+	}
+}
+
+static void
+GfMul (GsamGf o, const GsamGf a, const GsamGf b)
+{
+	int64_t t[31];
+	for (int i = 0; i < 31; i++)
+	{
+		t[i] = 0;
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		for (int j = 0; j < 16; j++)
+		{
+			t[i + j] += a[i] * b[j];
+		}
+	}
+	for (int i = 0; i < 15; i++)
+	{
+		t[i] += 38 * t[i + 16];
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		o[i] = t[i];
+	}
+	GfCarry(o);
+	GfCarry(o);
+}
+
+static void
+GfInvert (GsamGf o, const GsamGf i)
+{
+	//i^(p - 2)
+	GsamGf c;
+	for (int a = 0; a < 16; a++)
+	{
+		c[a] = i[a];
+	}
+	for (int a = 253; a >= 0; a--)
+	{
+		GfMul(c, c, c);
+		if ((a != 2) && (a != 4))
+		{
+			GfMul(c, c, i);
+		}
+	}
+	for (int a = 0; a < 16; a++)
+	{
+		o[a] = c[a];
+	}
+}
+
+static void
+GfScalarMult (uint8_t q[32], const uint8_t n[32], const uint8_t p[32])
+{
+	uint8_t z[32];
+	for (int i = 0; i < 32; i++)
+	{
+		z[i] = n[i];
+	}
+	//clamping, rfc 7748 5
+	z[31] = (n[31] & 127) | 64;
+	z[0] &= 248;
+
+	GsamGf x;
+	GfUnpack(x, p);
+
+	GsamGf a = {0};
+	GsamGf b;
+	GsamGf c = {0};
+	GsamGf d = {0};
+	GsamGf e;
+	GsamGf f;
+	for (int i = 0; i < 16; i++)
+	{
+		b[i] = x[i];
+	}
+	a[0] = 1;
+	d[0] = 1;
+
+	//montgomery ladder
+	for (int i = 254; i >= 0; i--)
+	{
+		int64_t r = (z[i >> 3] >> (i & 7)) & 1;
+		GfSelect(a, b, r);
+		GfSelect(c, d, r);
+		GfAdd(e, a, c);
+		GfSub(a, a, c);
+		GfAdd(c, b, d);
+		GfSub(b, b, d);
+		GfMul(d, e, e);
+		GfMul(f, a, a);
+		GfMul(a, c, a);
+		GfMul(c, b, e);
+		GfAdd(e, a, c);
+		GfSub(a, a, c);
+		GfMul(b, a, a);
+		GfSub(c, d, f);
+		GfMul(a, c, g_gf_121665);
+		GfAdd(a, a, d);
+		GfMul(c, c, a);
+		GfMul(a, d, f);
+		GfMul(d, b, x);
+		GfMul(b, e, e);
+		GfSelect(a, b, r);
+		GfSelect(c, d, r);
+	}
+
+	GfInvert(c, c);
+	GfMul(a, a, c);
+	GfPack(q, a);
+}
+
+/********************************************************
+ *        GsamCrypto
+ ********************************************************/
+
+void
+GsamCrypto::Sha256 (const std::vector<uint8_t>& data, std::vector<uint8_t>& retval)
+{
+	uint32_t state[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	uint64_t length = data.size();
+	uint64_t offset = 0;
+
+	while ((length - offset) >= GsamCrypto::SHA256_BLOCK_SIZE)
+	{
+		Sha256Block(state, &data[offset]);
+		offset += GsamCrypto::SHA256_BLOCK_SIZE;
+	}
+
+	//padding, one or two blocks
+	uint8_t tail[2 * GsamCrypto::SHA256_BLOCK_SIZE] = {0};
+	uint32_t rest = length - offset;
+	for (uint32_t i = 0; i < rest; i++)
+	{
+		tail[i] = data[offset + i];
+	}
+	tail[rest] = 0x80;
+	uint32_t tail_size = (rest < 56) ? GsamCrypto::SHA256_BLOCK_SIZE : (2 * GsamCrypto::SHA256_BLOCK_SIZE);
+	uint64_t bit_length = length * 8;
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		tail[tail_size - 1 - i] = (uint8_t)(bit_length >> (8 * i));
+	}
+	for (uint32_t i = 0; i < tail_size; i += GsamCrypto::SHA256_BLOCK_SIZE)
+	{
+		Sha256Block(state, tail + i);
+	}
+
+	retval.resize(GsamCrypto::SHA256_SIZE);
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		retval[4 * i] = (uint8_t)(state[i] >> 24);
+		retval[4 * i + 1] = (uint8_t)(state[i] >> 16);
+		retval[4 * i + 2] = (uint8_t)(state[i] >> 8);
+		retval[4 * i + 3] = (uint8_t)(state[i]);
+	}
+}
+
+void
+GsamCrypto::HmacSha256 (const std::vector<uint8_t>& key, const std::vector<uint8_t>& data, std::vector<uint8_t>& retval)
+{
+	//rfc 2104
+	std::vector<uint8_t> block_key = key;
+	if (block_key.size() > GsamCrypto::SHA256_BLOCK_SIZE)
+	{
+		GsamCrypto::Sha256(key, block_key);
+	}
+	block_key.resize(GsamCrypto::SHA256_BLOCK_SIZE, 0);
+
+	std::vector<uint8_t> inner;
+	inner.reserve(GsamCrypto::SHA256_BLOCK_SIZE + data.size());
+	for (uint32_t i = 0; i < GsamCrypto::SHA256_BLOCK_SIZE; i++)
+	{
+		inner.push_back(block_key[i] ^ 0x36);
+	}
+	inner.insert(inner.end(), data.begin(), data.end());
+
+	std::vector<uint8_t> inner_hash;
+	GsamCrypto::Sha256(inner, inner_hash);
+
+	std::vector<uint8_t> outer;
+	outer.reserve(GsamCrypto::SHA256_BLOCK_SIZE + GsamCrypto::SHA256_SIZE);
+	for (uint32_t i = 0; i < GsamCrypto::SHA256_BLOCK_SIZE; i++)
+	{
+		outer.push_back(block_key[i] ^ 0x5c);
+	}
+	outer.insert(outer.end(), inner_hash.begin(), inner_hash.end());
+
+	GsamCrypto::Sha256(outer, retval);
+}
+
+uint32_t
+GsamCrypto::PrfPlus (	const std::vector<uint8_t>& key,
+						const std::vector<uint8_t>& seed,
+						uint32_t length,
+						std::vector<uint8_t>& retval)
+{
+	//T1 = prf (K, S | 0x01), Tn = prf (K, Tn-1 | S | n)
+	uint32_t number_of_calls = GsamCrypto::GetNumberOfPrfCalls(length);
+	NS_ASSERT (number_of_calls <= 255);
+
+	retval.clear();
+	retval.reserve(number_of_calls * GsamCrypto::SHA256_SIZE);
+
+	std::vector<uint8_t> t;
+	for (uint32_t n = 1; n <= number_of_calls; n++)
+	{
+		std::vector<uint8_t> input = t;
+		input.insert(input.end(), seed.begin(), seed.end());
+		input.push_back((uint8_t)n);
+		GsamCrypto::HmacSha256(key, input, t);
+		retval.insert(retval.end(), t.begin(), t.end());
+	}
+	retval.resize(length);
+
+	return number_of_calls;
+}
+
+uint32_t
+GsamCrypto::GetNumberOfPrfCalls (uint32_t length)
+{
+	return (length + GsamCrypto::SHA256_SIZE - 1) / GsamCrypto::SHA256_SIZE;
+}
+
+void
+GsamCrypto::X25519 (const std::vector<uint8_t>& scalar, const std::vector<uint8_t>& u, std::vector<uint8_t>& retval)
+{
+	NS_ASSERT (scalar.size() == GsamCrypto::X25519_KEY_SIZE);
+	NS_ASSERT (u.size() == GsamCrypto::X25519_KEY_SIZE);
+
+	retval.resize(GsamCrypto::X25519_KEY_SIZE);
+	GfScalarMult(&retval[0], &scalar[0], &u[0]);
+}
+
+void
+GsamCrypto::X25519PublicKey (const std::vector<uint8_t>& private_key, std::vector<uint8_t>& retval)
+{
+	std::vector<uint8_t> base_point (GsamCrypto::X25519_KEY_SIZE, 0);
+	base_point[0] = 9;
+	GsamCrypto::X25519(private_key, base_point, retval);
+}
+
+void
+GsamCrypto::GenerateRandomBytes (uint32_t length, std::vector<uint8_t>& retval)
+{
+	//the rest of gsam draws its spis and nonces from rand() too, so runs stay reproducible
+	retval.resize(length);
+	for (uint32_t i = 0; i < length; i++)
+	{
+		retval[i] = (uint8_t)rand();
+	}
+}
+
+} /* namespace ns3 */
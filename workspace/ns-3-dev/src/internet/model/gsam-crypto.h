@@ -0,0 +1,67 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 CONCORDIA UNIVERSITY
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Lin Chen <c_lin13@encs.concordia.ca>
+ */
+
+#ifndef GSAM_CRYPTO_H
+#define GSAM_CRYPTO_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * keying material of gsam, self-contained so no crypto library is needed
+ * prf is hmac-sha256 (rfc 4868), the key exchange is x25519 (rfc 7748)
+ * slow reference code, meant to produce real keys, not to be fast
+ */
+class GsamCrypto {
+public:
+	enum CRYPTO_SIZE {
+		SHA256_SIZE = 32,
+		SHA256_BLOCK_SIZE = 64,
+		X25519_KEY_SIZE = 32,
+		//rfc 7296 2.10, at least half the key size of the prf
+		NONCE_SIZE = 32,
+		//sk_d | sk_ai | sk_ar | sk_ei | sk_er | sk_pi | sk_pr
+		IKE_SA_KEY_MATERIAL_SIZE = 224,
+		//sk_e | sk_a
+		KEK_SA_KEY_MATERIAL_SIZE = 64,
+		GSA_KEY_MATERIAL_SIZE = 64
+	};
+public:	//static
+	static void Sha256 (const std::vector<uint8_t>& data, std::vector<uint8_t>& retval);
+	static void HmacSha256 (const std::vector<uint8_t>& key, const std::vector<uint8_t>& data, std::vector<uint8_t>& retval);
+	/*
+	 * prf+ of rfc 7296 2.13
+	 * @return value: number of prf calls it took
+	 */
+	static uint32_t PrfPlus (	const std::vector<uint8_t>& key,
+								const std::vector<uint8_t>& seed,
+								uint32_t length,
+								std::vector<uint8_t>& retval);
+	static uint32_t GetNumberOfPrfCalls (uint32_t length);
+	static void X25519 (const std::vector<uint8_t>& scalar, const std::vector<uint8_t>& u, std::vector<uint8_t>& retval);
+	static void X25519PublicKey (const std::vector<uint8_t>& private_key, std::vector<uint8_t>& retval);
+	static void GenerateRandomBytes (uint32_t length, std::vector<uint8_t>& retval);
+};
+
+} /* namespace ns3 */
+
+#endif /* GSAM_CRYPTO_H */
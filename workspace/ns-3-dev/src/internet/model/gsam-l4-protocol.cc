@@ -13,6 +13,7 @@
  */
 
 #include "gsam-l4-protocol.h"
+#include "gsam-crypto.h"
 
 #include "ipv4-raw-socket-factory-impl-multicast.h"
 #include "ipv4-interface-multicast.h"
@@ -29,6 +30,7 @@
 #include "ipv4-raw-socket-impl-multicast.h"
 #include <cstdlib>
 #include <ctime>
+#include <map>
 #include "ns3/socket-factory.h"
 #include "ns3/udp-l4-protocol-multicast.h"
 #include "ns3/nstime.h"
@@ -61,7 +63,9 @@ GsamL4Protocol::GsamL4Protocol()
   : m_node (0),
 	m_socket (0),
 	m_ptr_database (0),
-	m_ptr_gsam_filter (0)
+	m_ptr_gsam_filter (0),
+	m_cookie_secret (0),
+	m_num_busy_crypto_workers (0)
 {
 	// TODO Auto-generated constructor stub
 	NS_LOG_FUNCTION (this);
@@ -117,6 +121,17 @@ void
 GsamL4Protocol::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
+	this->m_rekey_event.Cancel();
+	//the database owns all gsam state, its teardown breaks the links between them
+	if (0 != this->m_ptr_database)
+	{
+		this->m_ptr_database->Dispose();
+		this->m_ptr_database = 0;
+	}
+	this->m_ptr_gsam_filter = 0;
+	//jobs still with a worker find the database gone and do nothing
+	this->m_lst_crypto_jobs.clear();
+	this->m_vec_gsa_key_secret.clear();
 	m_node = 0;
 	Object::DoDispose ();
 }
@@ -138,6 +153,11 @@ GsamL4Protocol::Initialization (void)
 		this->m_ptr_database->SetGsam(this);
 	}
 
+	if (0 == this->m_cookie_secret)
+	{
+		this->m_cookie_secret = (((uint64_t)rand()) << 32) | ((uint64_t)rand());
+	}
+
 	if (this->m_socket == 0)
 	{
 		TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
@@ -169,6 +189,14 @@ GsamL4Protocol::Initialization (void)
 	gsam_bypass_policy->SetProtocolNum(UdpL4ProtocolMulticast::PROT_NUMBER);
 	gsam_bypass_policy->SetTranSrcPortRange(GsamL4Protocol::PROT_NUMBER, GsamL4Protocol::PROT_NUMBER);
 	gsam_bypass_policy->SetTranDestPortRange(GsamL4Protocol::PROT_NUMBER, GsamL4Protocol::PROT_NUMBER);
+
+	//whether this node turns out to be the q is only known later, CheckRekey looks each time
+	if (true == GsamConfig::GetSingleton()->IsSaSoftLifetimeSet())
+	{
+		this->m_rekey_event = Simulator::Schedule (GsamConfig::GetSingleton()->GetRekeyCheckIntervalInSeconds(),
+													&GsamL4Protocol::CheckRekey,
+													this);
+	}
 }
 
 void
@@ -192,6 +220,13 @@ GsamL4Protocol::HandleRead (Ptr<Socket> socket)
 
 	Ipv4Address peer_address = InetSocketAddress::ConvertFrom (from).GetIpv4 ();
 
+	if ((0 == ikeheader.GetInitiatorSpi()) && (0 == ikeheader.GetResponderSpi()))
+	{
+		//a push the querier multicast to its nqs, see GsamL4Protocol::MulticastToNQs
+		this->HandleNqControlPush(packet, ikeheader, peer_address);
+		return;
+	}
+
 	IkeHeader::EXCHANGE_TYPE exchange_type = ikeheader.GetExchangeType();
 
 	switch (exchange_type)
@@ -221,41 +256,67 @@ GsamL4Protocol::Send_IKE_SA_INIT (Ptr<GsamInitSession> init_session)
 
 	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), init_session);
 
+	uint64_t initiator_spi = this->GetIpSecDatabase()->GetInfo()->RegisterGsamSpi();
+	//start setting up a new session
+	init_session->SetSessionRole(GsamInitSession::INITIATOR);
+	init_session->EtablishGsamInitSa();
+	init_session->SetInitSaInitiatorSpi(initiator_spi);
+	//kept on the init sa, a retry with a cookie sends the same KEi and Ni
+	this->GenerateKeyExchangeValues(init_session->GetInitSa(), true);
+
+	this->DoSend_IKE_SA_INIT(init_session, 0);
+}
+
+void
+GsamL4Protocol::DoSend_IKE_SA_INIT (Ptr<GsamInitSession> init_session, uint64_t cookie)
+{
+	NS_LOG_FUNCTION (this);
+
 	//setting up Ni
 	IkePayload nonce_payload_init;
-	nonce_payload_init.SetSubstructure(IkeNonceSubstructure::GenerateRandomNonceSubstructure());
+	nonce_payload_init.SetSubstructure(this->GenerateNonceSubstructure(init_session->GetInitSa(), true));
 	//setting up KEi
 	IkePayload key_payload_init;
-	key_payload_init.SetSubstructure(IkeKeyExchangeSubStructure::GetDummySubstructure());
+	key_payload_init.SetSubstructure(this->GenerateKeyExchangeSubstructure(init_session->GetInitSa()));
 	key_payload_init.SetNextPayloadType(nonce_payload_init.GetPayloadType());
 	//setting up SAi1
 	IkePayload sa_payload_init;
 	sa_payload_init.SetSubstructure(IkeSaPayloadSubstructure::GenerateInitIkePayload());
 	sa_payload_init.SetNextPayloadType(key_payload_init.GetPayloadType());
+
+	uint32_t length_beside_ikeheader = 	sa_payload_init.GetSerializedSize() +
+										key_payload_init.GetSerializedSize() +
+										nonce_payload_init.GetSerializedSize();
+
+	Ptr<Packet> packet = Create<Packet>();
+	packet->AddHeader(nonce_payload_init);
+	packet->AddHeader(key_payload_init);
+	packet->AddHeader(sa_payload_init);
+
+	IkePayloadHeader::PAYLOAD_TYPE first_payload_type = sa_payload_init.GetPayloadType();
+
+	if (0 != cookie)
+	{
+		//the cookie goes first, rfc 7296 2.6
+		IkePayload cookie_payload;
+		cookie_payload.SetSubstructure(IkeNotifySubstructure::GenerateCookieSubstructure(cookie));
+		cookie_payload.SetNextPayloadType(first_payload_type);
+		packet->AddHeader(cookie_payload);
+		length_beside_ikeheader += cookie_payload.GetSerializedSize();
+		first_payload_type = cookie_payload.GetPayloadType();
+	}
+
 	//setting up HDR
 	IkeHeader ikeheader;
-	uint64_t initiator_spi = this->GetIpSecDatabase()->GetInfo()->RegisterGsamSpi();
-	ikeheader.SetInitiatorSpi(initiator_spi);
+	ikeheader.SetInitiatorSpi(init_session->GetInitSaInitiatorSpi());
 	ikeheader.SetResponderSpi(0);
 	ikeheader.SetIkev2Version();
 	ikeheader.SetExchangeType(IkeHeader::IKE_SA_INIT);
 	ikeheader.SetAsInitiator();
-	//pause setting up HDR, start setting up a new session
-	init_session->SetSessionRole(GsamInitSession::INITIATOR);
-	init_session->EtablishGsamInitSa();
-	init_session->SetInitSaInitiatorSpi(initiator_spi);
-	//continue setting HDR
 	ikeheader.SetMessageId(init_session->GetCurrentMessageId());
-	ikeheader.SetNextPayloadType(sa_payload_init.GetPayloadType());
-	ikeheader.SetLength(ikeheader.GetSerializedSize() +
-						sa_payload_init.GetSerializedSize() +
-						key_payload_init.GetSerializedSize() +
-						nonce_payload_init.GetSerializedSize());
+	ikeheader.SetNextPayloadType(first_payload_type);
+	ikeheader.SetLength(ikeheader.GetSerializedSize() + length_beside_ikeheader);
 
-	Ptr<Packet> packet = Create<Packet>();
-	packet->AddHeader(nonce_payload_init);
-	packet->AddHeader(key_payload_init);
-	packet->AddHeader(sa_payload_init);
 	packet->AddHeader(ikeheader);
 
 	init_session->SetCachePacket(packet);
@@ -270,78 +331,174 @@ GsamL4Protocol::Send_IKE_SA_AUTH (Ptr<GsamInitSession> init_session, Ptr<GsamSes
 
 	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session);
 
-	if (1 < init_session->GetCurrentMessageId())
+	init_session->PushBackSessionAwaitingAuth(session);
+
+	if (	(false == init_session->HaveInitSa()) ||
+			(0 == init_session->GetInitSaResponderSpi()))
 	{
-		NS_ASSERT (false);
+		//ike_sa_init not answered yet, the session goes with the first ike_auth
+		return;
 	}
-	else
+
+	if (true == init_session->IsAuthInFlight())
 	{
-		init_session->SetMessageId(1);
+		//the session goes with the next ike_auth, sent once the current one is answered
+		return;
 	}
 
-	//Setting up TSr
-	IkePayload tsr;
+	this->DoSend_IKE_SA_AUTH(init_session);
+}
+
+void
+GsamL4Protocol::DoSend_IKE_SA_AUTH (Ptr<GsamInitSession> init_session)
+{
+	NS_LOG_FUNCTION (this);
 
-	if (init_session->IsHostNonQuerier())
+	if (1 < init_session->GetCurrentMessageId())
 	{
-		tsr.SetSubstructure(IkeTrafficSelectorSubstructure::GenerateEmptySubstructure(true));
+		NS_ASSERT (false);
 	}
 	else
 	{
-		tsr.SetSubstructure(IkeTrafficSelectorSubstructure::GetSecureGroupSubstructure(session->GetGroupAddress(), true));
+		init_session->SetMessageId(1);
 	}
-	//settuping up tsi
-	IkePayload tsi;
-	if (init_session->IsHostNonQuerier())
+
+	std::list<Ptr<GsamSession> > lst_sessions;
+	init_session->StartAuth(lst_sessions);
+
+	if (true == lst_sessions.empty())
 	{
-		tsi.SetSubstructure(IkeTrafficSelectorSubstructure::GenerateEmptySubstructure(false));
+		NS_ASSERT (false);
+		return;
 	}
-	else
+
+	//every group joined gets its own id, sai2, tsi and tsr payloads, all behind one auth payload
+	//payloads are prepended, so the groups are walked backwards
+	Ptr<Packet> packet = Create<Packet>();
+	uint32_t length_beside_hedaer = 0;
+	IkePayloadHeader::PAYLOAD_TYPE next_payload_type = IkePayloadHeader::NO_NEXT_PAYLOAD;
+
+	for (	std::list<Ptr<GsamSession> >::reverse_iterator it = lst_sessions.rbegin();
+			it != lst_sessions.rend();
+			it++)
 	{
-		tsi.SetSubstructure(IkeTrafficSelectorSubstructure::GetSecureGroupSubstructure(Ipv4Address("0.0.0.0"), false));
-	}
-	tsi.SetNextPayloadType(tsr.GetPayloadType());
-	//setting up sai2
-	IkePayload sai2;
-	Ptr<Spi> initiator_kek_sa_spi = Create<Spi>();
-	initiator_kek_sa_spi->SetValueFromUint64(session->GetInfo()->RegisterGsamSpi());
-	sai2.SetSubstructure(IkeSaPayloadSubstructure::GenerateAuthIkePayload(initiator_kek_sa_spi));
-	sai2.SetNextPayloadType(tsi.GetPayloadType());
-	//setting up auth
-	IkePayload auth;
-	auth.SetSubstructure(IkeAuthSubstructure::GenerateEmptyAuthSubstructure());
-	auth.SetNextPayloadType(sai2.GetPayloadType());
-	//setting up id
-	IkePayload id;
-	id.SetSubstructure(IkeIdSubstructure::GenerateIpv4Substructure(session->GetGroupAddress(), false));
-	id.SetNextPayloadType(auth.GetPayloadType());
+		Ptr<GsamSession> session = (*it);
 
-	//pause setting up HDR, start setting up a kek sa
-	session->EtablishGsamKekSa();
-	session->SetKekSaInitiatorSpi(initiator_kek_sa_spi->ToUint64());
+		GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session);
 
-	Ptr<Packet> packet = Create<Packet>();
-	packet->AddHeader(tsr);
-	packet->AddHeader(tsi);
-	packet->AddHeader(sai2);
-	packet->AddHeader(auth);
-	packet->AddHeader(id);
+		//Setting up TSr
+		IkePayload tsr;
 
-	uint32_t length_beside_hedaer = id.GetSerializedSize() +
-									auth.GetSerializedSize() +
-									sai2.GetSerializedSize() +
+		if (init_session->IsHostNonQuerier())
+		{
+			tsr.SetSubstructure(IkeTrafficSelectorSubstructure::GenerateEmptySubstructure(true));
+		}
+		else
+		{
+			tsr.SetSubstructure(IkeTrafficSelectorSubstructure::GetSecureGroupSubstructure(session->GetGroupAddress(), true));
+		}
+		tsr.SetNextPayloadType(next_payload_type);
+		//settuping up tsi
+		IkePayload tsi;
+		if (init_session->IsHostNonQuerier())
+		{
+			tsi.SetSubstructure(IkeTrafficSelectorSubstructure::GenerateEmptySubstructure(false));
+		}
+		else
+		{
+			tsi.SetSubstructure(IkeTrafficSelectorSubstructure::GetSecureGroupSubstructure(Ipv4Address("0.0.0.0"), false));
+		}
+		tsi.SetNextPayloadType(tsr.GetPayloadType());
+		//setting up sai2
+		IkePayload sai2;
+		Ptr<Spi> initiator_kek_sa_spi = Create<Spi>();
+		initiator_kek_sa_spi->SetValueFromUint64(session->GetInfo()->RegisterGsamSpi());
+		sai2.SetSubstructure(IkeSaPayloadSubstructure::GenerateAuthIkePayload(initiator_kek_sa_spi));
+		sai2.SetNextPayloadType(tsi.GetPayloadType());
+
+		packet->AddHeader(tsr);
+		packet->AddHeader(tsi);
+		packet->AddHeader(sai2);
+
+		length_beside_hedaer += 	sai2.GetSerializedSize() +
 									tsi.GetSerializedSize() +
 									tsr.GetSerializedSize();
 
+		IkePayloadHeader::PAYLOAD_TYPE payload_type_after_id = sai2.GetPayloadType();
+
+		if (session == lst_sessions.front())
+		{
+			//setting up auth
+			IkePayload auth;
+			auth.SetSubstructure(IkeAuthSubstructure::GenerateEmptyAuthSubstructure());
+			auth.SetNextPayloadType(sai2.GetPayloadType());
+			packet->AddHeader(auth);
+			length_beside_hedaer += auth.GetSerializedSize();
+			payload_type_after_id = auth.GetPayloadType();
+		}
+
+		//setting up id
+		IkePayload id;
+		id.SetSubstructure(IkeIdSubstructure::GenerateIpv4Substructure(session->GetGroupAddress(), false));
+		id.SetNextPayloadType(payload_type_after_id);
+		packet->AddHeader(id);
+		length_beside_hedaer += id.GetSerializedSize();
+
+		next_payload_type = id.GetPayloadType();
+
+		//start setting up a kek sa
+		session->EtablishGsamKekSa();
+		session->SetKekSaInitiatorSpi(initiator_kek_sa_spi->ToUint64());
+	}
+
 	this->SendPhaseOneMessage(	init_session,
 						IkeHeader::IKE_AUTH,
 						false,
-						id.GetPayloadType(),
+						next_payload_type,
 						length_beside_hedaer,
 						packet,
 						true);
 }
 
+void
+GsamL4Protocol::Send_KEK_SA_DELETE (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session);
+
+	NS_ASSERT (true == session->IsHostGroupMember());
+
+	//from now on requests of the q on the session are dropped, the gm no longer answers them
+	session->SetLeaving(true);
+
+	IkePayload delete_payload;
+	delete_payload.SetSubstructure(IkeDeletePayloadSubstructure::GenerateIkeSaDeleteSubstructure());
+
+	Ptr<Packet> packet = Create<Packet>();
+	packet->AddHeader(delete_payload);
+
+	//the gm never initiates otherwise, the next id is not taken by any request of the q it answers
+	session->IncrementMessageId();
+
+	IkeHeader ikeheader;
+	ikeheader.SetInitiatorSpi(session->GetKekSaInitiatorSpi());
+	ikeheader.SetResponderSpi(session->GetKekSaResponderSpi());
+	ikeheader.SetIkev2Version();
+	ikeheader.SetExchangeType(IkeHeader::INFORMATIONAL);
+	ikeheader.SetAsInitiator();
+	ikeheader.SetMessageId(session->GetCurrentMessageId());
+	ikeheader.SetNextPayloadType(delete_payload.GetPayloadType());
+	ikeheader.SetLength(ikeheader.GetSerializedSize() + delete_payload.GetSerializedSize());
+
+	packet->AddHeader(ikeheader);
+
+	session->SetAwaitingResponse(true);
+	session->SetCachePacket(packet);
+	session->SetNumberRetransmission(GsamConfig::GetSingleton()->GetNumberOfRetransmission());
+	this->DoSendMessage(session, true);
+}
+
 void
 GsamL4Protocol::Send_GSA_PUSH (Ptr<GsamSession> session)
 {
@@ -368,6 +525,14 @@ GsamL4Protocol::Send_GSA_PUSH (Ptr<GsamSession> session)
 		//There is a NQ on the other side of the session
 		this->Send_GSA_PUSH_NQ(session);
 	}
+	else if ((true == this->GetIpSecDatabase()->IsGsaPushInFlight(session->GetGroupAddress())) ||
+			(true == session->GetSessionGroup()->IsRekeying()))
+	{
+		//pushes of a group go one after another, the next reuses the gsa_q the last one installs
+		//a rekey is about to replace that gsa_q, so pushes wait for it as well
+		//pushes of other groups do not wait
+		session->GetSessionGroup()->PushBackSessionAwaitingPush(session);
+	}
 	else
 	{
 		//There is a GM on the other side of the session
@@ -375,6 +540,29 @@ GsamL4Protocol::Send_GSA_PUSH (Ptr<GsamSession> session)
 	}
 }
 
+void
+GsamL4Protocol::Send_GSA_PUSH_AWAITING (Ipv4Address group_address)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (true == this->GetIpSecDatabase()->IsGsaPushInFlight(group_address))
+	{
+		return;
+	}
+
+	if (true == this->GetIpSecDatabase()->GetSessionGroup(group_address)->IsRekeying())
+	{
+		//GsamL4Protocol::FinishGroupRekey sends it
+		return;
+	}
+
+	Ptr<GsamSession> session = this->GetIpSecDatabase()->GetSessionGroup(group_address)->PopFrontSessionAwaitingPush();
+	if (0 != session)
+	{
+		this->Send_GSA_PUSH_GM(session);
+	}
+}
+
 void
 GsamL4Protocol::Send_GSA_PUSH_GM (Ptr<GsamSession> session)
 {
@@ -383,13 +571,23 @@ GsamL4Protocol::Send_GSA_PUSH_GM (Ptr<GsamSession> session)
 	Ptr<GsaPushSession> gsa_push_session = session->CreateAndSetGsaPushSession();
 	gsa_push_session->SetStatus(GsaPushSession::GSA_PUSH_ACK);
 
+	//spis proposed by other pushes in flight are not occupied yet, keep clear of them
+	std::set<uint32_t> set_in_flight_spis;
+	this->GetIpSecDatabase()->GetInFlightGsaSpis(set_in_flight_spis);
+
 	//setting up gsa_q
 	Ptr<Spi> suggested_gsa_q_spi = Create<Spi>();
 	Ptr<IpSecSAEntry> gsa_q = session->GetRelatedGsaQ();
 	if (gsa_q == 0)
 	{
-		suggested_gsa_q_spi->SetValueFromUint32(session->GetInfo()->GetLocalAvailableIpsecSpi());
+		uint32_t u32_gsa_q_spi = 0;
+		do {
+			u32_gsa_q_spi = session->GetInfo()->GetIpsecSpiToPropose();
+		} while (set_in_flight_spis.find(u32_gsa_q_spi) != set_in_flight_spis.end());
+		set_in_flight_spis.insert(u32_gsa_q_spi);
+		suggested_gsa_q_spi->SetValueFromUint32(u32_gsa_q_spi);
 		gsa_q = gsa_push_session->CreateGsaQ(suggested_gsa_q_spi->ToUint32());
+		this->DeriveGsaKeys(gsa_q);
 	}
 	else
 	{
@@ -401,8 +599,13 @@ GsamL4Protocol::Send_GSA_PUSH_GM (Ptr<GsamSession> session)
 	Ptr<IpSecSAEntry> gsa_r = session->GetRelatedGsaR();
 	if (gsa_r == 0)
 	{
-		suggested_gsa_r_spi->SetValueFromUint32(session->GetInfo()->GetLocalAvailableIpsecSpi());
+		uint32_t u32_gsa_r_spi = 0;
+		do {
+			u32_gsa_r_spi = session->GetInfo()->GetIpsecSpiToPropose();
+		} while (set_in_flight_spis.find(u32_gsa_r_spi) != set_in_flight_spis.end());
+		suggested_gsa_r_spi->SetValueFromUint32(u32_gsa_r_spi);
 		gsa_r = gsa_push_session->CreateGsaR(suggested_gsa_r_spi->ToUint32());
+		this->DeriveGsaKeys(gsa_r);
 	}
 	else
 	{
@@ -427,6 +630,9 @@ GsamL4Protocol::Send_GSA_PUSH_GM (Ptr<GsamSession> session)
 	Ptr<Packet> packet = Create<Packet>();
 	packet->AddHeader(gsa_push_proposal_payload);
 
+	IkePayloadHeader::PAYLOAD_TYPE first_payload_type = gsa_push_proposal_payload.GetPayloadType();
+	this->PrependSpiLeases(session, packet, first_payload_type, length_beside_ikeheader);
+
 //	std::cout << "GsamL4Protocol::Send_GSA_PUSH_GM, Node: " << this->m_node->GetId() << ", GsamSession: " << session;
 //	std::cout << " GsaPush Id: " << gsa_push_session->GetId() << std::endl;
 //	std::cout << " Gsa Q: " << suggested_gsa_q_spi->ToUint32();
@@ -436,7 +642,7 @@ GsamL4Protocol::Send_GSA_PUSH_GM (Ptr<GsamSession> session)
 	this->SendPhaseTwoMessage(	session,
 						IkeHeader::INFORMATIONAL,
 						false,
-						gsa_push_proposal_payload.GetPayloadType(),
+						first_payload_type,
 						length_beside_ikeheader,
 						packet,
 						true);
@@ -471,6 +677,9 @@ GsamL4Protocol::Send_GSA_RE_PUSH (Ptr<GsaPushSession> gsa_push_session)
 		//the revise gsa pair should have already been installed
 		NS_ASSERT (false);
 	}
+	//the revision changed the spis, the keys follow them
+	this->DeriveGsaKeys(installed_gsa_q);
+	this->DeriveGsaKeys(installed_gsa_r);
 //**********************************************
 	//send to the gm and nqs
 	Ptr<IkeGsaPayloadSubstructure> re_push_gm_nqs_payload_sub = IkeGsaPayloadSubstructure::GenerateEmptyGsaPayload(gsa_push_session->GetId(),
@@ -594,6 +803,7 @@ GsamL4Protocol::Send_GSA_RE_PUSH (Ptr<GsaPushSession> gsa_push_session)
 	{
 		Ipv4Address group_address = gsa_push_session->GetGmSession()->GetGroupAddress();
 		igmp->SendSecureGroupSpecificQuery(group_address);
+		this->Send_GSA_PUSH_AWAITING(group_address);
 	}
 }
 
@@ -699,6 +909,8 @@ GsamL4Protocol::Send_GSA_PUSH_NQ (Ptr<GsamSession> session)
 		next_payload_type = session_group_sa_payload.GetPayloadType();
 	}
 
+	this->PrependSpiLeases(session, packet, next_payload_type, length_beside_ikheader);
+
 	//now we have a SA payload with  spis from all GMs' sessions
 	this->SendPhaseTwoMessage(session,
 			IkeHeader::INFORMATIONAL,
@@ -934,16 +1146,40 @@ GsamL4Protocol::DeliverToNQs (	Ptr<GsaPushSession> gsa_push_session,
 		Ptr<GsamSession> nq_session = (*const_it);
 		gsa_push_session->PushBackNqSession(nq_session);
 		nq_session->InsertGsaPushSession(gsa_push_session);
+	}
+
+	if (true == GsamConfig::GetSingleton()->IsMulticastNqPush())
+	{
+		Ptr<Packet> packet = Create<Packet>();
+		packet->AddHeader(payload_without_header);
+		if (true == this->MulticastToNQs(	lst_sessions_nq,
+											packet,
+											payload_without_header.GetPayloadType(),
+											payload_without_header.GetSerializedSize(),
+											exchange_type))
+		{
+			return;
+		}
+	}
+
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = lst_sessions_nq.begin();
+			const_it != lst_sessions_nq.end();
+			const_it++)
+	{
+		Ptr<GsamSession> nq_session = (*const_it);
 
 		uint32_t length_beside_ikeheader = payload_without_header.GetSerializedSize();
 
 		Ptr<Packet> packet = Create<Packet>();
 		packet->AddHeader(payload_without_header);
 
+		IkePayloadHeader::PAYLOAD_TYPE first_payload_type = payload_without_header.GetPayloadType();
+		this->PrependSpiLeases(nq_session, packet, first_payload_type, length_beside_ikeheader);
+
 		this->SendPhaseTwoMessage(		nq_session,
 								exchange_type,
 								false,
-								payload_without_header.GetPayloadType(),
+								first_payload_type,
 								length_beside_ikeheader,
 								packet,
 								true);
@@ -996,111 +1232,472 @@ GsamL4Protocol::DeliverToNQs (	Ptr<GsaPushSession> gsa_push_session,
 	}
 }
 
-void
-GsamL4Protocol::SendPhaseOneMessage (	Ptr<GsamSession> session,
-								IkeHeader::EXCHANGE_TYPE exchange_type,
-								bool is_responder,
-								IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
-								uint32_t length_beside_ikeheader,
-								Ptr<Packet> packet,
-								bool retransmit)
+bool
+GsamL4Protocol::MulticastToNQs (	const std::list<Ptr<GsamSession> >& lst_nq_sessions,
+									Ptr<Packet> packet_without_ikeheader,
+									IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
+									uint32_t length_beside_ikeheader,
+									IkeHeader::EXCHANGE_TYPE exchange_type)
 {
 	NS_LOG_FUNCTION (this);
 
-	Ptr<Packet> cache_packet = packet->Copy();
-
-	//setting up HDR
-	IkeHeader ikeheader;
-	ikeheader.SetInitiatorSpi(session->GetInitSaInitiatorSpi());
-	ikeheader.SetResponderSpi(session->GetInitSaResponderSpi());
-	ikeheader.SetIkev2Version();
-	ikeheader.SetExchangeType(exchange_type);
-	if (true == is_responder)
+	if (true == lst_nq_sessions.empty())
 	{
-		ikeheader.SetAsResponder();
+		return false;
 	}
-	else
+
+	//an nq takes the multicast as the request after the last one it answered
+	//so every nq must have answered its last request and have been sent the same spi leases
+	uint32_t num_leases_sent = lst_nq_sessions.front()->GetNumberOfSpiLeasesSent();
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = lst_nq_sessions.begin();
+			const_it != lst_nq_sessions.end();
+			const_it++)
 	{
-		ikeheader.SetAsInitiator();
+		Ptr<GsamSession> nq_session = (*const_it);
+		if (	(nq_session->GetCurrentMessageId() < 2) ||
+				(true == nq_session->IsAwaitingResponse()) ||
+				(nq_session->GetNumberOfSpiLeasesSent() != num_leases_sent))
+		{
+			return false;
+		}
 	}
-	ikeheader.SetMessageId(session->GetCurrentMessageId());
-	ikeheader.SetNextPayloadType(first_payload_type);
-	ikeheader.SetLength(ikeheader.GetSerializedSize() + length_beside_ikeheader);
 
-	cache_packet->AddHeader(ikeheader);
+	Ptr<Packet> multicast_packet = 0;
+	IkePayloadHeader::PAYLOAD_TYPE multicast_first_payload_type = first_payload_type;
+	uint32_t multicast_length_beside_ikeheader = length_beside_ikeheader;
 
-	bool actual_retransmit = false;
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = lst_nq_sessions.begin();
+			const_it != lst_nq_sessions.end();
+			const_it++)
+	{
+		Ptr<GsamSession> nq_session = (*const_it);
 
-	if (false == is_responder)
+		Ptr<Packet> packet = packet_without_ikeheader->Copy();
+		IkePayloadHeader::PAYLOAD_TYPE session_first_payload_type = first_payload_type;
+		uint32_t session_length_beside_ikeheader = length_beside_ikeheader;
+		this->PrependSpiLeases(nq_session, packet, session_first_payload_type, session_length_beside_ikeheader);
+
+		if (0 == multicast_packet)
+		{
+			//the leases are the same for every nq
+			multicast_packet = packet->Copy();
+			multicast_first_payload_type = session_first_payload_type;
+			multicast_length_beside_ikeheader = session_length_beside_ikeheader;
+		}
+
+		//the unicast copy is only sent to repair, when the nq does not answer in time
+		IkeHeader ikeheader;
+		ikeheader.SetAsInitiator();
+		ikeheader.SetInitiatorSpi(nq_session->GetKekSaInitiatorSpi());
+		ikeheader.SetResponderSpi(nq_session->GetKekSaResponderSpi());
+		ikeheader.SetIkev2Version();
+		ikeheader.SetExchangeType(exchange_type);
+		ikeheader.SetNextPayloadType(session_first_payload_type);
+		ikeheader.SetLength(ikeheader.GetSerializedSize() + session_length_beside_ikeheader);
+		nq_session->IncrementMessageId();
+		ikeheader.SetMessageId(nq_session->GetCurrentMessageId());
+		packet->AddHeader(ikeheader);
+
+		nq_session->SetAwaitingResponse(true);
+		nq_session->SetCachePacket(packet);
+		nq_session->SetNumberRetransmission(GsamConfig::GetSingleton()->GetNumberOfRetransmission());
+		this->DoScheduleRepair(nq_session);
+	}
+
+	//kek spis and message id differ per nq, each nq takes them from its session with the sender
+	IkeHeader multicast_ikeheader;
+	multicast_ikeheader.SetAsInitiator();
+	multicast_ikeheader.SetInitiatorSpi(0);
+	multicast_ikeheader.SetResponderSpi(0);
+	multicast_ikeheader.SetIkev2Version();
+	multicast_ikeheader.SetExchangeType(exchange_type);
+	multicast_ikeheader.SetNextPayloadType(multicast_first_payload_type);
+	multicast_ikeheader.SetLength(multicast_ikeheader.GetSerializedSize() + multicast_length_beside_ikeheader);
+	multicast_ikeheader.SetMessageId(0);
+	multicast_packet->AddHeader(multicast_ikeheader);
+
+	Ptr<UdpL4ProtocolMulticast> udp = this->m_node->GetObject<UdpL4ProtocolMulticast>();
+	if (0 == udp)
 	{
-		actual_retransmit = retransmit;
+		NS_ASSERT (false);
 	}
 
-	session->SetCachePacket(cache_packet);
+	Ipv4Address nq_control_group_address = GsamConfig::GetNqControlGroupAddress();
 
-	session->SetNumberRetransmission(GsamConfig::GetSingleton()->GetNumberOfRetransmission());
-	this->DoSendMessage(session, actual_retransmit);
+	GsamConfig::GetSingleton()->LogMsgSent("gsam", this->m_node->GetId(), multicast_packet, nq_control_group_address);
+
+	//no route, it goes out of every interface as igmp queries do
+	udp->Send(multicast_packet, Ipv4Address::GetAny(), nq_control_group_address, GsamL4Protocol::PROT_NUMBER, GsamL4Protocol::PROT_NUMBER);
+
+	return true;
 }
 
 void
-GsamL4Protocol::SendPhaseOneMessage (	Ptr<GsamInitSession> session,
-								IkeHeader::EXCHANGE_TYPE exchange_type,
-								bool is_responder,
-								IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
-								uint32_t length_beside_ikeheader,
-								Ptr<Packet> packet,
-								bool retransmit)
+GsamL4Protocol::CheckRekey (void)
 {
 	NS_LOG_FUNCTION (this);
 
-	Ptr<Packet> cache_packet = packet->Copy();
+	Ptr<GsamConfig> config = GsamConfig::GetSingleton();
+	Ptr<IpSecDatabase> database = this->GetIpSecDatabase();
 
-	//setting up HDR
-	IkeHeader ikeheader;
-	ikeheader.SetInitiatorSpi(session->GetInitSaInitiatorSpi());
-	ikeheader.SetResponderSpi(session->GetInitSaResponderSpi());
-	ikeheader.SetIkev2Version();
-	ikeheader.SetExchangeType(exchange_type);
-	if (true == is_responder)
-	{
-		ikeheader.SetAsResponder();
-	}
-	else
+	if (true == database->IsHostQuerier())
 	{
-		ikeheader.SetAsInitiator();
-	}
-	ikeheader.SetMessageId(session->GetExchangeMessageId(exchange_type));
-	ikeheader.SetNextPayloadType(first_payload_type);
-	ikeheader.SetLength(ikeheader.GetSerializedSize() + length_beside_ikeheader);
+		//groups whose sas reach their soft lifetime, the rest waits for a later check
+		uint16_t max_groups_per_round = config->GetRekeyMaxGroupsPerRound();
+		std::list<Ptr<GsamSessionGroup> > lst_session_groups_to_rekey;
+		const std::list<Ptr<GsamSessionGroup> >& lst_session_groups = database->GetSessionGroups();
 
-	cache_packet->AddHeader(ikeheader);
+		for (	std::list<Ptr<GsamSessionGroup> >::const_iterator const_it = lst_session_groups.begin();
+				const_it != lst_session_groups.end();
+				const_it++)
+		{
+			if ((0 != max_groups_per_round) && (lst_session_groups_to_rekey.size() >= max_groups_per_round))
+			{
+				break;
+			}
 
-	bool actual_retransmit = false;
+			Ptr<GsamSessionGroup> session_group = (*const_it);
+			if (	(session_group->GetGroupAddress() != GsamConfig::GetIgmpv3DestGrpReportAddress()) &&
+					(0 != session_group->GetRelatedGsaQ()) &&
+					(false == session_group->IsRekeying()) &&
+					(false == database->IsGsaPushInFlight(session_group->GetGroupAddress())) &&
+					(true == session_group->IsSoftLifetimeExpired()))
+			{
+				lst_session_groups_to_rekey.push_back(session_group);
+			}
+		}
 
-	if (false == is_responder)
-	{
-		actual_retransmit = retransmit;
+		if (false == lst_session_groups_to_rekey.empty())
+		{
+			this->Send_GSA_REKEY(lst_session_groups_to_rekey);
+		}
 	}
 
-	session->SetCachePacket(cache_packet);
-
-	session->SetNumberRetransmission(GsamConfig::GetSingleton()->GetNumberOfRetransmission());
-	this->DoSendInitMessage(session, actual_retransmit);
+	Time interval = config->GetRekeyCheckIntervalInSeconds();
+	if ((Simulator::Now() + interval) < config->GetSimulationTimeInSeconds())
+	{
+		this->m_rekey_event = Simulator::Schedule (interval, &GsamL4Protocol::CheckRekey, this);
+	}
 }
 
 void
-GsamL4Protocol::SendPhaseTwoMessage (	Ptr<GsamSession> session,
-								IkeHeader::EXCHANGE_TYPE exchange_type,
-								bool is_responder,
-								IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
-								uint32_t length_beside_ikeheader,
-								Ptr<Packet> packet,
-								bool retransmit)
+GsamL4Protocol::Send_GSA_REKEY (const std::list<Ptr<GsamSessionGroup> >& lst_session_groups)
 {
 	NS_LOG_FUNCTION (this);
 
+	Ptr<GsamConfig> config = GsamConfig::GetSingleton();
+	Ptr<IpSecDatabase> database = this->GetIpSecDatabase();
+	Ptr<GsamInfo> info = database->GetInfo();
+	Time grace_time = config->GetSpiRekeyGraceTimeInSeconds();
+
+	std::set<uint32_t> set_in_flight_spis;
+	database->GetInFlightGsaSpis(set_in_flight_spis);
+
+	Ptr<GsamSessionGroup> session_group_nq = database->GetSessionGroup(GsamConfig::GetIgmpv3DestGrpReportAddress());
+	std::list<Ptr<GsamSession> >& lst_sessions_nq = session_group_nq->GetSessions();
+
+	//one re-push per gm peer, carrying a payload for every group of it being rekeyed
+	std::map<uint32_t, std::pair<Ptr<GsamSession>, std::list<IkePayload> > > map_peer_address_to_gm_payloads;
+	//one re-push per nq, carrying a payload for every group being rekeyed
+	std::list<IkePayload> lst_nq_payloads;
+	uint32_t number_of_payloads = 0;
+	uint32_t number_of_messages = 0;
+
+	for (	std::list<Ptr<GsamSessionGroup> >::const_iterator const_it = lst_session_groups.begin();
+			const_it != lst_session_groups.end();
+			const_it++)
+	{
+		Ptr<GsamSessionGroup> session_group = (*const_it);
+		Ipv4Address group_address = session_group->GetGroupAddress();
+		Ptr<IpSecPolicyEntry> policy = session_group->GetRelatedPolicy();
+		Ptr<IpSecSAEntry> gsa_q = session_group->GetRelatedGsaQ();
+
+		if ((0 == policy) || (0 == gsa_q))
+		{
+			NS_ASSERT (false);
+		}
+
+		//gsa_q is switched once everyone acked, see GsamL4Protocol::FinishGroupRekey
+		uint32_t new_gsa_q_spi = 0;
+		do {
+			new_gsa_q_spi = info->GetIpsecSpiToPropose();
+		} while (set_in_flight_spis.find(new_gsa_q_spi) != set_in_flight_spis.end());
+		set_in_flight_spis.insert(new_gsa_q_spi);
+
+		session_group->StartRekey(new_gsa_q_spi);
+		config->LogRekeyStart(this->m_node->GetId(), group_address);
+		GsamConfig::LogGsaQ(__FUNCTION__, new_gsa_q_spi);
+
+		Ptr<IkeGsaPayloadSubstructure> nq_payload_sub = IkeGsaPayloadSubstructure::GenerateEmptyGsaPayload(0, group_address, true);
+		nq_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(Create<Spi>(gsa_q->GetSpi()), IkeGsaProposal::GSA_Q_TO_BE_MODIFIED));
+		nq_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(Create<Spi>(new_gsa_q_spi), IkeGsaProposal::GSA_Q_REPLACEMENT));
+
+		const std::list<Ptr<GsamSession> >& lst_gm_sessions = session_group->GetSessionsConst();
+		for (	std::list<Ptr<GsamSession> >::const_iterator const_it_gm = lst_gm_sessions.begin();
+				const_it_gm != lst_gm_sessions.end();
+				const_it_gm++)
+		{
+			Ptr<GsamSession> gm_session = (*const_it_gm);
+			Ptr<IpSecSAEntry> old_gsa_r = gm_session->GetRelatedGsaR();
+			if (0 == old_gsa_r)
+			{
+				//its push has not got that far, it will be pushed the new gsa_q
+				continue;
+			}
+
+			//gsa_r is switched right away, the old one is accepted until the gm got the re-push
+			uint32_t new_gsa_r_spi = 0;
+			do {
+				new_gsa_r_spi = info->GetIpsecSpiToPropose();
+			} while (set_in_flight_spis.find(new_gsa_r_spi) != set_in_flight_spis.end());
+			set_in_flight_spis.insert(new_gsa_r_spi);
+
+			Ptr<IpSecSAEntry> new_gsa_r = policy->GetInboundSAD()->CreateIpSecSAEntry(new_gsa_r_spi);
+			gm_session->SetRelatedGsaR(new_gsa_r);
+			info->OccupyIpsecSpi(new_gsa_r_spi);
+			this->DeriveGsaKeys(new_gsa_r);
+			Simulator::Schedule (grace_time,
+								&IpSecSADatabase::RemoveEntry,
+								policy->GetInboundSAD(),
+								old_gsa_r);
+			GsamConfig::LogGsaR(__FUNCTION__, new_gsa_r_spi);
+
+			Ptr<IkeGsaPayloadSubstructure> gm_payload_sub = IkeGsaPayloadSubstructure::GenerateEmptyGsaPayload(0, group_address, true);
+			gm_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(Create<Spi>(gsa_q->GetSpi()), IkeGsaProposal::GSA_Q_TO_BE_MODIFIED));
+			gm_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(Create<Spi>(new_gsa_q_spi), IkeGsaProposal::GSA_Q_REPLACEMENT));
+			gm_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(Create<Spi>(old_gsa_r->GetSpi()), IkeGsaProposal::GSA_R_TO_BE_MODIFIED));
+			gm_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(Create<Spi>(new_gsa_r_spi), IkeGsaProposal::GSA_R_REPLACEMENT));
+			IkePayload gm_payload;
+			gm_payload.SetSubstructure(gm_payload_sub);
+
+			nq_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(Create<Spi>(old_gsa_r->GetSpi()), IkeGsaProposal::GSA_R_TO_BE_MODIFIED));
+			nq_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(Create<Spi>(new_gsa_r_spi), IkeGsaProposal::GSA_R_REPLACEMENT));
+
+			std::map<uint32_t, std::pair<Ptr<GsamSession>, std::list<IkePayload> > >::iterator it_peer = map_peer_address_to_gm_payloads.find(gm_session->GetPeerAddress().Get());
+			if (map_peer_address_to_gm_payloads.end() == it_peer)
+			{
+				//the first session of the peer carries the re-push of all its groups
+				it_peer = map_peer_address_to_gm_payloads.insert(std::pair<uint32_t, std::pair<Ptr<GsamSession>, std::list<IkePayload> > >(	gm_session->GetPeerAddress().Get(),
+																																			std::pair<Ptr<GsamSession>, std::list<IkePayload> >(gm_session, std::list<IkePayload>()))).first;
+			}
+			it_peer->second.second.push_back(gm_payload);
+			session_group->InsertSessionAwaitingRekeyAck(it_peer->second.first);
+			number_of_payloads++;
+		}
+
+		IkePayload nq_payload;
+		nq_payload.SetSubstructure(nq_payload_sub);
+		lst_nq_payloads.push_back(nq_payload);
+
+		for (	std::list<Ptr<GsamSession> >::const_iterator const_it_nq = lst_sessions_nq.begin();
+				const_it_nq != lst_sessions_nq.end();
+				const_it_nq++)
+		{
+			session_group->InsertSessionAwaitingRekeyAck(*const_it_nq);
+		}
+
+		//members that never ack do not hold the group back longer than a rejected push would
+		Simulator::Schedule (grace_time,
+							&GsamL4Protocol::FinishGroupRekey,
+							this,
+							session_group,
+							new_gsa_q_spi);
+	}
+
+	//send to gms
+	for (	std::map<uint32_t, std::pair<Ptr<GsamSession>, std::list<IkePayload> > >::iterator it_peer = map_peer_address_to_gm_payloads.begin();
+			it_peer != map_peer_address_to_gm_payloads.end();
+			it_peer++)
+	{
+		Ptr<GsamSession> gm_session = it_peer->second.first;
+		std::list<IkePayload>& lst_gm_payloads = it_peer->second.second;
+
+		Ptr<Packet> packet = Create<Packet>();
+		uint32_t length_beside_ikeheader = 0;
+		IkePayloadHeader::PAYLOAD_TYPE next_payload_type = IkePayloadHeader::NO_NEXT_PAYLOAD;
+		for (	std::list<IkePayload>::iterator it_payload = lst_gm_payloads.begin();
+				it_payload != lst_gm_payloads.end();
+				it_payload++)
+		{
+			it_payload->SetNextPayloadType(next_payload_type);
+			packet->AddHeader(*it_payload);
+			length_beside_ikeheader += it_payload->GetSerializedSize();
+			next_payload_type = it_payload->GetPayloadType();
+		}
+
+		this->PrependSpiLeases(gm_session, packet, next_payload_type, length_beside_ikeheader);
+
+		this->SendPhaseTwoMessage(	gm_session,
+									IkeHeader::CREATE_CHILD_SA,
+									false,
+									next_payload_type,
+									length_beside_ikeheader,
+									packet,
+									true);
+		number_of_messages++;
+	}
+
+	//send to nqs
+	Ptr<Packet> packet_nq = Create<Packet>();
+	uint32_t length_beside_ikeheader_nq = 0;
+	IkePayloadHeader::PAYLOAD_TYPE next_payload_type_nq = IkePayloadHeader::NO_NEXT_PAYLOAD;
+	for (	std::list<IkePayload>::iterator it_payload = lst_nq_payloads.begin();
+			it_payload != lst_nq_payloads.end();
+			it_payload++)
+	{
+		it_payload->SetNextPayloadType(next_payload_type_nq);
+		packet_nq->AddHeader(*it_payload);
+		length_beside_ikeheader_nq += it_payload->GetSerializedSize();
+		next_payload_type_nq = it_payload->GetPayloadType();
+	}
+
+	if ((true == config->IsMulticastNqPush()) &&
+		(true == this->MulticastToNQs(	lst_sessions_nq,
+										packet_nq,
+										next_payload_type_nq,
+										length_beside_ikeheader_nq,
+										IkeHeader::CREATE_CHILD_SA)))
+	{
+		number_of_messages++;
+		number_of_payloads += lst_nq_payloads.size();
+	}
+	else
+	{
+		for (	std::list<Ptr<GsamSession> >::const_iterator const_it_nq = lst_sessions_nq.begin();
+				const_it_nq != lst_sessions_nq.end();
+				const_it_nq++)
+		{
+			Ptr<GsamSession> nq_session = (*const_it_nq);
+
+			Ptr<Packet> packet = packet_nq->Copy();
+			uint32_t length_beside_ikeheader = length_beside_ikeheader_nq;
+			IkePayloadHeader::PAYLOAD_TYPE first_payload_type = next_payload_type_nq;
+			this->PrependSpiLeases(nq_session, packet, first_payload_type, length_beside_ikeheader);
+
+			this->SendPhaseTwoMessage(	nq_session,
+										IkeHeader::CREATE_CHILD_SA,
+										false,
+										first_payload_type,
+										length_beside_ikeheader,
+										packet,
+										true);
+			number_of_messages++;
+			number_of_payloads += lst_nq_payloads.size();
+		}
+	}
+
+	config->LogRekeyMessagesSent(number_of_messages, number_of_payloads);
+}
+
+void
+GsamL4Protocol::FinishGroupRekey (Ptr<GsamSessionGroup> session_group, uint32_t new_gsa_q_spi)
+{
+	NS_LOG_FUNCTION (this);
+
+	if ((false == session_group->IsRekeying()) ||
+		(session_group->GetRekeyGsaQSpi() != new_gsa_q_spi))
+	{
+		//everyone acked before the grace time ran out
+		return;
+	}
+
+	session_group->FinishRekey();
+	if (0 != session_group->GetRelatedGsaQ())
+	{
+		//same entry under the new spi, new keys with it
+		this->DeriveGsaKeys(session_group->GetRelatedGsaQ());
+	}
+	GsamConfig::GetSingleton()->LogRekeyFinish(this->m_node->GetId(), session_group->GetGroupAddress());
+
+	this->Send_GSA_PUSH_AWAITING(session_group->GetGroupAddress());
+}
+
+void
+GsamL4Protocol::HandleGsaRepushAck (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	if ((ikeheader.GetMessageId() != session->GetCurrentMessageId()) ||
+		(false == session->IsAwaitingResponse()))
+	{
+		//duplicate answer, its request is done already
+		return;
+	}
+
+	session->GetRetransmitTimer().Cancel();
+	session->SetAwaitingResponse(false);
+
+	//the answer is empty, the re-push it answers is still the cached packet
+	this->SettleGroupRekeyRepush(session);
+
+	this->SendPendingPhaseTwoMessage(session);
+}
+
+void
+GsamL4Protocol::SettleGroupRekeyRepush (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<Packet> cache_packet = session->GetCachePacket()->Copy();
+	IkeHeader cache_ikeheader;
+	cache_packet->RemoveHeader(cache_ikeheader);
+
+	if (IkeHeader::CREATE_CHILD_SA != cache_ikeheader.GetExchangeType())
+	{
+		//not a re-push
+		return;
+	}
+
+	IkePayloadHeader::PAYLOAD_TYPE next_payload_type = cache_ikeheader.GetNextPayloadType();
+	while (next_payload_type != IkePayloadHeader::NO_NEXT_PAYLOAD)
+	{
+		IkePayload payload = IkePayload::GetEmptyPayloadFromPayloadType(next_payload_type);
+		cache_packet->RemoveHeader(payload);
+
+		if (next_payload_type == IkePayloadHeader::GSA_REPUSH)
+		{
+			Ptr<IkeGsaPayloadSubstructure> gsa_repush_sub = DynamicCast<IkeGsaPayloadSubstructure>(payload.GetSubstructure());
+			if (0 == gsa_repush_sub->GetGsaPushId())
+			{
+				//re-push of a group rekey
+				Ipv4Address group_address = GsamUtility::CheckAndGetGroupAddressFromTrafficSelectors(	gsa_repush_sub->GetSourceTrafficSelector(),
+																										gsa_repush_sub->GetDestTrafficSelector());
+				Ptr<GsamSessionGroup> session_group = this->GetIpSecDatabase()->GetSessionGroup(group_address);
+				session_group->RemoveSessionAwaitingRekeyAck(session);
+				if ((true == session_group->IsRekeying()) && (true == session_group->IsRekeyAcked()))
+				{
+					this->FinishGroupRekey(session_group, session_group->GetRekeyGsaQSpi());
+				}
+			}
+		}
+		else
+		{
+			//spi leases
+		}
+
+		next_payload_type = payload.GetNextPayloadType();
+	}
+}
+
+void
+GsamL4Protocol::SendPhaseOneMessage (	Ptr<GsamSession> session,
+								IkeHeader::EXCHANGE_TYPE exchange_type,
+								bool is_responder,
+								IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
+								uint32_t length_beside_ikeheader,
+								Ptr<Packet> packet,
+								bool retransmit)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<Packet> cache_packet = packet->Copy();
+
 	//setting up HDR
 	IkeHeader ikeheader;
+	ikeheader.SetInitiatorSpi(session->GetInitSaInitiatorSpi());
+	ikeheader.SetResponderSpi(session->GetInitSaResponderSpi());
+	ikeheader.SetIkev2Version();
+	ikeheader.SetExchangeType(exchange_type);
 	if (true == is_responder)
 	{
 		ikeheader.SetAsResponder();
@@ -1108,16 +1705,54 @@ GsamL4Protocol::SendPhaseTwoMessage (	Ptr<GsamSession> session,
 	else
 	{
 		ikeheader.SetAsInitiator();
-		session->IncrementMessageId();
 	}
+	ikeheader.SetMessageId(session->GetCurrentMessageId());
+	ikeheader.SetNextPayloadType(first_payload_type);
+	ikeheader.SetLength(ikeheader.GetSerializedSize() + length_beside_ikeheader);
+
+	cache_packet->AddHeader(ikeheader);
+
+	bool actual_retransmit = false;
+
+	if (false == is_responder)
+	{
+		actual_retransmit = retransmit;
+	}
+
+	session->SetCachePacket(cache_packet);
+
+	session->SetNumberRetransmission(GsamConfig::GetSingleton()->GetNumberOfRetransmission());
+	this->DoSendMessage(session, actual_retransmit);
+}
+
+void
+GsamL4Protocol::SendPhaseOneMessage (	Ptr<GsamInitSession> session,
+								IkeHeader::EXCHANGE_TYPE exchange_type,
+								bool is_responder,
+								IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
+								uint32_t length_beside_ikeheader,
+								Ptr<Packet> packet,
+								bool retransmit)
+{
+	NS_LOG_FUNCTION (this);
 
 	Ptr<Packet> cache_packet = packet->Copy();
 
-	ikeheader.SetInitiatorSpi(session->GetKekSaInitiatorSpi());
-	ikeheader.SetResponderSpi(session->GetKekSaResponderSpi());
+	//setting up HDR
+	IkeHeader ikeheader;
+	ikeheader.SetInitiatorSpi(session->GetInitSaInitiatorSpi());
+	ikeheader.SetResponderSpi(session->GetInitSaResponderSpi());
 	ikeheader.SetIkev2Version();
 	ikeheader.SetExchangeType(exchange_type);
-	ikeheader.SetMessageId(session->GetCurrentMessageId());
+	if (true == is_responder)
+	{
+		ikeheader.SetAsResponder();
+	}
+	else
+	{
+		ikeheader.SetAsInitiator();
+	}
+	ikeheader.SetMessageId(session->GetExchangeMessageId(exchange_type));
 	ikeheader.SetNextPayloadType(first_payload_type);
 	ikeheader.SetLength(ikeheader.GetSerializedSize() + length_beside_ikeheader);
 
@@ -1130,11 +1765,112 @@ GsamL4Protocol::SendPhaseTwoMessage (	Ptr<GsamSession> session,
 		actual_retransmit = retransmit;
 	}
 
+	session->SetCachePacket(cache_packet);
+
+	session->SetNumberRetransmission(GsamConfig::GetSingleton()->GetNumberOfRetransmission());
+	this->DoSendInitMessage(session, actual_retransmit);
+}
+
+void
+GsamL4Protocol::SendPhaseTwoMessage (	Ptr<GsamSession> session,
+								IkeHeader::EXCHANGE_TYPE exchange_type,
+								bool is_responder,
+								IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
+								uint32_t length_beside_ikeheader,
+								Ptr<Packet> packet,
+								bool retransmit)
+{
+	NS_LOG_FUNCTION (this);
+
+	//setting up HDR
+	IkeHeader ikeheader;
+	if (true == is_responder)
+	{
+		ikeheader.SetAsResponder();
+	}
+	else
+	{
+		ikeheader.SetAsInitiator();
+	}
+
+	Ptr<Packet> cache_packet = packet->Copy();
+
+	ikeheader.SetInitiatorSpi(session->GetKekSaInitiatorSpi());
+	ikeheader.SetResponderSpi(session->GetKekSaResponderSpi());
+	ikeheader.SetIkev2Version();
+	ikeheader.SetExchangeType(exchange_type);
+	ikeheader.SetNextPayloadType(first_payload_type);
+	ikeheader.SetLength(ikeheader.GetSerializedSize() + length_beside_ikeheader);
+
+	bool actual_retransmit = false;
+
+	if (false == is_responder)
+	{
+		actual_retransmit = retransmit;
+	}
+
+	if ((true == actual_retransmit) && (true == session->IsAwaitingResponse()))
+	{
+		//the peer has not answered the last request yet
+		//sending now would replace its cached packet and stop its retransmission
+		//message id is given when it is sent, see GsamL4Protocol::SendPendingPhaseTwoMessage
+		cache_packet->AddHeader(ikeheader);
+		session->PushBackPendingPacket(cache_packet);
+		return;
+	}
+
+	if (false == is_responder)
+	{
+		session->IncrementMessageId();
+	}
+	ikeheader.SetMessageId(session->GetCurrentMessageId());
+
+	cache_packet->AddHeader(ikeheader);
+
+	if (true == actual_retransmit)
+	{
+		session->SetAwaitingResponse(true);
+	}
+
 	session->SetCachePacket(cache_packet);
 	session->SetNumberRetransmission(GsamConfig::GetSingleton()->GetNumberOfRetransmission());
 	this->DoSendMessage(session, actual_retransmit);
 }
 
+void
+GsamL4Protocol::SendPendingPhaseTwoMessage (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (true == session->IsAwaitingResponse())
+	{
+		return;
+	}
+
+	Ptr<Packet> cache_packet = session->PopFrontPendingPacket();
+	if (cache_packet == 0)
+	{
+		if ((true == session->IsLeaving()) && (true == session->IsHostQuerier()) && (false == session->IsBusy()))
+		{
+			//the last request to the leaving gm is through
+			//not from within the timers of the session, it is torn down
+			Simulator::ScheduleNow(&GsamL4Protocol::RemoveGmSession, this, session);
+		}
+		return;
+	}
+
+	IkeHeader ikeheader;
+	cache_packet->RemoveHeader(ikeheader);
+	session->IncrementMessageId();
+	ikeheader.SetMessageId(session->GetCurrentMessageId());
+	cache_packet->AddHeader(ikeheader);
+
+	session->SetAwaitingResponse(true);
+	session->SetCachePacket(cache_packet);
+	session->SetNumberRetransmission(GsamConfig::GetSingleton()->GetNumberOfRetransmission());
+	this->DoSendMessage(session, true);
+}
+
 void
 GsamL4Protocol::DoSendMessage (Ptr<GsamSession> session, bool retransmit)
 {
@@ -1145,7 +1881,7 @@ GsamL4Protocol::DoSendMessage (Ptr<GsamSession> session, bool retransmit)
 	//bool retransmit is for identifying initiator or responder
 	if (session->GetRemainingRetransmissionCount() < GsamConfig::GetSingleton()->GetNumberOfRetransmission())
 	{
-		std::cout << "Retransmitting." << std::endl;
+		NS_LOG_INFO ("Node: " << this->m_node->GetId() << " retransmitting to " << session->GetPeerAddress());
 	}
 
 	Ptr<Packet> packet = session->GetCachePacket();
@@ -1189,21 +1925,141 @@ GsamL4Protocol::DoSendMessage (Ptr<GsamSession> session, bool retransmit)
 			//do nothing
 		}
 	}
+	else if ((true == retransmit) && (true == session->IsAwaitingResponse()))
+	{
+		//no retransmission left, requests queued behind this one go on if it stays unanswered
+		session->GetRetransmitTimer().SetFunction(&GsamL4Protocol::GiveUpPhaseTwoMessage, this);
+		session->GetRetransmitTimer().SetArguments(session);
+		session->GetRetransmitTimer().Schedule(GsamConfig::GetSingleton()->GetDefaultRetransmitTimeoutInSeconds());
+	}
 	//scheudle timeout
 	session->SceduleTimeout(GsamConfig::GetSingleton()->GetDefaultSessionTimeoutSeconds());
 }
 
 void
-GsamL4Protocol::DoSendInitMessage (Ptr<GsamInitSession> session, bool retransmit)
+GsamL4Protocol::GiveUpPhaseTwoMessage (Ptr<GsamSession> session)
 {
 	NS_LOG_FUNCTION (this);
 
-	bool session_retransmit = session->IsRetransmit();
+	NS_LOG_INFO ("Node: " << this->m_node->GetId() << " no answer from " << session->GetPeerAddress() << ", giving up the request");
+
+	if ((true == session->IsHostGroupMember()) && (true == session->IsLeaving()))
+	{
+		//the q is gone or its answer got lost, the gm leaves all the same
+		//not from within the timer of the session, it is torn down
+		session->SetAwaitingResponse(false);
+		Simulator::ScheduleNow(&GsamL4Protocol::FinishGroupLeave, this, session);
+		return;
+	}
+
+	session->SetAwaitingResponse(false);
+
+	if (true == session->IsHostQuerier())
+	{
+		//the peer is silent, a group rekey does not wait for it
+		this->SettleGroupRekeyRepush(session);
+		//nor do the pushes waiting on it, they would keep their groups from moving on
+		this->AbortGsaPushes(session);
+	}
+
+	this->SendPendingPhaseTwoMessage(session);
+}
+
+void
+GsamL4Protocol::AbortGsaPushes (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	if ((false == session->HaveGsaPushSession()) && (true == session->GetGsaPushSessions().empty()))
+	{
+		//nothing waits on it, or it was torn down in the meantime
+		return;
+	}
+
+	if (false == session->IsHostQuerier())
+	{
+		NS_ASSERT (false);
+	}
+
+	std::list<Ptr<GsaPushSession> > lst_gsa_push_sessions;
+
+	if ((true == session->HaveGsaPushSession()) &&
+		(true == session->GetGsaPushSession()->IsAwaitingReplyFrom(session)))
+	{
+		lst_gsa_push_sessions.push_back(session->GetGsaPushSession());
+	}
+
+	for (	std::set<Ptr<GsaPushSession> >::const_iterator const_it = session->GetGsaPushSessions().begin();
+			const_it != session->GetGsaPushSessions().end();
+			const_it++)
+	{
+		if (true == (*const_it)->IsAwaitingReplyFrom(session))
+		{
+			lst_gsa_push_sessions.push_back(*const_it);
+		}
+	}
+
+	std::list<Ipv4Address> lst_group_addresses;
+
+	for (	std::list<Ptr<GsaPushSession> >::iterator it = lst_gsa_push_sessions.begin();
+			it != lst_gsa_push_sessions.end();
+			it++)
+	{
+		Ptr<GsaPushSession> gsa_push_session = (*it);
+		NS_LOG_INFO ("Node: " << this->m_node->GetId() << " no answer from " << session->GetPeerAddress() << ", aborting gsa push " << gsa_push_session->GetId());
+		if (0 != gsa_push_session->GetGmSession())
+		{
+			lst_group_addresses.push_back(gsa_push_session->GetGmSession()->GetGroupAddress());
+		}
+		gsa_push_session->Abort();
+	}
+
+	//the joins parked behind the aborted pushes go ahead
+	for (	std::list<Ipv4Address>::const_iterator const_it = lst_group_addresses.begin();
+			const_it != lst_group_addresses.end();
+			const_it++)
+	{
+		this->Send_GSA_PUSH_AWAITING(*const_it);
+	}
+}
+
+void
+GsamL4Protocol::DoScheduleRepair (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	//the cached packet went out by multicast
+	//arm what GsamL4Protocol::DoSendMessage would have armed after sending it
+	session->GetRetransmitTimer().Cancel();
+
+	if (true == session->IsRetransmit())
+	{
+		session->GetRetransmitTimer().SetFunction(&GsamL4Protocol::DoSendMessage, this);
+		session->GetRetransmitTimer().SetArguments(session, true);
+		session->GetRetransmitTimer().Schedule(GsamConfig::GetSingleton()->GetDefaultRetransmitTimeoutInSeconds());
+		session->DecrementNumberRetransmission();
+	}
+	else if (true == session->IsAwaitingResponse())
+	{
+		session->GetRetransmitTimer().SetFunction(&GsamL4Protocol::GiveUpPhaseTwoMessage, this);
+		session->GetRetransmitTimer().SetArguments(session);
+		session->GetRetransmitTimer().Schedule(GsamConfig::GetSingleton()->GetDefaultRetransmitTimeoutInSeconds());
+	}
+
+	session->SceduleTimeout(GsamConfig::GetSingleton()->GetDefaultSessionTimeoutSeconds());
+}
+
+void
+GsamL4Protocol::DoSendInitMessage (Ptr<GsamInitSession> session, bool retransmit)
+{
+	NS_LOG_FUNCTION (this);
+
+	bool session_retransmit = session->IsRetransmit();
 
 	//bool retransmit is for identifying initiator or responder
 	if (session->GetRemainingRetransmissionCount() < GsamConfig::GetSingleton()->GetNumberOfRetransmission())
 	{
-		std::cout << "Retransmitting." << std::endl;
+		NS_LOG_INFO ("Node: " << this->m_node->GetId() << " retransmitting to " << session->GetPeerAddress());
 	}
 
 	Ptr<Packet> packet = session->GetCachePacket();
@@ -1294,8 +2150,51 @@ GsamL4Protocol::HandleIkeSaInitInvitation (Ptr<Packet> packet, const IkeHeader&
 
 	if (init_session == 0)
 	{
-		//
+		//picking up the cookie, if any
 		IkePayloadHeader::PAYLOAD_TYPE sa_payload_type = ikeheader.GetNextPayloadType();
+		uint64_t cookie = 0;
+		if (sa_payload_type == IkePayloadHeader::NOTIFY)
+		{
+			IkePayload cookie_payload = IkePayload::GetEmptyPayloadFromPayloadType(sa_payload_type);
+			packet->RemoveHeader(cookie_payload);
+			Ptr<IkeNotifySubstructure> cookie_sub = DynamicCast<IkeNotifySubstructure>(cookie_payload.GetSubstructure());
+			if (cookie_sub->GetNotifyMessageType() == IkeNotifySubstructure::COOKIE)
+			{
+				cookie = cookie_sub->GetDataToU64();
+			}
+			sa_payload_type = cookie_payload.GetNextPayloadType();
+		}
+
+		//admission, checked before any state is kept for the initiator
+		uint32_t num_half_open = this->GetIpSecDatabase()->GetNumberOfHalfOpenInitSessions();
+
+		if (true == GsamConfig::GetSingleton()->IsIkeCookieRequired(num_half_open))
+		{
+			if (	(0 == cookie) ||
+					(cookie != this->ComputeIkeCookie(initiator_spi, peer_address)))
+			{
+				this->RespondIkeSaInitCookie(ikeheader, peer_address);
+				return;
+			}
+		}
+
+		uint32_t max_half_open = GsamConfig::GetSingleton()->GetMaxHalfOpenInitSessions();
+		if (	(0 != max_half_open) &&
+				(num_half_open >= max_half_open))
+		{
+			//the initiator retransmits once some half-open session is done or reaped
+			NS_LOG_INFO ("Node: " << this->m_node->GetId() << " half-open sessions full, dropping ike_sa_init from " << peer_address);
+			return;
+		}
+
+		if (true == this->IsCryptoQueueFull())
+		{
+			//same as a full half-open table, the initiator retransmits
+			NS_LOG_INFO ("Node: " << this->m_node->GetId() << " crypto queue full, dropping ike_sa_init from " << peer_address);
+			return;
+		}
+
+		//
 		if (sa_payload_type != IkePayloadHeader::SECURITY_ASSOCIATION)
 		{
 			NS_ASSERT (false);
@@ -1331,12 +2230,25 @@ GsamL4Protocol::HandleIkeSaInitInvitation (Ptr<Packet> packet, const IkeHeader&
 
 		GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), init_session);
 
-		this->RespondIkeSaInit(init_session);
+		this->GenerateKeyExchangeValues(init_session->GetInitSa(), false);
+		if (true == GsamConfig::GetSingleton()->IsIkeKeyExchangeX25519())
+		{
+			this->DeriveIkeSaKeys(init_session, ke_i, n_i);
+		}
+
+		//KEr, g^ir, skeyseed and the keys of the ike sa, answered once a worker is done
+		init_session->SetCryptoPending(true);
+		this->SubmitCryptoJob(	GsamConfig::GetSingleton()->GetCryptoCost(2, 1 + GsamCrypto::GetNumberOfPrfCalls(GsamCrypto::IKE_SA_KEY_MATERIAL_SIZE)),
+								Ptr<EventImpl> (MakeEvent(&GsamL4Protocol::FinishIkeSaInitInvitation, this, init_session), false));
 	}
 	else
 	{
 		GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), init_session);
-		if (init_session->GetCurrentMessageId() == message_id)
+		if (true == init_session->IsCryptoPending())
+		{
+			//still with a crypto worker, there is no response to repeat yet
+		}
+		else if (init_session->GetCurrentMessageId() == message_id)
 		{
 			//duplicate received
 			GsamConfig::LogMsg("Respond to duplicate ");
@@ -1349,6 +2261,86 @@ GsamL4Protocol::HandleIkeSaInitInvitation (Ptr<Packet> packet, const IkeHeader&
 	}
 }
 
+void
+GsamL4Protocol::FinishIkeSaInitInvitation (Ptr<GsamInitSession> init_session)
+{
+	NS_LOG_FUNCTION (this);
+
+	init_session->SetCryptoPending(false);
+
+	if (false == init_session->HaveInitSa())
+	{
+		//torn down while a worker was on it
+		return;
+	}
+
+	this->RespondIkeSaInit(init_session);
+}
+
+void
+GsamL4Protocol::RespondIkeSaInitCookie (const IkeHeader& ikeheader, Ipv4Address peer_address)
+{
+	NS_LOG_FUNCTION (this);
+
+	IkePayload cookie_payload;
+	cookie_payload.SetSubstructure(IkeNotifySubstructure::GenerateCookieSubstructure(this->ComputeIkeCookie(ikeheader.GetInitiatorSpi(), peer_address)));
+
+	IkeHeader cookie_ikeheader;
+	cookie_ikeheader.SetInitiatorSpi(ikeheader.GetInitiatorSpi());
+	cookie_ikeheader.SetResponderSpi(0);
+	cookie_ikeheader.SetIkev2Version();
+	cookie_ikeheader.SetExchangeType(IkeHeader::IKE_SA_INIT);
+	cookie_ikeheader.SetAsResponder();
+	cookie_ikeheader.SetMessageId(ikeheader.GetMessageId());
+	cookie_ikeheader.SetNextPayloadType(cookie_payload.GetPayloadType());
+	cookie_ikeheader.SetLength(cookie_ikeheader.GetSerializedSize() + cookie_payload.GetSerializedSize());
+
+	Ptr<Packet> packet = Create<Packet>();
+	packet->AddHeader(cookie_payload);
+	packet->AddHeader(cookie_ikeheader);
+
+	//no session, no cache and no timer
+	m_socket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom(peer_address), GsamL4Protocol::PROT_NUMBER));
+
+	GsamConfig::GetSingleton()->LogMsgSent("gsam", this->m_node->GetId(), packet, peer_address);
+
+	m_socket->Send(packet);
+}
+
+uint64_t
+GsamL4Protocol::ComputeIkeCookie (uint64_t initiator_spi, Ipv4Address peer_address) const
+{
+	NS_LOG_FUNCTION (this);
+
+	//fnv-1a over the secret, the initiator's spi and address
+	//cheap enough to run for every ike_sa_init under load
+	std::list<uint8_t> lst_bytes;
+	GsamUtility::Uint64ToBytes(lst_bytes, this->m_cookie_secret);
+	std::list<uint8_t> lst_spi_bytes;
+	GsamUtility::Uint64ToBytes(lst_spi_bytes, initiator_spi);
+	lst_bytes.splice(lst_bytes.end(), lst_spi_bytes);
+	std::list<uint8_t> lst_address_bytes;
+	GsamUtility::Uint32ToBytes(lst_address_bytes, peer_address.Get());
+	lst_bytes.splice(lst_bytes.end(), lst_address_bytes);
+
+	uint64_t retval = 14695981039346656037ULL;
+	for (	std::list<uint8_t>::const_iterator const_it = lst_bytes.begin();
+			const_it != lst_bytes.end();
+			const_it++)
+	{
+		retval ^= (*const_it);
+		retval *= 1099511628211ULL;
+	}
+
+	if (0 == retval)
+	{
+		//0 stands for no cookie
+		retval = 1;
+	}
+
+	return retval;
+}
+
 void
 GsamL4Protocol::HandleIkeSaInitResponse (Ptr<Packet> packet, const IkeHeader& ikeheader, Ipv4Address peer_address)
 {
@@ -1374,6 +2366,27 @@ GsamL4Protocol::HandleIkeSaInitResponse (Ptr<Packet> packet, const IkeHeader& ik
 			//response with matched message id received
 			NS_ASSERT (message_id == 0);
 
+			if (true == init_session->IsCryptoPending())
+			{
+				//a repeat of the response, a crypto worker is already on it
+				return;
+			}
+
+			if (ikeheader.GetNextPayloadType() == IkePayloadHeader::NOTIFY)
+			{
+				//the q is under load and asks for a cookie, start over with it
+				IkePayload cookie_payload = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::NOTIFY);
+				packet->RemoveHeader(cookie_payload);
+				Ptr<IkeNotifySubstructure> cookie_sub = DynamicCast<IkeNotifySubstructure>(cookie_payload.GetSubstructure());
+				if (cookie_sub->GetNotifyMessageType() != IkeNotifySubstructure::COOKIE)
+				{
+					NS_ASSERT (false);
+				}
+				init_session->GetRetransmitTimer().Cancel();
+				this->DoSend_IKE_SA_INIT(init_session, cookie_sub->GetDataToU64());
+				return;
+			}
+
 			//
 			IkePayloadHeader::PAYLOAD_TYPE sa_payload_type = ikeheader.GetNextPayloadType();
 			if (sa_payload_type != IkePayloadHeader::SECURITY_ASSOCIATION)
@@ -1413,7 +2426,15 @@ GsamL4Protocol::HandleIkeSaInitResponse (Ptr<Packet> packet, const IkeHeader& ik
 
 			init_session->SetInitSaResponderSpi(responder_spi);
 
-			this->Send_IKE_SA_AUTH(init_session, init_session->GetFirstJoinSession());
+			if (true == GsamConfig::GetSingleton()->IsIkeKeyExchangeX25519())
+			{
+				this->DeriveIkeSaKeys(init_session, ke_r, n_r);
+			}
+
+			//KEi was made before sending, it is charged here together with g^ir
+			init_session->SetCryptoPending(true);
+			this->SubmitCryptoJob(	GsamConfig::GetSingleton()->GetCryptoCost(2, 1 + GsamCrypto::GetNumberOfPrfCalls(GsamCrypto::IKE_SA_KEY_MATERIAL_SIZE)),
+									Ptr<EventImpl> (MakeEvent(&GsamL4Protocol::FinishIkeSaInitResponse, this, init_session), false));
 		}
 		else if (init_session->GetCurrentMessageId() > message_id)
 		{
@@ -1431,6 +2452,22 @@ GsamL4Protocol::HandleIkeSaInitResponse (Ptr<Packet> packet, const IkeHeader& ik
 	}
 }
 
+void
+GsamL4Protocol::FinishIkeSaInitResponse (Ptr<GsamInitSession> init_session)
+{
+	NS_LOG_FUNCTION (this);
+
+	init_session->SetCryptoPending(false);
+
+	if (false == init_session->HaveInitSa())
+	{
+		//torn down while a worker was on it
+		return;
+	}
+
+	this->Send_IKE_SA_AUTH(init_session, init_session->GetFirstJoinSession());
+}
+
 void
 GsamL4Protocol::RespondIkeSaInit (Ptr<GsamInitSession> session)
 {
@@ -1440,11 +2477,11 @@ GsamL4Protocol::RespondIkeSaInit (Ptr<GsamInitSession> session)
 
 	//setting up Nr
 	IkePayload n_r;
-	n_r.SetSubstructure(IkeNonceSubstructure::GenerateRandomNonceSubstructure());
+	n_r.SetSubstructure(this->GenerateNonceSubstructure(session->GetInitSa(), false));
 
 	//setting up KEr
 	IkePayload ke_r;
-	ke_r.SetSubstructure(IkeKeyExchangeSubStructure::GetDummySubstructure());
+	ke_r.SetSubstructure(this->GenerateKeyExchangeSubstructure(session->GetInitSa()));
 	ke_r.SetNextPayloadType(n_r.GetPayloadType());
 
 	//setting up SAr1
@@ -1481,8 +2518,16 @@ GsamL4Protocol::HandleIkeSaAuth (Ptr<Packet> packet, const IkeHeader& ikeheader,
 
 	if (init_session == 0)
 	{
-		//unsolicited
-		NS_ASSERT (false);
+		if (true == GsamConfig::GetSingleton()->IsHalfOpenReapingEnabled())
+		{
+			//the half-open session may have been reaped
+			//discard
+		}
+		else
+		{
+			//unsolicited
+			NS_ASSERT (false);
+		}
 	}
 	else
 	{
@@ -1521,6 +2566,20 @@ GsamL4Protocol::HandleIkeSaAuthInvitation (Ptr<Packet> packet, const IkeHeader&
 
 	NS_ASSERT (message_id == 1);
 
+	if (true == init_session->IsCryptoPending())
+	{
+		//a repeat of the invitation a crypto worker is on, answered once it is done
+		return;
+	}
+
+	if (	(init_session->GetCurrentMessageId() < message_id) &&
+			(true == this->IsCryptoQueueFull()))
+	{
+		//a duplicate is still answered from the cache, new work waits for the retransmission
+		NS_LOG_INFO ("Node: " << this->m_node->GetId() << " crypto queue full, dropping ike_auth from " << init_session->GetPeerAddress());
+		return;
+	}
+
 	if (init_session->GetCurrentMessageId() <= message_id)
 	{
 		//picking up id payload
@@ -1541,80 +2600,117 @@ GsamL4Protocol::HandleIkeSaAuthInvitation (Ptr<Packet> packet, const IkeHeader&
 		IkePayload auth = IkePayload::GetEmptyPayloadFromPayloadType(auth_payload_type);
 		packet->RemoveHeader(auth);
 
-		//picking up SAi2 payload
+		std::list<Ptr<GsamSession> > lst_sessions;
+		std::list<Ptr<GsamSession> > lst_new_sessions;
+		std::list<std::list<IkeTrafficSelector> > lst_narrowed_tssi;
+		std::list<std::list<IkeTrafficSelector> > lst_narrowed_tssr;
+
+		//one id, sai2, tsi and tsr per group joined, the auth payload only follows the first id
 		IkePayloadHeader::PAYLOAD_TYPE sai2_payload_type = auth.GetNextPayloadType();
-		if (sai2_payload_type != IkePayloadHeader::SECURITY_ASSOCIATION)
-		{
-			NS_ASSERT (false);
-		}
-		IkePayload sai2 = IkePayload::GetEmptyPayloadFromPayloadType(sai2_payload_type);
-		packet->RemoveHeader(sai2);
+		bool more_groups = true;
 
-		//picking up TSi payload
-		IkePayloadHeader::PAYLOAD_TYPE tsi_payload_type = sai2.GetNextPayloadType();
-		if (tsi_payload_type != IkePayloadHeader::TRAFFIC_SELECTOR_INITIATOR)
+		while (true == more_groups)
 		{
-			NS_ASSERT (false);
-		}
-		IkePayload tsi = IkePayload::GetEmptyPayloadFromPayloadType(tsi_payload_type);
-		packet->RemoveHeader(tsi);
+			//picking up SAi2 payload
+			if (sai2_payload_type != IkePayloadHeader::SECURITY_ASSOCIATION)
+			{
+				NS_ASSERT (false);
+			}
+			IkePayload sai2 = IkePayload::GetEmptyPayloadFromPayloadType(sai2_payload_type);
+			packet->RemoveHeader(sai2);
 
-		//picking up TSr payload
-		IkePayloadHeader::PAYLOAD_TYPE tsr_payload_type = tsi.GetNextPayloadType();
-		if (tsr_payload_type != IkePayloadHeader::TRAFFIC_SELECTOR_RESPONDER)
-		{
-			NS_ASSERT (false);
+			//picking up TSi payload
+			IkePayloadHeader::PAYLOAD_TYPE tsi_payload_type = sai2.GetNextPayloadType();
+			if (tsi_payload_type != IkePayloadHeader::TRAFFIC_SELECTOR_INITIATOR)
+			{
+				NS_ASSERT (false);
+			}
+			IkePayload tsi = IkePayload::GetEmptyPayloadFromPayloadType(tsi_payload_type);
+			packet->RemoveHeader(tsi);
+
+			//picking up TSr payload
+			IkePayloadHeader::PAYLOAD_TYPE tsr_payload_type = tsi.GetNextPayloadType();
+			if (tsr_payload_type != IkePayloadHeader::TRAFFIC_SELECTOR_RESPONDER)
+			{
+				NS_ASSERT (false);
+			}
+			IkePayload tsr = IkePayload::GetEmptyPayloadFromPayloadType(tsr_payload_type);
+			packet->RemoveHeader(tsr);
+
+			Ptr<IkeSaPayloadSubstructure> sai2_sub = DynamicCast<IkeSaPayloadSubstructure>(sai2.GetSubstructure());
+			Ptr<IkeSaProposal> chosen_proposal = GsamL4Protocol::ChooseSAProposalOffer(sai2_sub->GetProposals());
+
+			std::list<IkeTrafficSelector> narrowed_tssi;
+			Ptr<IkeTrafficSelectorSubstructure> tsi_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsi.GetSubstructure());
+			GsamL4Protocol::NarrowTrafficSelectors(tsi_sub->GetTrafficSelectors(), narrowed_tssi);
+			std::list<IkeTrafficSelector> narrowed_tssr;
+			Ptr<IkeTrafficSelectorSubstructure> tsr_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsr.GetSubstructure());
+			GsamL4Protocol::NarrowTrafficSelectors(tsr_sub->GetTrafficSelectors(), narrowed_tssr);
+
+			Ptr<IkeIdSubstructure> id_substructure = DynamicCast<IkeIdSubstructure>(id.GetSubstructure());
+
+			Ptr<GsamSession> session = 0;
+			bool new_session_created = this->ProcessIkeSaAuthInvitation(	init_session,
+															id_substructure->GetIpv4AddressFromData(),
+															chosen_proposal,
+															narrowed_tssi,
+															narrowed_tssr,
+															session);
+
+			lst_sessions.push_back(session);
+			lst_narrowed_tssi.push_back(narrowed_tssi);
+			lst_narrowed_tssr.push_back(narrowed_tssr);
+			if (true == new_session_created)
+			{
+				lst_new_sessions.push_back(session);
+			}
+
+			//picking up the id payload of the next group, if any
+			if (tsr.GetNextPayloadType() == IkePayloadHeader::IDENTIFICATION_INITIATOR)
+			{
+				id = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::IDENTIFICATION_INITIATOR);
+				packet->RemoveHeader(id);
+				sai2_payload_type = id.GetNextPayloadType();
+			}
+			else
+			{
+				more_groups = false;
+			}
 		}
-		IkePayload tsr = IkePayload::GetEmptyPayloadFromPayloadType(tsr_payload_type);
-		packet->RemoveHeader(tsr);
-
-		Ptr<IkeSaPayloadSubstructure> sai2_sub = DynamicCast<IkeSaPayloadSubstructure>(sai2.GetSubstructure());
-		Ptr<IkeSaProposal> chosen_proposal = GsamL4Protocol::ChooseSAProposalOffer(sai2_sub->GetProposals());
-
-		std::list<IkeTrafficSelector> narrowed_tssi;
-		Ptr<IkeTrafficSelectorSubstructure> tsi_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsi.GetSubstructure());
-		GsamL4Protocol::NarrowTrafficSelectors(tsi_sub->GetTrafficSelectors(), narrowed_tssi);
-		std::list<IkeTrafficSelector> narrowed_tssr;
-		Ptr<IkeTrafficSelectorSubstructure> tsr_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsr.GetSubstructure());
-		GsamL4Protocol::NarrowTrafficSelectors(tsr_sub->GetTrafficSelectors(), narrowed_tssr);
-
-		Ptr<IkeIdSubstructure> id_substructure = DynamicCast<IkeIdSubstructure>(id.GetSubstructure());
-
-		Ptr<GsamSession> session = 0;
-		bool new_session_created = this->ProcessIkeSaAuthInvitation(	init_session,
-														id_substructure->GetIpv4AddressFromData(),
-														chosen_proposal,
-														narrowed_tssi,
-														narrowed_tssr,
-														session);
-
-//		if (!init_session->HaveKekSa())
-//		{
-//			//not duplicated packet
-//			this->ProcessIkeSaAuthInvitation(	init_session,
-//												id_substructure->GetIpv4AddressFromData(),
-//												chosen_proposal,
-//												narrowed_tssi,
-//												narrowed_tssr);
-//		}
-//		else
-//		{
-//			//it has already receive a same auth invitation for the same session before
-//			//this assert is set because we have set an if (current_session_id < message_id) or (current_session_id == message_id) guard ahead
-//			NS_ASSERT (false);
-//		}
-
-		if (true == new_session_created)
+
+		if (false == lst_new_sessions.empty())
 		{
 			init_session->SetMessageId(message_id);
 
-			this->RespondIkeSaAuth(session, chosen_proposal, narrowed_tssi, narrowed_tssr);
+			if (true == GsamConfig::GetSingleton()->IsIkeKeyExchangeX25519())
+			{
+				for (	std::list<Ptr<GsamSession> >::const_iterator const_it = lst_new_sessions.begin();
+						const_it != lst_new_sessions.end();
+						const_it++)
+				{
+					this->DeriveKekSaKeys(*const_it);
+				}
+			}
+
+			//auth of both sides, then per new group its kek sa and the gsa pair pushed to it
+			uint32_t number_of_prf = 4 + (lst_new_sessions.size() * (	GsamCrypto::GetNumberOfPrfCalls(GsamCrypto::KEK_SA_KEY_MATERIAL_SIZE) +
+																		(2 * GsamCrypto::GetNumberOfPrfCalls(GsamCrypto::GSA_KEY_MATERIAL_SIZE))));
+			init_session->SetCryptoPending(true);
+			this->SubmitCryptoJob(	GsamConfig::GetSingleton()->GetCryptoCost(0, number_of_prf),
+									Ptr<EventImpl> (MakeEvent(	&GsamL4Protocol::FinishIkeSaAuthInvitation,
+																this,
+																init_session,
+																lst_sessions,
+																lst_narrowed_tssi,
+																lst_narrowed_tssr,
+																lst_new_sessions), false));
 		}
 		else
 		{
 			//incoming duplicate invitation
+			//every session of the invitation caches the same response
 			GsamConfig::LogMsg("Respond to duplicate ");
-			this->DoSendMessage(session, false);
+			this->DoSendMessage(lst_sessions.front(), false);
 		}
 	}
 //	@commented, moved codes
@@ -1631,6 +2727,33 @@ GsamL4Protocol::HandleIkeSaAuthInvitation (Ptr<Packet> packet, const IkeHeader&
 
 }
 
+void
+GsamL4Protocol::FinishIkeSaAuthInvitation (	Ptr<GsamInitSession> init_session,
+											const std::list<Ptr<GsamSession> >& lst_sessions,
+											const std::list<std::list<IkeTrafficSelector> >& lst_narrowed_tssi,
+											const std::list<std::list<IkeTrafficSelector> >& lst_narrowed_tssr,
+											const std::list<Ptr<GsamSession> >& lst_new_sessions)
+{
+	NS_LOG_FUNCTION (this);
+
+	init_session->SetCryptoPending(false);
+
+	if (false == init_session->HaveInitSa())
+	{
+		//torn down while a worker was on it
+		return;
+	}
+
+	this->RespondIkeSaAuth(lst_sessions, lst_narrowed_tssi, lst_narrowed_tssr);
+
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = lst_new_sessions.begin();
+			const_it != lst_new_sessions.end();
+			const_it++)
+	{
+		this->Send_GSA_PUSH(*const_it);
+	}
+}
+
 bool
 GsamL4Protocol::ProcessIkeSaAuthInvitation(	Ptr<GsamInitSession> init_session,
 											Ipv4Address group_address,
@@ -1710,8 +2833,6 @@ GsamL4Protocol::HandleIkeSaAuthResponse (Ptr<Packet> packet, const IkeHeader& ik
 		NS_ASSERT (message_id == 1);
 
 		//response with matched message id
-		init_session->GetRetransmitTimer().Cancel();
-
 		//picking up auth payload
 		IkePayloadHeader::PAYLOAD_TYPE auth_payload_type = ikeheader.GetNextPayloadType();
 		if (auth_payload_type != IkePayloadHeader::AUTHENTICATION)
@@ -1721,48 +2842,76 @@ GsamL4Protocol::HandleIkeSaAuthResponse (Ptr<Packet> packet, const IkeHeader& ik
 		IkePayload auth = IkePayload::GetEmptyPayloadFromPayloadType(auth_payload_type);
 		packet->RemoveHeader(auth);
 
-		//picking up SAr2 payload
-		IkePayloadHeader::PAYLOAD_TYPE sar2_payload_type = auth.GetNextPayloadType();
-		if (sar2_payload_type != IkePayloadHeader::SECURITY_ASSOCIATION)
-		{
-			NS_ASSERT (false);
-		}
-		IkePayload sar2 = IkePayload::GetEmptyPayloadFromPayloadType(sar2_payload_type);
-		packet->RemoveHeader(sar2);
+		//one sar2, nonce, tsi and tsr per group in the invitation
+		IkePayloadHeader::PAYLOAD_TYPE next_payload_type = auth.GetNextPayloadType();
 
-		//picking up nonce payload that contains kek initiator spi
-		IkePayloadHeader::PAYLOAD_TYPE nonce_payload_type = sar2.GetNextPayloadType();
-		if (nonce_payload_type != IkePayloadHeader::NONCE)
+		while (next_payload_type == IkePayloadHeader::SECURITY_ASSOCIATION)
 		{
-			NS_ASSERT (false);
+			//picking up SAr2 payload
+			IkePayload sar2 = IkePayload::GetEmptyPayloadFromPayloadType(next_payload_type);
+			packet->RemoveHeader(sar2);
+
+			//picking up nonce payload that contains kek initiator spi
+			IkePayloadHeader::PAYLOAD_TYPE nonce_payload_type = sar2.GetNextPayloadType();
+			if (nonce_payload_type != IkePayloadHeader::NONCE)
+			{
+				NS_ASSERT (false);
+			}
+			IkePayload nonce_payload = IkePayload::GetEmptyPayloadFromPayloadType(nonce_payload_type);
+			packet->RemoveHeader(nonce_payload);
+
+			//picking up TSi payload
+			IkePayloadHeader::PAYLOAD_TYPE tsi_payload_type = nonce_payload.GetNextPayloadType();
+			if (tsi_payload_type != IkePayloadHeader::TRAFFIC_SELECTOR_INITIATOR)
+			{
+				NS_ASSERT (false);
+			}
+			IkePayload tsi = IkePayload::GetEmptyPayloadFromPayloadType(tsi_payload_type);
+			packet->RemoveHeader(tsi);
+
+			//picking up TSr payload
+			IkePayloadHeader::PAYLOAD_TYPE tsr_payload_type = tsi.GetNextPayloadType();
+			if (tsr_payload_type != IkePayloadHeader::TRAFFIC_SELECTOR_RESPONDER)
+			{
+				NS_ASSERT (false);
+			}
+			IkePayload tsr = IkePayload::GetEmptyPayloadFromPayloadType(tsr_payload_type);
+			packet->RemoveHeader(tsr);
+
+			Ptr<IkeSaPayloadSubstructure> sar2_sub = DynamicCast<IkeSaPayloadSubstructure>(sar2.GetSubstructure());
+			Ptr<IkeTrafficSelectorSubstructure> tsi_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsi.GetSubstructure());
+			Ptr<IkeTrafficSelectorSubstructure> tsr_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsr.GetSubstructure());
+			Ptr<IkeNonceSubstructure> nonce_sub = DynamicCast<IkeNonceSubstructure>(nonce_payload.GetSubstructure());
+
+			this->ProcessIkeSaAuthResponse(init_session, nonce_sub->GetDataToU64(), sar2_sub->GetProposals(), tsi_sub->GetTrafficSelectors(), tsr_sub->GetTrafficSelectors());
+
+			next_payload_type = tsr.GetNextPayloadType();
 		}
-		IkePayload nonce_payload = IkePayload::GetEmptyPayloadFromPayloadType(nonce_payload_type);
-		packet->RemoveHeader(nonce_payload);
 
-		//picking up TSi payload
-		IkePayloadHeader::PAYLOAD_TYPE tsi_payload_type = nonce_payload.GetNextPayloadType();
-		if (tsi_payload_type != IkePayloadHeader::TRAFFIC_SELECTOR_INITIATOR)
+		//picking up spi leases of the q, if any
+		if (next_payload_type == IkePayloadHeader::GROUP_NOTIFY)
 		{
-			NS_ASSERT (false);
+			IkePayload spi_lease_payload = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::GROUP_NOTIFY);
+			packet->RemoveHeader(spi_lease_payload);
+			this->ReserveSpiLeases(init_session->GetInfo(), spi_lease_payload);
 		}
-		IkePayload tsi = IkePayload::GetEmptyPayloadFromPayloadType(tsi_payload_type);
-		packet->RemoveHeader(tsi);
 
-		//picking up TSr payload
-		IkePayloadHeader::PAYLOAD_TYPE tsr_payload_type = tsi.GetNextPayloadType();
-		if (tsr_payload_type != IkePayloadHeader::TRAFFIC_SELECTOR_RESPONDER)
+		//a late response to an earlier ike_auth answers none of the sessions in flight
+		if (true == init_session->IsAuthInFlight())
 		{
-			NS_ASSERT (false);
-		}
-		IkePayload tsr = IkePayload::GetEmptyPayloadFromPayloadType(tsr_payload_type);
-		packet->RemoveHeader(tsr);
+			init_session->FinishAuth();
 
-		Ptr<IkeSaPayloadSubstructure> sar2_sub = DynamicCast<IkeSaPayloadSubstructure>(sar2.GetSubstructure());
-		Ptr<IkeTrafficSelectorSubstructure> tsi_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsi.GetSubstructure());
-		Ptr<IkeTrafficSelectorSubstructure> tsr_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsr.GetSubstructure());
-		Ptr<IkeNonceSubstructure> nonce_sub = DynamicCast<IkeNonceSubstructure>(nonce_payload.GetSubstructure());
+			if (false == init_session->IsAuthInFlight())
+			{
+				init_session->GetRetransmitTimer().Cancel();
 
-		this->ProcessIkeSaAuthResponse(init_session, nonce_sub->GetDataToU64(), sar2_sub->GetProposals(), tsi_sub->GetTrafficSelectors(), tsr_sub->GetTrafficSelectors());
+				if (true == init_session->HaveSessionsAwaitingAuth())
+				{
+					//groups joined while the last ike_auth was in flight
+					this->DoSend_IKE_SA_AUTH(init_session);
+				}
+			}
+		}
 	}
 	else if (init_session->GetCurrentMessageId() > message_id)
 	{
@@ -1810,6 +2959,10 @@ GsamL4Protocol::ProcessIkeSaAuthResponse (	const Ptr<const GsamInitSession> init
 		Ptr<Spi> spi_responder = proposal->GetSpi();
 
 		session->SetKekSaResponderSpi(spi_responder->ToUint64());
+		if (true == GsamConfig::GetSingleton()->IsIkeKeyExchangeX25519())
+		{
+			this->DeriveKekSaKeys(session);
+		}
 
 		if (true == session->IsHostNonQuerier())
 		{
@@ -1838,60 +2991,107 @@ GsamL4Protocol::ProcessIkeSaAuthResponse (	const Ptr<const GsamInitSession> init
 }
 
 void
-GsamL4Protocol::RespondIkeSaAuth (	Ptr<GsamSession> session,
-									const Ptr<IkeSaProposal> chosen_proposal,
-									const std::list<IkeTrafficSelector>& narrowed_tssi,
-									const std::list<IkeTrafficSelector>& narrowed_tssr)
+GsamL4Protocol::RespondIkeSaAuth (	const std::list<Ptr<GsamSession> >& lst_sessions,
+									const std::list<std::list<IkeTrafficSelector> >& lst_narrowed_tssi,
+									const std::list<std::list<IkeTrafficSelector> >& lst_narrowed_tssr)
 {
 	NS_LOG_FUNCTION (this);
 
-	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session);
+	if (	(true == lst_sessions.empty()) ||
+			(lst_sessions.size() != lst_narrowed_tssi.size()) ||
+			(lst_sessions.size() != lst_narrowed_tssr.size()))
+	{
+		NS_ASSERT (false);
+		return;
+	}
+
+	Ptr<GsamSession> first_session = lst_sessions.front();
+
+	Ptr<Packet> packet = Create<Packet>();
+	uint32_t length_beside_ikeheader = 0;
+	IkePayloadHeader::PAYLOAD_TYPE next_payload_type = IkePayloadHeader::NO_NEXT_PAYLOAD;
+
+	//spi leases, if any, trail the last tsr so the peer knows them before the first push
+	IkePayload spi_lease_payload;
+	if (true == this->GenerateSpiLeasePayload(first_session, spi_lease_payload))
+	{
+		packet->AddHeader(spi_lease_payload);
+		length_beside_ikeheader += spi_lease_payload.GetSerializedSize();
+		next_payload_type = spi_lease_payload.GetPayloadType();
+	}
+
+	//payloads are prepended, so the groups are walked backwards
+	std::list<std::list<IkeTrafficSelector> >::const_reverse_iterator const_it_tssi = lst_narrowed_tssi.rbegin();
+	std::list<std::list<IkeTrafficSelector> >::const_reverse_iterator const_it_tssr = lst_narrowed_tssr.rbegin();
+	for (	std::list<Ptr<GsamSession> >::const_reverse_iterator const_it = lst_sessions.rbegin();
+			const_it != lst_sessions.rend();
+			const_it++, const_it_tssi++, const_it_tssr++)
+	{
+		Ptr<GsamSession> session = (*const_it);
+
+		GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session);
+
+		//Setting up TSr
+		IkePayload tsr = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::TRAFFIC_SELECTOR_RESPONDER);
+		Ptr<IkeTrafficSelectorSubstructure> tsr_payload_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsr.GetSubstructure());
+		tsr_payload_sub->PushBackTrafficSelectors(*const_it_tssr);
+		tsr.SetNextPayloadType(next_payload_type);
+		//settuping up tsi
+		IkePayload tsi = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::TRAFFIC_SELECTOR_INITIATOR);
+		Ptr<IkeTrafficSelectorSubstructure> tsi_payload_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsi.GetSubstructure());
+		tsi_payload_sub->PushBackTrafficSelectors(*const_it_tssi);
+		tsi.SetNextPayloadType(tsr.GetPayloadType());
+		//setting up initiator's kek spi as nonce
+		IkePayload nonce_payload_init;
+		nonce_payload_init.SetSubstructure(IkeNonceSubstructure::GenerateNonceSubstructure(session->GetKekSaInitiatorSpi()));
+		nonce_payload_init.SetNextPayloadType(tsi.GetPayloadType());
+		//setting up sar2
+		IkePayload sar2;
+		Ptr<Spi> responder_kek_sa_spi = Create<Spi>();
+		responder_kek_sa_spi->SetValueFromUint64(session->GetKekSaResponderSpi());
+		sar2.SetSubstructure(IkeSaPayloadSubstructure::GenerateAuthIkePayload(responder_kek_sa_spi));
+		sar2.SetNextPayloadType(nonce_payload_init.GetPayloadType());
+
+		packet->AddHeader(tsr);
+		packet->AddHeader(tsi);
+		packet->AddHeader(nonce_payload_init);
+		packet->AddHeader(sar2);
+
+		length_beside_ikeheader += 	sar2.GetSerializedSize() +
+									nonce_payload_init.GetSerializedSize() +
+									tsi.GetSerializedSize() +
+									tsr.GetSerializedSize();
+
+		next_payload_type = sar2.GetPayloadType();
+	}
 
-	//Setting up TSr
-	IkePayload tsr = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::TRAFFIC_SELECTOR_RESPONDER);
-	Ptr<IkeTrafficSelectorSubstructure> tsr_payload_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsr.GetSubstructure());
-	tsr_payload_sub->PushBackTrafficSelectors(narrowed_tssr);
-	//settuping up tsi
-	IkePayload tsi = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::TRAFFIC_SELECTOR_INITIATOR);
-	Ptr<IkeTrafficSelectorSubstructure> tsi_payload_sub = DynamicCast<IkeTrafficSelectorSubstructure>(tsi.GetSubstructure());
-	tsi_payload_sub->PushBackTrafficSelectors(narrowed_tssi);
-	tsi.SetNextPayloadType(tsr.GetPayloadType());
-	//setting up initiator's kek spi as nonce
-	IkePayload nonce_payload_init;
-	nonce_payload_init.SetSubstructure(IkeNonceSubstructure::GenerateNonceSubstructure(session->GetKekSaInitiatorSpi()));
-	nonce_payload_init.SetNextPayloadType(tsi.GetPayloadType());
-	//setting up sar2
-	IkePayload sar2;
-	Ptr<Spi> responder_kek_sa_spi = Create<Spi>();
-	responder_kek_sa_spi->SetValueFromUint64(session->GetKekSaResponderSpi());
-	sar2.SetSubstructure(IkeSaPayloadSubstructure::GenerateAuthIkePayload(responder_kek_sa_spi));
-	sar2.SetNextPayloadType(nonce_payload_init.GetPayloadType());
 	//setting up auth
 	IkePayload auth;
 	auth.SetSubstructure(IkeAuthSubstructure::GenerateEmptyAuthSubstructure());
-	auth.SetNextPayloadType(sar2.GetPayloadType());
-
-	uint32_t length_beside_ikeheader = 	auth.GetSerializedSize() +
-										sar2.GetSerializedSize() +
-										nonce_payload_init.GetSerializedSize() +
-										tsi.GetSerializedSize() +
-										tsr.GetSerializedSize();
-
-	Ptr<Packet> packet = Create<Packet>();
-	packet->AddHeader(tsr);
-	packet->AddHeader(tsi);
-	packet->AddHeader(nonce_payload_init);
-	packet->AddHeader(sar2);
+	auth.SetNextPayloadType(next_payload_type);
 	packet->AddHeader(auth);
+	length_beside_ikeheader += auth.GetSerializedSize();
 
-	this->SendPhaseOneMessage(	session,
+	this->SendPhaseOneMessage(	first_session,
 						IkeHeader::IKE_AUTH,
 						true,
 						auth.GetPayloadType(),
 						length_beside_ikeheader,
 						packet,
 						false);
-	this->Send_GSA_PUSH(session);
+
+	//a duplicate invitation is answered from any of its sessions
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = lst_sessions.begin();
+			const_it != lst_sessions.end();
+			const_it++)
+	{
+		Ptr<GsamSession> session = (*const_it);
+		if (session != first_session)
+		{
+			session->SetCachePacket(first_session->GetCachePacket());
+			session->SetNumberOfSpiLeasesSent(first_session->GetNumberOfSpiLeasesSent());
+		}
+	}
 }
 
 void
@@ -1903,7 +3103,8 @@ GsamL4Protocol::HandleGsaInformational (Ptr<Packet> packet, const IkeHeader& ike
 
 	if (session == 0)
 	{
-		NS_ASSERT (false);
+		//late retransmission on a kek sa deleted already
+		NS_LOG_INFO ("Node: " << this->m_node->GetId() << " no session for an informational from " << peer_address << ", dropped");
 	}
 	else
 	{
@@ -1913,7 +3114,15 @@ GsamL4Protocol::HandleGsaInformational (Ptr<Packet> packet, const IkeHeader& ike
 		if (	(true == is_invitation) &&
 				(false == is_response))
 		{
-			if ((true == session->IsHostGroupMember()) ||
+			if (true == session->IsHostQuerier())
+			{
+				this->HandleKekSaDelete(packet, ikeheader, session);
+			}
+			else if (true == session->IsLeaving())
+			{
+				//the gm is leaving the group, it takes no more gsas for it
+			}
+			else if ((true == session->IsHostGroupMember()) ||
 					(true == session->IsHostNonQuerier()))
 			{
 				this->HandleGsaPushSpiRequest(packet, ikeheader, session);
@@ -1930,6 +3139,10 @@ GsamL4Protocol::HandleGsaInformational (Ptr<Packet> packet, const IkeHeader& ike
 			{
 				this->HandleGsaAckRejectSpiResponse(packet, ikeheader, session);
 			}
+			else if ((true == session->IsHostGroupMember()) && (true == session->IsLeaving()))
+			{
+				this->HandleKekSaDeleteResponse(packet, ikeheader, session);
+			}
 			else
 			{
 				NS_ASSERT (false);
@@ -1954,13 +3167,17 @@ GsamL4Protocol::HandleGsaPushSpiRequest (Ptr<Packet> packet, const IkeHeader& ik
 
 	if (session->GetCurrentMessageId() < message_id)
 	{
+		//spi leases of the q come first, the rest is a push or a spi request
+		IkeHeader header_without_leases = ikeheader;
+		this->PeelSpiLeases(packet, header_without_leases, session);
+
 		if (true == session->IsHostNonQuerier())
 		{
-			this->HandleGsaPushSpiRequestNQ(packet, ikeheader, session);
+			this->HandleGsaPushSpiRequestNQ(packet, header_without_leases, session);
 		}
 		else if (true == session->IsHostGroupMember())
 		{
-			this->HandleGsaPushSpiRequestGM(packet, ikeheader, session);
+			this->HandleGsaPushSpiRequestGM(packet, header_without_leases, session);
 		}
 		else if (true == session->IsHostQuerier())
 		{
@@ -2109,7 +3326,8 @@ GsamL4Protocol::HandleCreateChildSa (Ptr<Packet> packet, const IkeHeader& ikehea
 
 	if (session == 0)
 	{
-		NS_ASSERT (false);
+		//late retransmission on a kek sa deleted already
+		NS_LOG_INFO ("Node: " << this->m_node->GetId() << " no session for a create_child_sa from " << peer_address << ", dropped");
 	}
 	else
 	{
@@ -2119,7 +3337,11 @@ GsamL4Protocol::HandleCreateChildSa (Ptr<Packet> packet, const IkeHeader& ikehea
 		if (	(true == is_invitation) &&
 				(false == is_response))
 		{
-			if ((true == session->IsHostGroupMember()) ||
+			if (true == session->IsLeaving())
+			{
+				//the gm is leaving the group, it takes no more gsas for it
+			}
+			else if ((true == session->IsHostGroupMember()) ||
 					(true == session->IsHostNonQuerier()))
 			{
 				this->HandleGsaRepush(packet, ikeheader, session);
@@ -2129,10 +3351,21 @@ GsamL4Protocol::HandleCreateChildSa (Ptr<Packet> packet, const IkeHeader& ikehea
 				NS_ASSERT (false);
 			}
 		}
+		else if ((false == is_invitation) &&
+				(true == is_response))
+		{
+			if (true == session->IsHostQuerier())
+			{
+				this->HandleGsaRepushAck(packet, ikeheader, session);
+			}
+			else
+			{
+				NS_ASSERT (false);
+			}
+		}
 		else
 		{
 			//error
-			//only GM or NQ would get to this, not Q
 			NS_ASSERT (false);
 		}
 	}
@@ -2146,25 +3379,39 @@ GsamL4Protocol::HandleGsaRepush (Ptr<Packet> packet, const IkeHeader& ikeheader,
 	if (session->GetCurrentMessageId() == (ikeheader.GetMessageId() - 1))
 	{
 		session->SetMessageId(ikeheader.GetMessageId());
+
+		//a rekey re-push may come with spi leases of the q
+		IkeHeader header_without_leases = ikeheader;
+		this->PeelSpiLeases(packet, header_without_leases, session);
+
 		if (true == session->IsHostGroupMember())
 		{
-			this->HandleGsaRepushGM(packet, ikeheader, session);
+			this->HandleGsaRepushGM(packet, header_without_leases, session);
 		}
 		else if (true == session->IsHostNonQuerier())
 		{
-			this->HandleGsaRepushNQ(packet, ikeheader, session);
+			this->HandleGsaRepushNQ(packet, header_without_leases, session);
 		}
 		else
 		{
 			NS_ASSERT (false);
 		}
+
+		//an empty answer, the q holds its next request to us until it gets it
+		this->SendPhaseTwoMessage(	session,
+									IkeHeader::CREATE_CHILD_SA,
+									true,
+									IkePayloadHeader::NO_NEXT_PAYLOAD,
+									0,
+									Create<Packet>(),
+									false);
 	}
 	else
 	{
 		if (session->GetCurrentMessageId() == ikeheader.GetMessageId())
 		{
-			//maybe retransmission
-			//ignore
+			//retransmission, our answer got lost
+			this->DoSendMessage(session, false);
 		}
 		else
 		{
@@ -2182,6 +3429,9 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 
 	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session);
 
+	//sessions whose group got re-pushed after a rejection and has to report again
+	std::set<Ptr<GsamSession> > set_sessions_to_report;
+
 	IkePayloadHeader::PAYLOAD_TYPE next_payload_type = ikeheader.GetNextPayloadType();
 
 	while (next_payload_type != IkePayloadHeader::NO_NEXT_PAYLOAD)
@@ -2193,14 +3443,30 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 
 		IkePayload gsa_repush_payload = IkePayload::GetEmptyPayloadFromPayloadType(next_payload_type);
 		packet->RemoveHeader(gsa_repush_payload);
+		next_payload_type = gsa_repush_payload.GetNextPayloadType();
 		Ptr<IkeGsaPayloadSubstructure> gsa_repush_sub = DynamicCast<IkeGsaPayloadSubstructure>(gsa_repush_payload.GetSubstructure());
 
 		const IkeTrafficSelector& ts_src = gsa_repush_sub->GetSourceTrafficSelector();
 		const IkeTrafficSelector& ts_dest = gsa_repush_sub->GetDestTrafficSelector();
 
-		if (session->GetGroupAddress() != GsamUtility::CheckAndGetGroupAddressFromTrafficSelectors(ts_src, ts_dest))
+		//a rekey re-push carries every group the gm has joined with the q
+		Ipv4Address group_address = GsamUtility::CheckAndGetGroupAddressFromTrafficSelectors(ts_src, ts_dest);
+		Ptr<GsamSession> group_session = session;
+		if (session->GetGroupAddress() != group_address)
 		{
-			NS_ASSERT (false);
+			group_session = this->GetIpSecDatabase()->GetGroupSession(group_address, session->GetPeerAddress());
+		}
+
+		if (0 == group_session)
+		{
+			//left the group meanwhile
+			continue;
+		}
+
+		bool is_rekey = (0 == gsa_repush_sub->GetGsaPushId());
+		if (false == is_rekey)
+		{
+			set_sessions_to_report.insert(group_session);
 		}
 
 		if (0 != (gsa_repush_sub->GetProposals().size() % 2))
@@ -2217,7 +3483,7 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 
 			if (gsa_proposal_to_modify->GetGsaType() == IkeGsaProposal::GSA_Q_TO_BE_MODIFIED)
 			{
-				Ptr<GsamSessionGroup> session_group = session->GetSessionGroup();
+				Ptr<GsamSessionGroup> session_group = group_session->GetSessionGroup();
 				if (0 == session_group)
 				{
 					NS_ASSERT (false);
@@ -2231,14 +3497,14 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 				if (gsa_proposal_replacement->GetGsaType() == IkeGsaProposal::GSA_Q_REPLACEMENT)
 				{
 					GsamConfig::LogGsaQ("IkeGsaProposal::GSA_Q_REPLACEMENT", gsa_proposal_replacement->GetSpi()->ToUint32());
-					Ptr<IpSecSAEntry> session_gsa_q = session->GetRelatedGsaQ();
+					Ptr<IpSecSAEntry> session_gsa_q = group_session->GetRelatedGsaQ();
 					if (0 == session_gsa_q)
 					{
 						//The reason why (0 == session_gsa_q) is that it was rejected?
 						//install a new gsa q with the incoming spi replacement
-						Ptr<IpSecSADatabase> inbound_sad = session->GetRelatedPolicy()->GetInboundSAD();
+						Ptr<IpSecSADatabase> inbound_sad = group_session->GetRelatedPolicy()->GetInboundSAD();
 						Ptr<IpSecSAEntry> new_gsa_q = inbound_sad->CreateIpSecSAEntry(gsa_proposal_replacement->GetSpi()->ToUint32());
-						session->AssociateGsaQ(new_gsa_q);
+						group_session->AssociateGsaQ(new_gsa_q);
 					}
 					else
 					{
@@ -2247,7 +3513,15 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 						{
 							NS_ASSERT (false);
 						}
-						session_gsa_q->SetSpi(gsa_proposal_replacement->GetSpi()->ToUint32());
+						if (true == is_rekey)
+						{
+							//the q keeps sending with the old gsa_q until every member acked
+							this->RekeyInboundGsa(group_session->GetRelatedPolicy()->GetInboundSAD(), session_gsa_q, gsa_proposal_replacement->GetSpi()->ToUint32());
+						}
+						else
+						{
+							session_gsa_q->SetSpi(gsa_proposal_replacement->GetSpi()->ToUint32());
+						}
 					}
 				}
 				else
@@ -2257,7 +3531,7 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 			}
 			else if (gsa_proposal_to_modify->GetGsaType() == IkeGsaProposal::GSA_R_TO_BE_MODIFIED)
 			{
-				Ptr<GsamSessionGroup> session_group = session->GetSessionGroup();
+				Ptr<GsamSessionGroup> session_group = group_session->GetSessionGroup();
 				if (0 == session_group)
 				{
 					NS_ASSERT (false);
@@ -2271,14 +3545,14 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 				if (gsa_proposal_replacement->GetGsaType() == IkeGsaProposal::GSA_R_REPLACEMENT)
 				{
 					GsamConfig::LogGsaR("IkeGsaProposal::GSA_R_REPLACEMENT", gsa_proposal_replacement->GetSpi()->ToUint32());
-					Ptr<IpSecSAEntry> session_gsa_r = session->GetRelatedGsaR();
+					Ptr<IpSecSAEntry> session_gsa_r = group_session->GetRelatedGsaR();
 					if (0 == session_gsa_r)
 					{
 						//The reason why (0 == session_gsa_r) is that it was rejected?
 						//install a new gsa q with the incoming spi replacement
-						Ptr<IpSecSADatabase> outbound_sad = session->GetRelatedPolicy()->GetOutboundSAD();
+						Ptr<IpSecSADatabase> outbound_sad = group_session->GetRelatedPolicy()->GetOutboundSAD();
 						Ptr<IpSecSAEntry> new_gsa_r = outbound_sad->CreateIpSecSAEntry(gsa_proposal_replacement->GetSpi()->ToUint32());
-						session->SetRelatedGsaR(new_gsa_r);
+						group_session->SetRelatedGsaR(new_gsa_r);
 					}
 					else
 					{
@@ -2287,6 +3561,7 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 						{
 							NS_ASSERT (false);
 						}
+						//the q accepts both for a while, see GsamL4Protocol::Send_GSA_REKEY
 						session_gsa_r->SetSpi(gsa_proposal_replacement->GetSpi()->ToUint32());
 					}
 				}
@@ -2300,16 +3575,21 @@ GsamL4Protocol::HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheade
 				NS_ASSERT (false);
 			}
 		}
-		next_payload_type = gsa_repush_payload.GetNextPayloadType();
 	}
 
 	Ptr<Igmpv3L4Protocol> igmp = Igmpv3L4Protocol::GetIgmp(this->m_node);
 	Time dt = GsamConfig::GetSingleton()->GetSigmpReportDelayAfterGsamInMilliSeconds();
-	Simulator::Schedule (dt,
-							&Igmpv3L4Protocol::SendSecureStateChangesReport,
-							igmp,
-							igmp->GetManager()->GetIfStateManager(session->GetIgmpInterface()),
-							session->GetGroupAddress());
+	for (	std::set<Ptr<GsamSession> >::const_iterator const_it = set_sessions_to_report.begin();
+			const_it != set_sessions_to_report.end();
+			const_it++)
+	{
+		Ptr<GsamSession> group_session = (*const_it);
+		Simulator::Schedule (dt,
+								&Igmpv3L4Protocol::SendSecureStateChangesReport,
+								igmp,
+								igmp->GetManager()->GetIfStateManager(group_session->GetIgmpInterface()),
+								group_session->GetGroupAddress());
+	}
 }
 
 void
@@ -2336,6 +3616,7 @@ GsamL4Protocol::HandleGsaRepushNQ (Ptr<Packet> packet, const IkeHeader& ikeheade
 		const IkeTrafficSelector& ts_dest = gsa_repush_sub->GetDestTrafficSelector();
 
 		Ipv4Address group_address = GsamUtility::CheckAndGetGroupAddressFromTrafficSelectors(ts_src, ts_dest);
+		bool is_rekey = (0 == gsa_repush_sub->GetGsaPushId());
 
 		Ptr<IpSecPolicyDatabase> spd = session->GetDatabase()->GetPolicyDatabase();
 		Ptr<IpSecPolicyEntry> policy = spd->GetExactMatchedPolicy(ts_src, ts_dest);
@@ -2397,183 +3678,748 @@ GsamL4Protocol::HandleGsaRepushNQ (Ptr<Packet> packet, const IkeHeader& ikeheade
 
 
 
-		}
-		else
-		{
-			GsamConfig::LogMsg("Policy Exists");
-			Ptr<GsamSessionGroup> session_group = this->m_ptr_database->GetSessionGroup(group_address);
-			if (0 == session_group)
-			{
-				NS_ASSERT (false);
-			}
-			//find gsa r or gsa q to modify
-			for (	std::list<Ptr<IkeSaProposal> >::const_iterator const_it_proposals = gsa_repush_sub->GetProposals().begin();
-					const_it_proposals != gsa_repush_sub->GetProposals().end();
-					const_it_proposals++)
-			{
-				Ptr<IkeGsaProposal> gsa_proposal_to_modify = DynamicCast<IkeGsaProposal>(*const_it_proposals);
+		}
+		else
+		{
+			GsamConfig::LogMsg("Policy Exists");
+			Ptr<GsamSessionGroup> session_group = this->m_ptr_database->GetSessionGroup(group_address);
+			if (0 == session_group)
+			{
+				NS_ASSERT (false);
+			}
+			//find gsa r or gsa q to modify
+			for (	std::list<Ptr<IkeSaProposal> >::const_iterator const_it_proposals = gsa_repush_sub->GetProposals().begin();
+					const_it_proposals != gsa_repush_sub->GetProposals().end();
+					const_it_proposals++)
+			{
+				Ptr<IkeGsaProposal> gsa_proposal_to_modify = DynamicCast<IkeGsaProposal>(*const_it_proposals);
+
+				if (gsa_proposal_to_modify->GetGsaType() == IkeGsaProposal::GSA_Q_TO_BE_MODIFIED)
+				{
+					GsamConfig::LogGsaQ("IkeGsaProposal::GSA_Q_TO_BE_MODIFIED", gsa_proposal_to_modify->GetSpi()->ToUint32());
+					const_it_proposals++;
+
+					Ptr<IkeGsaProposal> gsa_proposal_replacement = DynamicCast<IkeGsaProposal>(*const_it_proposals);
+
+					if (gsa_proposal_replacement->GetGsaType() == IkeGsaProposal::GSA_Q_REPLACEMENT)
+					{
+						GsamConfig::LogGsaQ("IkeGsaProposal::GSA_Q_REPLACEMENT", gsa_proposal_replacement->GetSpi()->ToUint32());
+						Ptr<IpSecSADatabase> outbound_sad = policy->GetOutboundSAD();
+						Ptr<IpSecSAEntry> gsa_q_in_sad = outbound_sad->GetIpsecSAEntry(gsa_proposal_to_modify->GetSpi()->ToUint32());
+						if (0 == gsa_q_in_sad)
+						{
+							//The reason why (0 == gsa_q_in_sad) is that it was rejected?
+							//install a new gsa q with the incoming spi replacement
+							Ptr<IpSecSAEntry> new_gsa_q = outbound_sad->CreateIpSecSAEntry(gsa_proposal_replacement->GetSpi()->ToUint32());
+						}
+						else
+						{
+							//change spi
+							if (gsa_q_in_sad->GetSpi() != gsa_proposal_to_modify->GetSpi()->ToUint32())
+							{
+								NS_ASSERT (false);
+							}
+							gsa_q_in_sad->SetSpi(gsa_proposal_replacement->GetSpi()->ToUint32());
+						}
+					}
+					else
+					{
+						NS_ASSERT (false);
+					}
+				}
+				else if (gsa_proposal_to_modify->GetGsaType() == IkeGsaProposal::GSA_R_TO_BE_MODIFIED)
+				{
+					GsamConfig::LogGsaR("IkeGsaProposal::GSA_R_TO_BE_MODIFIED", gsa_proposal_to_modify->GetSpi()->ToUint32());
+					const_it_proposals++;
+
+					Ptr<IkeGsaProposal> gsa_proposal_replacement = DynamicCast<IkeGsaProposal>(*const_it_proposals);
+
+					if (gsa_proposal_replacement->GetGsaType() == IkeGsaProposal::GSA_R_REPLACEMENT)
+					{
+						GsamConfig::LogGsaR("IkeGsaProposal::GSA_R_REPLACEMENT", gsa_proposal_replacement->GetSpi()->ToUint32());
+						Ptr<IpSecSADatabase> inbound_sad = policy->GetInboundSAD();
+						Ptr<IpSecSAEntry> gsa_r_in_sad = inbound_sad->GetIpsecSAEntry(gsa_proposal_to_modify->GetSpi()->ToUint32());
+						if (0 == gsa_r_in_sad)
+						{
+							//The reason why (0 == gsa_r_in_sad) is that it was rejected?
+							//install a new gsa q with the incoming spi replacement
+							Ptr<IpSecSAEntry> new_gsa_r = inbound_sad->CreateIpSecSAEntry(gsa_proposal_replacement->GetSpi()->ToUint32());
+						}
+						else
+						{
+							//change spi
+							if (gsa_r_in_sad->GetSpi() != gsa_proposal_to_modify->GetSpi()->ToUint32())
+							{
+								NS_ASSERT (false);
+							}
+							if (true == is_rekey)
+							{
+								//the gm may not have got its re-push yet
+								this->RekeyInboundGsa(inbound_sad, gsa_r_in_sad, gsa_proposal_replacement->GetSpi()->ToUint32());
+							}
+							else
+							{
+								gsa_r_in_sad->SetSpi(gsa_proposal_replacement->GetSpi()->ToUint32());
+							}
+						}
+					}
+					else
+					{
+						NS_ASSERT (false);
+					}
+				}
+				else
+				{
+					NS_ASSERT (false);
+				}
+			}
+		}
+
+
+		next_payload_type = gsa_repush_payload.GetNextPayloadType();
+	}
+}
+
+void
+GsamL4Protocol::RekeyInboundGsa (Ptr<IpSecSADatabase> inbound_sad, Ptr<IpSecSAEntry> gsa, uint32_t new_spi)
+{
+	NS_LOG_FUNCTION (this);
+
+	uint32_t old_spi = gsa->GetSpi();
+	Ptr<GsamInfo> info = this->GetIpSecDatabase()->GetInfo();
+
+	//an inbound entry frees its spi when it goes, so each of the two must hold its own
+	if (false == info->IsIpsecSpiOccupied(old_spi))
+	{
+		info->OccupyIpsecSpi(old_spi);
+	}
+	if (false == info->IsIpsecSpiOccupied(new_spi))
+	{
+		info->OccupyIpsecSpi(new_spi);
+	}
+
+	gsa->SetSpi(new_spi);
+
+	//keep accepting the old spi until the sender switched too
+	Ptr<IpSecSAEntry> old_gsa = inbound_sad->CreateIpSecSAEntry(old_spi);
+	Simulator::Schedule (GsamConfig::GetSingleton()->GetSpiRekeyGraceTimeInSeconds(),
+						&IpSecSADatabase::RemoveEntry,
+						inbound_sad,
+						old_gsa);
+}
+
+void
+GsamL4Protocol::RejectGsaR (Ptr<GsamSession> session,
+							uint32_t gsa_push_id,
+							const IkeTrafficSelector& ts_src,
+							const IkeTrafficSelector& ts_dest,
+							const std::list<uint32_t>& gsa_r_spis_to_reject,
+							std::list<Ptr<IkePayloadSubstructure> >& retval_payload_subs)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<IkeGroupNotifySubstructure> gsa_r_spis_to_reject_substructure = IkeGroupNotifySubstructure::GenerateEmptyGroupNotifySubstructure(IpSec::SA_PROPOSAL_AH,
+																																				IpSec::AH_ESP_SPI_SIZE,
+																																				IkeGroupNotifySubstructure::GSA_R_SPI_REJECTION,
+																																				gsa_push_id,
+																																				ts_src,
+																																				ts_dest);
+	gsa_r_spis_to_reject_substructure->InsertSpis(gsa_r_spis_to_reject);
+
+	retval_payload_subs.push_back(gsa_r_spis_to_reject_substructure);
+
+}
+
+void
+GsamL4Protocol::ProcessNQRejectResult (Ptr<GsamSession> session, std::list<Ptr<IkePayloadSubstructure> >& retval_payload_subs)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<Packet> packet = Create<Packet>();
+	uint32_t length_beside_ikeheader = 0;
+
+	IkePayloadHeader::PAYLOAD_TYPE next_payload_type = IkePayloadHeader::NO_NEXT_PAYLOAD;
+	for (std::list<Ptr<IkePayloadSubstructure> >::iterator it = retval_payload_subs.begin();
+			it != retval_payload_subs.end();
+			it++)
+	{
+		IkePayload reject_gsa_r_payload;
+		reject_gsa_r_payload.SetSubstructure(*it);
+		reject_gsa_r_payload.SetNextPayloadType(next_payload_type);
+
+		packet->AddHeader(reject_gsa_r_payload);
+
+		next_payload_type = reject_gsa_r_payload.GetPayloadType();
+		length_beside_ikeheader += reject_gsa_r_payload.GetSerializedSize();
+	}
+
+	this->SendPhaseTwoMessage(session,
+						IkeHeader::INFORMATIONAL,
+						true,
+						next_payload_type,
+						length_beside_ikeheader,
+						packet,
+						false);
+}
+
+void
+GsamL4Protocol::SendAcceptAck (Ptr<GsamSession> session,  uint32_t gsa_push_id)
+{
+	NS_LOG_FUNCTION (this);
+
+	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session, gsa_push_id);
+
+	IkeTrafficSelector empty_ts = IkeTrafficSelector::GetIpv4DummyTs();
+
+	Ptr<IkeGroupNotifySubstructure> ack_notify_substructure = IkeGroupNotifySubstructure::GenerateEmptyGroupNotifySubstructure(	GsamConfig::GetDefaultGSAProposalId(),
+																																	IpSec::AH_ESP_SPI_SIZE,
+																																	IkeGroupNotifySubstructure::GSA_ACKNOWLEDGEDMENT,
+																																	gsa_push_id,
+																																	empty_ts,
+																																	empty_ts);
+
+	IkePayload ack_notify_payload;
+	ack_notify_payload.SetSubstructure(ack_notify_substructure);
+
+	Ptr<Packet> packet = Create<Packet>();
+	packet->AddHeader(ack_notify_payload);
+
+	this->SendPhaseTwoMessage(session,
+				IkeHeader::INFORMATIONAL,
+				true,
+				ack_notify_payload.GetPayloadType(),
+				ack_notify_payload.GetSerializedSize(),
+				packet,
+				false);
+}
+
+bool
+GsamL4Protocol::GenerateSpiLeasePayload (Ptr<GsamSession> session, IkePayload& retval)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (0 == GsamConfig::GetSingleton()->GetSpiLeaseSize())
+	{
+		return false;
+	}
+
+	if (false == session->IsHostQuerier())
+	{
+		NS_ASSERT (false);
+	}
+
+	Ptr<GsamInfo> info = session->GetInfo();
+	if (true == info->GetIpsecSpiLeases().empty())
+	{
+		info->LeaseIpsecSpiRange();
+	}
+
+	const std::list<std::pair<uint32_t, uint32_t> >& lst_leases = info->GetIpsecSpiLeases();
+	uint32_t num_leases_sent = session->GetNumberOfSpiLeasesSent();
+	if (num_leases_sent >= lst_leases.size())
+	{
+		return false;
+	}
+
+	IkeTrafficSelector dummy_ts = IkeTrafficSelector::GetIpv4DummyTs();
+	Ptr<IkeGroupNotifySubstructure> spi_lease_sub = IkeGroupNotifySubstructure::GenerateEmptyGroupNotifySubstructure(GsamConfig::GetDefaultGSAProposalId(),
+			IpSec::AH_ESP_SPI_SIZE,
+			IkeGroupNotifySubstructure::SPI_LEASE,
+			0,
+			dummy_ts,
+			dummy_ts);
+
+	uint32_t index = 0;
+	for (	std::list<std::pair<uint32_t, uint32_t> >::const_iterator const_it = lst_leases.begin();
+			const_it != lst_leases.end();
+			const_it++)
+	{
+		//at most 255 spis fit in a notify, the rest goes with the next message
+		if ((index >= num_leases_sent) && (spi_lease_sub->GetSpiNum() < 254))
+		{
+			spi_lease_sub->InsertSpi(const_it->first);
+			spi_lease_sub->InsertSpi(const_it->second);
+			session->SetNumberOfSpiLeasesSent(index + 1);
+		}
+		index++;
+	}
+
+	retval.SetSubstructure(spi_lease_sub);
+	return true;
+}
+
+void
+GsamL4Protocol::PrependSpiLeases (	Ptr<GsamSession> session,
+									Ptr<Packet> packet,
+									IkePayloadHeader::PAYLOAD_TYPE& first_payload_type,
+									uint32_t& length_beside_ikeheader)
+{
+	NS_LOG_FUNCTION (this);
+
+	IkePayload spi_lease_payload;
+	if (true == this->GenerateSpiLeasePayload(session, spi_lease_payload))
+	{
+		spi_lease_payload.SetNextPayloadType(first_payload_type);
+		packet->AddHeader(spi_lease_payload);
+		length_beside_ikeheader += spi_lease_payload.GetSerializedSize();
+		first_payload_type = spi_lease_payload.GetPayloadType();
+	}
+}
+
+void
+GsamL4Protocol::PeelSpiLeases (Ptr<Packet> packet, IkeHeader& ikeheader, Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	while (ikeheader.GetNextPayloadType() == IkePayloadHeader::GROUP_NOTIFY)
+	{
+		IkePayload notify_payload = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::GROUP_NOTIFY);
+		packet->RemoveHeader(notify_payload);
+		Ptr<IkeGroupNotifySubstructure> notify_sub = DynamicCast<IkeGroupNotifySubstructure>(notify_payload.GetSubstructure());
+
+		if (notify_sub->GetNotifyMessageType() != IkeGroupNotifySubstructure::SPI_LEASE)
+		{
+			//not ours, e.g. a spi request, put it back
+			packet->AddHeader(notify_payload);
+			break;
+		}
+
+		this->ReserveSpiLeases(session->GetInfo(), notify_payload);
+		ikeheader.SetNextPayloadType(notify_payload.GetNextPayloadType());
+	}
+}
+
+void
+GsamL4Protocol::ReserveSpiLeases (Ptr<GsamInfo> info, const IkePayload& spi_lease_payload)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<IkeGroupNotifySubstructure> spi_lease_sub = DynamicCast<IkeGroupNotifySubstructure>(spi_lease_payload.GetSubstructure());
+
+	if (spi_lease_sub->GetNotifyMessageType() != IkeGroupNotifySubstructure::SPI_LEASE)
+	{
+		NS_ASSERT (false);
+	}
+
+	const std::set<uint32_t>& set_spis = spi_lease_sub->GetSpis();
+
+	if ((set_spis.size() % 2) != 0)
+	{
+		NS_ASSERT (false);
+	}
+
+	//leases never overlap, so the sorted spis are first and last spi in turn
+	for (	std::set<uint32_t>::const_iterator const_it = set_spis.begin();
+			const_it != set_spis.end();
+			const_it++)
+	{
+		uint32_t first_spi = (*const_it);
+		const_it++;
+		info->ReserveIpsecSpiRange(first_spi, (*const_it));
+	}
+}
+
+void
+GsamL4Protocol::HandleKekSaDelete (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session);
+
+	if (IkePayloadHeader::DELETE != ikeheader.GetNextPayloadType())
+	{
+		NS_ASSERT (false);
+	}
+
+	IkePayload delete_payload = IkePayload::GetEmptyPayloadFromPayloadType(IkePayloadHeader::DELETE);
+	packet->RemoveHeader(delete_payload);
+
+	Ptr<IkeDeletePayloadSubstructure> delete_sub = DynamicCast<IkeDeletePayloadSubstructure>(delete_payload.GetSubstructure());
+	if (IpSec::SA_PROPOSAL_IKE != delete_sub->GetProtocolId())
+	{
+		//only the kek sa is deleted by a gm
+		NS_ASSERT (false);
+	}
+
+	//the answer is empty, rfc 7296 1.4.1
+	//it is not cached, the session it goes on is about to go
+	IkeHeader response_ikeheader;
+	response_ikeheader.SetInitiatorSpi(session->GetKekSaInitiatorSpi());
+	response_ikeheader.SetResponderSpi(session->GetKekSaResponderSpi());
+	response_ikeheader.SetIkev2Version();
+	response_ikeheader.SetExchangeType(IkeHeader::INFORMATIONAL);
+	response_ikeheader.SetAsResponder();
+	response_ikeheader.SetMessageId(ikeheader.GetMessageId());
+	response_ikeheader.SetNextPayloadType(IkePayloadHeader::NO_NEXT_PAYLOAD);
+	response_ikeheader.SetLength(response_ikeheader.GetSerializedSize());
+
+	Ptr<Packet> response_packet = Create<Packet>();
+	response_packet->AddHeader(response_ikeheader);
+
+	m_socket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom(session->GetPeerAddress()), GsamL4Protocol::PROT_NUMBER));
+
+	GsamConfig::GetSingleton()->LogMsgSent("gsam", this->m_node->GetId(), response_packet, session->GetPeerAddress());
+
+	m_socket->Send(response_packet);
+
+	if (true == session->IsLeaving())
+	{
+		//retransmitted delete, the session is on its way out
+		return;
+	}
+
+	session->SetLeaving(true);
+	//the gm is gone, the pushes waiting on it get no answer any more
+	this->AbortGsaPushes(session);
+	this->RemoveGmSession(session);
+}
+
+void
+GsamL4Protocol::HandleKekSaDeleteResponse (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session);
+
+	if ((ikeheader.GetMessageId() != session->GetCurrentMessageId()) ||
+		(false == session->IsAwaitingResponse()))
+	{
+		//duplicate answer, the leave is done already
+		return;
+	}
+
+	session->GetRetransmitTimer().Cancel();
+	session->SetAwaitingResponse(false);
+
+	this->FinishGroupLeave(session);
+}
+
+void
+GsamL4Protocol::RemoveGmSession (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (0 == session->GetSessionGroup())
+	{
+		//torn down already
+		return;
+	}
+
+	if (true == session->IsBusy())
+	{
+		//what is in flight on the session still refers to it
+		//its last answer or giving up, see GsamL4Protocol::SendPendingPhaseTwoMessage,
+		//and the end of the last push holding it, see GsamSession::ClearGsaPushSession, come back here
+		return;
+	}
+
+	//the group stays, the q keeps sending to it
+	Ptr<GsamSessionGroup> session_group = session->GetSessionGroup();
+
+	this->TearDownSession(session);
+
+	if ((0 != session_group) &&
+		(true == session_group->IsRekeying()) &&
+		(true == session_group->IsRekeyAcked()))
+	{
+		//the session was the last one the rekey waited on
+		this->FinishGroupRekey(session_group, session_group->GetRekeyGsaQSpi());
+	}
+}
+
+void
+GsamL4Protocol::FinishGroupLeave (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	NS_LOG_INFO ("Node: " << this->m_node->GetId() << " left group " << session->GetGroupAddress());
+
+	Ipv4Address group_address = session->GetGroupAddress();
+	Ptr<Ipv4InterfaceMulticast> interface = session->GetIgmpInterface();
+	Ptr<GsamSessionGroup> session_group = session->GetSessionGroup();
+
+	this->TearDownSession(session);
+
+	if ((0 != session_group) && (true == session_group->GetSessions().empty()))
+	{
+		//its policy and gsas go with it
+		this->GetIpSecDatabase()->RemoveSessionGroup(session_group);
+		session_group->Dispose();
+	}
+
+	Ptr<IGMPv3InterfaceStateManager> ifstate_manager = this->GetIgmp()->GetManager()->GetIfStateManager(interface);
+	Ptr<IGMPv3InterfaceState> if_state = ifstate_manager->GetIfState(interface, group_address);
+
+	if (0 == if_state)
+	{
+		//nobody listened again meanwhile
+	}
+	else if ((ns3::INCLUDE == if_state->GetFilterMode()) && (true == if_state->GetSrcList().empty()))
+	{
+		//listened and left again meanwhile, nothing of it is to be reported any more
+		ifstate_manager->RemoveIfState(if_state);
+	}
+	else
+	{
+		//listening again, its records go out once gsam is done, see IGMPv3InterfaceStateManager::ReportStateChanges
+		this->GetGsamFilter()->DoGsam(interface, group_address);
+	}
+}
+
+void
+GsamL4Protocol::GenerateKeyExchangeValues (Ptr<GsamSa> init_sa, bool is_initiator)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (false == GsamConfig::GetSingleton()->IsIkeKeyExchangeX25519())
+	{
+		//dummy values are made when the payloads are
+		return;
+	}
+
+	std::vector<uint8_t> private_key;
+	GsamCrypto::GenerateRandomBytes(GsamCrypto::X25519_KEY_SIZE, private_key);
+	init_sa->SetDhPrivateKey(private_key);
+
+	std::vector<uint8_t> nonce;
+	GsamCrypto::GenerateRandomBytes(GsamCrypto::NONCE_SIZE, nonce);
+	if (true == is_initiator)
+	{
+		init_sa->SetInitiatorNonce(nonce);
+	}
+	else
+	{
+		init_sa->SetResponderNonce(nonce);
+	}
+}
+
+Ptr<IkeKeyExchangeSubStructure>
+GsamL4Protocol::GenerateKeyExchangeSubstructure (Ptr<GsamSa> init_sa) const
+{
+	NS_LOG_FUNCTION (this);
+
+	if (false == GsamConfig::GetSingleton()->IsIkeKeyExchangeX25519())
+	{
+		return IkeKeyExchangeSubStructure::GetDummySubstructure();
+	}
+
+	std::vector<uint8_t> public_key;
+	GsamCrypto::X25519PublicKey(init_sa->GetDhPrivateKey(), public_key);
+	return IkeKeyExchangeSubStructure::GenerateKeyExchangeSubstructure(IkeKeyExchangeSubStructure::CURVE_25519, public_key);
+}
+
+Ptr<IkeNonceSubstructure>
+GsamL4Protocol::GenerateNonceSubstructure (Ptr<GsamSa> init_sa, bool is_initiator) const
+{
+	NS_LOG_FUNCTION (this);
+
+	if (false == GsamConfig::GetSingleton()->IsIkeKeyExchangeX25519())
+	{
+		return IkeNonceSubstructure::GenerateRandomNonceSubstructure();
+	}
 
-				if (gsa_proposal_to_modify->GetGsaType() == IkeGsaProposal::GSA_Q_TO_BE_MODIFIED)
-				{
-					GsamConfig::LogGsaQ("IkeGsaProposal::GSA_Q_TO_BE_MODIFIED", gsa_proposal_to_modify->GetSpi()->ToUint32());
-					const_it_proposals++;
+	if (true == is_initiator)
+	{
+		return IkeNonceSubstructure::GenerateNonceSubstructure(init_sa->GetInitiatorNonce());
+	}
+	else
+	{
+		return IkeNonceSubstructure::GenerateNonceSubstructure(init_sa->GetResponderNonce());
+	}
+}
 
-					Ptr<IkeGsaProposal> gsa_proposal_replacement = DynamicCast<IkeGsaProposal>(*const_it_proposals);
+void
+GsamL4Protocol::TearDownSession (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
 
-					if (gsa_proposal_replacement->GetGsaType() == IkeGsaProposal::GSA_Q_REPLACEMENT)
-					{
-						GsamConfig::LogGsaQ("IkeGsaProposal::GSA_Q_REPLACEMENT", gsa_proposal_replacement->GetSpi()->ToUint32());
-						Ptr<IpSecSADatabase> outbound_sad = policy->GetOutboundSAD();
-						Ptr<IpSecSAEntry> gsa_q_in_sad = outbound_sad->GetIpsecSAEntry(gsa_proposal_to_modify->GetSpi()->ToUint32());
-						if (0 == gsa_q_in_sad)
-						{
-							//The reason why (0 == gsa_q_in_sad) is that it was rejected?
-							//install a new gsa q with the incoming spi replacement
-							Ptr<IpSecSAEntry> new_gsa_q = outbound_sad->CreateIpSecSAEntry(gsa_proposal_replacement->GetSpi()->ToUint32());
-						}
-						else
-						{
-							//change spi
-							if (gsa_q_in_sad->GetSpi() != gsa_proposal_to_modify->GetSpi()->ToUint32())
-							{
-								NS_ASSERT (false);
-							}
-							gsa_q_in_sad->SetSpi(gsa_proposal_replacement->GetSpi()->ToUint32());
-						}
-					}
-					else
-					{
-						NS_ASSERT (false);
-					}
-				}
-				else if (gsa_proposal_to_modify->GetGsaType() == IkeGsaProposal::GSA_R_TO_BE_MODIFIED)
-				{
-					GsamConfig::LogGsaR("IkeGsaProposal::GSA_R_TO_BE_MODIFIED", gsa_proposal_to_modify->GetSpi()->ToUint32());
-					const_it_proposals++;
+	this->GetIpSecDatabase()->RemoveSession(session);
+	session->Dispose();
+}
 
-					Ptr<IkeGsaProposal> gsa_proposal_replacement = DynamicCast<IkeGsaProposal>(*const_it_proposals);
+void
+GsamL4Protocol::DeriveIkeSaKeys (Ptr<GsamInitSession> init_session, const IkePayload& peer_ke, const IkePayload& peer_nonce)
+{
+	NS_LOG_FUNCTION (this);
 
-					if (gsa_proposal_replacement->GetGsaType() == IkeGsaProposal::GSA_R_REPLACEMENT)
-					{
-						GsamConfig::LogGsaR("IkeGsaProposal::GSA_R_REPLACEMENT", gsa_proposal_replacement->GetSpi()->ToUint32());
-						Ptr<IpSecSADatabase> inbound_sad = policy->GetInboundSAD();
-						Ptr<IpSecSAEntry> gsa_r_in_sad = inbound_sad->GetIpsecSAEntry(gsa_proposal_to_modify->GetSpi()->ToUint32());
-						if (0 == gsa_r_in_sad)
-						{
-							//The reason why (0 == gsa_r_in_sad) is that it was rejected?
-							//install a new gsa q with the incoming spi replacement
-							Ptr<IpSecSAEntry> new_gsa_r = inbound_sad->CreateIpSecSAEntry(gsa_proposal_replacement->GetSpi()->ToUint32());
-						}
-						else
-						{
-							//change spi
-							if (gsa_r_in_sad->GetSpi() != gsa_proposal_to_modify->GetSpi()->ToUint32())
-							{
-								NS_ASSERT (false);
-							}
-							gsa_r_in_sad->SetSpi(gsa_proposal_replacement->GetSpi()->ToUint32());
-						}
-					}
-					else
-					{
-						NS_ASSERT (false);
-					}
-				}
-				else
-				{
-					NS_ASSERT (false);
-				}
-			}
-		}
+	Ptr<GsamSa> init_sa = init_session->GetInitSa();
 
+	Ptr<IkeKeyExchangeSubStructure> ke_sub = DynamicCast<IkeKeyExchangeSubStructure>(peer_ke.GetSubstructure());
+	if (ke_sub->GetDhGroupNum() != IkeKeyExchangeSubStructure::CURVE_25519)
+	{
+		//both ends read the same config
+		NS_ASSERT (false);
+	}
+	std::vector<uint8_t> peer_public_key;
+	ke_sub->GetKeyExchangeData(peer_public_key);
 
-		next_payload_type = gsa_repush_payload.GetNextPayloadType();
+	Ptr<IkeNonceSubstructure> nonce_sub = DynamicCast<IkeNonceSubstructure>(peer_nonce.GetSubstructure());
+	std::vector<uint8_t> nonce;
+	nonce_sub->GetNonceData(nonce);
+	if (GsamInitSession::INITIATOR == init_session->GetSessionRole())
+	{
+		init_sa->SetResponderNonce(nonce);
 	}
+	else
+	{
+		init_sa->SetInitiatorNonce(nonce);
+	}
+
+	//g^ir
+	std::vector<uint8_t> shared_secret;
+	GsamCrypto::X25519(init_sa->GetDhPrivateKey(), peer_public_key, shared_secret);
+
+	//rfc 7296 2.14, skeyseed = prf(ni | nr, g^ir)
+	std::vector<uint8_t> nonces = init_sa->GetInitiatorNonce();
+	nonces.insert(nonces.end(), init_sa->GetResponderNonce().begin(), init_sa->GetResponderNonce().end());
+	std::vector<uint8_t> skeyseed;
+	GsamCrypto::HmacSha256(nonces, shared_secret, skeyseed);
+
+	//prf+ (skeyseed, ni | nr | spii | spir)
+	std::vector<uint8_t> seed = nonces;
+	std::list<uint8_t> lst_spi_bytes;
+	GsamUtility::Uint64ToBytes(lst_spi_bytes, init_session->GetInitSaInitiatorSpi());
+	seed.insert(seed.end(), lst_spi_bytes.begin(), lst_spi_bytes.end());
+	GsamUtility::Uint64ToBytes(lst_spi_bytes, init_session->GetInitSaResponderSpi());
+	seed.insert(seed.end(), lst_spi_bytes.begin(), lst_spi_bytes.end());
+
+	std::vector<uint8_t> key_material;
+	GsamCrypto::PrfPlus(skeyseed, seed, GsamCrypto::IKE_SA_KEY_MATERIAL_SIZE, key_material);
+	init_sa->SetKeyMaterial(key_material);
 }
 
 void
-GsamL4Protocol::RejectGsaR (Ptr<GsamSession> session,
-							uint32_t gsa_push_id,
-							const IkeTrafficSelector& ts_src,
-							const IkeTrafficSelector& ts_dest,
-							const std::list<uint32_t>& gsa_r_spis_to_reject,
-							std::list<Ptr<IkePayloadSubstructure> >& retval_payload_subs)
+GsamL4Protocol::DeriveKekSaKeys (Ptr<GsamSession> session)
 {
 	NS_LOG_FUNCTION (this);
 
-	Ptr<IkeGroupNotifySubstructure> gsa_r_spis_to_reject_substructure = IkeGroupNotifySubstructure::GenerateEmptyGroupNotifySubstructure(IpSec::SA_PROPOSAL_AH,
-																																				IpSec::AH_ESP_SPI_SIZE,
-																																				IkeGroupNotifySubstructure::GSA_R_SPI_REJECTION,
-																																				gsa_push_id,
-																																				ts_src,
-																																				ts_dest);
-	gsa_r_spis_to_reject_substructure->InsertSpis(gsa_r_spis_to_reject);
+	Ptr<GsamInitSession> init_session = session->GetInitSession();
+	if ((0 == init_session) ||
+		(false == init_session->HaveInitSa()))
+	{
+		NS_ASSERT (false);
+	}
 
-	retval_payload_subs.push_back(gsa_r_spis_to_reject_substructure);
+	Ptr<GsamSa> init_sa = init_session->GetInitSa();
+	const std::vector<uint8_t>& ike_key_material = init_sa->GetKeyMaterial();
+	if (true == ike_key_material.empty())
+	{
+		//the ike sa was set up before real keys were configured
+		return;
+	}
+
+	//rfc 7296 2.17, keymat = prf+ (sk_d, ni | nr), the kek spis keep each group apart
+	std::vector<uint8_t> sk_d (ike_key_material.begin(), ike_key_material.begin() + GsamCrypto::SHA256_SIZE);
+	std::vector<uint8_t> seed = init_sa->GetInitiatorNonce();
+	seed.insert(seed.end(), init_sa->GetResponderNonce().begin(), init_sa->GetResponderNonce().end());
+	std::list<uint8_t> lst_spi_bytes;
+	GsamUtility::Uint64ToBytes(lst_spi_bytes, session->GetKekSaInitiatorSpi());
+	seed.insert(seed.end(), lst_spi_bytes.begin(), lst_spi_bytes.end());
+	GsamUtility::Uint64ToBytes(lst_spi_bytes, session->GetKekSaResponderSpi());
+	seed.insert(seed.end(), lst_spi_bytes.begin(), lst_spi_bytes.end());
 
+	std::vector<uint8_t> key_material;
+	GsamCrypto::PrfPlus(sk_d, seed, GsamCrypto::KEK_SA_KEY_MATERIAL_SIZE, key_material);
+	session->GetKekSa()->SetKeyMaterial(key_material);
 }
 
 void
-GsamL4Protocol::ProcessNQRejectResult (Ptr<GsamSession> session, std::list<Ptr<IkePayloadSubstructure> >& retval_payload_subs)
+GsamL4Protocol::DeriveGsaKeys (Ptr<IpSecSAEntry> gsa)
 {
 	NS_LOG_FUNCTION (this);
 
-	Ptr<Packet> packet = Create<Packet>();
-	uint32_t length_beside_ikeheader = 0;
-
-	IkePayloadHeader::PAYLOAD_TYPE next_payload_type = IkePayloadHeader::NO_NEXT_PAYLOAD;
-	for (std::list<Ptr<IkePayloadSubstructure> >::iterator it = retval_payload_subs.begin();
-			it != retval_payload_subs.end();
-			it++)
+	if (false == GsamConfig::GetSingleton()->IsIkeKeyExchangeX25519())
 	{
-		IkePayload reject_gsa_r_payload;
-		reject_gsa_r_payload.SetSubstructure(*it);
-		reject_gsa_r_payload.SetNextPayloadType(next_payload_type);
+		//dummy key exchange, gsas go without keys as before
+		return;
+	}
 
-		packet->AddHeader(reject_gsa_r_payload);
+	if (Igmpv3L4Protocol::QUERIER != this->GetIgmp()->GetRole())
+	{
+		NS_ASSERT (false);
+	}
 
-		next_payload_type = reject_gsa_r_payload.GetPayloadType();
-		length_beside_ikeheader += reject_gsa_r_payload.GetSerializedSize();
+	if (true == this->m_vec_gsa_key_secret.empty())
+	{
+		//the role is only known by now, see GsamL4Protocol::Initialization
+		GsamCrypto::GenerateRandomBytes(GsamCrypto::SHA256_SIZE, this->m_vec_gsa_key_secret);
 	}
 
-	this->SendPhaseTwoMessage(session,
-						IkeHeader::INFORMATIONAL,
-						true,
-						next_payload_type,
-						length_beside_ikeheader,
-						packet,
-						false);
+	//only the q derives gsa keys, they are not distributed to the members
+	//the gm and nq ends of a gsa go without keys
+	std::list<uint8_t> lst_spi_bytes;
+	GsamUtility::Uint32ToBytes(lst_spi_bytes, gsa->GetSpi());
+	std::vector<uint8_t> seed (lst_spi_bytes.begin(), lst_spi_bytes.end());
+
+	std::vector<uint8_t> key_material;
+	GsamCrypto::PrfPlus(this->m_vec_gsa_key_secret, seed, GsamCrypto::GSA_KEY_MATERIAL_SIZE, key_material);
+	gsa->SetKeyMaterial(key_material);
+}
+
+bool
+GsamL4Protocol::IsCryptoQueueFull (void) const
+{
+	NS_LOG_FUNCTION (this);
+
+	uint32_t limit = GsamConfig::GetSingleton()->GetCryptoQueueLimit();
+
+	return ((0 != limit) && (this->m_lst_crypto_jobs.size() >= limit));
 }
 
 void
-GsamL4Protocol::SendAcceptAck (Ptr<GsamSession> session,  uint32_t gsa_push_id)
+GsamL4Protocol::SubmitCryptoJob (Time cost, Ptr<EventImpl> job)
 {
 	NS_LOG_FUNCTION (this);
 
-	GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session, gsa_push_id);
+	if (true == cost.IsZero())
+	{
+		//no cost configured, the job runs right away as before
+		job->Invoke();
+	}
+	else if (this->m_num_busy_crypto_workers < GsamConfig::GetSingleton()->GetNumberOfCryptoWorkers())
+	{
+		this->StartCryptoJob(cost, job);
+	}
+	else
+	{
+		this->m_lst_crypto_jobs.push_back(std::pair<Time, Ptr<EventImpl> >(cost, job));
+	}
+}
 
-	IkeTrafficSelector empty_ts = IkeTrafficSelector::GetIpv4DummyTs();
+void
+GsamL4Protocol::StartCryptoJob (Time cost, Ptr<EventImpl> job)
+{
+	NS_LOG_FUNCTION (this);
 
-	Ptr<IkeGroupNotifySubstructure> ack_notify_substructure = IkeGroupNotifySubstructure::GenerateEmptyGroupNotifySubstructure(	GsamConfig::GetDefaultGSAProposalId(),
-																																	IpSec::AH_ESP_SPI_SIZE,
-																																	IkeGroupNotifySubstructure::GSA_ACKNOWLEDGEDMENT,
-																																	gsa_push_id,
-																																	empty_ts,
-																																	empty_ts);
+	this->m_num_busy_crypto_workers++;
+	Simulator::Schedule (cost, &GsamL4Protocol::FinishCryptoJob, this, job);
+}
 
-	IkePayload ack_notify_payload;
-	ack_notify_payload.SetSubstructure(ack_notify_substructure);
+void
+GsamL4Protocol::FinishCryptoJob (Ptr<EventImpl> job)
+{
+	NS_LOG_FUNCTION (this);
 
-	Ptr<Packet> packet = Create<Packet>();
-	packet->AddHeader(ack_notify_payload);
+	if (0 == this->m_ptr_database)
+	{
+		//disposed while the worker was on it
+		return;
+	}
 
-	this->SendPhaseTwoMessage(session,
-				IkeHeader::INFORMATIONAL,
-				true,
-				ack_notify_payload.GetPayloadType(),
-				ack_notify_payload.GetSerializedSize(),
-				packet,
-				false);
+	if (0 == this->m_num_busy_crypto_workers)
+	{
+		NS_ASSERT (false);
+	}
+	this->m_num_busy_crypto_workers--;
+
+	if (false == this->m_lst_crypto_jobs.empty())
+	{
+		std::pair<Time, Ptr<EventImpl> > next_job = this->m_lst_crypto_jobs.front();
+		this->m_lst_crypto_jobs.pop_front();
+		this->StartCryptoJob(next_job.first, next_job.second);
+	}
+
+	job->Invoke();
 }
 
 void
@@ -2659,6 +4505,45 @@ GsamL4Protocol::HandleGsaPushGM (Ptr<Packet> packet, const IkeHeader& ikeheader,
 	this->ProcessGsaPushGM(session, gsa_push_id, ts_src, ts_dest, gsa_q_proposal, gsa_r_proposal);
 }
 
+void
+GsamL4Protocol::HandleNqControlPush (Ptr<Packet> packet, const IkeHeader& ikeheader, Ipv4Address peer_address)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<GsamSession> session = this->GetIpSecDatabase()->GetNqSession(peer_address);
+
+	if (0 == session)
+	{
+		//we are a gm, the querier itself, or an nq of another querier
+		return;
+	}
+
+	if (session->GetCurrentMessageId() < 2)
+	{
+		//the querier has not pushed to us yet, its first push carries every group anyway
+		return;
+	}
+
+	//the querier only multicasts once every nq answered its last request, so this is the next one
+	IkeHeader session_ikeheader = ikeheader;
+	session_ikeheader.SetInitiatorSpi(session->GetKekSaInitiatorSpi());
+	session_ikeheader.SetResponderSpi(session->GetKekSaResponderSpi());
+	session_ikeheader.SetMessageId(session->GetCurrentMessageId() + 1);
+
+	if (ikeheader.GetExchangeType() == IkeHeader::INFORMATIONAL)
+	{
+		this->HandleGsaPushSpiRequest(packet, session_ikeheader, session);
+	}
+	else if (ikeheader.GetExchangeType() == IkeHeader::CREATE_CHILD_SA)
+	{
+		this->HandleGsaRepush(packet, session_ikeheader, session);
+	}
+	else
+	{
+		NS_ASSERT (false);
+	}
+}
+
 void
 GsamL4Protocol::HandleGsaPushSpiRequestNQ (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session)
 {
@@ -2837,7 +4722,9 @@ GsamL4Protocol::ProcessGsaPushGM (	Ptr<GsamSession> session,
 			else
 			{
 				//Fake Reject
-				if (false == GsamConfig::IsFalseByPercentage(GsamConfig::GetSingleton()->GetSpiRejectPropability()))
+				//a leased spi is reserved by every member, it cannot conflict
+				if ((false == session->GetInfo()->IsIpsecSpiLeased(pushed_gsa_q_spi)) &&
+					(false == GsamConfig::IsFalseByPercentage(GsamConfig::GetSingleton()->GetSpiRejectPropability())))
 				{
 					this->FakeRejection(session, pushed_gsa_q_spi);
 					this->RejectGsaQ(session, gsa_push_id, ts_src, ts_dest, gsa_q_proposal);
@@ -3076,7 +4963,9 @@ GsamL4Protocol::ProcessGsaPushNQForOneGrp (	Ptr<GsamSession> session,
 			else
 			{
 				//Fake Reject
-				if (false == GsamConfig::IsFalseByPercentage(GsamConfig::GetSingleton()->GetSpiRejectPropability()))
+				//a leased spi is reserved by every member, it cannot conflict
+				if ((false == local_gsam_info->IsIpsecSpiLeased(gsa_r_proposal_spi->ToUint32())) &&
+					(false == GsamConfig::IsFalseByPercentage(GsamConfig::GetSingleton()->GetSpiRejectPropability())))
 				{
 					this->FakeRejection(session, gsa_r_proposal_spi->ToUint32());
 					lst_u32_gsa_r_spis_to_reject.push_back(gsa_r_proposal_spi->ToUint32());
@@ -3165,7 +5054,13 @@ GsamL4Protocol::HandleGsaAckRejectSpiResponse (Ptr<Packet> packet, const IkeHead
 {
 	NS_LOG_FUNCTION (this);
 
-	session->GetRetransmitTimer().Cancel();
+	if (ikeheader.GetMessageId() == session->GetCurrentMessageId())
+	{
+		//answer to the outstanding request
+		//an older message id is a duplicate answer, its request is done already
+		session->GetRetransmitTimer().Cancel();
+		session->SetAwaitingResponse(false);
+	}
 
 	if (session->GetGroupAddress() == GsamConfig::GetIgmpv3DestGrpReportAddress())
 	{
@@ -3175,6 +5070,8 @@ GsamL4Protocol::HandleGsaAckRejectSpiResponse (Ptr<Packet> packet, const IkeHead
 	{
 		this->HandleGsaAckRejectSpiResponseFromGM(packet, ikeheader, session);
 	}
+
+	this->SendPendingPhaseTwoMessage(session);
 }
 
 void
@@ -3269,6 +5166,23 @@ GsamL4Protocol::HandleGsaAckFromGM (Ptr<Packet> packet, const IkePayload& first_
 				}
 				Ipv4Address group_address = session->GetGroupAddress();
 				igmp->SendSecureGroupSpecificQuery(group_address);
+				this->Send_GSA_PUSH_AWAITING(group_address);
+			}
+			else if ((true == GsamConfig::GetSingleton()->IsInstallBeforeNqAck()) &&
+					(false == gsa_push_session->IsGsaPairInstalled()))
+			{
+				//optimistic, the gm can use the group before the nqs ack
+				//a late nq rejection re-keys gsa_r, see GsaPushSession::InstallGsaPair
+				GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session, gsa_push_session->GetId());
+				gsa_push_session->InstallGsaPair();
+				Ptr<Igmpv3L4Protocol> igmp = Igmpv3L4Protocol::GetIgmp(this->m_node);
+				if (0 == igmp)
+				{
+					NS_ASSERT (false);
+				}
+				Ipv4Address group_address = session->GetGroupAddress();
+				igmp->SendSecureGroupSpecificQuery(group_address);
+				this->Send_GSA_PUSH_AWAITING(group_address);
 			}
 		}
 		else if (gsa_push_session->GetStatus() == GsaPushSession::SPI_CONFLICT_RESOLVE)
@@ -3541,6 +5455,12 @@ GsamL4Protocol::HandleGsaAckFromNQ (Ptr<Packet> packet, Ptr<GsamSession> session
 		if (true == gsa_push_session->IsAllReplied())
 		{
 			GsamConfig::Log(__FUNCTION__, this->m_node->GetId(), session, gsa_push_session->GetId());
+			if (true == gsa_push_session->IsGsaPairInstalled())
+			{
+				//installed when the gm acked, nothing left but cleaning up
+				gsa_push_session->SelfRemoval();
+				return;
+			}
 			gsa_push_session->InstallGsaPair();
 			gsa_push_session->SelfRemoval();
 			Ptr<Igmpv3L4Protocol> igmp = Igmpv3L4Protocol::GetIgmp(this->m_node);
@@ -3550,6 +5470,7 @@ GsamL4Protocol::HandleGsaAckFromNQ (Ptr<Packet> packet, Ptr<GsamSession> session
 			}
 			Ipv4Address group_address = gsa_push_session->GetGmSession()->GetGroupAddress();
 			igmp->SendSecureGroupSpecificQuery(group_address);
+			this->Send_GSA_PUSH_AWAITING(group_address);
 		}
 	}
 	else if (gsa_push_session->GetStatus() == GsaPushSession::SPI_CONFLICT_RESOLVE)
@@ -3688,7 +5609,7 @@ GsamL4Protocol::HandleGsaSpiNotificationFromNQ (Ptr<Packet> packet, Ptr<GsamSess
 			{
 				//ok
 			}
-			std::cout << " GsaPush Id: " << gsa_push_session->GetId() << std::endl;
+			NS_LOG_LOGIC ("GsaPush Id: " << gsa_push_session->GetId());
 		}
 
 		if (gsa_push_session->GetStatus() == GsaPushSession::GSA_PUSH_ACK)
@@ -11,8 +11,12 @@
 #include "ns3/object.h"
 #include "ipsec.h"
 #include "ns3/socket.h"
+#include "ns3/event-id.h"
+#include "ns3/event-impl.h"
+#include "ns3/nstime.h"
 #include <list>
 #include <set>
+#include <vector>
 #include "igmpv3-l4-protocol.h"
 
 namespace ns3 {
@@ -58,6 +62,11 @@ public:	//exchanges, added by Lin Chen
 	//create session somewhere first
 	void Send_IKE_SA_INIT (Ptr<GsamInitSession> init_session);
 	void Send_IKE_SA_AUTH (Ptr<GsamInitSession> init_session, Ptr<GsamSession> session);
+	void Send_KEK_SA_DELETE (Ptr<GsamSession> session);
+	//q only, the pushes still waiting on the peer of the session are dropped and the groups move on
+	void AbortGsaPushes (Ptr<GsamSession> session);
+	//q only, the session of a leaving gm goes once nothing in flight refers to it any more
+	void RemoveGmSession (Ptr<GsamSession> session);
 private:	//Sending, added by Lin Chen,
 	void SendPhaseOneMessage (Ptr<GsamSession> session,
 								IkeHeader::EXCHANGE_TYPE exchange_type,
@@ -80,10 +89,18 @@ private:	//Sending, added by Lin Chen,
 						uint32_t length_beside_ikeheader,
 						Ptr<Packet> packet,
 						bool retransmit);
+	void SendPendingPhaseTwoMessage (Ptr<GsamSession> session);
 	void DoSendMessage (Ptr<GsamSession> session, bool retransmit);
+	//the retransmissions ran out, the next queued request is sent
+	void GiveUpPhaseTwoMessage (Ptr<GsamSession> session);
+	void DoScheduleRepair (Ptr<GsamSession> session);
 	void DoSendInitMessage (Ptr<GsamInitSession> session, bool retransmit);
 private:	//phase 1, initiator
+	//cookie, 0 if the q has not asked for one
+	void DoSend_IKE_SA_INIT (Ptr<GsamInitSession> init_session, uint64_t cookie);
+	void DoSend_IKE_SA_AUTH (Ptr<GsamInitSession> init_session);
 	void HandleIkeSaInitResponse (Ptr<Packet> packet, const IkeHeader& ikeheader, Ipv4Address peer_address);
+	void FinishIkeSaInitResponse (Ptr<GsamInitSession> init_session);
 	void HandleIkeSaAuthResponse (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamInitSession> init_session);
 	void ProcessIkeSaAuthResponse (	const Ptr<const GsamInitSession> init_session,
 									uint64_t kek_initiator_spi,
@@ -93,7 +110,11 @@ private:	//phase 1, initiator
 private:	//phase 1, responder
 	void HandleIkeSaInit (Ptr<Packet> packet, const IkeHeader& ikeheader, Ipv4Address peer_address);
 	void HandleIkeSaInitInvitation (Ptr<Packet> packet, const IkeHeader& ikeheader, Ipv4Address peer_address);
+	void FinishIkeSaInitInvitation (Ptr<GsamInitSession> init_session);
 	void RespondIkeSaInit (Ptr<GsamInitSession> session);
+	//stateless, nothing is kept until the initiator returns the cookie
+	void RespondIkeSaInitCookie (const IkeHeader& ikeheader, Ipv4Address peer_address);
+	uint64_t ComputeIkeCookie (uint64_t initiator_spi, Ipv4Address peer_address) const;
 	void HandleIkeSaAuth (Ptr<Packet> packet, const IkeHeader& ikeheader, Ipv4Address peer_address);
 	void HandleIkeSaAuthInvitation (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamInitSession> init_session);
 	/*
@@ -105,13 +126,22 @@ private:	//phase 1, responder
 										const std::list<IkeTrafficSelector>& tsi_selectors,
 										const std::list<IkeTrafficSelector>& tsr_selectors,
 										Ptr<GsamSession>& found_or_created_session);
-	void RespondIkeSaAuth (	Ptr<GsamSession> session,
-							const Ptr<IkeSaProposal> chosen_proposal,
-							const std::list<IkeTrafficSelector>& narrowed_tssi,
-							const std::list<IkeTrafficSelector>& narrowed_tssr);
+	void FinishIkeSaAuthInvitation (	Ptr<GsamInitSession> init_session,
+										const std::list<Ptr<GsamSession> >& lst_sessions,
+										const std::list<std::list<IkeTrafficSelector> >& lst_narrowed_tssi,
+										const std::list<std::list<IkeTrafficSelector> >& lst_narrowed_tssr,
+										const std::list<Ptr<GsamSession> >& lst_new_sessions);
+	//one response for all groups of an invitation, in the order they were invited
+	void RespondIkeSaAuth (	const std::list<Ptr<GsamSession> >& lst_sessions,
+							const std::list<std::list<IkeTrafficSelector> >& lst_narrowed_tssi,
+							const std::list<std::list<IkeTrafficSelector> >& lst_narrowed_tssr);
 private:	//phase 2, Q
 	void Send_GSA_PUSH (Ptr<GsamSession> session);
 	void Send_GSA_PUSH_GM (Ptr<GsamSession> session);
+	void Send_GSA_PUSH_AWAITING (Ipv4Address group_address);
+	void HandleGsaRepushAck (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
+	//the cached group rekey re-push of the session was acked or given up, the group stops waiting on it
+	void SettleGroupRekeyRepush (Ptr<GsamSession> session);
 	void Send_GSA_RE_PUSH (Ptr<GsaPushSession> gsa_push_session);
 	void Send_GSA_PUSH_NQ (Ptr<GsamSession> session);
 	void Send_SPI_REQUEST (Ptr<GsaPushSession> gsa_push_session, GsaPushSession::SPI_REQUEST_TYPE spi_request_type);
@@ -134,6 +164,18 @@ private:	//phase 2, Q
 						Ptr<Packet> packet_without_ikeheader,
 						IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
 						IkeHeader::EXCHANGE_TYPE exchange_type);
+	/*
+	 * @return value: whether the nqs were sent one multicast, false if they must be sent unicasts
+	 */
+	bool MulticastToNQs (	const std::list<Ptr<GsamSession> >& lst_nq_sessions,
+							Ptr<Packet> packet_without_ikeheader,
+							IkePayloadHeader::PAYLOAD_TYPE first_payload_type,
+							uint32_t length_beside_ikeheader,
+							IkeHeader::EXCHANGE_TYPE exchange_type);
+private:	//group rekey, Q
+	void CheckRekey (void);
+	void Send_GSA_REKEY (const std::list<Ptr<GsamSessionGroup> >& lst_session_groups);
+	void FinishGroupRekey (Ptr<GsamSessionGroup> session_group, uint32_t new_gsa_q_spi);
 private:	//phase 2, GM, NQ
 	void HandleGsaInformational (Ptr<Packet> packet, const IkeHeader& ikeheader, Ipv4Address peer_address);
 	void HandleGsaPushSpiRequest (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
@@ -143,6 +185,7 @@ private:	//phase 2, GM, NQ
 	void HandleGsaRepush (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
 	void HandleGsaRepushGM (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
 	void HandleGsaRepushNQ (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
+	void RekeyInboundGsa (Ptr<IpSecSADatabase> inbound_sad, Ptr<IpSecSAEntry> gsa, uint32_t new_spi);
 private:	//phase 2, GM
 	void HandleGsaPushSpiRequestGM (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
 	void HandleGsaPushGM (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
@@ -175,6 +218,7 @@ private:	//phase 2, GM
 						const Ptr<IkeSaProposal> gsa_q_proposal,
 						const Ptr<IkeSaProposal> gsa_r_proposal);
 private:	//phase 2, NQ
+	void HandleNqControlPush (Ptr<Packet> packet, const IkeHeader& ikeheader, Ipv4Address peer_address);
 	void HandleGsaPushSpiRequestNQ (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
 	void HandleGsaPushNQ (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
 	void ProcessGsaPushNQForOneGrp (	Ptr<GsamSession> session,
@@ -191,6 +235,35 @@ private:	//phase 2, NQ
 						std::list<Ptr<IkePayloadSubstructure> >& retval_payload_subs);
 	void ProcessNQRejectResult (Ptr<GsamSession> session, std::list<Ptr<IkePayloadSubstructure> >& retval_payload_subs);
 	void SendAcceptAck (Ptr<GsamSession> session, uint32_t gsa_push_id);
+private:	//spi leases
+	/*
+	 * @return value: whether there are leases the peer has not been sent yet
+	 */
+	bool GenerateSpiLeasePayload (Ptr<GsamSession> session, IkePayload& retval);
+	void PrependSpiLeases (	Ptr<GsamSession> session,
+							Ptr<Packet> packet,
+							IkePayloadHeader::PAYLOAD_TYPE& first_payload_type,
+							uint32_t& length_beside_ikeheader);
+	void PeelSpiLeases (Ptr<Packet> packet, IkeHeader& ikeheader, Ptr<GsamSession> session);
+	void ReserveSpiLeases (Ptr<GsamInfo> info, const IkePayload& spi_lease_payload);
+private:	//leave
+	void HandleKekSaDelete (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
+	void HandleKekSaDeleteResponse (Ptr<Packet> packet, const IkeHeader& ikeheader, Ptr<GsamSession> session);
+	void FinishGroupLeave (Ptr<GsamSession> session);
+	void TearDownSession (Ptr<GsamSession> session);
+private:	//keying material, real only if the config asks for x25519, see GsamCrypto
+	void GenerateKeyExchangeValues (Ptr<GsamSa> init_sa, bool is_initiator);
+	Ptr<IkeKeyExchangeSubStructure> GenerateKeyExchangeSubstructure (Ptr<GsamSa> init_sa) const;
+	Ptr<IkeNonceSubstructure> GenerateNonceSubstructure (Ptr<GsamSa> init_sa, bool is_initiator) const;
+	void DeriveIkeSaKeys (Ptr<GsamInitSession> init_session, const IkePayload& peer_ke, const IkePayload& peer_nonce);
+	void DeriveKekSaKeys (Ptr<GsamSession> session);
+	void DeriveGsaKeys (Ptr<IpSecSAEntry> gsa);
+private:	//crypto workers, the cpu of the node as the simulation sees it
+	bool IsCryptoQueueFull (void) const;
+	//job runs once a worker has spent cost on it
+	void SubmitCryptoJob (Time cost, Ptr<EventImpl> job);
+	void StartCryptoJob (Time cost, Ptr<EventImpl> job);
+	void FinishCryptoJob (Ptr<EventImpl> job);
 private://experiencement
 	void FakeRejection (Ptr<GsamSession> session, uint32_t u32_spi);
 public:	//const
@@ -219,6 +292,12 @@ private:	//fields
 	Ptr<Socket> m_socket;
 	Ptr<IpSecDatabase> m_ptr_database;
 	Ptr<GsamFilter> m_ptr_gsam_filter;
+	EventId m_rekey_event;
+	uint64_t m_cookie_secret;
+	//q only, made on its first gsa, gsa keys are derived from it
+	std::vector<uint8_t> m_vec_gsa_key_secret;
+	uint16_t m_num_busy_crypto_workers;
+	std::list<std::pair<Time, Ptr<EventImpl> > > m_lst_crypto_jobs;
 };
 
 } /* namespace ns3 */
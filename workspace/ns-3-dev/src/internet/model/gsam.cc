@@ -2396,6 +2396,16 @@ IkeKeyExchangeSubStructure::GetDummySubstructure (void)
 	return substructure;
 }
 
+Ptr<IkeKeyExchangeSubStructure>
+IkeKeyExchangeSubStructure::GenerateKeyExchangeSubstructure (uint16_t dh_group_num, const std::vector<uint8_t>& key_exchange_data)
+{
+	Ptr<IkeKeyExchangeSubStructure> substructure = Create<IkeKeyExchangeSubStructure>();
+	substructure->m_dh_group_num = dh_group_num;
+	substructure->m_lst_data.assign(key_exchange_data.begin(), key_exchange_data.end());
+	substructure->SetLength(substructure->GetSerializedSize());
+	return substructure;
+}
+
 IkePayloadHeader::PAYLOAD_TYPE
 IkeKeyExchangeSubStructure::GetPayloadType (void) const
 {
@@ -2403,6 +2413,20 @@ IkeKeyExchangeSubStructure::GetPayloadType (void) const
 	return IkePayloadHeader::KEY_EXCHANGE;
 }
 
+uint16_t
+IkeKeyExchangeSubStructure::GetDhGroupNum (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_dh_group_num;
+}
+
+void
+IkeKeyExchangeSubStructure::GetKeyExchangeData (std::vector<uint8_t>& retval) const
+{
+	NS_LOG_FUNCTION (this);
+	retval.assign(this->m_lst_data.begin(), this->m_lst_data.end());
+}
+
 /********************************************************
  *        IkeIdSubstructure
  ********************************************************/
@@ -2892,6 +2916,17 @@ IkeNonceSubstructure::GenerateNonceSubstructure (uint64_t u64)
 	return nonce;
 }
 
+Ptr<IkeNonceSubstructure>
+IkeNonceSubstructure::GenerateNonceSubstructure (const std::vector<uint8_t>& nonce_data)
+{
+	Ptr<IkeNonceSubstructure> nonce = Create<IkeNonceSubstructure>();
+
+	nonce->m_lst_nonce_data.assign(nonce_data.begin(), nonce_data.end());
+	nonce->SetLength(nonce_data.size());
+
+	return nonce;
+}
+
 void
 IkeNonceSubstructure::SetU64ToData (uint64_t u64)
 {
@@ -2906,6 +2941,13 @@ IkeNonceSubstructure::GetDataToU64 (void) const
 	return GsamUtility::BytesToUint64(this->m_lst_nonce_data);
 }
 
+void
+IkeNonceSubstructure::GetNonceData (std::vector<uint8_t>& retval) const
+{
+	NS_LOG_FUNCTION (this);
+	retval.assign(this->m_lst_nonce_data.begin(), this->m_lst_nonce_data.end());
+}
+
 /********************************************************
  *        IkeNotifySubstructure
  ********************************************************/
@@ -2944,6 +2986,10 @@ IkeNotifySubstructure::GetSerializedSize (void) const
 
 	uint32_t size = 0;
 
+	size += sizeof (this->m_protocol_id);
+	size += sizeof (this->m_spi_size);
+	size += sizeof (this->m_notify_message_type);
+	size += this->m_spi_size;
 	size += this->m_lst_notification_data.size();
 
 	return size;
@@ -2964,11 +3010,11 @@ IkeNotifySubstructure::Serialize (Buffer::Iterator start) const
 
 	i.WriteU8(this->m_protocol_id);
 
-	i.WriteU8(this->m_ptr_spi->GetSerializedSize());
+	i.WriteU8(this->m_spi_size);
 
 	i.WriteHtonU16(this->m_notify_message_type);
 
-	if (0 < this->m_ptr_spi)
+	if (0 < this->m_spi_size)
 	{
 		this->m_ptr_spi->Serialize(i);
 		i.Next(this->m_ptr_spi->GetSerializedSize());
@@ -3008,7 +3054,7 @@ IkeNotifySubstructure::Deserialize (Buffer::Iterator start)
 	this->m_notify_message_type = i.ReadNtohU16();
 	size += sizeof (this->m_notify_message_type);
 
-	if (0 < this->m_ptr_spi)
+	if (0 < this->m_spi_size)
 	{
 		uint32_t size_spi_deserialzie = this->m_ptr_spi->Deserialize(i, this->m_spi_size);
 		if (size_spi_deserialzie != this->m_ptr_spi->GetSerializedSize())
@@ -3078,7 +3124,7 @@ IkeNotifySubstructure::SetSpi (Ptr<Spi> spi)
 	this->m_spi_size = spi->GetSerializedSize();
 }
 
-uint8_t
+uint16_t
 IkeNotifySubstructure::GetNotifyMessageType (void) const
 {
 	NS_LOG_FUNCTION (this);
@@ -3099,6 +3145,28 @@ IkeNotifySubstructure::GetPayloadType (void) const
 	return IkePayloadHeader::NOTIFY;
 }
 
+uint64_t
+IkeNotifySubstructure::GetDataToU64 (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return GsamUtility::BytesToUint64(this->m_lst_notification_data);
+}
+
+Ptr<IkeNotifySubstructure>
+IkeNotifySubstructure::GenerateCookieSubstructure (uint64_t cookie)
+{
+	Ptr<IkeNotifySubstructure> retval = Create<IkeNotifySubstructure>();
+
+	//no spi, the cookie is the notification data
+	retval->m_protocol_id = 0;
+	retval->m_spi_size = 0;
+	retval->m_notify_message_type = IkeNotifySubstructure::COOKIE;
+	GsamUtility::Uint64ToBytes(retval->m_lst_notification_data, cookie);
+	retval->SetLength(retval->GetSerializedSize());
+
+	return retval;
+}
+
 /********************************************************
  *        IkeDeletePayloadSubstructure
  ********************************************************/
@@ -3234,6 +3302,26 @@ IkeDeletePayloadSubstructure::GetPayloadType (void) const
 	return IkePayloadHeader::DELETE;
 }
 
+uint8_t
+IkeDeletePayloadSubstructure::GetProtocolId (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_protocol_id;
+}
+
+Ptr<IkeDeletePayloadSubstructure>
+IkeDeletePayloadSubstructure::GenerateIkeSaDeleteSubstructure (void)
+{
+	Ptr<IkeDeletePayloadSubstructure> retval = Create<IkeDeletePayloadSubstructure>();
+
+	retval->m_protocol_id = IpSec::SA_PROPOSAL_IKE;
+	retval->m_spi_size = 0;
+	retval->m_num_of_spis = 0;
+	retval->SetLength(retval->GetSerializedSize());
+
+	return retval;
+}
+
 /********************************************************
  *        IkeTrafficSelector
  ********************************************************/
@@ -4846,7 +4934,7 @@ IkeGroupNotifySubstructure::Serialize (Buffer::Iterator start) const
 	{
 		NS_ASSERT (false);
 	}
-	if (this->m_notify_message_type > 6)
+	if (this->m_notify_message_type > IkeGroupNotifySubstructure::SPI_LEASE)
 	{
 		NS_ASSERT (false);
 	}
@@ -4886,7 +4974,7 @@ IkeGroupNotifySubstructure::Deserialize (Buffer::Iterator start)
 	{
 		NS_ASSERT (false);
 	}
-	if (this->m_notify_message_type > 6)
+	if (this->m_notify_message_type > IkeGroupNotifySubstructure::SPI_LEASE)
 	{
 		NS_ASSERT (false);
 	}
@@ -4978,6 +5066,10 @@ IkeGroupNotifySubstructure::SetNotifyMessageType (uint8_t notify_message_type)
 	{
 		//ok
 	}
+	else if (notify_message_type == IkeGroupNotifySubstructure::SPI_LEASE)
+	{
+		//ok
+	}
 	else
 	{
 		//not ok
@@ -5172,6 +5264,14 @@ IkeGroupNotifySubstructure::GetNotifyMessageType (void) const
 	{
 		//ok
 	}
+	else if (this->m_notify_message_type == IkeGroupNotifySubstructure::SPI_REQUEST)
+	{
+		//ok
+	}
+	else if (this->m_notify_message_type == IkeGroupNotifySubstructure::SPI_LEASE)
+	{
+		//ok
+	}
 	else
 	{
 		//not ok
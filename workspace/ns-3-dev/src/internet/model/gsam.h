@@ -27,6 +27,7 @@
 #include "ns3/ipv4-address.h"
 #include <list>
 #include <set>
+#include <vector>
 #include "ns3/object.h"
 
 namespace ns3 {
@@ -454,7 +455,9 @@ public:
 		DH_6144_BIT_MODP = 17,
 		DH_8192_BIT_MODP = 18,
 		//dummy test use
-		DH_32_BIT_MODP = 19
+		DH_32_BIT_MODP = 19,
+		//rfc 8031
+		CURVE_25519 = 31
 	};
 	enum TRANSFORM_ESN_ID {
 		//TYPE 5
@@ -623,7 +626,9 @@ public:
 		DH_6144_BIT_MODP = 17,
 		DH_8192_BIT_MODP = 18,
 		//dummy test use
-		DH_32_BIT_MODP = 19
+		DH_32_BIT_MODP = 19,
+		//rfc 8031
+		CURVE_25519 = 31
 	};
 
 public:
@@ -638,10 +643,13 @@ public:	//Header Override
 	virtual void Print (std::ostream &os) const;
 public:
 	static Ptr<IkeKeyExchangeSubStructure> GetDummySubstructure (void);
+	static Ptr<IkeKeyExchangeSubStructure> GenerateKeyExchangeSubstructure (uint16_t dh_group_num, const std::vector<uint8_t>& key_exchange_data);
 public:
 	using IkePayloadSubstructure::Deserialize;
 public:	//const
 	virtual IkePayloadHeader::PAYLOAD_TYPE GetPayloadType (void) const;
+	uint16_t GetDhGroupNum (void) const;
+	void GetKeyExchangeData (std::vector<uint8_t>& retval) const;
 private:
 	uint16_t m_dh_group_num;
 	std::list<uint8_t> m_lst_data;
@@ -772,10 +780,12 @@ public:	//override IkePayloadSubstructure
 public:	//static
 	static Ptr<IkeNonceSubstructure> GenerateRandomNonceSubstructure (void);
 	static Ptr<IkeNonceSubstructure> GenerateNonceSubstructure (uint64_t u64);
+	static Ptr<IkeNonceSubstructure> GenerateNonceSubstructure (const std::vector<uint8_t>& nonce_data);
 public:
 	using IkePayloadSubstructure::Deserialize;
 public:	//self-defined const
 	uint64_t GetDataToU64 (void) const;
+	void GetNonceData (std::vector<uint8_t>& retval) const;
 private:	//self-defined
 	void SetU64ToData (uint64_t u64);
 private:
@@ -800,6 +810,7 @@ class IkeNotifySubstructure : public IkePayloadSubstructure {
      * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 	 */
 
+public:
 	enum NOTIFY_MESSAGE_TYPE {
 		//error types
 		UNSUPPORTED_CRITICAL_PAYLOAD = 1,
@@ -842,13 +853,17 @@ public:	//Header Override
 	virtual void Serialize (Buffer::Iterator start) const;
 	virtual uint32_t Deserialize (Buffer::Iterator start);
 	virtual void Print (std::ostream &os) const;
+public:	//static
+	//stateless cookie of an ike_sa_init, rfc 7296 2.6
+	static Ptr<IkeNotifySubstructure> GenerateCookieSubstructure (uint64_t cookie);
 public:	//non_const
 	void SetSpi (uint32_t spi);
 	void SetSpi (Ptr<Spi> spi);
 public:	//const
-	uint8_t GetNotifyMessageType (void) const;
+	uint16_t GetNotifyMessageType (void) const;
 	Ptr<Spi> GetSpi (void) const;
 	virtual IkePayloadHeader::PAYLOAD_TYPE GetPayloadType (void) const;
+	uint64_t GetDataToU64 (void) const;
 public:
 	using IkePayloadSubstructure::Deserialize;
 private:
@@ -883,8 +898,12 @@ public:	//Header Override
 	virtual void Serialize (Buffer::Iterator start) const;
 	virtual uint32_t Deserialize (Buffer::Iterator start);
 	virtual void Print (std::ostream &os) const;
+public:	//static
+	//deletes the ike sa the message is sent on, no spi is carried, rfc 7296 3.11
+	static Ptr<IkeDeletePayloadSubstructure> GenerateIkeSaDeleteSubstructure (void);
 public:	//const
 	virtual IkePayloadHeader::PAYLOAD_TYPE GetPayloadType (void) const;
+	uint8_t GetProtocolId (void) const;
 public:
 	using IkePayloadSubstructure::Deserialize;
 private:
@@ -1262,7 +1281,8 @@ public:
 		GSA_Q_SPI_NOTIFICATION = 3,
 		GSA_R_SPI_NOTIFICATION = 4,
 		GSA_ACKNOWLEDGEDMENT = 5,
-		SPI_REQUEST = 6
+		SPI_REQUEST = 6,
+		SPI_LEASE = 7	//spis as pairs of first and last spi of the ranges leased to the q
 	};
 public:
 	static TypeId GetTypeId (void);
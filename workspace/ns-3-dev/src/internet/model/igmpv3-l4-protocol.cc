@@ -472,7 +472,7 @@ Igmpv3L4Protocol::SendDefaultGeneralQuery (void)
 
 	packet->AddHeader(header);
 
-	std::cout << "Node: " << m_node->GetId() << " sending a default general query" << std::endl;
+	NS_LOG_INFO ("Node: " << m_node->GetId() << " sending a default general query");
 
 	Ipv4Header ipv4header;
 	ipv4header.SetSource("0.0.0.0");
@@ -508,7 +508,7 @@ Igmpv3L4Protocol::SendSecureGroupSpecificQuery (Ipv4Address group_address)
 
 	packet->AddHeader(header);
 
-	std::cout << "Node: " << m_node->GetId() << " sending a secure group specific query" << std::endl;
+	NS_LOG_INFO ("Node: " << m_node->GetId() << " sending a secure group specific query");
 
 	Ipv4Header ipv4header;
 	ipv4header.SetSource("0.0.0.0");
@@ -710,6 +710,8 @@ Igmpv3L4Protocol::SendSecureStateChangesReport (Ptr<IGMPv3InterfaceStateManager>
 		packet->AddHeader(header);
 
 		this->SendSecureReport(ifstate_manager->GetInterface(), packet, secure_group_address);
+
+		ifstate_manager->CheckSecureGroupLeave(secure_group_address);
 	}
 }
 
@@ -798,7 +800,7 @@ Igmpv3L4Protocol::Receive (Ptr<Packet> p,
 	switch (igmp.GetType ()) {
 	case Igmpv3Header::MEMBERSHIP_QUERY:
 		//HandleEcho (p, igmp, header.GetSource (), header.GetDestination ());
-		std::cout << "Node: " << m_node->GetId() << " received a query" << std::endl;
+		NS_LOG_INFO ("Node: " << m_node->GetId() << " received a query");
 		if (Igmpv3L4Protocol::GROUP_MEMBER == this->m_role) {
 			this->HandleQuery(p, igmp.GetMaxRespCode(), incomingInterface);
 		}
@@ -809,28 +811,28 @@ Igmpv3L4Protocol::Receive (Ptr<Packet> p,
 		break;
 	case Igmpv3Header::V1_MEMBERSHIP_REPORT:
 		//HandleTimeExceeded (p, igmp, header.GetSource (), header.GetDestination ());
-		std::cout << "Node: " << m_node->GetId() << " received a v1 report" << std::endl;
+		NS_LOG_INFO ("Node: " << m_node->GetId() << " received a v1 report");
 		if (Igmpv3L4Protocol::QUERIER == this->m_role) {
 			//dummy
 			this->HandleV1MemReport ();
 		}
 		break;
 	case Igmpv3Header::V2_MEMBERSHIP_REPORT:
-		std::cout << "Node: " << m_node->GetId() << " received a v2 report" << std::endl;
+		NS_LOG_INFO ("Node: " << m_node->GetId() << " received a v2 report");
 		if (Igmpv3L4Protocol::QUERIER == this->m_role) {
 			//dummy
 			this->HandleV2MemReport ();
 		}
 		break;
 	case Igmpv3Header::V3_MEMBERSHIP_REPORT:
-		std::cout << "Node: " << m_node->GetId() << " received a v3 report" << std::endl;
+		NS_LOG_INFO ("Node: " << m_node->GetId() << " received a v3 report");
 		if (Igmpv3L4Protocol::QUERIER == this->m_role) {
 			this->HandleV3MemReport (p, incomingInterface, header.GetSource());
 		}
 		break;
 	default:
 		NS_LOG_DEBUG (igmp << " " << *p);
-		std::cout << "Node: " << m_node->GetId() << " did not find a appropriate type in IGMP header" << std::endl;
+		NS_LOG_WARN ("Node: " << m_node->GetId() << " did not find a appropriate type in IGMP header");
 		break;
 	}
 
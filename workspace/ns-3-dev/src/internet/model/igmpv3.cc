@@ -200,7 +200,7 @@ IGMPv3SocketState::UnSubscribeIGMP ()
 {
 	if (this->m_associated_if_state != 0)
 	{
-		std::cout << "socket state: " << this << " UnSubscribeIGMP ()" << std::endl;
+		NS_LOG_LOGIC ("socket state: " << this << " UnSubscribeIGMP ()");
 		this->m_associated_if_state->UnSubscribeIGMP (this);
 	}
 	else
@@ -212,15 +212,7 @@ IGMPv3SocketState::UnSubscribeIGMP ()
 void
 IGMPv3SocketState::StateChange (ns3::FILTER_MODE filter_mode, std::list<Ipv4Address> const &src_list)
 {
-	std::cout << "Socket state change: ";
-	if (filter_mode == ns3::INCLUDE)
-	{
-		std::cout << "filter mode: include" << std::endl;
-	}
-	else
-	{
-		std::cout << "filter mode: exclude" << std::endl;
-	}
+	NS_LOG_LOGIC ("Socket state change: filter mode: " << ((filter_mode == ns3::INCLUDE) ? "include" : "exclude"));
 
 	if ((filter_mode == ns3::INCLUDE) && (true == src_list.empty()))
 	{
@@ -229,6 +221,9 @@ IGMPv3SocketState::StateChange (ns3::FILTER_MODE filter_mode, std::list<Ipv4Addr
 	}
 	else
 	{
+		//remove the contribution of the old socket state from the interface state before changing
+		this->m_associated_if_state->SocketStateChange(this, filter_mode, src_list);
+
 		this->m_filter_mode = filter_mode;
 		this->m_lst_source_list = src_list;
 
@@ -372,6 +367,235 @@ IGMPv3SocketStateManager::Remove (Ptr<IGMPv3SocketState> socket_state)
 	this->m_lst_socket_states.remove(socket_state);
 }
 
+/********************************************************
+ *        IGMPv3SourceFilterMerger
+ ********************************************************/
+
+IGMPv3SourceFilterMerger::IGMPv3SourceFilterMerger (void)
+  :  m_num_include_states (0),
+	 m_num_exclude_states (0),
+	 m_last_filter_mode (ns3::INCLUDE),
+	 m_flag_src_lst_changed (false)
+{
+
+}
+
+IGMPv3SourceFilterMerger::~IGMPv3SourceFilterMerger (void)
+{
+	this->Clear();
+}
+
+void
+IGMPv3SourceFilterMerger::AddSocketState (ns3::FILTER_MODE filter_mode, std::list<Ipv4Address> const &src_list)
+{
+	if (filter_mode == ns3::EXCLUDE)
+	{
+		this->m_num_exclude_states++;
+	}
+	else
+	{
+		this->m_num_include_states++;
+	}
+
+	this->UpdateRefCounts(filter_mode, src_list, true);
+}
+
+void
+IGMPv3SourceFilterMerger::RemoveSocketState (ns3::FILTER_MODE filter_mode, std::list<Ipv4Address> const &src_list)
+{
+	if (filter_mode == ns3::EXCLUDE)
+	{
+		NS_ASSERT (0 < this->m_num_exclude_states);
+		this->m_num_exclude_states--;
+	}
+	else
+	{
+		NS_ASSERT (0 < this->m_num_include_states);
+		this->m_num_include_states--;
+	}
+
+	this->UpdateRefCounts(filter_mode, src_list, false);
+}
+
+ns3::FILTER_MODE
+IGMPv3SourceFilterMerger::GetFilterMode (void) const
+{
+	//rfc 3376, 3.2, EXCLUDE if any of the socket states has filter mode EXCLUDE
+	if (0 < this->m_num_exclude_states)
+	{
+		return ns3::EXCLUDE;
+	}
+	else
+	{
+		return ns3::INCLUDE;
+	}
+}
+
+void
+IGMPv3SourceFilterMerger::GetSrcList (std::list<Ipv4Address> &retval) const
+{
+	for (std::set<Ipv4Address>::const_iterator const_it = this->m_set_merged_srcs.begin();
+			const_it != this->m_set_merged_srcs.end();
+			const_it++)
+	{
+		retval.push_back(*const_it);
+	}
+}
+
+bool
+IGMPv3SourceFilterMerger::IsFilterModeChanged (void) const
+{
+	return (this->m_last_filter_mode != this->GetFilterMode());
+}
+
+bool
+IGMPv3SourceFilterMerger::IsSrcLstChanged (void) const
+{
+	return this->m_flag_src_lst_changed;
+}
+
+void
+IGMPv3SourceFilterMerger::ClearChanges (void)
+{
+	this->m_last_filter_mode = this->GetFilterMode();
+	this->m_flag_src_lst_changed = false;
+}
+
+void
+IGMPv3SourceFilterMerger::Clear (void)
+{
+	this->m_map_src_refcounts.clear();
+	this->m_set_merged_srcs.clear();
+	this->m_num_include_states = 0;
+	this->m_num_exclude_states = 0;
+}
+
+void
+IGMPv3SourceFilterMerger::UpdateRefCounts (ns3::FILTER_MODE filter_mode, std::list<Ipv4Address> const &src_list, bool add)
+{
+	for (std::list<Ipv4Address>::const_iterator const_it = src_list.begin();
+			const_it != src_list.end();
+			const_it++)
+	{
+		SrcRefCount &count = this->m_map_src_refcounts[(*const_it)];
+		if (true == add)
+		{
+			if (filter_mode == ns3::EXCLUDE)
+			{
+				count.m_exclude++;
+			}
+			else
+			{
+				count.m_include++;
+			}
+		}
+		else
+		{
+			if (filter_mode == ns3::EXCLUDE)
+			{
+				NS_ASSERT (0 < count.m_exclude);
+				count.m_exclude--;
+			}
+			else
+			{
+				NS_ASSERT (0 < count.m_include);
+				count.m_include--;
+			}
+		}
+	}
+
+	if (filter_mode == ns3::EXCLUDE)
+	{
+		//the number of EXCLUDE socket states is part of the membership test of every source
+		this->UpdateAllMergedSrcs();
+	}
+	else
+	{
+		for (std::list<Ipv4Address>::const_iterator const_it = src_list.begin();
+				const_it != src_list.end();
+				const_it++)
+		{
+			this->UpdateMergedSrc(*const_it);
+		}
+	}
+}
+
+bool
+IGMPv3SourceFilterMerger::IsMergedSrc (SrcRefCount const &count) const
+{
+	if (0 < this->m_num_exclude_states)
+	{
+		//intersection of EXCLUDE source lists minus union of INCLUDE source lists
+		return ((count.m_exclude == this->m_num_exclude_states) && (0 == count.m_include));
+	}
+	else
+	{
+		//union of INCLUDE source lists
+		return (0 < count.m_include);
+	}
+}
+
+void
+IGMPv3SourceFilterMerger::UpdateMergedSrc (Ipv4Address src)
+{
+	std::map<Ipv4Address, SrcRefCount>::iterator it = this->m_map_src_refcounts.find(src);
+	bool is_merged_src = false;
+
+	if (it != this->m_map_src_refcounts.end())
+	{
+		is_merged_src = this->IsMergedSrc(it->second);
+
+		if ((0 == it->second.m_include) && (0 == it->second.m_exclude))
+		{
+			this->m_map_src_refcounts.erase(it);
+		}
+	}
+
+	if (true == is_merged_src)
+	{
+		if (true == this->m_set_merged_srcs.insert(src).second)
+		{
+			this->m_flag_src_lst_changed = true;
+		}
+	}
+	else
+	{
+		if (0 < this->m_set_merged_srcs.erase(src))
+		{
+			this->m_flag_src_lst_changed = true;
+		}
+	}
+}
+
+void
+IGMPv3SourceFilterMerger::UpdateAllMergedSrcs (void)
+{
+	//sources of the current merged list may have dropped their reference counts to 0
+	std::list<Ipv4Address> lst_srcs;
+	for (std::set<Ipv4Address>::const_iterator const_it = this->m_set_merged_srcs.begin();
+			const_it != this->m_set_merged_srcs.end();
+			const_it++)
+	{
+		if (this->m_map_src_refcounts.end() == this->m_map_src_refcounts.find(*const_it))
+		{
+			lst_srcs.push_back(*const_it);
+		}
+	}
+	for (std::map<Ipv4Address, SrcRefCount>::const_iterator const_it = this->m_map_src_refcounts.begin();
+			const_it != this->m_map_src_refcounts.end();
+			const_it++)
+	{
+		lst_srcs.push_back(const_it->first);
+	}
+
+	for (std::list<Ipv4Address>::const_iterator const_it = lst_srcs.begin();
+			const_it != lst_srcs.end();
+			const_it++)
+	{
+		this->UpdateMergedSrc(*const_it);
+	}
+}
+
 /********************************************************
  *        IGMPv3InterfaceState
  ********************************************************/
@@ -391,7 +615,8 @@ IGMPv3InterfaceState::IGMPv3InterfaceState (void)
 	 m_multicast_address ("0. 0. 0. 0"),
 	 m_flag_secure_group (false),
 	 m_filter_mode (ns3::INCLUDE),
-	 m_old_if_state (0)
+	 m_old_if_state (0),
+	 m_flag_pending_listed (false)
 {
 	//this->m_old_if_state = IGMPv3InterfaceState::GetNonExistentState(this->m_interface, this->m_multicast_address);
 }
@@ -411,6 +636,7 @@ IGMPv3InterfaceState::~IGMPv3InterfaceState (void)
 	this->m_manager = 0;
 	this->m_lst_source_list.clear();
 	this->m_lst_associated_socket_state.clear();
+	this->m_merger.Clear();
 	this->m_old_if_state = 0;
 }
 
@@ -487,11 +713,11 @@ IGMPv3InterfaceState::UnSubscribeIGMP (Ptr<IGMPv3SocketState> socket_state)
 		if ((*it) == socket_state)
 		{
 			it = this->m_lst_associated_socket_state.erase(it);
+			this->m_merger.RemoveSocketState(socket_state->GetFilterMode(), socket_state->GetSrcList());
+			this->ComputeState();
 			break;
 		}
 	}
-
-	this->ComputeState();
 }
 
 //bool
@@ -663,59 +889,64 @@ IGMPv3InterfaceState::HasPendingRecords (void) const
 	}
 }
 
+bool
+IGMPv3InterfaceState::IsPendingListed (void) const
+{
+	return this->m_flag_pending_listed;
+}
+
+void
+IGMPv3InterfaceState::SetPendingListed (bool listed)
+{
+	this->m_flag_pending_listed = listed;
+}
+
 bool
 IGMPv3InterfaceState::IsSecureGroup (void) const
 {
 	return this->m_flag_secure_group;
 }
 
-// May trigger sending of reports
 void
-IGMPv3InterfaceState::ComputeState (void)
+IGMPv3InterfaceState::SocketStateChange (Ptr<IGMPv3SocketState> socket_state,
+										 ns3::FILTER_MODE new_filter_mode,
+										 std::list<Ipv4Address> const &new_src_list)
 {
-	//Is the following two lines reset correct?
-	//updated: no, I dont think so. they should be set as the values of fields in first invoked sockt state
-//	this->m_filter_mode = ns3::EXCLUDE;
-//	this->m_lst_source_list.clear();
+	if (false == this->IsSocketStateExist(socket_state))
+	{
+		//should not go here
+		NS_ASSERT (false);
+	}
 
-//	ns3::FILTER_MODE old_filter_mode = this->m_filter_mode;
-//	std::list<Ipv4Address> old_src_list = this->m_lst_source_list;
+	this->m_merger.RemoveSocketState(socket_state->GetFilterMode(), socket_state->GetSrcList());
+	this->m_merger.AddSocketState(new_filter_mode, new_src_list);
+}
 
+// May trigger sending of reports
+void
+IGMPv3InterfaceState::ComputeState (void)
+{
 	this->m_old_if_state = this->SaveOldInterfaceState ();	//saving the old state
 
-	this->m_lst_associated_socket_state.sort();
+	//the merger has already been updated with the socket state that joined, left or changed
+	bool is_filter_mode_changed = this->m_merger.IsFilterModeChanged();
+	bool is_src_lst_changed = this->m_merger.IsSrcLstChanged();
+	this->m_merger.ClearChanges();
 
-	for (std::list<Ptr<IGMPv3SocketState> >::iterator it = this->m_lst_associated_socket_state.begin();
-			it != this->m_lst_associated_socket_state.end();
-			it++)
+	this->m_filter_mode = this->m_merger.GetFilterMode();
+	if (true == is_src_lst_changed)
 	{
-		if (this->m_multicast_address != (*it)->GetGroupAddress())
-		{
-			//should not go here
-			NS_ASSERT (false);
-		}
-
-		bool first_element = true;
-
-		if (true == first_element)
-		{
-			this->m_filter_mode = (*it)->GetFilterMode();
-			this->SetSrcList((*it)->GetSrcList());
-		}
-		else
-		{
-			this->Invoke (*it);
-			first_element = false;
-		}
+		this->m_lst_source_list.clear();
+		this->m_merger.GetSrcList(this->m_lst_source_list);
 	}
 
 	//It is ethier case of change of source list or change or filter mode
-	if (true == this->IsFilterModeChanged())
+	if (true == is_filter_mode_changed)
 	{
 		//todo generate state change records and send
 		this->ReportFilterModeChange();
 	}
-	else if (true == this->IsSrcLstChanged())
+	else if (true == is_src_lst_changed)
 	{
 		//todo generate src list allow and block records and send
 		this->ReportSrcLstChange();
@@ -729,7 +960,7 @@ IGMPv3InterfaceState::ComputeState (void)
 void
 IGMPv3InterfaceState::ReportFilterModeChange (void)
 {
-	std::cout << "Interface state: " << this << " report filter mode change" << std::endl;
+	NS_LOG_LOGIC ("Interface state: " << this << " report filter mode change");
 
 	Ptr<Igmpv3L4Protocol> igmp = this->GetIgmp();
 
@@ -769,6 +1000,7 @@ IGMPv3InterfaceState::ReportFilterModeChange (void)
 		//Take them out while sending reports.
 		this->m_que_pending_filter_mode_chg_records.push(filter_mode_change_record);
 	}
+	this->m_manager->MarkPendingIfState(this);
 
 	/*
 	 * From rfc 3376
@@ -796,7 +1028,7 @@ IGMPv3InterfaceState::ReportFilterModeChange (void)
 void
 IGMPv3InterfaceState::ReportSrcLstChange (void)
 {
-	std::cout << "Interface state: " << this << " report src list change" << std::endl;
+	NS_LOG_LOGIC ("Interface state: " << this << " report src list change");
 
 	Ptr<Igmpv3L4Protocol> igmp = this->GetIgmp();
 
@@ -844,6 +1076,7 @@ IGMPv3InterfaceState::ReportSrcLstChange (void)
 		this->m_que_pending_allow_src_chg_records.push(allow_record);
 		this->m_que_pending_block_src_chg_records.push(block_record);
 	}
+	this->m_manager->MarkPendingIfState(this);
 
 	//this->m_event_retransmission = Simulator::ScheduleNow (&IGMPv3InterfaceState::DoReportSrcLstChange, this);
 	//this->DoReportSrcLstChange();
@@ -1043,109 +1276,6 @@ IGMPv3InterfaceState::GetNonExistentState (Ptr<IGMPv3InterfaceStateManager> mana
 	return if_state;
 }
 
-void
-IGMPv3InterfaceState::Invoke (Ptr<IGMPv3SocketState> socket_state)
-{
-	if (socket_state == 0)
-	{
-		NS_ASSERT (false);
-	}
-
-	Ipv4Address group_address = socket_state->GetGroupAddress();
-	ns3::FILTER_MODE filter_mode = socket_state->GetFilterMode();
-	std::list<Ipv4Address> source_list = socket_state->GetSrcList();
-
-	if (group_address == this->m_multicast_address)
-	{
-		if (filter_mode == ns3::EXCLUDE)
-		{
-			if (this->m_filter_mode == ns3::EXCLUDE)	//invocation EXCLUDE, this EXCLUDE
-			{
-				if (true == source_list.empty())
-				{
-					this->m_lst_source_list.clear();
-				}
-				else
-				{
-					source_list.sort();
-					this->m_lst_source_list.sort();
-					std::list<Ipv4Address> new_src_lst = Igmpv3L4Protocol::ListIntersection(source_list, this->m_lst_source_list);
-					this->m_lst_source_list = new_src_lst;
-				}
-			}
-			else if (this->m_filter_mode == ns3::INCLUDE)	//invocation EXCLUDE, this INCLUDE
-			{
-				//may not reach here
-
-				if (true == source_list.empty())
-				{
-					this->m_lst_source_list.clear();
-					this->m_filter_mode = ns3::EXCLUDE;
-				}
-				else
-				{
-					source_list.sort();
-					this->m_lst_source_list.sort();
-					//incoming source list (EXCLUDE list) - this source list (INCLUDE list)
-					std::list<Ipv4Address> new_src_lst = Igmpv3L4Protocol::ListSubtraction(source_list, this->m_lst_source_list);
-					this->m_lst_source_list = new_src_lst;
-					this->m_filter_mode = ns3::EXCLUDE;
-				}
-			}
-			else
-			{
-				//should not go here.
-				NS_ASSERT(false);
-			}
-		}
-		else if (filter_mode == ns3::INCLUDE)
-		{
-			if (this->m_filter_mode == ns3::INCLUDE)	//invocation INCLUDE, this INCLUDE
-			{
-				//same action for true == source_list.empty() and false == source_list.empty()
-				source_list.sort();
-				this->m_lst_source_list.sort();
-				std::list<Ipv4Address> new_src_lst = Igmpv3L4Protocol::ListUnion(source_list, this->m_lst_source_list);
-				this->m_lst_source_list = new_src_lst;
-			}
-			else if (this->m_filter_mode == ns3::EXCLUDE)	//invocation INCLUDE, this EXCLUDE
-			{
-				//obsoleted, socket states that have filter mode EXCLUDE should and will always be invoked before ones have mode INCLUDE
-				NS_ASSERT (false);
-
-//				source_list.sort();
-//				this->m_lst_source_list.sort();
-//				//this source list (EXCLUDE list) - incoming source list (INCLUDE list)
-//				std::list<Ipv4Address> new_src_lst = Igmpv3L4Protocol::ListSubtraction(source_list, this->m_lst_source_list);
-//				this->m_lst_source_list = new_src_lst;
-
-				//					//check whether all subscribed sockets are of INCLUDE mode
-				//					if (this->CheckSubscribedAllSocketsIncludeMode())
-				//					{
-				//						//if true, change filter mode of this interface to INCLUDE
-				//						this->m_filter_mode = ns3::INCLUDE;
-				//					}
-			}
-			else	//filter_mode != INCLUDE and filter_mode != EXCLUDE
-			{
-				//should not go here.
-				NS_ASSERT(false);
-			}
-		}
-		else	//filter_mode != INCLUDE and filter_mode != EXCLUDE
-		{
-			//should not go here
-			NS_ASSERT(false);
-		}
-	}
-	else
-	{
-		//should not go here
-		//group_address != this->m_multicast_address
-		NS_ASSERT (false);
-	}
-}
-
 void
 IGMPv3InterfaceState::AssociateSocketStateInterfaceState (Ptr<IGMPv3SocketState> socket_state)
 {
@@ -1171,6 +1301,7 @@ IGMPv3InterfaceState::AssociateSocketStateInterfaceState (Ptr<IGMPv3SocketState>
 		}
 
 		this->m_lst_associated_socket_state.push_back(socket_state);
+		this->m_merger.AddSocketState(socket_state->GetFilterMode(), socket_state->GetSrcList());
 		return;
 	}
 }
@@ -1335,17 +1466,22 @@ IGMPv3MaintenanceSrcRecord::Initialize (Ptr<IGMPv3MaintenanceState> group_state,
 void
 IGMPv3MaintenanceSrcRecord::TimerExpire (void)
 {
-	if (this->m_group_state->GetFilterMode() == ns3::INCLUDE) {
-		this->m_group_state->DeleteSrcRecord(this->GetMulticastAddress());
+	//deleting the record can free this, only locals are used after it
+	Ptr<IGMPv3MaintenanceState> group_state = this->m_group_state;
+
+	if (group_state->GetFilterMode() == ns3::INCLUDE) {
+		group_state->DeleteSrcRecord(this->GetMulticastAddress());
 	}
-	else if(this->m_group_state->GetFilterMode() == ns3::EXCLUDE)
+	else if(group_state->GetFilterMode() == ns3::EXCLUDE)
 	{
-		//do nothing
+		//do nothing, the source is now blocked
 	}
 	else
 	{
 		NS_ASSERT (false);
 	}
+
+	group_state->UpdateForwardingState();
 }
 
 void
@@ -1859,6 +1995,49 @@ IGMPv3MaintenanceState::HandleGrpRecord (const Igmpv3GrpRecord &record)
 	{
 		NS_ASSERT (false);
 	}
+
+	this->UpdateForwardingState();
+}
+
+void
+IGMPv3MaintenanceState::UpdateForwardingState (void)
+{
+	Ptr<Ipv4InterfaceMulticast> interface = this->m_manager->GetInterface();
+	Ptr<Ipv4Multicast> ipv4 = interface->GetDevice()->GetNode()->GetObject<Ipv4Multicast> ();
+	Ptr<Ipv4L3ProtocolMulticast> ipv4l3 = DynamicCast<Ipv4L3ProtocolMulticast>(ipv4);
+	int32_t if_index = ipv4l3->GetInterfaceForDevice(interface->GetDevice());
+
+	if (if_index < 0)
+	{
+		NS_ASSERT (false);
+	}
+
+	std::list<Ipv4Address> src_lst;
+
+	if (this->GetFilterMode() == ns3::INCLUDE)
+	{
+		//rfc 3376, 6.3, INCLUDE (A): forward traffic from sources in A
+		this->GetCurrentSrcLst(src_lst);
+		if (true == src_lst.empty())
+		{
+			//no interested receivers left
+			ipv4l3->RemoveMembershipForwardingState(if_index, this->m_multicast_address);
+		}
+		else
+		{
+			ipv4l3->SetMembershipForwardingState(if_index, this->m_multicast_address, ns3::INCLUDE, src_lst);
+		}
+	}
+	else if (this->GetFilterMode() == ns3::EXCLUDE)
+	{
+		//rfc 3376, 6.3, EXCLUDE (X,Y): forward traffic from all sources except those in Y
+		this->GetCurrentSrcLstTimerEqualToZero(src_lst);
+		ipv4l3->SetMembershipForwardingState(if_index, this->m_multicast_address, ns3::EXCLUDE, src_lst);
+	}
+	else
+	{
+		NS_ASSERT (false);
+	}
 }
 
 void
@@ -2034,6 +2213,7 @@ IGMPv3MaintenanceState::TimerExpire (void)
 	{
 		this->DeleteExpiredSrcRecords();
 		this->SetFilterMode(ns3::INCLUDE);
+		this->UpdateForwardingState();
 	}
 }
 
@@ -2248,6 +2428,7 @@ IGMPv3InterfaceStateManager::~IGMPv3InterfaceStateManager()
 	this->m_event_robustness_retransmission.Cancel();
 	this->m_timer_gen_query.Cancel();
 	this->m_lst_interfacestates.clear();
+	this->m_lst_pending_interfacestates.clear();
 	this->m_lst_per_group_interface_timers.clear();
 	this->m_lst_maintenance_states.clear();
 }
@@ -2314,18 +2495,8 @@ bool
 IGMPv3InterfaceStateManager::HasPendingRecords (void) const
 {
 	NS_LOG_FUNCTION (this);
-	for (std::list<Ptr<IGMPv3InterfaceState> >::const_iterator const_it = this->m_lst_interfacestates.begin();
-		 const_it != this->m_lst_interfacestates.end();
-		 const_it++)
-	{
-		Ptr<IGMPv3InterfaceState> interfacestate = (*const_it);
-		if (true == interfacestate->HasPendingRecords())
-		{
-			return true;
-		}
-	}
-
-	return false;
+	//states leave the pending list as soon as their last pending records are taken out
+	return (false == this->m_lst_pending_interfacestates.empty());
 }
 
 bool
@@ -2357,6 +2528,22 @@ IGMPv3InterfaceStateManager::RemoveIfState (Ptr<IGMPv3InterfaceState> if_state)
 {
 	NS_LOG_FUNCTION (this);
 	this->m_lst_interfacestates.remove(if_state);
+	if (true == if_state->IsPendingListed())
+	{
+		this->m_lst_pending_interfacestates.remove(if_state);
+		if_state->SetPendingListed(false);
+	}
+}
+
+void
+IGMPv3InterfaceStateManager::MarkPendingIfState (Ptr<IGMPv3InterfaceState> if_state)
+{
+	NS_LOG_FUNCTION (this);
+	if (false == if_state->IsPendingListed())
+	{
+		this->m_lst_pending_interfacestates.push_back(if_state);
+		if_state->SetPendingListed(true);
+	}
 }
 
 Ptr<IGMPv3MaintenanceState>
@@ -2389,13 +2576,24 @@ IGMPv3InterfaceStateManager::UnSubscribeIGMP (Ptr<Socket> socket)
 void
 IGMPv3InterfaceStateManager::AddPendingRecordsToReport (Igmpv3Report &report)
 {
-	for (std::list<Ptr<IGMPv3InterfaceState> >::iterator it = this->m_lst_interfacestates.begin();
-		 it != this->m_lst_interfacestates.end();
-		 it++)
+	//only visiting states with pending records instead of all interface states
+	std::list<Ptr<IGMPv3InterfaceState> >::iterator it = this->m_lst_pending_interfacestates.begin();
+	while (it != this->m_lst_pending_interfacestates.end())
 	{
-		if (false == (*it)->IsSecureGroup())
+		Ptr<IGMPv3InterfaceState> if_state = (*it);
+		if (false == if_state->IsSecureGroup())
+		{
+			if_state->AddPendingRecordsToReport(report);
+		}
+
+		if (false == if_state->HasPendingRecords())
+		{
+			if_state->SetPendingListed(false);
+			it = this->m_lst_pending_interfacestates.erase(it);
+		}
+		else
 		{
-			(*it)->AddPendingRecordsToReport(report);
+			it++;
 		}
 	}
 }
@@ -2403,13 +2601,21 @@ IGMPv3InterfaceStateManager::AddPendingRecordsToReport (Igmpv3Report &report)
 void
 IGMPv3InterfaceStateManager::AddPendingRecordsToReport (Igmpv3Report &report, Ipv4Address secure_group_address)
 {
-	for (std::list<Ptr<IGMPv3InterfaceState> >::iterator it = this->m_lst_interfacestates.begin();
-		 it != this->m_lst_interfacestates.end();
+	for (std::list<Ptr<IGMPv3InterfaceState> >::iterator it = this->m_lst_pending_interfacestates.begin();
+		 it != this->m_lst_pending_interfacestates.end();
 		 it++)
 	{
-		if ((*it)->GetGroupAddress() == secure_group_address)
+		Ptr<IGMPv3InterfaceState> if_state = (*it);
+		if (if_state->GetGroupAddress() == secure_group_address)
 		{
-			(*it)->AddPendingRecordsToReport(report);
+			if_state->AddPendingRecordsToReport(report);
+			if (false == if_state->HasPendingRecords())
+			{
+				if_state->SetPendingListed(false);
+				this->m_lst_pending_interfacestates.erase(it);
+			}
+			//only one state for a group on each interface;
+			break;
 		}
 	}
 }
@@ -2417,7 +2623,7 @@ IGMPv3InterfaceStateManager::AddPendingRecordsToReport (Igmpv3Report &report, Ip
 void
 IGMPv3InterfaceStateManager::ReportStateChanges (void)
 {
-	std::cout << "Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " report state changes" << Simulator::Now().GetSeconds() << "seconds" << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " report state changes" << Simulator::Now().GetSeconds() << "seconds");
 
 	Ptr<Ipv4Multicast> ipv4 = this->m_interface->GetDevice()->GetNode()->GetObject<Ipv4Multicast> ();
 	Ptr<Ipv4L3ProtocolMulticast> ipv4l3 = DynamicCast<Ipv4L3ProtocolMulticast>(ipv4);
@@ -2442,7 +2648,7 @@ IGMPv3InterfaceStateManager::ReportStateChanges (void)
 void
 IGMPv3InterfaceStateManager::ReportStateChanges (Ipv4Address secure_group_address)
 {
-	std::cout << "Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " report state changes, secure group address: " << secure_group_address << ", " << Simulator::Now().GetSeconds() << "seconds" << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " report state changes, secure group address: " << secure_group_address << ", " << Simulator::Now().GetSeconds() << "seconds");
 
 	Ptr<Ipv4Multicast> ipv4 = this->m_interface->GetDevice()->GetNode()->GetObject<Ipv4Multicast> ();
 	Ptr<Ipv4L3ProtocolMulticast> ipv4l3 = DynamicCast<Ipv4L3ProtocolMulticast>(ipv4);
@@ -2457,6 +2663,10 @@ IGMPv3InterfaceStateManager::ReportStateChanges (Ipv4Address secure_group_addres
 	{
 		gsam->GetGsamFilter()->DoGsam(this->GetInterface(), secure_group_address);
 	}
+	else if (true == gsam->GetGsamFilter()->IsUndoingGsam(this->GetInterface(), secure_group_address))
+	{
+		//listening again before the last leave is through, gsam joins over after it, see GsamL4Protocol::FinishGroupLeave
+	}
 	else
 	{
 		if (true == this->m_event_robustness_retransmission.IsRunning())
@@ -2479,7 +2689,7 @@ IGMPv3InterfaceStateManager::ReportStateChanges (Ipv4Address secure_group_addres
 void
 IGMPv3InterfaceStateManager::DoReportStateChanges (void)
 {
-	std::cout << "Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " do report state changes " << Simulator::Now().GetSeconds() << "seconds" << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " do report state changes " << Simulator::Now().GetSeconds() << "seconds");
 
 	Ptr<Ipv4Multicast> ipv4 = this->m_interface->GetDevice()->GetNode()->GetObject<Ipv4Multicast> ();
 	Ptr<Ipv4L3ProtocolMulticast> ipv4l3 = DynamicCast<Ipv4L3ProtocolMulticast>(ipv4);
@@ -2498,12 +2708,18 @@ IGMPv3InterfaceStateManager::DoReportStateChanges (void)
 void
 IGMPv3InterfaceStateManager::DoSecureReportStateChanges (Ipv4Address group_address)
 {
-	std::cout << "Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " do secure report state changes, group address: " << group_address << ", " << Simulator::Now().GetSeconds() << "seconds" << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " do secure report state changes, group address: " << group_address << ", " << Simulator::Now().GetSeconds() << "seconds");
 
 	Ptr<Ipv4Multicast> ipv4 = this->m_interface->GetDevice()->GetNode()->GetObject<Ipv4Multicast> ();
 	Ptr<Ipv4L3ProtocolMulticast> ipv4l3 = DynamicCast<Ipv4L3ProtocolMulticast>(ipv4);
 	Ptr<Igmpv3L4Protocol> igmp = ipv4l3->GetIgmp();
 
+	if (true == igmp->GetGsam()->GetGsamFilter()->IsUndoingGsam(this->GetInterface(), group_address))
+	{
+		//the records wait for gsam to join the group again
+		return;
+	}
+
 	igmp->SendSecureStateChangesReport(this, group_address);
 
 	if (true == this->HasPendingRecords())
@@ -2514,12 +2730,42 @@ IGMPv3InterfaceStateManager::DoSecureReportStateChanges (Ipv4Address group_addre
 	}
 }
 
+void
+IGMPv3InterfaceStateManager::CheckSecureGroupLeave (Ipv4Address secure_group_address)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<IGMPv3InterfaceState> if_state = this->GetIfState(this->m_interface, secure_group_address);
+
+	if (0 == if_state)
+	{
+		return;
+	}
+
+	if ((ns3::INCLUDE != if_state->GetFilterMode()) || (false == if_state->GetSrcList().empty()))
+	{
+		//still a member
+		return;
+	}
+
+	if (true == if_state->HasPendingRecords())
+	{
+		//the leave is retransmitted a few more times under the group's sas
+		return;
+	}
+
+	this->RemoveIfState(if_state);
+
+	Ptr<Igmpv3L4Protocol> igmp = Igmpv3L4Protocol::GetIgmp(this->m_interface->GetDevice()->GetNode());
+	igmp->GetGsam()->GetGsamFilter()->UndoGsam(this->m_interface, secure_group_address);
+}
+
 void
 IGMPv3InterfaceStateManager::ReportCurrentStates (void)
 {
 	NS_LOG_FUNCTION (this);
 
-	std::cout << "Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " report current state " << Simulator::Now().GetSeconds() << "seconds" << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " Interface: " << this << " report current state " << Simulator::Now().GetSeconds() << "seconds");
 
 	Ptr<Ipv4Multicast> ipv4 = this->m_interface->GetDevice()->GetNode()->GetObject<Ipv4Multicast> ();
 	Ptr<Ipv4L3ProtocolMulticast> ipv4l3 = DynamicCast<Ipv4L3ProtocolMulticast>(ipv4);
@@ -2556,7 +2802,7 @@ IGMPv3InterfaceStateManager::ReportCurrentStates (void)
 
 	packet->AddHeader(igmpv3);
 
-	std::cout << "Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " reporting a general query to the querier" << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " reporting a general query to the querier");
 
 	igmp->SendReport(this->GetInterface(), packet);
 }
@@ -2607,7 +2853,7 @@ IGMPv3InterfaceStateManager::ReportCurrentGrpStates (Ipv4Address group_address)
 
 	packet->AddHeader(igmpv3);
 
-	std::cout << "Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " reporting a general query to the querier" << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " reporting a general query to the querier");
 
 	igmp->SendReport(this->GetInterface(), packet);
 
@@ -2665,7 +2911,7 @@ IGMPv3InterfaceStateManager::ReportCurrentGrpNSrcStates (Ipv4Address group_addre
 
 	packet->AddHeader(igmpv3);
 
-	std::cout << "Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " reporting a general query to the querier" << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_interface->GetDevice()->GetNode()->GetId() << " reporting a general query to the querier");
 
 	igmp->SendReport(this->GetInterface(), packet);
 
@@ -2710,10 +2956,10 @@ IGMPv3InterfaceStateManager::HandleGeneralQuery (Time resp_time)
 {
 	if (false == this->m_timer_gen_query.IsRunning())
 	{
-		std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << "'s has no per-interface-timer" << std::endl;
-		std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << " creating a new timer for handling incoming General Query" << std::endl;
+		NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << "'s has no per-interface-timer");
+		NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << " creating a new timer for handling incoming General Query");
 		this->m_timer_gen_query.SetFunction(&IGMPv3InterfaceStateManager::ReportCurrentStates, this);
-		std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << " scheduling report, delay time: " << resp_time.GetSeconds() << " seconds" << std::endl;
+		NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << " scheduling report, delay time: " << resp_time.GetSeconds() << " seconds");
 		this->m_timer_gen_query.Schedule(resp_time);
 	}
 	else
@@ -2722,10 +2968,10 @@ IGMPv3InterfaceStateManager::HandleGeneralQuery (Time resp_time)
 		{
 			this->m_timer_gen_query.Cancel();
 
-			std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << "'s has a per-interface-timer, but delay time is smaller than resp time" << std::endl;
-			std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << " creating a new timer for handling incoming General Query" << std::endl;
+			NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << "'s has a per-interface-timer, but delay time is smaller than resp time");
+			NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << " creating a new timer for handling incoming General Query");
 			this->m_timer_gen_query.SetFunction(&IGMPv3InterfaceStateManager::ReportCurrentStates, this);
-			std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << " scheduling report, delay time: " << resp_time.GetSeconds() << " seconds" << std::endl;
+			NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId()  << " scheduling report, delay time: " << resp_time.GetSeconds() << " seconds");
 			this->m_timer_gen_query.Schedule(resp_time);
 		}
 		else
@@ -2738,14 +2984,9 @@ IGMPv3InterfaceStateManager::HandleGeneralQuery (Time resp_time)
 void
 IGMPv3InterfaceStateManager::HandleGroupSpecificQuery (Time resp_time, Ipv4Address group_address)
 {
-	if (true == GsamConfig::GetSingleton()->IsGroupAddressSecureGroup(group_address))
-	{
-		std::cout << "If State Manager: " << this << " handling a secure group query" << std::endl;
-	}
-	else
-	{
-		std::cout << "If State Manager: " << this << " handling a non-secure group query" << std::endl;
-	}
+	NS_LOG_LOGIC ("If State Manager: " << this << " handling a "
+	              << (GsamConfig::GetSingleton()->IsGroupAddressSecureGroup(group_address) ? "secure" : "non-secure")
+	              << " group query");
 
 	for (std::list<Ptr<IGMPv3InterfaceState> >::iterator ifstate_it = this->m_lst_interfacestates.begin();
 			ifstate_it != this->m_lst_interfacestates.end();
@@ -2780,27 +3021,27 @@ IGMPv3InterfaceStateManager::DoHandleGroupSpecificQuery (Time resp_time, Ipv4Add
 				delay = timer->m_softTimer.GetDelayLeft();
 			}
 
-			std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " there is a timer exist for group specific query with delaytime left smaller current resp time." << std::endl;
-			std::cout << "Interface: " << this << ", Group Address: " << group_address << std::endl;
-			std::cout << "Canceling previous report." << std::endl;
+			NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " there is a timer exist for group specific query with delaytime left smaller current resp time.");
+			NS_LOG_LOGIC ("Interface: " << this << ", Group Address: " << group_address);
+			NS_LOG_LOGIC ("Canceling previous report.");
 			timer->m_softTimer.Cancel();
 
 			timer->m_softTimer.SetFunction(&IGMPv3InterfaceStateManager::ReportCurrentGrpStates, this);
 			timer->m_softTimer.SetArguments(group_address);
-			std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " scheduling new report, delay time: " << resp_time.GetSeconds() << " seconds" << std::endl;
+			NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " scheduling new report, delay time: " << resp_time.GetSeconds() << " seconds");
 			timer->m_softTimer.Schedule(delay);
 			return;
 		}
 	}
 
-	std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " creating a new timer for handling incoming Group Specific Query" << std::endl;
-	std::cout << "Interface: " << this << ", Group Address: " << group_address << std::endl;
+	NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " creating a new timer for handling incoming Group Specific Query");
+	NS_LOG_LOGIC ("Interface: " << this << ", Group Address: " << group_address);
 	Ptr<PerGroupInterfaceTimer> new_timer = Create<PerGroupInterfaceTimer>();
 	new_timer->m_interface = this->GetInterface();
 	new_timer->m_group_address = group_address;
 	new_timer->m_softTimer.SetFunction(&IGMPv3InterfaceStateManager::ReportCurrentGrpStates, this);
 	new_timer->m_softTimer.SetArguments(group_address);
-	std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " scheduling report, delay time: " << resp_time.GetSeconds() << " seconds" << std::endl;
+	NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " scheduling report, delay time: " << resp_time.GetSeconds() << " seconds");
 	new_timer->m_softTimer.Schedule(resp_time);
 	this->m_lst_per_group_interface_timers.push_back(new_timer);
 }
@@ -2841,27 +3082,27 @@ IGMPv3InterfaceStateManager::DoHandleGroupNSrcSpecificQuery (Time resp_time, Ipv
 				delay = timer->m_softTimer.GetDelayLeft();
 			}
 
-			std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " there is a timer exist for group specific query with delaytime left smaller current resp time." << std::endl;
-			std::cout << "Interface: " << this << ", Group Address: " << group_address << std::endl;
-			std::cout << "Canceling previous report." << std::endl;
+			NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " there is a timer exist for group specific query with delaytime left smaller current resp time.");
+			NS_LOG_LOGIC ("Interface: " << this << ", Group Address: " << group_address);
+			NS_LOG_LOGIC ("Canceling previous report.");
 			timer->m_softTimer.Cancel();
 
 			timer->m_softTimer.SetFunction(&IGMPv3InterfaceStateManager::ReportCurrentGrpNSrcStates, this);
 			timer->m_softTimer.SetArguments(group_address, src_list);
-			std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " scheduling new report, delay time: " << resp_time.GetSeconds() << " seconds" << std::endl;
+			NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " scheduling new report, delay time: " << resp_time.GetSeconds() << " seconds");
 			timer->m_softTimer.Schedule(delay);
 			return;
 		}
 	}
 
-	std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " creating a new timer for handling incoming Group Specific Query" << std::endl;
-	std::cout << "Interface: " << this << ", Group Address: " << group_address << std::endl;
+	NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " creating a new timer for handling incoming Group Specific Query");
+	NS_LOG_LOGIC ("Interface: " << this << ", Group Address: " << group_address);
 	Ptr<PerGroupInterfaceTimer> new_timer = Create<PerGroupInterfaceTimer>();
 	new_timer->m_interface = this->GetInterface();
 	new_timer->m_group_address = group_address;
 	new_timer->m_softTimer.SetFunction(&IGMPv3InterfaceStateManager::ReportCurrentGrpNSrcStates, this);
 	new_timer->m_softTimer.SetArguments(group_address, src_list);
-	std::cout << "Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " scheduling report, delay time: " << resp_time.GetSeconds() << " seconds" << std::endl;
+	NS_LOG_LOGIC ("Node id: " << this->m_interface->GetDevice()->GetNode()->GetId() << " scheduling report, delay time: " << resp_time.GetSeconds() << " seconds");
 	new_timer->m_softTimer.Schedule(resp_time);
 	this->m_lst_per_group_interface_timers.push_back(new_timer);
 }
@@ -2881,14 +3122,9 @@ IGMPv3InterfaceStateManager::HandleV3Records (const std::list<Igmpv3GrpRecord> &
 		{
 			Ptr<IGMPv3MaintenanceState> maintenance_state = (*state_it);
 
-			if (true == GsamConfig::GetSingleton()->IsGroupAddressSecureGroup(record.GetMulticastAddress()))
-			{
-				std::cout << "If State Manager: " << this << " handling a secure group record" << std::endl;
-			}
-			else
-			{
-				std::cout << "If State Manager: " << this << " handling a non-secure group record" << std::endl;
-			}
+			NS_LOG_LOGIC ("If State Manager: " << this << " handling a "
+			              << (GsamConfig::GetSingleton()->IsGroupAddressSecureGroup(record.GetMulticastAddress()) ? "secure" : "non-secure")
+			              << " group record");
 
 			if (record.GetMulticastAddress() == maintenance_state->GetMulticastAddress())
 			{
@@ -3084,6 +3320,13 @@ Igmpv3Manager::GetSocketStateManager (Ptr<Socket> key)
 	return retval;
 }
 
+void
+Igmpv3Manager::RemoveSocketStateManager (Ptr<Socket> key)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_map_socketstate_managers.erase(key);
+}
+
 Ptr<IGMPv3InterfaceStateManager>
 Igmpv3Manager::GetIfStateManager (Ptr<Ipv4InterfaceMulticast> key)
 {
@@ -34,6 +34,7 @@
 #include <list>
 #include <queue>
 #include <map>
+#include <set>
 
 namespace ns3 {
 
@@ -125,6 +126,48 @@ private:
 	std::list<Ptr<IGMPv3SocketState> > m_lst_socket_states;
 };
 
+/*
+ * \breif Merges the socket states of one group on one interface (rfc 3376, 3.2).
+ * Keeps per-source include/exclude reference counts, so that a socket join, leave
+ * or change only touches the sources carried by that socket state instead of
+ * re-walking every socket state associated with the interface state.
+ */
+class IGMPv3SourceFilterMerger {
+public:
+	IGMPv3SourceFilterMerger (void);
+	~IGMPv3SourceFilterMerger (void);
+	void AddSocketState (ns3::FILTER_MODE filter_mode, std::list<Ipv4Address> const &src_list);
+	void RemoveSocketState (ns3::FILTER_MODE filter_mode, std::list<Ipv4Address> const &src_list);
+	ns3::FILTER_MODE GetFilterMode (void) const;
+	/*
+	 * \breif Merged source list, sorted.
+	 */
+	void GetSrcList (std::list<Ipv4Address> &retval) const;
+	/*
+	 * \breif Comparing to the merged state at the last ClearChanges ()
+	 */
+	bool IsFilterModeChanged (void) const;
+	bool IsSrcLstChanged (void) const;
+	void ClearChanges (void);
+	void Clear (void);
+private:
+	struct SrcRefCount {
+		uint32_t m_include;	//number of INCLUDE socket states listing the source
+		uint32_t m_exclude;	//number of EXCLUDE socket states listing the source
+	};
+	void UpdateRefCounts (ns3::FILTER_MODE filter_mode, std::list<Ipv4Address> const &src_list, bool add);
+	void UpdateMergedSrc (Ipv4Address src);
+	void UpdateAllMergedSrcs (void);
+	bool IsMergedSrc (SrcRefCount const &count) const;
+private:
+	std::map<Ipv4Address, SrcRefCount> m_map_src_refcounts;
+	std::set<Ipv4Address> m_set_merged_srcs;
+	uint32_t m_num_include_states;
+	uint32_t m_num_exclude_states;
+	ns3::FILTER_MODE m_last_filter_mode;
+	bool m_flag_src_lst_changed;
+};
+
 class IGMPv3InterfaceState : public Object {
 private:
 	Ptr<IGMPv3InterfaceStateManager> m_manager;
@@ -134,6 +177,8 @@ private:
 	std::list<Ipv4Address> m_lst_source_list;
 	//std::list<Ptr<Socket> > m_lst_sockets;
 	std::list<Ptr<IGMPv3SocketState> > m_lst_associated_socket_state;
+	//incremental merge of the filter modes and source lists of associated socket states
+	IGMPv3SourceFilterMerger m_merger;
 
 	//for generating records
 	Ptr<IGMPv3InterfaceState> m_old_if_state;
@@ -145,6 +190,8 @@ private:
 	std::queue<Igmpv3GrpRecord> m_que_pending_allow_src_chg_records;
 	//Pending filter mode changes records
 	std::queue<Igmpv3GrpRecord> m_que_pending_filter_mode_chg_records;
+	//Whether this state is linked in the manager's list of states with pending records
+	bool m_flag_pending_listed;
 //	*obsolete*/for check whether the a new state change occur during old state report is still being scheduled.
 //	EventId m_event_robustness_retransmission;
 
@@ -192,6 +239,12 @@ public:
 	 */
 	bool HasPendingRecords (void) const;
 
+	/*
+	 * \breif Used by the manager for keeping its list of states with pending records
+	 */
+	bool IsPendingListed (void) const;
+	void SetPendingListed (bool listed);
+
 	/*
 	 * \breif flag, secure group
 	 */
@@ -206,6 +259,14 @@ public:
 	 */
 	Igmpv3GrpRecord GenerateRecord (ns3::FILTER_MODE old_filter_mode, std::list<Ipv4Address> const &old_src_list);
 
+	/*
+	 * \brief A socket state associated with this interface state is going to change its filter mode and source list.
+	 * \brief Only the sources of that socket state are merged again.
+	 */
+	void SocketStateChange (Ptr<IGMPv3SocketState> socket_state,
+							ns3::FILTER_MODE new_filter_mode,
+							std::list<Ipv4Address> const &new_src_list);
+
 	/*
 	 * \brief Compute interface state from socket states it associated with.
 	 * \brief And also save old state
@@ -232,7 +293,6 @@ public:
 
 	void AssociateSocketStateInterfaceState (Ptr<IGMPv3SocketState> socket_state);
 private:
-	void Invoke (Ptr<IGMPv3SocketState> socket_state);
 	bool IsSocketStateExist (Ptr<IGMPv3SocketState> socket_state) const;
 	bool CheckSubscribedAllSocketsIncludeMode (void);
 	Ptr<IGMPv3InterfaceState> SaveOldInterfaceState (void);
@@ -288,6 +348,10 @@ public:
 	void HandleQuery (void);
 	void HandleQuery (std::list<Ipv4Address> const &src_lst);
 	void DeleteSrcRecord (Ipv4Address src);
+	/*
+	 * \breif Install or prune the membership forwarding state of this group in Ipv4L3ProtocolMulticast
+	 */
+	void UpdateForwardingState (void);
 public:	//utilies
 	void StopEverything (void);
 private:
@@ -369,6 +433,11 @@ public:	//self-defined
 	Ptr<IGMPv3InterfaceState> CreateIfState (Ipv4Address multicast_address, bool is_secure_group = false);
 	void PushBackIfState (Ptr<IGMPv3InterfaceState> if_state);
 	void RemoveIfState (Ptr<IGMPv3InterfaceState> if_state);
+	/*
+	 * \breif Link an interface state which has just queued records into the pending list,
+	 * so that assembling reports only visits groups with pending records.
+	 */
+	void MarkPendingIfState (Ptr<IGMPv3InterfaceState> if_state);
 	Ptr<IGMPv3MaintenanceState> CreateMaintenanceState (Ipv4Address group_address, Time delay);
 	void Sort (void);
 	void UnSubscribeIGMP (Ptr<Socket> socket);
@@ -378,6 +447,8 @@ public:	//self-defined
 	void ReportStateChanges (Ipv4Address secure_group_address);
 	void DoReportStateChanges (void);
 	void DoSecureReportStateChanges (Ipv4Address group_address);
+	//once the last report of a leave is sent, the group's gsam session goes
+	void CheckSecureGroupLeave (Ipv4Address secure_group_address);
 	void ReportCurrentStates (void);
 	void ReportCurrentGrpStates (Ipv4Address group_address);
 	void ReportCurrentGrpNSrcStates (Ipv4Address group_address, std::list<Ipv4Address> const &src_list);
@@ -397,6 +468,8 @@ public:	//self-defined
 private:
 	Ptr<Ipv4InterfaceMulticast> m_interface;
 	std::list<Ptr<IGMPv3InterfaceState> > m_lst_interfacestates;
+	//Interface states which still have pending records to be retransmitted
+	std::list<Ptr<IGMPv3InterfaceState> > m_lst_pending_interfacestates;
 	//Robustness retransmission
 	EventId m_event_robustness_retransmission;
 
@@ -431,6 +504,7 @@ private:
 	virtual void DoDispose (void);
 public:	//self-defined const
 	Ptr<IGMPv3SocketStateManager> GetSocketStateManager (Ptr<Socket> key);
+	void RemoveSocketStateManager (Ptr<Socket> key);
 	Ptr<IGMPv3InterfaceStateManager> GetIfStateManager (Ptr<Ipv4InterfaceMulticast> key);
 public:	//non-const
 	void StopEverything (void);
@@ -294,7 +294,9 @@ GsamConfig::GetTypeId (void)
 }
 
 GsamConfig::GsamConfig ()
-  :  m_q_unicast_address (Ipv4Address("0.0.0.0"))
+  :  m_q_unicast_address (Ipv4Address("0.0.0.0")),
+	 m_num_rekey_messages (0),
+	 m_num_rekey_payloads (0)
 {
 	NS_LOG_FUNCTION (this);
 	srand(time(NULL));
@@ -309,6 +311,8 @@ GsamConfig::~GsamConfig()
 	this->m_set_used_unsec_grp_addresses.clear();
 	this->m_map_node_id_group_address_to_time_join_finish.clear();
 	this->m_map_node_id_group_address_to_time_join_sec_delay.clear();
+	this->m_map_node_id_group_address_to_time_rekey_start.clear();
+	this->m_lst_rekey_windows.clear();
 }
 
 TypeId
@@ -342,6 +346,20 @@ GsamConfig::GetIgmpv3DestGrpReportAddress (void)
 	return Ipv4Address ("224.0.0.22");
 }
 
+Ipv4Address
+GsamConfig::GetNqControlGroupAddress (void)
+{
+	//link local, so it reaches the nqs on the querier's links and goes no further
+	return Ipv4Address ("224.0.0.250");
+}
+
+uint32_t
+GsamConfig::GetLeasedSpiRangeStart (void)
+{
+	//spis picked by rand() stay below, so leases never overlap a node's own spis
+	return 0x80000000;
+}
+
 uint16_t
 GsamConfig::GetSpiRejectPropability (void) const
 {
@@ -433,13 +451,13 @@ GsamConfig::Log (	const std::string& func_name,
 					uint32_t gsa_r_spi)
 {
 	const std::string split = ", ";
-	std::cout << func_name << split;
-	std::cout << "Node Id: " << node_id << split;
-	std::cout << "Session: " << session << split;
-	std::cout << "Peer Node Id: " << GsamConfig::GetSingleton()->m_map_u32_ipv4addr_to_node_id.find(session->GetPeerAddress().Get())->second << std::endl;
-	std::cout << "Gsa Push Id: " << gsa_push_id << split;
-	std::cout << "Gsa Q's Spi: " << gsa_q_spi << split;
-	std::cout << "Gsa R's Spi: " << gsa_r_spi << std::endl;
+	NS_LOG_INFO (func_name << split
+	             << "Node Id: " << node_id << split
+	             << "Session: " << session << split
+	             << "Peer Node Id: " << GsamConfig::GetSingleton()->m_map_u32_ipv4addr_to_node_id.find(session->GetPeerAddress().Get())->second << split
+	             << "Gsa Push Id: " << gsa_push_id << split
+	             << "Gsa Q's Spi: " << gsa_q_spi << split
+	             << "Gsa R's Spi: " << gsa_r_spi);
 }
 
 void
@@ -450,17 +468,17 @@ GsamConfig::Log (	const std::string& func_name,
 					Ptr<Packet> packet)
 {
 	const std::string split = ", ";
-	std::cout << func_name << split;
-	std::cout << "Node Id: " << node_id << split;
-	std::cout << "Session: " << session << split;
-	std::cout << "Peer Node Id: " << GsamConfig::GetSingleton()->m_map_u32_ipv4addr_to_node_id.find(session->GetPeerAddress().Get())->second << std::endl;
+	NS_LOG_INFO (func_name << split
+	             << "Node Id: " << node_id << split
+	             << "Session: " << session << split
+	             << "Peer Node Id: " << GsamConfig::GetSingleton()->m_map_u32_ipv4addr_to_node_id.find(session->GetPeerAddress().Get())->second);
 	if (0 != packet)
 	{
-		std::cout << "Sending Packet: " << packet << std::endl;
+		NS_LOG_LOGIC ("Sending Packet: " << packet);
 	}
 	if (true == retransmit)
 	{
-		std::cout << "Same packet is scheduled for retransmission" << std::endl;
+		NS_LOG_LOGIC ("Same packet is scheduled for retransmission");
 	}
 }
 
@@ -479,31 +497,29 @@ GsamConfig::Log (	const std::string& func_name,
 					uint32_t gsa_push_id)
 {
 	const std::string split = ", ";
-	std::cout << func_name << split;
-	std::cout << "Node Id: " << node_id << split;
-	std::cout << "Gsa Push Id: " << gsa_push_id << std::endl;;
+	NS_LOG_INFO (func_name << split
+	             << "Node Id: " << node_id << split
+	             << "Gsa Push Id: " << gsa_push_id);
 }
 
 void
 GsamConfig::LogGsaQ (const std::string& msg, uint32_t gsa_q_spi)
 {
 	const std::string split = ", ";
-	std::cout << msg << split;
-	std::cout << "Gsa Q's Spi: " << gsa_q_spi <<std::endl;
+	NS_LOG_LOGIC (msg << split << "Gsa Q's Spi: " << gsa_q_spi);
 }
 
 void
 GsamConfig::LogGsaR (const std::string& msg, uint32_t gsa_r_spi)
 {
 	const std::string split = ", ";
-	std::cout << msg << split;
-	std::cout << "Gsa R's Spi: " << gsa_r_spi <<std::endl;
+	NS_LOG_LOGIC (msg << split << "Gsa R's Spi: " << gsa_r_spi);
 }
 
 void
 GsamConfig::LogMsg (const std::string& msg)
 {
-	std::cout << msg << std::endl;
+	NS_LOG_LOGIC (msg);
 }
 
 void
@@ -633,6 +649,18 @@ GsamConfig::GetAUsedSecGrpAddress (void) const
 	return Ipv4Address(*const_it);
 }
 
+void
+GsamConfig::GetUsedSecGrpAddresses (std::list<Ipv4Address>& retval) const
+{
+	NS_LOG_FUNCTION (this);
+	for (	std::set<uint32_t>::const_iterator const_it = this->m_set_used_sec_grp_addresses.begin();
+			const_it != this->m_set_used_sec_grp_addresses.end();
+			const_it++)
+	{
+		retval.push_back(Ipv4Address(*const_it));
+	}
+}
+
 Ipv4Address
 GsamConfig::GetAUsedUnsecGrpAddress (void) const
 {
@@ -1219,8 +1247,7 @@ GsamConfig::GetNodeIdByAddress (Ipv4Address node_interface_address) const
 	}
 	else
 	{
-		std::cout << "No node exists has address: " << node_interface_address << std::endl;
-		NS_ASSERT (false);
+		NS_ASSERT_MSG (false, "No node exists has address: " << node_interface_address);
 	}
 	return retval;
 }
@@ -1367,6 +1394,267 @@ GsamConfig::IsInstallBeforeNqAck (void) const
 	return retval;
 }
 
+Time
+GsamConfig::GetSpiRekeyGraceTimeInSeconds (void) const
+{
+	NS_LOG_FUNCTION (this);
+	std::map<std::string, std::string>::const_iterator const_it = this->m_map_settings.find("spi-rekey-grace-second");
+	if (const_it != this->m_map_settings.end())
+	{
+		double seconds_double = 0;
+		std::string value_text = const_it->second;
+		if (std::stringstream(value_text) >> seconds_double)
+		{
+			//ok
+		}
+		else
+		{
+			NS_ASSERT (false);
+		}
+		return Seconds(seconds_double);
+	}
+	else
+	{
+		//long enough for a re-push to reach the gm with all its retransmissions
+		return Seconds (this->GetDefaultRetransmitTimeoutInSeconds().GetSeconds() * (this->GetNumberOfRetransmission() + 1));
+	}
+}
+
+uint32_t
+GsamConfig::GetSpiLeaseSize (void) const
+{
+	NS_LOG_FUNCTION (this);
+	uint32_t retval = 0;
+	std::map<std::string, std::string>::const_iterator const_it = this->m_map_settings.find("spi-lease-size");
+	if (const_it != this->m_map_settings.end())
+	{
+		std::string value_text = const_it->second;
+		if (std::stringstream(value_text) >> retval)
+		{
+			//a lease is sent as its first and last spi, which must differ
+			NS_ASSERT (retval != 1);
+		}
+		else
+		{
+			NS_ASSERT (false);
+		}
+	}
+	else
+	{
+		//do nothing
+		//retval = 0, no spi leasing
+	}
+	return retval;
+}
+
+bool
+GsamConfig::IsMulticastNqPush (void) const
+{
+	NS_LOG_FUNCTION (this);
+	bool retval = false;
+	std::map<std::string, std::string>::const_iterator const_it = this->m_map_settings.find("multicast-nq-push");
+	if (const_it != this->m_map_settings.end())
+	{
+		std::string value_text = const_it->second;
+		if ("true" == value_text)
+		{
+			retval = true;
+		}
+		else if ("false" == value_text)
+		{
+			retval = false;
+		}
+		else
+		{
+			NS_ASSERT (false);
+		}
+	}
+	else
+	{
+		//do nothing
+		//retval = false, one unicast push per nq
+	}
+	return retval;
+}
+
+double
+GsamConfig::GetNumericSetting (const std::string& setting_name, double default_value) const
+{
+	NS_LOG_FUNCTION (this);
+	double retval = default_value;
+	std::map<std::string, std::string>::const_iterator const_it = this->m_map_settings.find(setting_name);
+	if (const_it != this->m_map_settings.end())
+	{
+		std::string value_text = const_it->second;
+		if (std::stringstream(value_text) >> retval)
+		{
+			NS_ASSERT (retval >= 0);
+		}
+		else
+		{
+			NS_ASSERT (false);
+		}
+	}
+	else
+	{
+		//do nothing
+		//retval = default_value
+	}
+	return retval;
+}
+
+Time
+GsamConfig::GetSaSoftLifetimeInSeconds (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return Seconds (this->GetNumericSetting("sa-soft-lifetime-second", 0));
+}
+
+Time
+GsamConfig::GetSaHardLifetimeInSeconds (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return Seconds (this->GetNumericSetting("sa-hard-lifetime-second", 0));
+}
+
+uint64_t
+GsamConfig::GetSaSoftLifetimeInBytes (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return (uint64_t)this->GetNumericSetting("sa-soft-lifetime-byte", 0);
+}
+
+uint64_t
+GsamConfig::GetSaHardLifetimeInBytes (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return (uint64_t)this->GetNumericSetting("sa-hard-lifetime-byte", 0);
+}
+
+uint16_t
+GsamConfig::GetSaLifetimeJitterPercentage (void) const
+{
+	NS_LOG_FUNCTION (this);
+	double retval = this->GetNumericSetting("sa-lifetime-jitter-percentage", 10);
+	NS_ASSERT (retval < 100);
+	return (uint16_t)retval;
+}
+
+bool
+GsamConfig::IsSaSoftLifetimeSet (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return ((false == this->GetSaSoftLifetimeInSeconds().IsZero()) ||
+			(0 != this->GetSaSoftLifetimeInBytes()));
+}
+
+Time
+GsamConfig::GetRekeyCheckIntervalInSeconds (void) const
+{
+	NS_LOG_FUNCTION (this);
+	double retval = this->GetNumericSetting("rekey-check-interval-second", 1);
+	NS_ASSERT (retval > 0);
+	return Seconds (retval);
+}
+
+uint16_t
+GsamConfig::GetRekeyMaxGroupsPerRound (void) const
+{
+	NS_LOG_FUNCTION (this);
+	//0, no cap on the groups rekeyed in one check
+	return (uint16_t)this->GetNumericSetting("rekey-max-groups-per-round", 0);
+}
+
+bool
+GsamConfig::IsIkeCookieRequired (uint32_t number_of_half_open_sessions) const
+{
+	NS_LOG_FUNCTION (this);
+	//not set, cookies are never asked for
+	//0, every ike_sa_init has to bring a cookie
+	if (this->m_map_settings.end() == this->m_map_settings.find("ike-cookie-half-open-threshold"))
+	{
+		return false;
+	}
+	uint32_t threshold = (uint32_t)this->GetNumericSetting("ike-cookie-half-open-threshold", 0);
+	return (number_of_half_open_sessions >= threshold);
+}
+
+uint32_t
+GsamConfig::GetMaxHalfOpenInitSessions (void) const
+{
+	NS_LOG_FUNCTION (this);
+	//0, no cap on the half-open init sessions
+	return (uint32_t)this->GetNumericSetting("ike-max-half-open", 0);
+}
+
+bool
+GsamConfig::IsHalfOpenReapingEnabled (void) const
+{
+	NS_LOG_FUNCTION (this);
+	//only with admission on are the half-open sessions counted against a limit
+	return ((this->m_map_settings.end() != this->m_map_settings.find("ike-cookie-half-open-threshold")) ||
+			(0 != this->GetMaxHalfOpenInitSessions()));
+}
+
+bool
+GsamConfig::IsIkeKeyExchangeX25519 (void) const
+{
+	NS_LOG_FUNCTION (this);
+	bool retval = false;
+	std::map<std::string, std::string>::const_iterator const_it = this->m_map_settings.find("ike-key-exchange");
+	if (const_it != this->m_map_settings.end())
+	{
+		std::string value_text = const_it->second;
+		if ("x25519" == value_text)
+		{
+			retval = true;
+		}
+		else if ("dummy" == value_text)
+		{
+			retval = false;
+		}
+		else
+		{
+			NS_ASSERT (false);
+		}
+	}
+	else
+	{
+		//do nothing
+		//dummy key exchange, no keying material
+	}
+	return retval;
+}
+
+Time
+GsamConfig::GetCryptoCost (uint32_t number_of_dh, uint32_t number_of_prf) const
+{
+	NS_LOG_FUNCTION (this);
+	//not set, crypto takes no simulated time
+	//a dh is one side's modular exponentiation or scalar multiplication, a prf is one hmac
+	//the dh cost also stands for modp groups, whatever the key exchange actually computed
+	double dh_cost = this->GetNumericSetting("crypto-dh-cost-microsecond", 0);
+	double prf_cost = this->GetNumericSetting("crypto-prf-cost-microsecond", 0);
+	return Seconds (((number_of_dh * dh_cost) + (number_of_prf * prf_cost)) / 1000000);
+}
+
+uint16_t
+GsamConfig::GetNumberOfCryptoWorkers (void) const
+{
+	NS_LOG_FUNCTION (this);
+	double retval = this->GetNumericSetting("crypto-workers", 1);
+	NS_ASSERT (retval >= 1);
+	return (uint16_t)retval;
+}
+
+uint32_t
+GsamConfig::GetCryptoQueueLimit (void) const
+{
+	NS_LOG_FUNCTION (this);
+	//0, no cap on the jobs waiting for a crypto worker
+	return (uint32_t)this->GetNumericSetting("crypto-queue-limit", 0);
+}
+
 void
 GsamConfig::SetupIgmpAndGsam (const Ipv4InterfaceContainerMulticast& interfaces, uint16_t num_nqs)
 {
@@ -1387,14 +1675,13 @@ GsamConfig::SetupIgmpAndGsam (const Ipv4InterfaceContainerMulticast& interfaces,
 
 		uint32_t n_addr = ipv4->GetNAddresses(ifindex);
 		uint32_t node_id = ipv4->GetNetDevice(ifindex)->GetNode()->GetId();
-		std::cout << "Printing address of interface: " << ifindex << " of Node" << node_id << std::endl;
+		NS_LOG_INFO ("Printing address of interface: " << ifindex << " of Node" << node_id);
 		for (	uint32_t n_addr_it = 0;
 				n_addr_it < n_addr;
 				n_addr_it++)
 		{
 			Ipv4Address if_ipv4_addr = ipv4->GetAddress(ifindex, n_addr_it).GetLocal();
-			if_ipv4_addr.Print(std::cout);
-			std::cout << std::endl;
+			NS_LOG_INFO (if_ipv4_addr);
 
 			static uint8_t count = 0;
 			if (0 == count)
@@ -1416,7 +1703,6 @@ GsamConfig::SetupIgmpAndGsam (const Ipv4InterfaceContainerMulticast& interfaces,
 			this->m_map_u32_ipv4addr_to_node_id.insert(std::pair<uint32_t, uint32_t>(if_ipv4_addr.Get(), node_id));
 			count++;
 		}
-		std::cout << std::endl;
 
 	}
 }
@@ -1799,6 +2085,79 @@ GsamConfig::PlotSecGroupDelayInRange (Time max)
 	plotFile.close ();
 }
 
+void
+GsamConfig::PlotSecGroupDelayHistogram (Time bin_width)
+{
+	if (bin_width <= Seconds (0.0))
+	{
+		NS_ASSERT (false);
+	}
+
+	std::string mode = (true == this->IsInstallBeforeNqAck()) ? "optimistic" : "pessimistic";
+
+	//number of joins per delay bin, bin i holds delays in [i * bin_width, (i + 1) * bin_width)
+	std::vector<uint32_t> vector_bins;
+	for (std::map<std::pair<uint32_t, uint32_t>, Time>::const_iterator const_it = this->m_map_node_id_group_address_to_time_join_sec_delay.begin();
+			const_it != this->m_map_node_id_group_address_to_time_join_sec_delay.end();
+			const_it++)
+	{
+		uint32_t bin = static_cast<uint32_t> (const_it->second.GetSeconds() / bin_width.GetSeconds());
+		if (bin >= vector_bins.size())
+		{
+			vector_bins.resize(bin + 1, 0);
+		}
+		vector_bins[bin]++;
+	}
+
+	Gnuplot2dDataset dataset;
+	dataset.SetStyle (Gnuplot2dDataset::HISTEPS);
+
+	std::ofstream result_doc(GsamConfig::m_path_result.c_str(), std::ios::app);
+	if (result_doc.is_open())
+	{
+		result_doc << " sec group - join delay histogram (" << mode << ", bin " << bin_width.GetSeconds() << " seconds):" << std::endl;
+	}
+	else
+	{
+		std::cout << "Unable to open result file" << std::endl;
+	}
+
+	for (uint32_t bin = 0; bin < vector_bins.size(); bin++)
+	{
+		dataset.Add (bin * bin_width.GetSeconds(), vector_bins[bin]);
+		if (result_doc.is_open())
+		{
+			result_doc << "  [" << bin * bin_width.GetSeconds() << ", " << (bin + 1) * bin_width.GetSeconds() << "): " << vector_bins[bin] << std::endl;
+		}
+	}
+
+	if (result_doc.is_open())
+	{
+		result_doc.close();
+	}
+
+	std::stringstream ss_number_joins;
+	ss_number_joins << this->m_map_node_id_group_address_to_time_join_sec_delay.size();
+	dataset.SetTitle (ss_number_joins.str() + " joins, " + mode);
+
+	//plotting, one file per mode so the two can be drawn side by side
+	std::string fileNameWithNoExtension = "sec group join delay histogram " + mode;
+	std::string graphicsFileName        = fileNameWithNoExtension + ".svg";
+	std::string plotFileName            = fileNameWithNoExtension + ".plt";
+	std::string plotTitle               = "sec group join delay histogram, " + mode + " sa install";
+
+	Gnuplot plot (graphicsFileName);
+	plot.SetTitle (plotTitle);
+	plot.SetTerminal ("svg");
+	plot.SetLegend ("Join Delay in Seconds", "Number of Joins");
+	plot.AppendExtra ("set term svg mouse jsdir \"http://gnuplot.sourceforge.net/demo_svg/\"");
+	plot.AddDataset (dataset);
+
+	std::ofstream plotFile (plotFileName.c_str());
+	plot.GenerateOutput (plotFile);
+	plotFile.close ();
+}
+
 void
 GsamConfig::PlotNonsecGroupDelay (void)
 {
@@ -2051,6 +2410,95 @@ GsamConfig::LogALlJoinAverageAndWorstDelay (uint16_t percentage_rejection)
 	this->LogSecGroupJoinAverageAndWorstDelay();
 }
 
+void
+GsamConfig::LogRekeyStart (uint32_t node_id, Ipv4Address group_address)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_map_node_id_group_address_to_time_rekey_start[std::pair<uint32_t, uint32_t>(node_id, group_address.Get())] = Simulator::Now();
+	std::ofstream result_doc(GsamConfig::m_path_result.c_str(), std::ios::app);
+	if (result_doc.is_open())
+	{
+		result_doc << "Node: " << node_id << " rekey group {start} address: " << group_address << " Time: " << Simulator::Now().GetSeconds() << " seconds." << std::endl;
+		result_doc.close();
+	}
+	else
+	{
+		std::cout << "Unable to open result file" << std::endl;
+	}
+}
+
+void
+GsamConfig::LogRekeyFinish (uint32_t node_id, Ipv4Address group_address)
+{
+	NS_LOG_FUNCTION (this);
+	std::map<std::pair<uint32_t, uint32_t>, Time>::iterator it = this->m_map_node_id_group_address_to_time_rekey_start.find(std::pair<uint32_t, uint32_t>(node_id, group_address.Get()));
+	if (this->m_map_node_id_group_address_to_time_rekey_start.end() == it)
+	{
+		NS_ASSERT (false);
+		return;
+	}
+	//pushes to the group are held back from the start till the finish of its rekey
+	Time rekey_window = Simulator::Now() - it->second;
+	this->m_map_node_id_group_address_to_time_rekey_start.erase(it);
+	this->m_lst_rekey_windows.push_back(rekey_window);
+	std::ofstream result_doc(GsamConfig::m_path_result.c_str(), std::ios::app);
+	if (result_doc.is_open())
+	{
+		result_doc << "Node: " << node_id << " rekey group {finish} address: " << group_address << " Time: " << Simulator::Now().GetSeconds() << " seconds.";
+		result_doc << " rekey window: " << rekey_window.GetSeconds() << " seconds." << std::endl;
+		result_doc.close();
+	}
+	else
+	{
+		std::cout << "Unable to open result file" << std::endl;
+	}
+}
+
+void
+GsamConfig::LogRekeyMessagesSent (uint32_t number_of_messages, uint32_t number_of_payloads)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_num_rekey_messages += number_of_messages;
+	this->m_num_rekey_payloads += number_of_payloads;
+}
+
+void
+GsamConfig::LogRekeyStatistics (void)
+{
+	NS_LOG_FUNCTION (this);
+	Time total_window = Seconds (0.0);
+	Time worst_window = Seconds (0.0);
+	for (	std::list<Time>::const_iterator const_it = this->m_lst_rekey_windows.begin();
+			const_it != this->m_lst_rekey_windows.end();
+			const_it++)
+	{
+		total_window += (*const_it);
+		if (worst_window < (*const_it))
+		{
+			worst_window = (*const_it);
+		}
+	}
+
+	std::ofstream result_doc(GsamConfig::m_path_result.c_str(), std::ios::app);
+	if (result_doc.is_open())
+	{
+		result_doc << " rekey - groups rekeyed: " << this->m_lst_rekey_windows.size();
+		result_doc << ", unfinished: " << this->m_map_node_id_group_address_to_time_rekey_start.size() << std::endl;
+		result_doc << " rekey - messages sent: " << this->m_num_rekey_messages << ", payloads sent: " << this->m_num_rekey_payloads;
+		result_doc << ", message rate: " << (this->m_num_rekey_messages / this->GetSimulationTimeInSeconds().GetSeconds()) << " per second." << std::endl;
+		if (false == this->m_lst_rekey_windows.empty())
+		{
+			result_doc << " rekey - average window: " << (total_window.GetSeconds() / this->m_lst_rekey_windows.size()) << " seconds,";
+			result_doc << " worst window: " << worst_window.GetSeconds() << " seconds." << std::endl;
+		}
+		result_doc.close();
+	}
+	else
+	{
+		std::cout << "Unable to open result file" << std::endl;
+	}
+}
+
 /********************************************************
  *        GsamInfo
  ********************************************************/
@@ -2071,7 +2519,8 @@ GsamInfo::GetTypeId (void)
 GsamInfo::GsamInfo ()
   :  m_retransmission_delay (Seconds(0.0)),
 	 m_sec_group_start ("0.0.0.0"),
-	 m_sec_group_end ("0.0.0.0")
+	 m_sec_group_end ("0.0.0.0"),
+	 m_spi_lease_cursor (0)
 {
 	NS_LOG_FUNCTION (this);
 }
@@ -2083,6 +2532,7 @@ GsamInfo::~GsamInfo()
 	this->m_set_occupied_ipsec_spis.clear();
 	this->m_set_occupied_gsa_push_ids.clear();
 	this->m_set_deleted_gsa_push_id.clear();
+	this->m_lst_spi_leases.clear();
 }
 
 TypeId
@@ -2114,7 +2564,8 @@ GsamInfo::GetLocalAvailableIpsecSpi (void) const
 	do {
 		spi = rand();
 	} while (	(0 != spi) &&
-				(this->m_set_occupied_ipsec_spis.find(spi) != this->m_set_occupied_ipsec_spis.end()));
+				((this->m_set_occupied_ipsec_spis.find(spi) != this->m_set_occupied_ipsec_spis.end()) ||
+				(true == this->IsIpsecSpiLeased(spi))));
 
 	return spi;
 }
@@ -2133,7 +2584,8 @@ GsamInfo::GetLocalAvailableIpsecSpi (const std::set<uint32_t>& external_occupied
 	do {
 		spi = rand();
 	} while (	(0 != spi) &&
-			(set_u32_merged.find(spi) != set_u32_merged.end()));
+			((set_u32_merged.find(spi) != set_u32_merged.end()) ||
+			(true == this->IsIpsecSpiLeased(spi))));
 
 	return spi;
 }
@@ -2147,7 +2599,8 @@ GsamInfo::GetLocalAvailableGsaPushId (void) const
 
 	do {
 		spi = rand();
-	} while (	(0 != spi) &&
+		//push id 0 marks the re-pushes of a group rekey
+	} while (	(0 == spi) ||
 				(this->m_set_occupied_gsa_push_ids.find(spi) != this->m_set_occupied_gsa_push_ids.end()));
 
 	return spi;
@@ -2340,6 +2793,129 @@ GsamInfo::IsGsaPushIdDeleted (uint32_t gsa_push_id) const
 	return retval;
 }
 
+bool
+GsamInfo::IsIpsecSpiLeased (uint32_t spi) const
+{
+	NS_LOG_FUNCTION (this);
+	bool retval = false;
+	for (	std::list<std::pair<uint32_t, uint32_t> >::const_iterator const_it = this->m_lst_spi_leases.begin();
+			const_it != this->m_lst_spi_leases.end();
+			const_it++)
+	{
+		if ((const_it->first <= spi) && (spi <= const_it->second))
+		{
+			retval = true;
+			break;
+		}
+	}
+	return retval;
+}
+
+const std::list<std::pair<uint32_t, uint32_t> >&
+GsamInfo::GetIpsecSpiLeases (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_lst_spi_leases;
+}
+
+uint32_t
+GsamInfo::GetNumberOfOccupiedGsamSpis (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_set_occupied_gsam_spis.size();
+}
+
+uint32_t
+GsamInfo::GetNumberOfOccupiedIpsecSpis (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_set_occupied_ipsec_spis.size();
+}
+
+uint32_t
+GsamInfo::GetNumberOfOccupiedGsaPushIds (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_set_occupied_gsa_push_ids.size();
+}
+
+uint32_t
+GsamInfo::GetIpsecSpiToPropose (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (0 == GsamConfig::GetSingleton()->GetSpiLeaseSize())
+	{
+		return this->GetLocalAvailableIpsecSpi();
+	}
+
+	if (true == this->m_lst_spi_leases.empty())
+	{
+		this->LeaseIpsecSpiRange();
+	}
+
+	uint32_t retval = 0;
+	do {
+		const std::pair<uint32_t, uint32_t>& lease = this->m_lst_spi_leases.back();
+		if ((this->m_spi_lease_cursor < lease.first) || (this->m_spi_lease_cursor > lease.second))
+		{
+			//the last lease is used up, the cursor may have wrapped around
+			this->LeaseIpsecSpiRange();
+			continue;
+		}
+		retval = this->m_spi_lease_cursor;
+		this->m_spi_lease_cursor++;
+	} while ((0 == retval) || (true == this->IsIpsecSpiOccupied(retval)));
+
+	return retval;
+}
+
+void
+GsamInfo::LeaseIpsecSpiRange (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	uint32_t lease_size = GsamConfig::GetSingleton()->GetSpiLeaseSize();
+	if (0 == lease_size)
+	{
+		NS_ASSERT (false);
+	}
+
+	uint32_t first_spi = GsamConfig::GetLeasedSpiRangeStart();
+	if (false == this->m_lst_spi_leases.empty())
+	{
+		first_spi = this->m_lst_spi_leases.back().second + 1;
+	}
+
+	NS_ASSERT_MSG ((first_spi >= GsamConfig::GetLeasedSpiRangeStart()) && ((0xffffffff - first_spi) >= (lease_size - 1)),
+			"GsamInfo::LeaseIpsecSpiRange (): spi space for leases is used up");
+
+	uint32_t last_spi = first_spi + (lease_size - 1);
+	NS_LOG_LOGIC ("Leasing spis " << first_spi << " to " << last_spi);
+	this->m_lst_spi_leases.push_back(std::pair<uint32_t, uint32_t>(first_spi, last_spi));
+	this->m_spi_lease_cursor = first_spi;
+}
+
+void
+GsamInfo::ReserveIpsecSpiRange (uint32_t first_spi, uint32_t last_spi)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (first_spi > last_spi)
+	{
+		NS_ASSERT (false);
+	}
+
+	std::pair<uint32_t, uint32_t> lease (first_spi, last_spi);
+	if (this->m_lst_spi_leases.end() != std::find(this->m_lst_spi_leases.begin(), this->m_lst_spi_leases.end(), lease))
+	{
+		//already reserved, e.g. a retransmitted message
+		return;
+	}
+	NS_LOG_LOGIC ("Reserving spis " << first_spi << " to " << last_spi << " for the q");
+	this->m_lst_spi_leases.push_back(lease);
+}
+
 void
 GsamInfo::SetSecGrpStart (Ipv4Address address)
 {
@@ -2385,8 +2961,6 @@ GsamSa::~GsamSa()
 {
 	NS_LOG_FUNCTION (this);
 
-	this->FreeLocalSpi();
-
 	this->m_ptr_init_session = 0;
 	this->m_ptr_encrypt_fn = 0;
 }
@@ -2408,6 +2982,19 @@ void
 GsamSa::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
+
+	//the owning session disposes its sa before it lets go of the database
+	if (0 != this->m_ptr_init_session)
+	{
+		this->FreeLocalSpi();
+	}
+
+	this->m_ptr_init_session = 0;
+	this->m_ptr_encrypt_fn = 0;
+	this->m_vec_dh_private_key.clear();
+	this->m_vec_initiator_nonce.clear();
+	this->m_vec_responder_nonce.clear();
+	this->m_vec_key_material.clear();
 }
 
 bool
@@ -2445,7 +3032,7 @@ GsamSa::SetSession (Ptr<GsamInitSession> session)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_init_session = session;
+	this->m_ptr_init_session = PeekPointer(session);
 }
 
 void
@@ -2503,6 +3090,62 @@ GsamSa::IsHalfOpen (void) const
 	return retval;
 }
 
+void
+GsamSa::SetDhPrivateKey (const std::vector<uint8_t>& private_key)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_vec_dh_private_key = private_key;
+}
+
+void
+GsamSa::SetInitiatorNonce (const std::vector<uint8_t>& nonce)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_vec_initiator_nonce = nonce;
+}
+
+void
+GsamSa::SetResponderNonce (const std::vector<uint8_t>& nonce)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_vec_responder_nonce = nonce;
+}
+
+void
+GsamSa::SetKeyMaterial (const std::vector<uint8_t>& key_material)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_vec_key_material = key_material;
+}
+
+const std::vector<uint8_t>&
+GsamSa::GetDhPrivateKey (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_vec_dh_private_key;
+}
+
+const std::vector<uint8_t>&
+GsamSa::GetInitiatorNonce (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_vec_initiator_nonce;
+}
+
+const std::vector<uint8_t>&
+GsamSa::GetResponderNonce (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_vec_responder_nonce;
+}
+
+const std::vector<uint8_t>&
+GsamSa::GetKeyMaterial (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_vec_key_material;
+}
+
 void
 GsamSa::FreeLocalSpi (void)
 {
@@ -2606,6 +3249,7 @@ GsaPushSession::GsaPushSession ()
 	 m_ptr_database (0),
 	 m_ptr_gm_session (0),
 	 m_flag_gm_session_acked_notified (false),
+	 m_flag_gsa_pair_installed (false),
 	 m_ptr_gsa_q_to_install (0),
 	 m_gsa_q_spi_before_revision (0),
 	 m_ptr_gsa_r_to_install (0),
@@ -2618,9 +3262,8 @@ GsaPushSession::~GsaPushSession()
 {
 	NS_LOG_FUNCTION (this);
 
-	std::cout << "GsaPushSession::~GsaPushSession(), id: " << this->m_id << std::endl;
+	NS_LOG_LOGIC ("GsaPushSession::~GsaPushSession(), id: " << this->m_id);
 
-	this->m_ptr_database->GetInfo()->FreeGsaPushId(this->m_id);
 	this->m_ptr_gm_session = 0;
 
 	this->m_ptr_gsa_q_to_install = 0;
@@ -2629,9 +3272,6 @@ GsaPushSession::~GsaPushSession()
 	this->m_set_aggregated_gsa_q_spi_notification.clear();
 	this->m_set_aggregated_gsa_r_spi_notification.clear();
 	this->m_lst_nq_rejected_spis_subs.clear();
-
-	this->ClearNqSessions();
-	this->ClearOtherGmSessions();
 }
 
 TypeId
@@ -2641,6 +3281,18 @@ GsaPushSession::GetInstanceTypeId (void) const
 	return GsaPushSession::GetTypeId();
 }
 
+void*
+GsaPushSession::operator new (std::size_t size)
+{
+	return GsamObjectPool<GsaPushSession>::Allocate(size);
+}
+
+void
+GsaPushSession::operator delete (void* ptr, std::size_t size)
+{
+	GsamObjectPool<GsaPushSession>::Free(ptr, size);
+}
+
 void
 GsaPushSession::NotifyNewAggregate ()
 {
@@ -2651,6 +3303,22 @@ void
 GsaPushSession::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
+
+	if (0 != this->m_ptr_database)
+	{
+		this->m_ptr_database->GetInfo()->FreeGsaPushId(this->m_id);
+	}
+
+	//the sessions were unlinked by SelfRemoval or by the owner, only drop the references
+	this->m_ptr_gm_session = 0;
+	this->m_set_ptr_nq_sessions_sent_unreplied.clear();
+	this->m_set_ptr_nq_sessions_acked_notified.clear();
+	this->m_set_ptr_other_gm_sessions_sent_unreplied.clear();
+	this->m_set_ptr_other_gm_sessions_replied_notified.clear();
+	this->m_ptr_gsa_q_to_install = 0;
+	this->m_ptr_gsa_r_to_install = 0;
+	this->m_lst_nq_rejected_spis_subs.clear();
+	this->m_ptr_database = 0;
 }
 
 bool
@@ -2740,7 +3408,7 @@ GsaPushSession::SetDatabase (Ptr<IpSecDatabase> database)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_database = database;
+	this->m_ptr_database = PeekPointer(database);
 }
 
 void
@@ -2758,7 +3426,7 @@ GsaPushSession::SetGmSession (Ptr<GsamSession> gsam_gm_session)
 		NS_ASSERT (0);
 	}
 
-	this->m_ptr_gm_session = gsam_gm_session;
+	this->m_ptr_gm_session = PeekPointer(gsam_gm_session);
 }
 
 void
@@ -2766,7 +3434,7 @@ GsaPushSession::SelfRemoval (void)
 {
 	NS_LOG_FUNCTION (this);
 
-	std::cout << "GsaPushSession::SelfRemoval(), id: " << this->m_id << std::endl;
+	NS_LOG_LOGIC ("GsaPushSession::SelfRemoval(), id: " << this->m_id);
 
 	if (this->m_ptr_database == 0)
 	{
@@ -2787,13 +3455,39 @@ GsaPushSession::SelfRemoval (void)
 
 	this->ClearOtherGmSessions();
 
-	this->m_ptr_gm_session->ClearGsaPushSession();
+	if (0 != this->m_ptr_gm_session)
+	{
+		//gm_session may be zero in phase of spi request of new incoming nq
+		this->m_ptr_gm_session->ClearGsaPushSession();
+	}
 
 	this->m_ptr_database->RemoveGsaPushSession(this);
 
 	this->m_ptr_database->GetInfo()->InsertDeletedGsaPushId(this->GetId());
 }
 
+void
+GsaPushSession::Abort (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	NS_LOG_LOGIC ("GsaPushSession::Abort(), id: " << this->m_id);
+
+	//the sessions still owing a reply are let go of, late replies find the id deleted
+	this->ClearNqSessions();
+	this->ClearOtherGmSessions();
+
+	//the proposed spis were never occupied, dropping the sas to install hands them back
+	//a pair installed before the nqs acked stays, the gm has it as well
+	this->m_ptr_gsa_q_to_install = 0;
+	this->m_ptr_gsa_r_to_install = 0;
+	this->m_set_aggregated_gsa_q_spi_notification.clear();
+	this->m_set_aggregated_gsa_r_spi_notification.clear();
+	this->m_lst_nq_rejected_spis_subs.clear();
+
+	this->SelfRemoval();
+}
+
 void
 GsaPushSession::MarkGmSessionReplied (void)
 {
@@ -2975,23 +3669,58 @@ GsaPushSession::InstallGsaPair (void)
 	//the new gm session can already have Gsa Q because there is a existing gm session group for that group address
 	if (0 == gsa_q)
 	{
-		std::cout << "Installing Gsa Q: " << this->m_ptr_gsa_q_to_install->GetSpi() << std::endl;
+		NS_LOG_LOGIC ("Installing Gsa Q: " << this->m_ptr_gsa_q_to_install->GetSpi());
 		gsa_q = policy->GetOutboundSAD()->CreateIpSecSAEntry(this->m_ptr_gsa_q_to_install->GetSpi());
 		this->m_ptr_gm_session->AssociateGsaQ(gsa_q);
 	}
 	else
 	{
-		std::cout << "Installing Gsa Q: " << this->m_ptr_gsa_q_to_install->GetSpi() << std::endl;
+		NS_LOG_LOGIC ("Installing Gsa Q: " << this->m_ptr_gsa_q_to_install->GetSpi());
 		gsa_q->SetSpi(this->m_ptr_gsa_q_to_install->GetSpi());
 	}
 
-	//gsa_r must be completely new
-	std::cout << "Installing Gsa R: " << this->m_ptr_gsa_r_to_install->GetSpi() << std::endl;
-	Ptr<IpSecSAEntry> gsa_r = policy->GetInboundSAD()->CreateIpSecSAEntry(this->m_ptr_gsa_r_to_install->GetSpi());
-	this->m_ptr_gm_session->SetRelatedGsaR(gsa_r);
-
 	Ptr<GsamInfo> info = this->m_ptr_database->GetInfo();
-	info->OccupyIpsecSpi(this->m_ptr_gsa_r_to_install->GetSpi());
+	Ptr<IpSecSAEntry> installed_gsa_r = this->m_ptr_gm_session->GetRelatedGsaR();
+
+	if ((true == this->m_flag_gsa_pair_installed) && (0 != installed_gsa_r))
+	{
+		//installed before the nqs acked and an nq rejected gsa_r afterwards, re-key it
+		if (installed_gsa_r->GetSpi() != this->m_ptr_gsa_r_to_install->GetSpi())
+		{
+			NS_LOG_LOGIC ("Re-keying Gsa R: " << installed_gsa_r->GetSpi() << " to " << this->m_ptr_gsa_r_to_install->GetSpi());
+			Ptr<IpSecSAEntry> gsa_r = policy->GetInboundSAD()->CreateIpSecSAEntry(this->m_ptr_gsa_r_to_install->GetSpi());
+			this->m_ptr_gm_session->SetRelatedGsaR(gsa_r);
+			info->OccupyIpsecSpi(this->m_ptr_gsa_r_to_install->GetSpi());
+			//the gm sends with the old spi until the re-push reaches it, keep accepting it meanwhile
+			Simulator::Schedule (GsamConfig::GetSingleton()->GetSpiRekeyGraceTimeInSeconds(),
+								&IpSecSADatabase::RemoveEntry,
+								policy->GetInboundSAD(),
+								installed_gsa_r);
+		}
+	}
+	else
+	{
+		//gsa_r must be completely new
+		NS_LOG_LOGIC ("Installing Gsa R: " << this->m_ptr_gsa_r_to_install->GetSpi());
+		Ptr<IpSecSAEntry> gsa_r = policy->GetInboundSAD()->CreateIpSecSAEntry(this->m_ptr_gsa_r_to_install->GetSpi());
+		this->m_ptr_gm_session->SetRelatedGsaR(gsa_r);
+		info->OccupyIpsecSpi(this->m_ptr_gsa_r_to_install->GetSpi());
+	}
+
+	//keys derived for the pushed pair go with it, there are none unless real keys are configured
+	if (false == this->m_ptr_gsa_q_to_install->GetKeyMaterial().empty())
+	{
+		gsa_q->SetKeyMaterial(this->m_ptr_gsa_q_to_install->GetKeyMaterial());
+	}
+	Ptr<IpSecSAEntry> related_gsa_r = this->m_ptr_gm_session->GetRelatedGsaR();
+	if ((0 != related_gsa_r) &&
+		(related_gsa_r->GetSpi() == this->m_ptr_gsa_r_to_install->GetSpi()) &&
+		(false == this->m_ptr_gsa_r_to_install->GetKeyMaterial().empty()))
+	{
+		related_gsa_r->SetKeyMaterial(this->m_ptr_gsa_r_to_install->GetKeyMaterial());
+	}
+
+	this->m_flag_gsa_pair_installed = true;
 
 //	this->SelfRemoval();
 }
@@ -3104,7 +3833,9 @@ GsaPushSession::GenerateNewSpisAndModifySa (void)
 		{
 			//nq rejected stored but not yet installed gsa_r
 			Ptr<GsamInfo> info = this->m_ptr_database->GetInfo();
-			uint32_t revised_gsa_r_spi = info->GetLocalAvailableIpsecSpi(this->m_set_aggregated_gsa_r_spi_notification);
+			std::set<uint32_t> set_spis_to_avoid = this->m_set_aggregated_gsa_r_spi_notification;
+			this->m_ptr_database->GetInFlightGsaSpis(set_spis_to_avoid);
+			uint32_t revised_gsa_r_spi = info->GetLocalAvailableIpsecSpi(set_spis_to_avoid);
 			this->m_gsa_r_spi_before_revision = this->m_ptr_gsa_r_to_install->GetSpi();
 			this->m_ptr_gsa_r_to_install->SetSpi(revised_gsa_r_spi);
 		}
@@ -3171,6 +3902,8 @@ GsaPushSession::AlterRejectedGsaAndAggregatePacket (Ptr<Packet> retval_packet_fo
 
 		Ptr<GsamInfo> info = this->m_ptr_database->GetInfo();
 		IkePayloadHeader::PAYLOAD_TYPE next_payload_type = IkePayloadHeader::NO_NEXT_PAYLOAD;
+		std::set<uint32_t> set_spis_to_avoid = this->m_set_aggregated_gsa_r_spi_notification;
+		this->m_ptr_database->GetInFlightGsaSpis(set_spis_to_avoid);
 
 		for (	std::list<Ptr<IkeGroupNotifySubstructure> >::const_iterator const_sub_it = this->m_lst_nq_rejected_spis_subs.begin();
 				const_sub_it != this->m_lst_nq_rejected_spis_subs.end();
@@ -3222,7 +3955,7 @@ GsaPushSession::AlterRejectedGsaAndAggregatePacket (Ptr<Packet> retval_packet_fo
 					NS_ASSERT (false);
 				}
 				uint32_t gsa_r_old_spi = gsa_r_to_modify->GetSpi();
-				uint32_t gsa_r_new_spi = info->GetLocalAvailableIpsecSpi(this->m_set_aggregated_gsa_r_spi_notification);
+				uint32_t gsa_r_new_spi = info->GetLocalAvailableIpsecSpi(set_spis_to_avoid);
 				//aggregate new_gsa_payload_sub
 				new_gsa_payload_sub->PushBackProposal(IkeGsaProposal::GenerateGsaProposal(	Create<Spi>(gsa_r_old_spi),
 																							IkeGsaProposal::GSA_R_TO_BE_MODIFIED));
@@ -3350,6 +4083,29 @@ GsaPushSession::GetStatus (void) const
 	return this->m_status;
 }
 
+bool
+GsaPushSession::IsGsaPairInstalled (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_flag_gsa_pair_installed;
+}
+
+bool
+GsaPushSession::IsAwaitingReplyFrom (Ptr<GsamSession> session) const
+{
+	NS_LOG_FUNCTION (this);
+
+	if (PeekPointer(session) == this->m_ptr_gm_session)
+	{
+		//the gm answers the push itself and, on a spi conflict, the spi request
+		return ((false == this->m_flag_gm_session_acked_notified) &&
+				((GsaPushSession::GSA_PUSH_ACK == this->GetStatus()) || (true == this->m_flag_gms_spi_requested)));
+	}
+
+	return ((this->m_set_ptr_nq_sessions_sent_unreplied.find(session) != this->m_set_ptr_nq_sessions_sent_unreplied.end()) ||
+			(this->m_set_ptr_other_gm_sessions_sent_unreplied.find(session) != this->m_set_ptr_other_gm_sessions_sent_unreplied.end()));
+}
+
 bool
 GsaPushSession::IsAllReplied (void) const
 {
@@ -3622,7 +4378,9 @@ GsamInitSession::GsamInitSession ()
 	 m_number_retranmission (0),
 	 m_peer_address (Ipv4Address ("0.0.0.0")),
 	 m_ptr_init_sa (0),
-	 m_ptr_first_join_session (0)
+	 m_ptr_first_join_session (0),
+	 m_flag_crypto_pending (false),
+	 m_flag_half_open (false)
 {
 	NS_LOG_FUNCTION (this);
 
@@ -3633,11 +4391,6 @@ GsamInitSession::~GsamInitSession()
 {
 	NS_LOG_FUNCTION (this);
 
-	if(this->m_ptr_database != 0)
-	{
-		this->m_ptr_database->RemoveInitSession(this);
-	}
-
 	this->m_ptr_database = 0;
 	this->m_ptr_init_sa = 0;
 
@@ -3646,6 +4399,8 @@ GsamInitSession::~GsamInitSession()
 
 	this->m_last_sent_packet = 0;
 	this->m_ptr_first_join_session = 0;
+	this->m_lst_sessions_awaiting_auth.clear();
+	this->m_lst_sessions_in_auth.clear();
 }
 
 TypeId
@@ -3655,24 +4410,47 @@ GsamInitSession::GetInstanceTypeId (void) const
 	return GsamInitSession::GetTypeId();
 }
 
-void
-GsamInitSession::NotifyNewAggregate ()
+void*
+GsamInitSession::operator new (std::size_t size)
 {
-	NS_LOG_FUNCTION (this);
+	return GsamObjectPool<GsamInitSession>::Allocate(size);
 }
 
 void
-GsamInitSession::DoDispose (void)
+GsamInitSession::operator delete (void* ptr, std::size_t size)
+{
+	GsamObjectPool<GsamInitSession>::Free(ptr, size);
+}
+
+void
+GsamInitSession::NotifyNewAggregate ()
 {
 	NS_LOG_FUNCTION (this);
+}
 
-	if (this->m_ptr_database != 0)
+void
+GsamInitSession::DoDispose (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	this->m_timer_retransmit.Cancel();
+	this->m_timer_timeout.Cancel();
+	//a cancelled timer still holds the session it was bound to, rebinding lets go of it
+	this->m_timer_retransmit.SetFunction(&GsamInitSession::TimeoutAction, this);
+
+	//the init sa frees its spi through this session and the database, so it goes first
+	if (0 != this->m_ptr_init_sa)
 	{
-		this->m_ptr_database->RemoveInitSession(this);
+		this->m_ptr_init_sa->Dispose();
+		this->m_ptr_init_sa = 0;
 	}
 
+	this->m_last_sent_packet = 0;
+	this->m_ptr_first_join_session = 0;
+	this->m_lst_sessions_awaiting_auth.clear();
+	this->m_lst_sessions_in_auth.clear();
+	this->LeaveHalfOpen();
 	this->m_ptr_database = 0;
-
 }
 
 GsamInitSession::SESSION_ROLE
@@ -3713,6 +4491,15 @@ GsamInitSession::SetSessionRole (GsamInitSession::SESSION_ROLE role)
 	{
 		NS_ASSERT (false);
 	}
+
+	if (	(GsamInitSession::RESPONDER == role) &&
+			(0 == this->m_current_message_id) &&
+			(0 != this->m_ptr_database))
+	{
+		//answering an ike_sa_init, half-open until the ike_auth arrives
+		this->m_flag_half_open = true;
+		this->m_ptr_database->IncrementHalfOpenInitSessions();
+	}
 }
 
 uint64_t
@@ -3767,7 +4554,7 @@ GsamInitSession::SetDatabase (Ptr<IpSecDatabase> database)
 	}
 	else
 	{
-		this->m_ptr_database = database;
+		this->m_ptr_database = PeekPointer(database);
 	}
 }
 
@@ -3832,6 +4619,12 @@ GsamInitSession::SetMessageId (uint32_t message_id)
 //		}
 //	}
 
+	if (0 != message_id)
+	{
+		//ike_auth arrived, no longer half-open
+		this->LeaveHalfOpen();
+	}
+
 	this->m_current_message_id = message_id;
 }
 
@@ -3961,6 +4754,119 @@ GsamInitSession::SetFirstJoinSession (Ptr<GsamSession> session)
 	this->m_ptr_first_join_session = session;
 }
 
+void
+GsamInitSession::PushBackSessionAwaitingAuth (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+	if (0 == session)
+	{
+		NS_ASSERT (false);
+	}
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = this->m_lst_sessions_awaiting_auth.begin();
+			const_it != this->m_lst_sessions_awaiting_auth.end();
+			const_it++)
+	{
+		if ((*const_it) == session)
+		{
+			//already queued
+			return;
+		}
+	}
+	this->m_lst_sessions_awaiting_auth.push_back(session);
+}
+
+void
+GsamInitSession::StartAuth (std::list<Ptr<GsamSession> >& retval_sessions)
+{
+	NS_LOG_FUNCTION (this);
+	if (false == this->m_lst_sessions_in_auth.empty())
+	{
+		//one ike_auth exchange at a time
+		NS_ASSERT (false);
+	}
+	this->m_lst_sessions_in_auth.swap(this->m_lst_sessions_awaiting_auth);
+	retval_sessions = this->m_lst_sessions_in_auth;
+}
+
+void
+GsamInitSession::FinishAuth (void)
+{
+	NS_LOG_FUNCTION (this);
+	//a session is done once the responder's kek spi is known
+	std::list<Ptr<GsamSession> >::iterator it = this->m_lst_sessions_in_auth.begin();
+	while (it != this->m_lst_sessions_in_auth.end())
+	{
+		if (0 != (*it)->GetKekSaResponderSpi())
+		{
+			it = this->m_lst_sessions_in_auth.erase(it);
+		}
+		else
+		{
+			it++;
+		}
+	}
+}
+
+void
+GsamInitSession::ClearSession (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+	//the session is leaving, this init session stops holding it
+	if (this->m_ptr_first_join_session == session)
+	{
+		this->m_ptr_first_join_session = 0;
+	}
+	this->m_lst_sessions_awaiting_auth.remove(session);
+	this->m_lst_sessions_in_auth.remove(session);
+}
+
+bool
+GsamInitSession::HaveSessionsAwaitingAuth (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return (false == this->m_lst_sessions_awaiting_auth.empty());
+}
+
+bool
+GsamInitSession::IsAuthInFlight (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return (false == this->m_lst_sessions_in_auth.empty());
+}
+
+void
+GsamInitSession::SetCryptoPending (bool crypto_pending)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_flag_crypto_pending = crypto_pending;
+}
+
+bool
+GsamInitSession::IsCryptoPending (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_flag_crypto_pending;
+}
+
+bool
+GsamInitSession::HaveInitSa (void) const
+{
+	NS_LOG_FUNCTION (this);
+	//0 again once the session is reaped or disposed
+	return (this->m_ptr_init_sa != 0);
+}
+
+Ptr<GsamSa>
+GsamInitSession::GetInitSa (void) const
+{
+	NS_LOG_FUNCTION (this);
+	if (0 == this->m_ptr_init_sa)
+	{
+		NS_ASSERT (false);
+	}
+	return this->m_ptr_init_sa;
+}
+
 
 
 Ptr<GsamInfo>
@@ -4072,25 +4978,61 @@ GsamInitSession::TimeoutAction (void)
 {
 	NS_LOG_FUNCTION (this);
 
-	std::cout << "Node: " << this->GetDatabase()->GetGsam()->GetNode()->GetId() << ", ";
-	if (true == this->IsHostGroupMember())
+	NS_ASSERT ((true == this->IsHostGroupMember()) || (true == this->IsHostNonQuerier()) || (true == this->IsHostQuerier()));
+	NS_LOG_INFO ("Node: " << this->GetDatabase()->GetGsam()->GetNode()->GetId() << ", "
+	             << ((true == this->IsHostGroupMember()) ? "GM, " : ((true == this->IsHostNonQuerier()) ? "NQ, " : "Q, "))
+	             << "GsamInitSession: " << this << " time out.");
+
+	if (	(GsamInitSession::RESPONDER == this->m_session_role) &&
+			(0 == this->m_current_message_id) &&
+			(true == GsamConfig::GetSingleton()->IsHalfOpenReapingEnabled()))
 	{
-		std::cout << "GM, ";
+		//half-open, the peer never followed up with an ike_auth
+		//removed after the timer returns, the database may hold the last reference
+		Simulator::ScheduleNow(&GsamInitSession::ReapHalfOpen, Ptr<GsamInitSession>(this));
 	}
-	else if (true == this->IsHostNonQuerier())
+}
+
+void
+GsamInitSession::ReapHalfOpen (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (0 != this->m_current_message_id)
 	{
-		std::cout << "NQ, ";
+		//ike_auth arrived in the meantime
+		return;
 	}
-	else if (true == this->IsHostQuerier())
+
+	this->m_timer_retransmit.Cancel();
+	this->m_timer_timeout.Cancel();
+	this->m_last_sent_packet = 0;
+	//the init sa frees the responder spi and points back to this session
+	this->m_ptr_init_sa = 0;
+
+	this->LeaveHalfOpen();
+
+	//cleared first, the database may drop the last reference to this session
+	Ptr<IpSecDatabase> database = this->m_ptr_database;
+	this->m_ptr_database = 0;
+
+	if (0 != database)
 	{
-		std::cout << "Q, ";
+		database->RemoveInitSession(this);
 	}
-	else
+}
+
+void
+GsamInitSession::LeaveHalfOpen (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	if ((true == this->m_flag_half_open) && (0 != this->m_ptr_database))
 	{
-		NS_ASSERT (false);
+		this->m_ptr_database->DecrementHalfOpenInitSessions();
 	}
 
-	std::cout << "GsamInitSession: " << this << " time out." << std::endl;
+	this->m_flag_half_open = false;
 }
 
 /********************************************************
@@ -4117,7 +5059,10 @@ GsamSession::GsamSession ()
 	 m_ptr_kek_sa (0),
 	 m_ptr_related_gsa_r (0),
 	 m_ptr_push_session (0),
-	 m_ptr_igmp_interface (0)
+	 m_ptr_igmp_interface (0),
+	 m_num_spi_leases_sent (0),
+	 m_flag_awaiting_response (false),
+	 m_flag_leaving (false)
 {
 	NS_LOG_FUNCTION (this);
 
@@ -4128,16 +5073,6 @@ GsamSession::~GsamSession()
 {
 	NS_LOG_FUNCTION (this);
 
-	if(this->m_ptr_database != 0)
-	{
-		this->m_ptr_database->RemoveSession(this);
-	}
-
-	if (this->m_ptr_session_group != 0)
-	{
-		this->m_ptr_session_group->RemoveSession(this);
-	}
-
 	this->m_ptr_database = 0;
 	this->m_ptr_kek_sa = 0;
 	this->m_ptr_session_group = 0;
@@ -4149,6 +5084,7 @@ GsamSession::~GsamSession()
 	this->m_ptr_push_session = 0;
 	this->m_last_sent_packet = 0;
 	this->m_set_ptr_push_sessions.clear();
+	this->m_lst_pending_packets.clear();
 	this->m_ptr_init_session = 0;
 	this->m_ptr_igmp_interface = 0;
 }
@@ -4160,6 +5096,18 @@ GsamSession::GetInstanceTypeId (void) const
 	return GsamSession::GetTypeId();
 }
 
+void*
+GsamSession::operator new (std::size_t size)
+{
+	return GsamObjectPool<GsamSession>::Allocate(size);
+}
+
+void
+GsamSession::operator delete (void* ptr, std::size_t size)
+{
+	GsamObjectPool<GsamSession>::Free(ptr, size);
+}
+
 void
 GsamSession::NotifyNewAggregate ()
 {
@@ -4171,19 +5119,35 @@ GsamSession::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
 
-	if (this->m_ptr_database != 0)
+	//the kek sa frees its spi through this session and the database, so it goes first
+	if (0 != this->m_ptr_kek_sa)
 	{
-		this->m_ptr_database->RemoveSession(this);
+		this->m_ptr_kek_sa->Dispose();
+		this->m_ptr_kek_sa = 0;
 	}
 
-	this->m_ptr_database = 0;
-
-	if (this->m_ptr_session_group != 0)
+	//a gm session owns its gsa push session, retire it together with the session
+	if (0 != this->m_ptr_push_session)
 	{
-		this->m_ptr_session_group->RemoveSession(this);
+		Ptr<GsaPushSession> gsa_push_session = this->m_ptr_push_session;
+		this->m_ptr_push_session = 0;
+		gsa_push_session->ClearNqSessions();
+		gsa_push_session->ClearOtherGmSessions();
+		if (0 != this->m_ptr_database)
+		{
+			this->m_ptr_database->RemoveGsaPushSession(gsa_push_session);
+		}
+		gsa_push_session->Dispose();
 	}
 
+	this->m_set_ptr_push_sessions.clear();
+	this->m_ptr_related_gsa_r = 0;
+	this->m_lst_pending_packets.clear();
 	this->m_ptr_session_group = 0;
+	this->m_ptr_init_session = 0;
+	this->m_ptr_igmp_interface = 0;
+
+	GsamInitSession::DoDispose();
 }
 
 //bool
@@ -4285,7 +5249,7 @@ GsamSession::SetInitSession (Ptr<GsamInitSession> init_session)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_init_session = init_session;
+	this->m_ptr_init_session = PeekPointer(init_session);
 }
 
 void
@@ -4344,7 +5308,7 @@ GsamSession::SetGroupAddress (Ipv4Address group_address)
 
 	if (this->m_ptr_session_group == 0)
 	{
-		this->m_ptr_session_group = this->m_ptr_database->GetSessionGroup(group_address);
+		this->m_ptr_session_group = PeekPointer(this->m_ptr_database->GetSessionGroup(group_address));
 		this->m_ptr_session_group->PushBackSession(this);
 		this->m_group_address = group_address;
 	}
@@ -4386,7 +5350,7 @@ GsamSession::AssociateWithSessionGroup (Ptr<GsamSessionGroup> session_group)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_session_group = session_group;
+	this->m_ptr_session_group = PeekPointer(session_group);
 }
 
 void
@@ -4462,6 +5426,8 @@ GsamSession::ClearGsaPushSession (void)
 	}
 
 	this->m_ptr_push_session = 0;
+
+	this->RemoveIfLeavingAndIdle();
 }
 
 void
@@ -4478,6 +5444,21 @@ GsamSession::ClearGsaPushSession (const Ptr<GsaPushSession> gsa_push_session)
 	{
 		NS_ASSERT (false);
 	}
+
+	this->RemoveIfLeavingAndIdle();
+}
+
+void
+GsamSession::RemoveIfLeavingAndIdle (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	if ((true == this->IsLeaving()) && (false == this->IsBusy()))
+	{
+		//the last push holding the session of a leaving gm is through
+		//not from within the push, it is still being taken apart
+		Simulator::ScheduleNow(&GsamL4Protocol::RemoveGmSession, this->GetDatabase()->GetGsam(), Ptr<GsamSession>(this));
+	}
 }
 
 Ptr<GsaPushSession>
@@ -4567,30 +5548,33 @@ GsamSession::HaveKekSa (void) const
 	return (this->m_ptr_kek_sa != 0);
 }
 
+Ptr<GsamSa>
+GsamSession::GetKekSa (void) const
+{
+	NS_LOG_FUNCTION (this);
+	if (0 == this->m_ptr_kek_sa)
+	{
+		NS_ASSERT (false);
+	}
+	return this->m_ptr_kek_sa;
+}
+
 void
 GsamSession::TimeoutAction (void)
 {
 	NS_LOG_FUNCTION (this);
 
-	std::cout << "Node: " << this->GetDatabase()->GetGsam()->GetNode()->GetId() << ", ";
-	if (true == this->IsHostGroupMember())
-	{
-		std::cout << "GM, ";
-	}
-	else if (true == this->IsHostNonQuerier())
-	{
-		std::cout << "NQ, ";
-	}
-	else if (true == this->IsHostQuerier())
-	{
-		std::cout << "Q, ";
-	}
-	else
+	NS_ASSERT ((true == this->IsHostGroupMember()) || (true == this->IsHostNonQuerier()) || (true == this->IsHostQuerier()));
+	NS_LOG_INFO ("Node: " << this->GetDatabase()->GetGsam()->GetNode()->GetId() << ", "
+	             << ((true == this->IsHostGroupMember()) ? "GM, " : ((true == this->IsHostNonQuerier()) ? "NQ, " : "Q, "))
+	             << "GsamSession: " << this << " time out.");
+
+	if (true == this->IsHostQuerier())
 	{
-		NS_ASSERT (false);
+		//a peer silent for this long does not get to hold up the pushes of a group
+		//not from within the timer of the session
+		Simulator::ScheduleNow(&GsamL4Protocol::AbortGsaPushes, this->GetDatabase()->GetGsam(), Ptr<GsamSession>(this));
 	}
-
-	std::cout << "GsamSession: " << this << " time out." << std::endl;
 }
 
 Ptr<IpSecSAEntry>
@@ -4647,6 +5631,20 @@ GsamSession::IsHostNonQuerier (void) const
 	return retval;
 }
 
+bool
+GsamSession::HaveGsaPushSession (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return (this->m_ptr_push_session != 0);
+}
+
+const std::set<Ptr<GsaPushSession> >&
+GsamSession::GetGsaPushSessions (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_set_ptr_push_sessions;
+}
+
 Ptr<GsaPushSession>
 GsamSession::GetGsaPushSession (void) const
 {
@@ -4706,12 +5704,11 @@ GsamSession::GetGsaPushSession (uint32_t gsa_push_id) const
 		if (true == this->m_ptr_database->GetInfo()->IsGsaPushIdDeleted(gsa_push_id))
 		{
 			//ok
-			std::cout << "The gsa push id belongs to a deleted gsa push session" << std::endl;
+			NS_LOG_LOGIC ("The gsa push id belongs to a deleted gsa push session");
 		}
 		else
 		{
-			std::cout << "No gsa push session with this id existed" << std::endl;
-			NS_ASSERT (false);
+			NS_ASSERT_MSG (false, "No gsa push session with this id existed");
 		}
 	}
 
@@ -4738,6 +5735,85 @@ GsamSession::GetIgmpInterface (void) const
 	return this->m_ptr_igmp_interface;
 }
 
+void
+GsamSession::SetNumberOfSpiLeasesSent (uint32_t num_spi_leases)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_num_spi_leases_sent = num_spi_leases;
+}
+
+uint32_t
+GsamSession::GetNumberOfSpiLeasesSent (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_num_spi_leases_sent;
+}
+
+void
+GsamSession::SetAwaitingResponse (bool awaiting_response)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_flag_awaiting_response = awaiting_response;
+}
+
+bool
+GsamSession::IsAwaitingResponse (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_flag_awaiting_response;
+}
+
+void
+GsamSession::SetLeaving (bool leaving)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_flag_leaving = leaving;
+}
+
+bool
+GsamSession::IsLeaving (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_flag_leaving;
+}
+
+bool
+GsamSession::IsBusy (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return ((true == this->m_flag_awaiting_response) ||
+			(false == this->m_lst_pending_packets.empty()) ||
+			(0 != this->m_ptr_push_session) ||
+			(false == this->m_set_ptr_push_sessions.empty()));
+}
+
+void
+GsamSession::PushBackPendingPacket (Ptr<Packet> packet)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (packet == 0)
+	{
+		NS_ASSERT (false);
+	}
+
+	this->m_lst_pending_packets.push_back(packet);
+}
+
+Ptr<Packet>
+GsamSession::PopFrontPendingPacket (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<Packet> retval = 0;
+	if (false == this->m_lst_pending_packets.empty())
+	{
+		retval = this->m_lst_pending_packets.front();
+		this->m_lst_pending_packets.pop_front();
+	}
+	return retval;
+}
+
 /********************************************************
  *        GsamSessionGroup
  ********************************************************/
@@ -4759,7 +5835,8 @@ GsamSessionGroup::GsamSessionGroup ()
   :  m_group_address (Ipv4Address ("0.0.0.0")),
 	 m_ptr_database (0),
 	 m_ptr_related_gsa_q (0),
-	 m_ptr_related_policy (0)
+	 m_ptr_related_policy (0),
+	 m_rekey_gsa_q_spi (0)
 {
 	NS_LOG_FUNCTION (this);
 }
@@ -4767,13 +5844,12 @@ GsamSessionGroup::GsamSessionGroup ()
 GsamSessionGroup::~GsamSessionGroup()
 {
 	NS_LOG_FUNCTION (this);
-	if (this->m_ptr_database != 0)
-	{
-		this->m_ptr_database->RemoveSessionGroup(this);
-	}
+	this->m_ptr_database = 0;
 	this->m_ptr_related_gsa_q = 0;
 	this->m_ptr_related_policy = 0;
 	this->m_lst_sessions.clear();
+	this->m_lst_sessions_awaiting_push.clear();
+	this->m_set_sessions_awaiting_rekey_ack.clear();
 }
 
 TypeId
@@ -4784,6 +5860,18 @@ GsamSessionGroup::GetInstanceTypeId (void) const
 	return GsamSessionGroup::GetTypeId();
 }
 
+void*
+GsamSessionGroup::operator new (std::size_t size)
+{
+	return GsamObjectPool<GsamSessionGroup>::Allocate(size);
+}
+
+void
+GsamSessionGroup::operator delete (void* ptr, std::size_t size)
+{
+	GsamObjectPool<GsamSessionGroup>::Free(ptr, size);
+}
+
 void
 GsamSessionGroup::NotifyNewAggregate ()
 {
@@ -4794,10 +5882,12 @@ void
 GsamSessionGroup::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
-	if (this->m_ptr_database != 0)
-	{
-		this->m_ptr_database->RemoveSessionGroup(this);
-	}
+	//the policy belongs to the spd and the sessions to the database, only drop the references
+	this->m_ptr_related_gsa_q = 0;
+	this->m_ptr_related_policy = 0;
+	this->m_lst_sessions.clear();
+	this->m_lst_sessions_awaiting_push.clear();
+	this->m_set_sessions_awaiting_rekey_ack.clear();
 	this->m_ptr_database = 0;
 }
 
@@ -4824,7 +5914,7 @@ GsamSessionGroup::SetDatabase (Ptr<IpSecDatabase> database)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_database = database;
+	this->m_ptr_database = PeekPointer(database);
 }
 
 void
@@ -4876,6 +5966,8 @@ GsamSessionGroup::RemoveSession (Ptr<GsamSession> session)
 {
 	NS_LOG_FUNCTION (this);
 	this->m_lst_sessions.remove(session);
+	this->m_lst_sessions_awaiting_push.remove(session);
+	this->m_set_sessions_awaiting_rekey_ack.erase(session);
 }
 
 std::list<Ptr<GsamSession> >&
@@ -4885,6 +5977,92 @@ GsamSessionGroup::GetSessions (void)
 	return this->m_lst_sessions;
 }
 
+void
+GsamSessionGroup::PushBackSessionAwaitingPush (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (session == 0)
+	{
+		NS_ASSERT (false);
+	}
+
+	this->m_lst_sessions_awaiting_push.push_back(session);
+}
+
+Ptr<GsamSession>
+GsamSessionGroup::PopFrontSessionAwaitingPush (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<GsamSession> retval = 0;
+	if (false == this->m_lst_sessions_awaiting_push.empty())
+	{
+		retval = this->m_lst_sessions_awaiting_push.front();
+		this->m_lst_sessions_awaiting_push.pop_front();
+	}
+	return retval;
+}
+
+void
+GsamSessionGroup::StartRekey (uint32_t new_gsa_q_spi)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (0 == new_gsa_q_spi)
+	{
+		NS_ASSERT (false);
+	}
+
+	if (true == this->IsRekeying())
+	{
+		NS_ASSERT (false);
+	}
+
+	this->m_rekey_gsa_q_spi = new_gsa_q_spi;
+	this->m_set_sessions_awaiting_rekey_ack.clear();
+}
+
+void
+GsamSessionGroup::InsertSessionAwaitingRekeyAck (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (session == 0)
+	{
+		NS_ASSERT (false);
+	}
+
+	this->m_set_sessions_awaiting_rekey_ack.insert(session);
+}
+
+void
+GsamSessionGroup::RemoveSessionAwaitingRekeyAck (Ptr<GsamSession> session)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_set_sessions_awaiting_rekey_ack.erase(session);
+}
+
+void
+GsamSessionGroup::FinishRekey (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (false == this->IsRekeying())
+	{
+		NS_ASSERT (false);
+	}
+
+	//every gm and nq knows the new gsa_q by now, or gave up on it, switch to it
+	if (0 != this->m_ptr_related_gsa_q)
+	{
+		this->m_ptr_related_gsa_q->SetSpi(this->m_rekey_gsa_q_spi);
+	}
+
+	this->m_rekey_gsa_q_spi = 0;
+	this->m_set_sessions_awaiting_rekey_ack.clear();
+}
+
 void
 GsamSessionGroup::EtablishPolicy (Ipv4Address group_address,
 									uint8_t protocol_id,
@@ -5032,6 +6210,53 @@ GsamSessionGroup::GetSessionsConst (void) const
 	return this->m_lst_sessions;
 }
 
+bool
+GsamSessionGroup::IsRekeying (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return (0 != this->m_rekey_gsa_q_spi);
+}
+
+bool
+GsamSessionGroup::IsRekeyAcked (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_set_sessions_awaiting_rekey_ack.empty();
+}
+
+uint32_t
+GsamSessionGroup::GetRekeyGsaQSpi (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_rekey_gsa_q_spi;
+}
+
+bool
+GsamSessionGroup::IsSoftLifetimeExpired (void) const
+{
+	NS_LOG_FUNCTION (this);
+
+	bool retval = false;
+
+	if (0 != this->m_ptr_related_gsa_q)
+	{
+		retval = this->m_ptr_related_gsa_q->IsSoftLifetimeExpired();
+	}
+
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = this->m_lst_sessions.begin();
+			(false == retval) && (const_it != this->m_lst_sessions.end());
+			const_it++)
+	{
+		Ptr<IpSecSAEntry> gsa_r = (*const_it)->GetRelatedGsaR();
+		if (0 != gsa_r)
+		{
+			retval = gsa_r->IsSoftLifetimeExpired();
+		}
+	}
+
+	return retval;
+}
+
 Ptr<GsamSession>
 GsamSessionGroup::GetSessionByGsaRSpi (uint32_t gsa_r_spi)
 {
@@ -5119,21 +6344,25 @@ IpSecSAEntry::IpSecSAEntry ()
 	 m_spi (0),
 	 m_ptr_encrypt_fn (0),
 	 m_ptr_sad (0),
-     m_ptr_policy (0)
+     m_ptr_policy (0),
+	 m_time_installed (Seconds (0.0)),
+	 m_soft_lifetime (Seconds (0.0)),
+	 m_hard_lifetime (Seconds (0.0)),
+	 m_soft_lifetime_bytes (0),
+	 m_hard_lifetime_bytes (0),
+	 m_num_bytes (0),
+	 m_num_packets (0)
 {
 	NS_LOG_FUNCTION (this);
+	this->ResetLifetime();
 }
 
 IpSecSAEntry::~IpSecSAEntry()
 {
 	NS_LOG_FUNCTION (this);
-	if (IpSecSAEntry::INBOUND == this->m_direction)
-	{
-		this->m_ptr_sad->GetRootDatabase()->GetInfo()->FreeIpsecSpi(this->m_spi);
-	}
-
 	this->m_ptr_encrypt_fn = 0;
 	this->m_ptr_sad = 0;
+	this->m_ptr_policy = 0;
 }
 
 TypeId
@@ -5143,6 +6372,18 @@ IpSecSAEntry::GetInstanceTypeId (void) const
 	return IpSecSAEntry::GetTypeId();
 }
 
+void*
+IpSecSAEntry::operator new (std::size_t size)
+{
+	return GsamObjectPool<IpSecSAEntry>::Allocate(size);
+}
+
+void
+IpSecSAEntry::operator delete (void* ptr, std::size_t size)
+{
+	GsamObjectPool<IpSecSAEntry>::Free(ptr, size);
+}
+
 void
 IpSecSAEntry::NotifyNewAggregate ()
 {
@@ -5153,12 +6394,16 @@ void
 IpSecSAEntry::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
-	if (this->m_ptr_sad != 0)
+	//inbound spis are local, hand them back while the root database is still around
+	if ((IpSecSAEntry::INBOUND == this->m_direction) && (0 != this->m_ptr_sad))
 	{
-		this->m_ptr_sad->RemoveEntry(this);
+		this->m_ptr_sad->GetInfo()->FreeIpsecSpi(this->m_spi);
 	}
 
+	this->m_ptr_encrypt_fn = 0;
 	this->m_ptr_sad = 0;
+	this->m_ptr_policy = 0;
+	this->m_vec_key_material.clear();
 }
 
 bool
@@ -5189,9 +6434,44 @@ void
 IpSecSAEntry::SetSpi (uint32_t spi)
 {
 	NS_LOG_FUNCTION (this);
+	if (this->m_spi != spi)
+	{
+		//a new spi is a new key, so its lifetime starts over
+		this->ResetLifetime();
+	}
 	this->m_spi = spi;
 }
 
+void
+IpSecSAEntry::ResetLifetime (void)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_time_installed = Simulator::Now();
+	this->m_num_bytes = 0;
+	this->m_num_packets = 0;
+	//the limits are read once here, not on every packet
+	Ptr<GsamConfig> config = GsamConfig::GetSingleton();
+	this->m_soft_lifetime = config->GetSaSoftLifetimeInSeconds();
+	this->m_hard_lifetime = config->GetSaHardLifetimeInSeconds();
+	this->m_soft_lifetime_bytes = config->GetSaSoftLifetimeInBytes();
+	this->m_hard_lifetime_bytes = config->GetSaHardLifetimeInBytes();
+	uint16_t jitter_percentage = config->GetSaLifetimeJitterPercentage();
+	if ((false == this->m_soft_lifetime.IsZero()) && (0 != jitter_percentage))
+	{
+		//shorten the soft lifetime by up to jitter_percentage
+		double jitter = (rand() % (jitter_percentage * 100 + 1)) / 10000.0;
+		this->m_soft_lifetime = Seconds (this->m_soft_lifetime.GetSeconds() * (1 - jitter));
+	}
+}
+
+void
+IpSecSAEntry::CountPacket (uint32_t packet_size)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_num_bytes += packet_size;
+	this->m_num_packets++;
+}
+
 void
 IpSecSAEntry::SetSAD (Ptr<IpSecSADatabase> sad)
 {
@@ -5201,7 +6481,7 @@ IpSecSAEntry::SetSAD (Ptr<IpSecSADatabase> sad)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_sad = sad;
+	this->m_ptr_sad = PeekPointer(sad);
 }
 
 void
@@ -5213,7 +6493,7 @@ IpSecSAEntry::AssociatePolicy (Ptr<IpSecPolicyEntry> policy)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_policy = policy;
+	this->m_ptr_policy = PeekPointer(policy);
 }
 
 void
@@ -5242,6 +6522,20 @@ IpSecSAEntry::SetOutbound (void)
 	this->m_direction = IpSecSAEntry::OUTBOUND;
 }
 
+void
+IpSecSAEntry::SetKeyMaterial (const std::vector<uint8_t>& key_material)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_vec_key_material = key_material;
+}
+
+const std::vector<uint8_t>&
+IpSecSAEntry::GetKeyMaterial (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_vec_key_material;
+}
+
 uint32_t
 IpSecSAEntry::GetSpi (void) const
 {
@@ -5296,6 +6590,59 @@ IpSecSAEntry::IsOutbound (void) const
 	return retval;
 }
 
+Time
+IpSecSAEntry::GetAge (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return Simulator::Now() - this->m_time_installed;
+}
+
+uint64_t
+IpSecSAEntry::GetNumberOfBytes (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_num_bytes;
+}
+
+uint64_t
+IpSecSAEntry::GetNumberOfPackets (void) const
+{
+	NS_LOG_FUNCTION (this);
+	return this->m_num_packets;
+}
+
+bool
+IpSecSAEntry::IsSoftLifetimeExpired (void) const
+{
+	NS_LOG_FUNCTION (this);
+	bool retval = false;
+	if ((false == this->m_soft_lifetime.IsZero()) && (this->GetAge() >= this->m_soft_lifetime))
+	{
+		retval = true;
+	}
+	else if ((0 != this->m_soft_lifetime_bytes) && (this->m_num_bytes >= this->m_soft_lifetime_bytes))
+	{
+		retval = true;
+	}
+	return retval;
+}
+
+bool
+IpSecSAEntry::IsHardLifetimeExpired (void) const
+{
+	NS_LOG_FUNCTION (this);
+	bool retval = false;
+	if ((false == this->m_hard_lifetime.IsZero()) && (this->GetAge() >= this->m_hard_lifetime))
+	{
+		retval = true;
+	}
+	else if ((0 != this->m_hard_lifetime_bytes) && (this->m_num_bytes >= this->m_hard_lifetime_bytes))
+	{
+		retval = true;
+	}
+	return retval;
+}
+
 /********************************************************
  *        IpSecSADatabase
  ********************************************************/
@@ -5336,6 +6683,18 @@ IpSecSADatabase::GetInstanceTypeId (void) const
 	return IpSecSADatabase::GetTypeId();
 }
 
+void*
+IpSecSADatabase::operator new (std::size_t size)
+{
+	return GsamObjectPool<IpSecSADatabase>::Allocate(size);
+}
+
+void
+IpSecSADatabase::operator delete (void* ptr, std::size_t size)
+{
+	GsamObjectPool<IpSecSADatabase>::Free(ptr, size);
+}
+
 void
 IpSecSADatabase::NotifyNewAggregate ()
 {
@@ -5346,6 +6705,34 @@ void
 IpSecSADatabase::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
+
+	if (0 != this->m_ptr_policy_entry)
+	{
+		//a logical database, the entries belong to the root sad
+		if (0 != this->m_ptr_root_database)
+		{
+			Ptr<IpSecSADatabase> root_sad = this->m_ptr_root_database->GetSAD();
+			for (	std::list<Ptr<IpSecSAEntry> >::const_iterator const_it = this->m_lst_entries.begin();
+					const_it != this->m_lst_entries.end();
+					const_it++)
+			{
+				root_sad->RemoveEntry(*const_it);
+			}
+		}
+	}
+	else
+	{
+		for (	std::list<Ptr<IpSecSAEntry> >::const_iterator const_it = this->m_lst_entries.begin();
+				const_it != this->m_lst_entries.end();
+				const_it++)
+		{
+			(*const_it)->Dispose();
+		}
+	}
+
+	this->m_lst_entries.clear();
+	this->m_ptr_policy_entry = 0;
+	this->m_ptr_root_database = 0;
 }
 
 void
@@ -5360,6 +6747,12 @@ IpSecSADatabase::RemoveEntry (Ptr<IpSecSAEntry> entry)
 {
 	NS_LOG_FUNCTION (this);
 	this->m_lst_entries.remove(entry);
+
+	if ((0 != this->m_ptr_policy_entry) && (0 != this->m_ptr_root_database))
+	{
+		//a logical database, the root sad owns the entry, otherwise it would stay there for good
+		this->m_ptr_root_database->GetSAD()->RemoveEntry(entry);
+	}
 }
 
 void
@@ -5370,14 +6763,14 @@ IpSecSADatabase::AssociatePolicyEntry (Ptr<IpSecPolicyEntry> policy)
 	{
 		NS_ASSERT (false);
 	}
-	this->m_ptr_policy_entry = policy;
+	this->m_ptr_policy_entry = PeekPointer(policy);
 }
 
 void
 IpSecSADatabase::SetRootDatabase (Ptr<IpSecDatabase> database)
 {
 	NS_LOG_FUNCTION (this);
-	this->m_ptr_root_database = database;
+	this->m_ptr_root_database = PeekPointer(database);
 }
 
 void
@@ -5439,7 +6832,13 @@ IpSecSADatabase::GetInfo (void) const
 {
 	NS_LOG_FUNCTION (this);
 
-	return this->GetRootDatabase()->GetInfo();
+	if (this->m_ptr_root_database == 0)
+	{
+		NS_ASSERT (false);
+	}
+
+	//no Ptr to the root database, this also runs while it is being disposed
+	return this->m_ptr_root_database->GetInfo();
 }
 
 void
@@ -5549,6 +6948,18 @@ IpSecPolicyEntry::GetInstanceTypeId (void) const
 	return IpSecSADatabase::GetTypeId();
 }
 
+void*
+IpSecPolicyEntry::operator new (std::size_t size)
+{
+	return GsamObjectPool<IpSecPolicyEntry>::Allocate(size);
+}
+
+void
+IpSecPolicyEntry::operator delete (void* ptr, std::size_t size)
+{
+	GsamObjectPool<IpSecPolicyEntry>::Free(ptr, size);
+}
+
 void
 IpSecPolicyEntry::NotifyNewAggregate ()
 {
@@ -5559,9 +6970,18 @@ void
 IpSecPolicyEntry::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
-	if (this->m_ptr_spd != 0)
+
+	//the policy owns its logical sads, they take their sas out of the root sad
+	if (0 != this->m_ptr_outbound_sad)
 	{
-		this->m_ptr_spd->RemoveEntry(this);
+		this->m_ptr_outbound_sad->Dispose();
+		this->m_ptr_outbound_sad = 0;
+	}
+
+	if (0 != this->m_ptr_inbound_sad)
+	{
+		this->m_ptr_inbound_sad->Dispose();
+		this->m_ptr_inbound_sad = 0;
 	}
 
 	this->m_ptr_spd = 0;
@@ -5819,7 +7239,7 @@ IpSecPolicyEntry::SetSPD (Ptr<IpSecPolicyDatabase> spd)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_spd = spd;
+	this->m_ptr_spd = PeekPointer(spd);
 }
 
 Ptr<IpSecSADatabase>
@@ -6007,6 +7427,16 @@ void
 IpSecPolicyDatabase::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
+
+	for (	std::list<Ptr<IpSecPolicyEntry> >::const_iterator const_it = this->m_lst_entries.begin();
+			const_it != this->m_lst_entries.end();
+			const_it++)
+	{
+		(*const_it)->Dispose();
+	}
+
+	this->m_lst_entries.clear();
+	this->m_ptr_root_database = 0;
 }
 
 void
@@ -6044,7 +7474,7 @@ IpSecPolicyDatabase::SetRootDatabase (Ptr<IpSecDatabase> database)
 		NS_ASSERT (false);
 	}
 
-	this->m_ptr_root_database = database;
+	this->m_ptr_root_database = PeekPointer(database);
 }
 
 Ptr<IpSecDatabase>
@@ -6065,7 +7495,12 @@ IpSecPolicyDatabase::GetInfo (void) const
 {
 	NS_LOG_FUNCTION (this);
 
-	return this->GetRootDatabase()->GetInfo();
+	if (this->m_ptr_root_database == 0)
+	{
+		NS_ASSERT (false);
+	}
+
+	return this->m_ptr_root_database->GetInfo();
 }
 
 void
@@ -6287,6 +7722,7 @@ IpSecDatabase::GetTypeId (void)
 
 IpSecDatabase::IpSecDatabase ()
   :  m_window_size (0),
+	 m_num_half_open_init_sessions (0),
 	 m_ptr_spd (0),
 	 m_ptr_sad (0),
 	 m_ptr_info (0)
@@ -6330,6 +7766,65 @@ void
 IpSecDatabase::DoDispose (void)
 {
 	NS_LOG_FUNCTION (this);
+
+	//gsa push sessions and the nq or other gm sessions they update hold each other, unlink them first
+	for (	std::set<Ptr<GsaPushSession> >::const_iterator const_it = this->m_set_ptr_gsa_push_sessions.begin();
+			const_it != this->m_set_ptr_gsa_push_sessions.end();
+			const_it++)
+	{
+		(*const_it)->ClearNqSessions();
+		(*const_it)->ClearOtherGmSessions();
+	}
+
+	//a gm session retires its own push session, the kek sas free their spis through the sessions
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = this->m_lst_ptr_all_sessions.begin();
+			const_it != this->m_lst_ptr_all_sessions.end();
+			const_it++)
+	{
+		(*const_it)->Dispose();
+	}
+	this->m_lst_ptr_all_sessions.clear();
+
+	for (	std::list<Ptr<GsamInitSession> >::const_iterator const_it = this->m_lst_init_sessions.begin();
+			const_it != this->m_lst_init_sessions.end();
+			const_it++)
+	{
+		(*const_it)->Dispose();
+	}
+	this->m_lst_init_sessions.clear();
+
+	for (	std::set<Ptr<GsaPushSession> >::const_iterator const_it = this->m_set_ptr_gsa_push_sessions.begin();
+			const_it != this->m_set_ptr_gsa_push_sessions.end();
+			const_it++)
+	{
+		(*const_it)->Dispose();
+	}
+	this->m_set_ptr_gsa_push_sessions.clear();
+
+	for (	std::list<Ptr<GsamSessionGroup> >::const_iterator const_it = this->m_lst_ptr_session_groups.begin();
+			const_it != this->m_lst_ptr_session_groups.end();
+			const_it++)
+	{
+		(*const_it)->Dispose();
+	}
+	this->m_lst_ptr_session_groups.clear();
+
+	//the policies take their sas out of the sad, so the spd goes first
+	if (0 != this->m_ptr_spd)
+	{
+		this->m_ptr_spd->Dispose();
+		this->m_ptr_spd = 0;
+	}
+
+	if (0 != this->m_ptr_sad)
+	{
+		this->m_ptr_sad->Dispose();
+		this->m_ptr_sad = 0;
+	}
+
+	//everything above handed its spis and push ids back to the info
+	this->m_ptr_info = 0;
+	this->m_ptr_gsam = 0;
 }
 
 Ptr<GsamSession>
@@ -6652,6 +8147,121 @@ IpSecDatabase::IsHostNonQuerier (void) const
 	return retval;
 }
 
+bool
+IpSecDatabase::IsGsaPushInFlight (Ipv4Address group_address) const
+{
+	NS_LOG_FUNCTION (this);
+
+	bool retval = false;
+
+	for (	std::set<Ptr<GsaPushSession> >::const_iterator const_it = this->m_set_ptr_gsa_push_sessions.begin();
+			const_it != this->m_set_ptr_gsa_push_sessions.end();
+			const_it++)
+	{
+		Ptr<GsamSession> gm_session = (*const_it)->GetGmSession();
+		//once installed the group has its gsa_q, the next push of the group can go ahead
+		if ((gm_session != 0) &&
+			(gm_session->GetGroupAddress() == group_address) &&
+			(false == (*const_it)->IsGsaPairInstalled()))
+		{
+			retval = true;
+			break;
+		}
+	}
+
+	return retval;
+}
+
+void
+IpSecDatabase::GetInFlightGsaSpis (std::set<uint32_t>& retval) const
+{
+	NS_LOG_FUNCTION (this);
+
+	//spis proposed by pushes not yet installed, they are not occupied in GsamInfo yet
+	for (	std::set<Ptr<GsaPushSession> >::const_iterator const_it = this->m_set_ptr_gsa_push_sessions.begin();
+			const_it != this->m_set_ptr_gsa_push_sessions.end();
+			const_it++)
+	{
+		Ptr<GsaPushSession> gsa_push_session = (*const_it);
+		if (0 != gsa_push_session->GetGsaQ())
+		{
+			retval.insert(gsa_push_session->GetGsaQ()->GetSpi());
+		}
+		if (0 != gsa_push_session->GetGsaR())
+		{
+			retval.insert(gsa_push_session->GetGsaR()->GetSpi());
+		}
+	}
+
+	//nor is the gsa_q a group rekey switches to
+	for (	std::list<Ptr<GsamSessionGroup> >::const_iterator const_it = this->m_lst_ptr_session_groups.begin();
+			const_it != this->m_lst_ptr_session_groups.end();
+			const_it++)
+	{
+		if (true == (*const_it)->IsRekeying())
+		{
+			retval.insert((*const_it)->GetRekeyGsaQSpi());
+		}
+	}
+}
+
+uint32_t
+IpSecDatabase::GetNumberOfHalfOpenInitSessions (void) const
+{
+	NS_LOG_FUNCTION (this);
+	//answered an ike_sa_init but has not seen the ike_auth yet
+	return this->m_num_half_open_init_sessions;
+}
+
+Ptr<GsamSession>
+IpSecDatabase::GetNqSession (Ipv4Address querier_address) const
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<GsamSession> retval = 0;
+
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = this->m_lst_ptr_all_sessions.begin();
+			const_it != this->m_lst_ptr_all_sessions.end();
+			const_it++)
+	{
+		Ptr<GsamSession> session_it = (*const_it);
+		if (	(true == session_it->HaveKekSa()) &&
+				(true == session_it->IsHostNonQuerier()) &&
+				(session_it->GetGroupAddress() == GsamConfig::GetIgmpv3DestGrpReportAddress()) &&
+				(session_it->GetPeerAddress() == querier_address))
+		{
+			retval = session_it;
+			break;
+		}
+	}
+
+	return retval;
+}
+
+Ptr<GsamSession>
+IpSecDatabase::GetGroupSession (Ipv4Address group_address, Ipv4Address peer_address) const
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<GsamSession> retval = 0;
+
+	for (	std::list<Ptr<GsamSession> >::const_iterator const_it = this->m_lst_ptr_all_sessions.begin();
+			const_it != this->m_lst_ptr_all_sessions.end();
+			const_it++)
+	{
+		Ptr<GsamSession> session_it = (*const_it);
+		if (	(true == session_it->HaveKekSa()) &&
+				(session_it->GetGroupAddress() == group_address) &&
+				(session_it->GetPeerAddress() == peer_address))
+		{
+			retval = session_it;
+			break;
+		}
+	}
+
+	return retval;
+}
+
 Ptr<GsamSession>
 IpSecDatabase::CreateSession (Ptr<GsamInitSession> init_session, Ipv4Address group_address)
 {
@@ -6753,13 +8363,41 @@ IpSecDatabase::RemoveSession (Ptr<GsamSession> session)
 {
 	NS_LOG_FUNCTION (this);
 
+	if (0 == session)
+	{
+		NS_ASSERT (false);
+	}
+
+	//the group and the init session hold the session too, it is freed once all of them let go
+	Ptr<GsamSessionGroup> session_group = session->GetSessionGroup();
+	if (0 != session_group)
+	{
+		session_group->RemoveSession(session);
+	}
+	session->GetInitSession()->ClearSession(session);
+
+	//its gsa_r is not shared with anyone
+	Ptr<IpSecSAEntry> gsa_r = session->GetRelatedGsaR();
+	if (0 != gsa_r)
+	{
+		Ptr<IpSecPolicyEntry> policy = gsa_r->GetPolicyEntry();
+		if (true == gsa_r->IsInbound())
+		{
+			policy->GetInboundSAD()->RemoveEntry(gsa_r);
+		}
+		else
+		{
+			policy->GetOutboundSAD()->RemoveEntry(gsa_r);
+		}
+	}
+
 	for (	std::list<Ptr<GsamSession> >::iterator it = this->m_lst_ptr_all_sessions.begin();
 			it != this->m_lst_ptr_all_sessions.end();
 			it++)
 	{
 		Ptr<GsamSession> session_it = (*it);
 
-		if (session_it == session_it)
+		if (session_it == session)
 		{
 			it = this->m_lst_ptr_all_sessions.erase(it);
 			break;
@@ -6778,7 +8416,7 @@ IpSecDatabase::RemoveInitSession (Ptr<GsamInitSession> session)
 	{
 		Ptr<GsamInitSession> session_it = (*it);
 
-		if (session_it == session_it)
+		if (session_it == session)
 		{
 			it = this->m_lst_init_sessions.erase(it);
 			break;
@@ -6790,6 +8428,22 @@ void
 IpSecDatabase::RemoveSessionGroup (Ptr<GsamSessionGroup> session_group)
 {
 	NS_LOG_FUNCTION (this);
+
+	if (0 == session_group)
+	{
+		NS_ASSERT (false);
+	}
+
+	//the group's policy goes with it, the policy then takes its sas out of the sad
+	if (session_group->GetGroupAddress() != GsamConfig::GetIgmpv3DestGrpReportAddress())
+	{
+		Ptr<IpSecPolicyEntry> policy = session_group->GetRelatedPolicy();
+		if (0 != policy)
+		{
+			this->GetSPD()->RemoveEntry(policy);
+		}
+	}
+
 	this->m_lst_ptr_session_groups.remove(session_group);
 }
 
@@ -6848,7 +8502,28 @@ IpSecDatabase::SetGsam (Ptr<GsamL4Protocol> gsam)
 	{
 		NS_ASSERT (false);
 	}
-	this->m_ptr_gsam = gsam;
+	this->m_ptr_gsam = PeekPointer(gsam);
+}
+
+void
+IpSecDatabase::IncrementHalfOpenInitSessions (void)
+{
+	NS_LOG_FUNCTION (this);
+	this->m_num_half_open_init_sessions++;
+}
+
+void
+IpSecDatabase::DecrementHalfOpenInitSessions (void)
+{
+	NS_LOG_FUNCTION (this);
+	if (0 == this->m_num_half_open_init_sessions)
+	{
+		NS_ASSERT (false);
+	}
+	else
+	{
+		this->m_num_half_open_init_sessions--;
+	}
 }
 
 /********************************************************
@@ -7174,9 +8849,7 @@ GsamFilter::GetIgmp (void) const
 
 	if (0 == retval)
 	{
-		std::cout << "Node id: " << node->GetId() << ", ";
-		std::cout << "does not have igmp." << std::endl;
-		NS_ASSERT (false);
+		NS_ASSERT_MSG (false, "Node id: " << node->GetId() << ", does not have igmp.");
 	}
 
 	return retval;
@@ -7269,11 +8942,17 @@ GsamFilter::ProcessIncomingPacket (	Ptr<Packet> incoming_and_retval_packet)
 						//sa entry not found
 						retval = IpSec::DISCARD;
 					}
+					else if (true == sa_entry->IsHardLifetimeExpired())
+					{
+						//the group was not rekeyed in time
+						retval = IpSec::DISCARD;
+					}
 					else
 					{
 						//sa entry found
 						//ok
 						//retval remain IpSec::PROTECT
+						sa_entry->CountPacket(incoming_and_retval_packet->GetSize());
 						ipv4header.SetProtocol(simpleah.GetNextHeader());
 						ipv4header.SetPayloadSize(incoming_and_retval_packet->GetSize());
 					}
@@ -7369,11 +9048,17 @@ GsamFilter::ProcessOutgoingPacket (	Ptr<Packet> packet,
 						//sa entry not found
 						retval.first = IpSec::DISCARD;
 					}
+					else if (true == sa_entry->IsHardLifetimeExpired())
+					{
+						//the group was not rekeyed in time
+						retval.first = IpSec::DISCARD;
+					}
 					else
 					{
 						//sa entry found
 						//ok
 						//retval remain IpSec::PROTECT
+						sa_entry->CountPacket(packet->GetSize());
 					}
 					packet->AddHeader(simpleah);
 				}
@@ -7393,6 +9078,16 @@ GsamFilter::ProcessOutgoingPacket (	Ptr<Packet> packet,
 							NS_ASSERT (false);
 						}
 						uint32_t spi = outbound_spis.front()->ToUint32();
+						Ptr<IpSecSAEntry> sa_entry = policy->GetOutboundSAD()->GetIpsecSAEntry(spi);
+						if (true == sa_entry->IsHardLifetimeExpired())
+						{
+							//the group was not rekeyed in time
+							retval.first = IpSec::DISCARD;
+						}
+						else
+						{
+							sa_entry->CountPacket(packet->GetSize());
+						}
 						SimpleAuthenticationHeader simpleah (IpSec::IP_ID_IGMP, packet->GetSize(), spi, 0);
 						packet->AddHeader(simpleah);
 						retval.second = IpSec::IP_ID_AH;
@@ -7427,7 +9122,7 @@ void
 GsamFilter::DoGsam (Ptr<Ipv4InterfaceMulticast> interface, Ipv4Address group_address, const Ptr<GsamFilterCache> cache)
 {
 	NS_LOG_FUNCTION (this);
-	std::cout << "Node: " << this->m_ptr_gsam->GetNode()->GetId() << " DoGsam, Group Address: " << group_address << std::endl;
+	NS_LOG_INFO ("Node: " << this->m_ptr_gsam->GetNode()->GetId() << " DoGsam, Group Address: " << group_address);
 	Ipv4Address q_address = GsamConfig::GetSingleton()->GetQAddress();
 	Ptr<GsamL4Protocol> gsam = this->GetGsam();
 	Ptr<GsamInitSession> init_session = gsam->GetIpSecDatabase()->GetInitSession(GsamInitSession::INITIATOR, q_address);
@@ -7449,6 +9144,45 @@ GsamFilter::DoGsam (Ptr<Ipv4InterfaceMulticast> interface, Ipv4Address group_add
 	}
 }
 
+void
+GsamFilter::UndoGsam (Ptr<Ipv4InterfaceMulticast> interface, Ipv4Address group_address)
+{
+	NS_LOG_FUNCTION (this);
+	NS_LOG_INFO ("Node: " << this->m_ptr_gsam->GetNode()->GetId() << " UndoGsam, Group Address: " << group_address);
+	Ipv4Address q_address = GsamConfig::GetSingleton()->GetQAddress();
+	Ptr<GsamL4Protocol> gsam = this->GetGsam();
+	Ptr<GsamSession> session = gsam->GetIpSecDatabase()->GetGroupSession(group_address, q_address);
+	if (0 == session)
+	{
+		//gsam never got that far
+		return;
+	}
+	if (session->GetIgmpInterface() != interface)
+	{
+		NS_ASSERT (false);
+	}
+	if (false == session->IsHostGroupMember())
+	{
+		//an nq keeps its session, it forwards for the group all the same
+		return;
+	}
+	if (false == session->IsLeaving())
+	{
+		//a packet cached for the group would find no sas any more
+		this->m_map_sessions_to_packets.erase(session);
+		gsam->Send_KEK_SA_DELETE(session);
+	}
+}
+
+bool
+GsamFilter::IsUndoingGsam (Ptr<Ipv4InterfaceMulticast> interface, Ipv4Address group_address) const
+{
+	NS_LOG_FUNCTION (this);
+	Ipv4Address q_address = GsamConfig::GetSingleton()->GetQAddress();
+	Ptr<GsamSession> session = this->GetGsam()->GetIpSecDatabase()->GetGroupSession(group_address, q_address);
+	return ((0 != session) && (session->GetIgmpInterface() == interface) && (true == session->IsLeaving()));
+}
+
 void
 GsamFilter::GsamCallBack (Ptr<GsamSession> session)
 {
@@ -23,6 +23,9 @@
 #include "ns3/ip-l4-protocol-multicast.h"
 #include <utility>
 #include "ns3/ipv4-interface-multicast.h"
+#include <new>
+#include <cstddef>
+#include <vector>
 
 namespace ns3 {
 
@@ -53,6 +56,152 @@ public://static
 	static uint8_t ConvertSaProposalIdToIpProtocolNum (IpSec::SA_Proposal_PROTOCOL_ID sa_protocol_id);
 };
 
+/*
+ * slab allocator behind operator new/delete of the objects the querier creates per join
+ * blocks come from slabs of GsamObjectPool::SLAB_SIZE objects and are recycled through a free list
+ * slabs are kept until the program exits, the pool of a class is shared by every node of the simulation
+ */
+template <typename T>
+class GsamObjectPool {
+public:
+	enum {
+		SLAB_SIZE = 256
+	};
+public:	//static
+	static void* Allocate (std::size_t size);
+	static void Free (void* ptr, std::size_t size);
+	static uint64_t GetNumberOfAllocations (void);
+	static uint64_t GetNumberOfSlabs (void);
+	static uint64_t GetNumberOfObjectsInUse (void);
+	static uint64_t GetPeakObjectsInUse (void);
+private:
+	struct FreeBlock {
+		FreeBlock* m_next;
+	};
+	static std::size_t GetBlockSize (void);
+	static void AddSlab (void);
+private:	//static member
+	static FreeBlock* m_ptr_free_head;
+	static uint64_t m_num_allocations;
+	static uint64_t m_num_slabs;
+	static uint64_t m_num_in_use;
+	static uint64_t m_num_peak_in_use;
+};
+
+template <typename T>
+typename GsamObjectPool<T>::FreeBlock* GsamObjectPool<T>::m_ptr_free_head = 0;
+template <typename T>
+uint64_t GsamObjectPool<T>::m_num_allocations = 0;
+template <typename T>
+uint64_t GsamObjectPool<T>::m_num_slabs = 0;
+template <typename T>
+uint64_t GsamObjectPool<T>::m_num_in_use = 0;
+template <typename T>
+uint64_t GsamObjectPool<T>::m_num_peak_in_use = 0;
+
+template <typename T>
+std::size_t
+GsamObjectPool<T>::GetBlockSize (void)
+{
+	//a free block holds the link to the next one
+	return (sizeof (T) < sizeof (FreeBlock)) ? sizeof (FreeBlock) : sizeof (T);
+}
+
+template <typename T>
+void
+GsamObjectPool<T>::AddSlab (void)
+{
+	std::size_t block_size = GsamObjectPool<T>::GetBlockSize();
+	char* slab = static_cast<char*>(::operator new (block_size * GsamObjectPool<T>::SLAB_SIZE));
+	for (	uint32_t index = 0;
+			index < GsamObjectPool<T>::SLAB_SIZE;
+			index++)
+	{
+		FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + (index * block_size));
+		block->m_next = m_ptr_free_head;
+		m_ptr_free_head = block;
+	}
+	m_num_slabs++;
+}
+
+template <typename T>
+void*
+GsamObjectPool<T>::Allocate (std::size_t size)
+{
+	if (size != sizeof (T))
+	{
+		//a subclass without a pool of its own
+		return ::operator new (size);
+	}
+
+	if (0 == m_ptr_free_head)
+	{
+		GsamObjectPool<T>::AddSlab();
+	}
+
+	FreeBlock* block = m_ptr_free_head;
+	m_ptr_free_head = block->m_next;
+
+	m_num_allocations++;
+	m_num_in_use++;
+	if (m_num_in_use > m_num_peak_in_use)
+	{
+		m_num_peak_in_use = m_num_in_use;
+	}
+
+	return block;
+}
+
+template <typename T>
+void
+GsamObjectPool<T>::Free (void* ptr, std::size_t size)
+{
+	if (0 == ptr)
+	{
+		return;
+	}
+
+	if (size != sizeof (T))
+	{
+		::operator delete (ptr);
+		return;
+	}
+
+	FreeBlock* block = static_cast<FreeBlock*>(ptr);
+	block->m_next = m_ptr_free_head;
+	m_ptr_free_head = block;
+
+	m_num_in_use--;
+}
+
+template <typename T>
+uint64_t
+GsamObjectPool<T>::GetNumberOfAllocations (void)
+{
+	return m_num_allocations;
+}
+
+template <typename T>
+uint64_t
+GsamObjectPool<T>::GetNumberOfSlabs (void)
+{
+	return m_num_slabs;
+}
+
+template <typename T>
+uint64_t
+GsamObjectPool<T>::GetNumberOfObjectsInUse (void)
+{
+	return m_num_in_use;
+}
+
+template <typename T>
+uint64_t
+GsamObjectPool<T>::GetPeakObjectsInUse (void)
+{
+	return m_num_peak_in_use;
+}
+
 class GsamConfig : public Object {
 public:	//Object override
 	static TypeId GetTypeId (void);
@@ -64,10 +213,12 @@ public:	//static methods
 	static uint8_t GetDefaultIpsecProtocolId (void);
 	static IpSec::SA_Proposal_PROTOCOL_ID GetDefaultGSAProposalId (void);
 	static Ipv4Address GetIgmpv3DestGrpReportAddress (void);
+	static Ipv4Address GetNqControlGroupAddress (void);
+	static uint32_t GetLeasedSpiRangeStart (void);
 	static Ptr<GsamConfig> GetSingleton (void);
 	static bool IsFalseByPercentage (uint16_t percentage_0_to_100);
 	static void ReadAndParse (Ptr<GsamConfig> singleton);
-public:	//log method
+public:	//log method, printed through NS_LOG component "GsamSa", compiled out of optimized builds
 	static void Log (	const std::string& func_name,
 						uint32_t node_id,
 						const Ptr<GsamInitSession> session,
@@ -103,6 +254,7 @@ public:	//
 	void LogNonsecGroupAverageDelay (void);
 	void PlotSecGroupDelay (void);
 	void PlotSecGroupDelayInRange (Time max);
+	void PlotSecGroupDelayHistogram (Time bin_width);
 	void PlotNonsecGroupDelay (void);
 	void LogNonSecGroupJoinWorstDelay (void);
 	void LogSecGroupJoinWorstDelay (void);
@@ -111,6 +263,10 @@ public:	//
 	void LogNonSecGroupJoinAverageAndWorstDelay (void);
 	void LogSecGroupJoinAverageAndWorstDelay (void);
 	void LogALlJoinAverageAndWorstDelay (uint16_t percentage_rejection);
+	void LogRekeyStart (uint32_t node_id, Ipv4Address group_address);
+	void LogRekeyFinish (uint32_t node_id, Ipv4Address group_address);
+	void LogRekeyMessagesSent (uint32_t number_of_messages, uint32_t number_of_payloads);
+	void LogRekeyStatistics (void);
 public:	//const
 	//Gsam Configs
 	uint16_t GetSpiRejectPropability (void) const;
@@ -119,6 +275,7 @@ public:	//const
 	Time GetDefaultSessionTimeoutSeconds (void) const;
 	Ipv4Address GetAUsedSecGrpAddress (void) const;
 	Ipv4Address GetAUsedUnsecGrpAddress (void) const;
+	void GetUsedSecGrpAddresses (std::list<Ipv4Address>& retval) const;
 	uint16_t GetNumberOfNodes (void) const;
 	uint16_t GetNumberOfNqs (void) const;
 	bool IsNodeIsNq (uint32_t node_id) const;
@@ -150,8 +307,30 @@ public:	//const
 	Time GetGmJoinIntervalInSeconds (void) const;
 	Time GetSimulationTimeInSeconds (void) const;
 	bool IsInstallBeforeNqAck (void) const;
+	Time GetSpiRekeyGraceTimeInSeconds (void) const;
+	uint32_t GetSpiLeaseSize (void) const;
+	bool IsMulticastNqPush (void) const;
+	//sa lifetimes, 0 means no limit
+	Time GetSaSoftLifetimeInSeconds (void) const;
+	Time GetSaHardLifetimeInSeconds (void) const;
+	uint64_t GetSaSoftLifetimeInBytes (void) const;
+	uint64_t GetSaHardLifetimeInBytes (void) const;
+	uint16_t GetSaLifetimeJitterPercentage (void) const;
+	bool IsSaSoftLifetimeSet (void) const;
+	Time GetRekeyCheckIntervalInSeconds (void) const;
+	uint16_t GetRekeyMaxGroupsPerRound (void) const;
+	//ike_sa_init admission on the q
+	bool IsIkeCookieRequired (uint32_t number_of_half_open_sessions) const;
+	uint32_t GetMaxHalfOpenInitSessions (void) const;
+	bool IsHalfOpenReapingEnabled (void) const;
+	//keying material and the cpu time it costs, see GsamCrypto
+	bool IsIkeKeyExchangeX25519 (void) const;
+	Time GetCryptoCost (uint32_t number_of_dh, uint32_t number_of_prf) const;
+	uint16_t GetNumberOfCryptoWorkers (void) const;
+	uint32_t GetCryptoQueueLimit (void) const;
 private://private methods
 	void SetQAddress (Ipv4Address address);
+	double GetNumericSetting (const std::string& setting_name, double default_value) const;
 private:	//static member
 	static Ptr<GsamConfig> m_ptr_config_instance;
 	const static std::string m_path_config;
@@ -167,6 +346,10 @@ private:
 	std::map<std::pair<uint32_t, uint32_t>, Time> m_map_node_id_group_address_to_time_join_finish;
 	std::map<std::pair<uint32_t, uint32_t>, Time> m_map_node_id_group_address_to_time_join_sec_delay;
 	std::map<std::pair<uint32_t, uint32_t>, Time> m_map_node_id_group_address_to_time_join_nonsec_delay;
+	std::map<std::pair<uint32_t, uint32_t>, Time> m_map_node_id_group_address_to_time_rekey_start;
+	std::list<Time> m_lst_rekey_windows;
+	uint32_t m_num_rekey_messages;
+	uint32_t m_num_rekey_payloads;
 };
 
 class GsamInfo : public Object {
@@ -197,6 +380,9 @@ public:	//self-defined
 	void SetSecGrpEnd (Ipv4Address address);
 	void OccupyIpsecSpi (uint32_t spi);
 	void InsertDeletedGsaPushId (uint32_t gsa_push_id);
+	uint32_t GetIpsecSpiToPropose (void);
+	void LeaseIpsecSpiRange (void);
+	void ReserveIpsecSpiRange (uint32_t first_spi, uint32_t last_spi);
 public: //const
 	Time GetRetransmissionDelay (void) const;
 	uint32_t GetLocalAvailableIpsecSpi (void) const;
@@ -204,6 +390,11 @@ public: //const
 	uint32_t GenerateIpsecSpi (void) const;
 	bool IsIpsecSpiOccupied (uint32_t spi) const;
 	bool IsGsaPushIdDeleted (uint32_t gsa_push_id) const;
+	bool IsIpsecSpiLeased (uint32_t spi) const;
+	const std::list<std::pair<uint32_t, uint32_t> >& GetIpsecSpiLeases (void) const;
+	uint32_t GetNumberOfOccupiedGsamSpis (void) const;
+	uint32_t GetNumberOfOccupiedIpsecSpis (void) const;
+	uint32_t GetNumberOfOccupiedGsaPushIds (void) const;
 private:
 	uint64_t GetLocalAvailableGsamSpi (void) const;
 	uint32_t GetLocalAvailableGsaPushId (void) const;
@@ -219,6 +410,9 @@ private:	//fields
 	Ipv4Address m_sec_group_start;
 	Ipv4Address m_sec_group_end;
 	std::set<uint32_t> m_set_deleted_gsa_push_id;
+	//spi ranges, first and last spi, leased to the q by all nqs and gms
+	std::list<std::pair<uint32_t, uint32_t> > m_lst_spi_leases;
+	uint32_t m_spi_lease_cursor;	//next spi of the last lease to propose, q only
 };
 
 class GsamSa : public Object {
@@ -251,18 +445,35 @@ public:	//self defined
 	void SetInitiatorSpi (uint64_t spi);
 	void SetResponderSpi (uint64_t spi);
 	bool IsHalfOpen (void) const;
+	//keying material, only kept if the key exchange is real
+	void SetDhPrivateKey (const std::vector<uint8_t>& private_key);
+	void SetInitiatorNonce (const std::vector<uint8_t>& nonce);
+	void SetResponderNonce (const std::vector<uint8_t>& nonce);
+	void SetKeyMaterial (const std::vector<uint8_t>& key_material);
 public:	//const
 	GsamSa::SA_TYPE GetType (void) const;
 	uint64_t GetInitiatorSpi (void) const;
 	uint64_t GetResponderSpi (void) const;
+	const std::vector<uint8_t>& GetDhPrivateKey (void) const;
+	const std::vector<uint8_t>& GetInitiatorNonce (void) const;
+	const std::vector<uint8_t>& GetResponderNonce (void) const;
+	const std::vector<uint8_t>& GetKeyMaterial (void) const;
 private:
 	void FreeLocalSpi (void);
 private:	//fields
 	GsamSa::SA_TYPE m_type;
 	uint64_t m_initiator_spi;
 	uint64_t m_responder_spi;
-	Ptr<GsamInitSession> m_ptr_init_session;
+	GsamInitSession* m_ptr_init_session;	//weak, the session owns its sa
 	Ptr<EncryptionFunction> m_ptr_encrypt_fn;
+	//init sa, until the peer's public value arrives
+	std::vector<uint8_t> m_vec_dh_private_key;
+	//init sa, ni and nr, kek sas are derived from them as well
+	std::vector<uint8_t> m_vec_initiator_nonce;
+	std::vector<uint8_t> m_vec_responder_nonce;
+	//init sa, sk_d | sk_ai | sk_ar | sk_ei | sk_er | sk_pi | sk_pr
+	//kek sa, sk_e | sk_a
+	std::vector<uint8_t> m_vec_key_material;
 };
 
 class EncryptionFunction : public Object {
@@ -299,6 +510,9 @@ public:	//Object override
 	GsaPushSession ();
 	virtual ~GsaPushSession();
 	virtual TypeId GetInstanceTypeId (void) const;
+public:	//pooled allocation, see GsamObjectPool
+	static void* operator new (std::size_t size);
+	static void operator delete (void* ptr, std::size_t size);
 protected:
 	/*
 	 * This function will notify other components connected to the node that a new stack member is now connected
@@ -318,6 +532,8 @@ public:	//non-const
 	void SetDatabase (Ptr<IpSecDatabase> database);
 	void SetGmSession (Ptr<GsamSession> gsam_gm_session);
 	void SelfRemoval (void);
+	//a peer never answered, the push is dropped with its proposed spis
+	void Abort (void);
 	void MarkGmSessionReplied (void);
 	void MarkNqSessionReplied (Ptr<GsamSession> nq_session);
 	void MarkOtherGmSessionReplied (Ptr<GsamSession> other_gm_session);
@@ -339,6 +555,8 @@ public:	//const
 	uint32_t GetId (void) const;
 	GsaPushSession::GSA_PUSH_STATUS GetStatus (void) const;
 	bool IsAllReplied (void) const;
+	bool IsAwaitingReplyFrom (Ptr<GsamSession> session) const;
+	bool IsGsaPairInstalled (void) const;
 	const Ptr<IpSecSAEntry> GetGsaQ (void) const;
 	const Ptr<IpSecSAEntry> GetGsaR (void) const;
 	uint32_t GetOldGsaQSpi (void) const;
@@ -356,9 +574,10 @@ private:	//fields
 	GsaPushSession::GSA_PUSH_STATUS m_status;
 	bool m_flag_gms_spi_requested;
 	bool m_flag_nqs_spi_requested;
-	Ptr<IpSecDatabase> m_ptr_database;
-	Ptr<GsamSession> m_ptr_gm_session;
+	IpSecDatabase* m_ptr_database;	//weak, the database owns the push sessions
+	GsamSession* m_ptr_gm_session;	//weak, the gm session owns its push session
 	bool m_flag_gm_session_acked_notified;
+	bool m_flag_gsa_pair_installed;	//q only, may be set before the nqs ack, see install-before-nq-ack
 
 	//nq sessions
 	std::set<Ptr<GsamSession> > m_set_ptr_nq_sessions_sent_unreplied;
@@ -389,14 +608,15 @@ public:	//Object override
 	GsamInitSession ();
 	virtual ~GsamInitSession();
 	virtual TypeId GetInstanceTypeId (void) const;
+public:	//pooled allocation, see GsamObjectPool
+	static void* operator new (std::size_t size);
+	static void operator delete (void* ptr, std::size_t size);
 protected:
 	/*
 	 * This function will notify other components connected to the node that a new stack member is now connected
 	 * This will be used to notify Layer 3 protocol of layer 4 protocol stack to connect them together.
 	 */
 	virtual void NotifyNewAggregate ();
-
-private:
 	virtual void DoDispose (void);
 
 public:	//static
@@ -417,8 +637,16 @@ public:
 	void SetNumberRetransmission (uint16_t number_retransmission);
 	void DecrementNumberRetransmission (void);
 	void SetFirstJoinSession (Ptr<GsamSession> session);
+	//sessions joining through this init session share one ike_auth exchange
+	void PushBackSessionAwaitingAuth (Ptr<GsamSession> session);
+	void StartAuth (std::list<Ptr<GsamSession> >& retval_sessions);
+	void FinishAuth (void);
+	void ClearSession (Ptr<GsamSession> session);
+	//a crypto worker of the node is on the last message, repeats of it are dropped meanwhile
+	void SetCryptoPending (bool crypto_pending);
 public: //const
 	bool HaveInitSa (void) const;
+	Ptr<GsamSa> GetInitSa (void) const;
 	Ptr<GsamInfo> GetInfo (void) const;
 	Ptr<IpSecDatabase> GetDatabase (void) const;
 	virtual uint64_t GetInitSaResponderSpi (void) const;
@@ -434,11 +662,16 @@ public: //const
 	bool IsRetransmit (void) const;
 	uint16_t GetRemainingRetransmissionCount (void) const;
 	Ptr<GsamSession> GetFirstJoinSession (void) const;
+	bool HaveSessionsAwaitingAuth (void) const;
+	bool IsAuthInFlight (void) const;
+	bool IsCryptoPending (void) const;
 protected:
 	void TimeoutAction (void);
+	void ReapHalfOpen (void);
+	void LeaveHalfOpen (void);
 protected:
 	uint32_t m_current_message_id;
-	Ptr<IpSecDatabase> m_ptr_database;
+	IpSecDatabase* m_ptr_database;	//weak, the database owns the sessions
 	GsamInitSession::SESSION_ROLE m_session_role;
 	Timer m_timer_retransmit;
 	Timer m_timer_timeout;
@@ -448,6 +681,10 @@ private:
 	Ipv4Address m_peer_address;
 	Ptr<GsamSa> m_ptr_init_sa;
 	Ptr<GsamSession> m_ptr_first_join_session;
+	std::list<Ptr<GsamSession> > m_lst_sessions_awaiting_auth;
+	std::list<Ptr<GsamSession> > m_lst_sessions_in_auth;
+	bool m_flag_crypto_pending;
+	bool m_flag_half_open;	//counted by the database, from answering an ike_sa_init until the ike_auth or the end
 };
 
 class GsamSession : public GsamInitSession {
@@ -457,6 +694,9 @@ public:	//Object override
 	GsamSession ();
 	virtual ~GsamSession();
 	virtual TypeId GetInstanceTypeId (void) const;
+public:	//pooled allocation, see GsamObjectPool
+	static void* operator new (std::size_t size);
+	static void operator delete (void* ptr, std::size_t size);
 protected:
 	/*
 	 * This function will notify other components connected to the node that a new stack member is now connected
@@ -489,8 +729,14 @@ public:	//self defined
 	void SetNumberRetransmission (uint16_t number_retransmission);
 	void DecrementNumberRetransmission (void);
 	void SetIgmpInterface (Ptr<Ipv4InterfaceMulticast> interface);
+	void SetNumberOfSpiLeasesSent (uint32_t num_spi_leases);
+	void SetAwaitingResponse (bool awaiting_response);
+	void SetLeaving (bool leaving);
+	void PushBackPendingPacket (Ptr<Packet> packet);
+	Ptr<Packet> PopFrontPendingPacket (void);
 public: //const
 	bool HaveKekSa (void) const;
+	Ptr<GsamSa> GetKekSa (void) const;
 	Ptr<GsamInfo> GetInfo (void) const;
 	Ptr<IpSecDatabase> GetDatabase (void) const;
 	Ptr<GsamInitSession> GetInitSession (void) const;
@@ -504,15 +750,23 @@ public: //const
 	Ptr<IpSecSAEntry> GetRelatedGsaQ (void) const;
 	Ptr<IpSecPolicyEntry> GetRelatedPolicy (void) const;
 	virtual bool IsHostNonQuerier (void) const;
+	bool HaveGsaPushSession (void) const;
 	Ptr<GsaPushSession> GetGsaPushSession (void) const;
 	Ptr<GsaPushSession> GetGsaPushSession (uint32_t gsa_push_id) const;
+	const std::set<Ptr<GsaPushSession> >& GetGsaPushSessions (void) const;
 	Ptr<GsamSessionGroup> GetSessionGroup (void) const;
 	Ptr<Ipv4InterfaceMulticast> GetIgmpInterface (void) const;
+	uint32_t GetNumberOfSpiLeasesSent (void) const;
+	bool IsAwaitingResponse (void) const;
+	bool IsLeaving (void) const;
+	//a request of it is unanswered or queued, or a gsa push still counts on it
+	bool IsBusy (void) const;
 private:
 	void TimeoutAction (void);
+	void RemoveIfLeavingAndIdle (void);
 private:	//fields
-	Ptr<GsamInitSession> m_ptr_init_session;
-	Ptr<GsamSessionGroup> m_ptr_session_group;
+	GsamInitSession* m_ptr_init_session;	//weak, the database owns the init sessions
+	GsamSessionGroup* m_ptr_session_group;	//weak, the group holds its sessions
 	Ipv4Address m_group_address;
 	Ptr<GsamSa> m_ptr_kek_sa;
 	Ptr<IpSecSAEntry> m_ptr_related_gsa_r;
@@ -521,6 +775,11 @@ private:	//fields
 	//other gm sessions for spi request
 	std::set<Ptr<GsaPushSession> > m_set_ptr_push_sessions;
 	Ptr<Ipv4InterfaceMulticast> m_ptr_igmp_interface;
+	uint32_t m_num_spi_leases_sent;	//q only, spi leases of GsamInfo the peer has been told about
+	//requests wait here while an earlier one is not yet answered, so each keeps its retransmissions
+	bool m_flag_awaiting_response;
+	std::list<Ptr<Packet> > m_lst_pending_packets;
+	bool m_flag_leaving;	//the kek sa is being deleted, see GsamL4Protocol::Send_KEK_SA_DELETE
 };
 
 class GsamSessionGroup : public Object {
@@ -529,6 +788,9 @@ public:	//Object override
 	GsamSessionGroup ();
 	virtual ~GsamSessionGroup();
 	virtual TypeId GetInstanceTypeId (void) const;
+public:	//pooled allocation, see GsamObjectPool
+	static void* operator new (std::size_t size);
+	static void operator delete (void* ptr, std::size_t size);
 protected:
 	/*
 	 * This function will notify other components connected to the node that a new stack member is now connected
@@ -548,6 +810,12 @@ public: //self-defined
 	void PushBackSession (Ptr<GsamSession> session);
 	void RemoveSession (Ptr<GsamSession> session);
 	std::list<Ptr<GsamSession> >& GetSessions (void);
+	void PushBackSessionAwaitingPush (Ptr<GsamSession> session);
+	Ptr<GsamSession> PopFrontSessionAwaitingPush (void);
+	void StartRekey (uint32_t new_gsa_q_spi);
+	void InsertSessionAwaitingRekeyAck (Ptr<GsamSession> session);
+	void RemoveSessionAwaitingRekeyAck (Ptr<GsamSession> session);
+	void FinishRekey (void);
 	void EtablishPolicy (Ipv4Address group_address,
 							uint8_t protocol_id,
 							IpSec::PROCESS_CHOICE policy_process_choice,
@@ -566,15 +834,24 @@ public:	//const
 	Ptr<IpSecSAEntry> GetRelatedGsaQ (void) const;
 	const std::list<Ptr<GsamSession> >& GetSessionsConst (void) const;
 	Ptr<GsamSession> GetSessionByGsaRSpi (uint32_t gsa_r_spi);
+	bool IsRekeying (void) const;
+	bool IsRekeyAcked (void) const;
+	uint32_t GetRekeyGsaQSpi (void) const;
+	bool IsSoftLifetimeExpired (void) const;
 private:
 	Ptr<IpSecSAEntry> InstallInboundGsa (uint32_t spi);
 	Ptr<IpSecSAEntry> InstallOutboundGsa (uint32_t spi);
 private:	//fields
 	Ipv4Address m_group_address;
-	Ptr<IpSecDatabase> m_ptr_database;
+	IpSecDatabase* m_ptr_database;	//weak, the database owns the groups
 	Ptr<IpSecSAEntry> m_ptr_related_gsa_q;
 	std::list<Ptr<GsamSession> > m_lst_sessions;
 	Ptr<IpSecPolicyEntry> m_ptr_related_policy;
+	//q only, gm sessions whose gsa push waits for the one in flight for this group
+	std::list<Ptr<GsamSession> > m_lst_sessions_awaiting_push;
+	//q only, gsa_q spi a rekey switches to once the gms and nqs acked its re-push, 0 if not rekeying
+	uint32_t m_rekey_gsa_q_spi;
+	std::set<Ptr<GsamSession> > m_set_sessions_awaiting_rekey_ack;
 };
 
 class IpSecSAEntry : public Object {
@@ -589,6 +866,9 @@ public:	//Object override
 	IpSecSAEntry ();
 	virtual ~IpSecSAEntry();
 	virtual TypeId GetInstanceTypeId (void) const;
+public:	//pooled allocation, see GsamObjectPool
+	static void* operator new (std::size_t size);
+	static void operator delete (void* ptr, std::size_t size);
 protected:
 	/*
 	 * This function will notify other components connected to the node that a new stack member is now connected
@@ -606,17 +886,36 @@ public:
 	void AssociatePolicy (Ptr<IpSecPolicyEntry> policy);
 	void SetInbound (void);
 	void SetOutbound (void);
+	void CountPacket (uint32_t packet_size);
+	void SetKeyMaterial (const std::vector<uint8_t>& key_material);
 public:	//const
 	uint32_t GetSpi (void) const;
 	Ptr<IpSecPolicyEntry> GetPolicyEntry (void) const;
 	bool IsInbound (void) const;
 	bool IsOutbound (void) const;
+	Time GetAge (void) const;
+	uint64_t GetNumberOfBytes (void) const;
+	uint64_t GetNumberOfPackets (void) const;
+	bool IsSoftLifetimeExpired (void) const;
+	bool IsHardLifetimeExpired (void) const;
+	const std::vector<uint8_t>& GetKeyMaterial (void) const;
+private:
+	void ResetLifetime (void);
 private:	//fields
 	IpSecSAEntry::DIRECTION m_direction;
 	uint32_t m_spi;
 	Ptr<EncryptionFunction> m_ptr_encrypt_fn;
-	Ptr<IpSecSADatabase> m_ptr_sad;
-	Ptr<IpSecPolicyEntry> m_ptr_policy;
+	IpSecSADatabase* m_ptr_sad;	//weak, the root sad owns its entries
+	IpSecPolicyEntry* m_ptr_policy;	//weak
+	Time m_time_installed;
+	Time m_soft_lifetime;	//jittered, so the sas installed together do not expire together
+	Time m_hard_lifetime;
+	uint64_t m_soft_lifetime_bytes;
+	uint64_t m_hard_lifetime_bytes;
+	uint64_t m_num_bytes;
+	uint64_t m_num_packets;
+	//q only, sk_e | sk_a, empty if the key exchange is the dummy one
+	std::vector<uint8_t> m_vec_key_material;
 };
 
 class IpSecSADatabase : public Object {
@@ -631,6 +930,9 @@ public:	//Object override
 	IpSecSADatabase ();
 	virtual ~IpSecSADatabase();
 	virtual TypeId GetInstanceTypeId (void) const;
+public:	//pooled allocation, see GsamObjectPool
+	static void* operator new (std::size_t size);
+	static void operator delete (void* ptr, std::size_t size);
 protected:
 	/*
 	 * This function will notify other components connected to the node that a new stack member is now connected
@@ -656,8 +958,8 @@ private:
 	void PushBackEntry (Ptr<IpSecSAEntry> entry);
 private:	//fields
 	IpSecSADatabase::DIRECTION m_direction;
-	Ptr<IpSecDatabase> m_ptr_root_database;
-	Ptr<IpSecPolicyEntry> m_ptr_policy_entry;	//inbound, outbound logical database ptr in policy entry
+	IpSecDatabase* m_ptr_root_database;	//weak
+	IpSecPolicyEntry* m_ptr_policy_entry;	//weak, inbound, outbound logical database ptr in policy entry
 	std::list<Ptr<IpSecSAEntry> > m_lst_entries;
 };
 
@@ -667,6 +969,9 @@ public:	//Object override
 	IpSecPolicyEntry ();
 	virtual ~IpSecPolicyEntry();
 	virtual TypeId GetInstanceTypeId (void) const;
+public:	//pooled allocation, see GsamObjectPool
+	static void* operator new (std::size_t size);
+	static void operator delete (void* ptr, std::size_t size);
 protected:
 	/*
 	 * This function will notify other components connected to the node that a new stack member is now connected
@@ -726,7 +1031,7 @@ private:
 	uint16_t m_dest_transport_protocol_starting_num;
 	uint16_t m_dest_transport_protocol_ending_num;
 	IpSec::PROCESS_CHOICE m_process_choise;
-	Ptr<IpSecPolicyDatabase> m_ptr_spd;
+	IpSecPolicyDatabase* m_ptr_spd;	//weak, the spd owns its policies
 	Ptr<IpSecSADatabase> m_ptr_outbound_sad;
 	Ptr<IpSecSADatabase> m_ptr_inbound_sad;
 };
@@ -764,7 +1069,7 @@ public:	//const
 private:
 	void PushBackEntry (Ptr<IpSecPolicyEntry> entry);
 private:	//fields
-	Ptr<IpSecDatabase> m_ptr_root_database;
+	IpSecDatabase* m_ptr_root_database;	//weak
 	std::list<Ptr<IpSecPolicyEntry> > m_lst_entries;
 };
 
@@ -801,6 +1106,9 @@ public:	//self defined
 	Ptr<IpSecPolicyDatabase> GetSPD (void);
 	Ptr<IpSecSADatabase> GetSAD (void);
 	void SetGsam (Ptr<GsamL4Protocol> gsam);
+	//responder init sessions answered an ike_sa_init but without an ike_auth yet
+	void IncrementHalfOpenInitSessions (void);
+	void DecrementHalfOpenInitSessions (void);
 public:	//const
 	Ptr<GsamInfo> GetInfo (void) const;
 	Ptr<GsamSession> GetPhaseTwoSession (uint64_t initiator_spi, uint64_t responder_spi, uint32_t message_id, Ipv4Address peer_address) const;
@@ -816,18 +1124,25 @@ public:	//const
 	bool IsHostQuerier (void) const;
 	bool IsHostGroupMember (void) const;
 	bool IsHostNonQuerier (void) const;
+	bool IsGsaPushInFlight (Ipv4Address group_address) const;
+	void GetInFlightGsaSpis (std::set<uint32_t>& retval) const;
+	uint32_t GetNumberOfHalfOpenInitSessions (void) const;
+	Ptr<GsamSession> GetNqSession (Ipv4Address querier_address) const;
+	Ptr<GsamSession> GetGroupSession (Ipv4Address group_address, Ipv4Address peer_address) const;
 private:
 	Ptr<GsamSessionGroup> CreateSessionGroup (Ipv4Address group_address);
 private:	//fields
+	//owned, what they hold points back here weakly, DoDispose tears them down in order
 	std::list<Ptr<GsamSession> > m_lst_ptr_all_sessions;
 	std::list<Ptr<GsamInitSession> > m_lst_init_sessions;
 	std::list<Ptr<GsamSessionGroup> > m_lst_ptr_session_groups;
 	std::set<Ptr<GsaPushSession> > m_set_ptr_gsa_push_sessions;
 	uint32_t m_window_size;
+	uint32_t m_num_half_open_init_sessions;
 	Ptr<IpSecPolicyDatabase> m_ptr_spd;
 	Ptr<IpSecSADatabase> m_ptr_sad;
 	Ptr<GsamInfo> m_ptr_info;
-	Ptr<GsamL4Protocol> m_ptr_gsam;
+	GsamL4Protocol* m_ptr_gsam;	//weak, the protocol owns its database
 };
 
 class SimpleAuthenticationHeader : public Header {
@@ -932,6 +1247,9 @@ public:	//self-defined non-const
 													uint8_t protocol,
 													Ptr<Ipv4Route> route);
 	void DoGsam (Ptr<Ipv4InterfaceMulticast> interface, Ipv4Address group_address, const Ptr<GsamFilterCache> cache = 0);
+	//the leave of the group is reported, its session with the q goes
+	void UndoGsam (Ptr<Ipv4InterfaceMulticast> interface, Ipv4Address group_address);
+	bool IsUndoingGsam (Ptr<Ipv4InterfaceMulticast> interface, Ipv4Address group_address) const;
 	void GsamCallBack (Ptr<GsamSession> session);
 private:
 	Ptr<GsamL4Protocol> m_ptr_gsam;
@@ -27,7 +27,7 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("Ipv4EndPointDemuxMulticast");
 
 Ipv4EndPointDemuxMulticast::Ipv4EndPointDemuxMulticast ()
-  : m_ephemeral (49152), m_portLast (65535), m_portFirst (49152)
+  : m_ephemeral (49152), m_portLast (65535), m_portFirst (49152), m_nEndPoints (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -35,36 +35,38 @@ Ipv4EndPointDemuxMulticast::Ipv4EndPointDemuxMulticast ()
 Ipv4EndPointDemuxMulticast::~Ipv4EndPointDemuxMulticast ()
 {
   NS_LOG_FUNCTION (this);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  for (PortMap::iterator p = m_ports.begin (); p != m_ports.end (); p++)
     {
-      Ipv4EndPointMulticast *endPoint = *i;
-      delete endPoint;
+      for (EndPointsI i = p->second.begin (); i != p->second.end (); i++) 
+        {
+          Ipv4EndPointMulticast *endPoint = *i;
+          delete endPoint;
+        }
     }
-  m_endPoints.clear ();
+  m_ports.clear ();
+  m_nEndPoints = 0;
 }
 
 bool
 Ipv4EndPointDemuxMulticast::LookupPortLocal (uint16_t port)
 {
   NS_LOG_FUNCTION (this << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
-    {
-      if ((*i)->GetLocalPort  () == port) 
-        {
-          return true;
-        }
-    }
-  return false;
+  // empty buckets are erased, so any bucket holds an end point
+  return m_ports.find (port) != m_ports.end ();
 }
 
 bool
 Ipv4EndPointDemuxMulticast::LookupLocal (Ipv4Address addr, uint16_t port)
 {
   NS_LOG_FUNCTION (this << addr << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  PortMap::iterator p = m_ports.find (port);
+  if (p == m_ports.end ())
+    {
+      return false;
+    }
+  for (EndPointsI i = p->second.begin (); i != p->second.end (); i++) 
     {
-      if ((*i)->GetLocalPort () == port &&
-          (*i)->GetLocalAddress () == addr) 
+      if ((*i)->GetLocalAddress () == addr) 
         {
           return true;
         }
@@ -72,6 +74,14 @@ Ipv4EndPointDemuxMulticast::LookupLocal (Ipv4Address addr, uint16_t port)
   return false;
 }
 
+void
+Ipv4EndPointDemuxMulticast::Insert (Ipv4EndPointMulticast *endPoint)
+{
+  m_ports[endPoint->GetLocalPort ()].push_back (endPoint);
+  m_nEndPoints++;
+  NS_LOG_DEBUG ("Now have >>" << m_nEndPoints << "<< endpoints.");
+}
+
 Ipv4EndPointMulticast *
 Ipv4EndPointDemuxMulticast::Allocate (void)
 {
@@ -83,8 +93,7 @@ Ipv4EndPointDemuxMulticast::Allocate (void)
       return 0;
     }
   Ipv4EndPointMulticast *endPoint = new Ipv4EndPointMulticast (Ipv4Address::GetAny (), port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -99,8 +108,7 @@ Ipv4EndPointDemuxMulticast::Allocate (Ipv4Address address)
       return 0;
     }
   Ipv4EndPointMulticast *endPoint = new Ipv4EndPointMulticast (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -122,8 +130,7 @@ Ipv4EndPointDemuxMulticast::Allocate (Ipv4Address address, uint16_t port)
       return 0;
     }
   Ipv4EndPointMulticast *endPoint = new Ipv4EndPointMulticast (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -132,24 +139,24 @@ Ipv4EndPointDemuxMulticast::Allocate (Ipv4Address localAddress, uint16_t localPo
                              Ipv4Address peerAddress, uint16_t peerPort)
 {
   NS_LOG_FUNCTION (this << localAddress << localPort << peerAddress << peerPort);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  PortMap::iterator p = m_ports.find (localPort);
+  if (p != m_ports.end ())
     {
-      if ((*i)->GetLocalPort () == localPort &&
-          (*i)->GetLocalAddress () == localAddress &&
-          (*i)->GetPeerPort () == peerPort &&
-          (*i)->GetPeerAddress () == peerAddress) 
+      for (EndPointsI i = p->second.begin (); i != p->second.end (); i++) 
         {
-          NS_LOG_WARN ("No way we can allocate this end-point.");
-          /* no way we can allocate this end-point. */
-          return 0;
+          if ((*i)->GetLocalAddress () == localAddress &&
+              (*i)->GetPeerPort () == peerPort &&
+              (*i)->GetPeerAddress () == peerAddress) 
+            {
+              NS_LOG_WARN ("No way we can allocate this end-point.");
+              /* no way we can allocate this end-point. */
+              return 0;
+            }
         }
     }
   Ipv4EndPointMulticast *endPoint = new Ipv4EndPointMulticast (localAddress, localPort);
   endPoint->SetPeer (peerAddress, peerPort);
-  m_endPoints.push_back (endPoint);
-
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -157,12 +164,23 @@ void
 Ipv4EndPointDemuxMulticast::DeAllocate (Ipv4EndPointMulticast *endPoint)
 {
   NS_LOG_FUNCTION (this << endPoint);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  PortMap::iterator p = m_ports.find (endPoint->GetLocalPort ());
+  if (p == m_ports.end ())
+    {
+      return;
+    }
+  for (EndPointsI i = p->second.begin (); i != p->second.end (); i++) 
     {
       if (*i == endPoint)
         {
           delete endPoint;
-          m_endPoints.erase (i);
+          // keep the allocation order, Lookup () returns matches in it
+          p->second.erase (i);
+          if (p->second.empty ())
+            {
+              m_ports.erase (p);
+            }
+          m_nEndPoints--;
           break;
         }
     }
@@ -176,35 +194,70 @@ Ipv4EndPointDemuxMulticast::GetAllEndPoints (void)
 {
   NS_LOG_FUNCTION (this);
   EndPoints ret;
+  ret.reserve (m_nEndPoints);
 
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  for (PortMap::iterator p = m_ports.begin (); p != m_ports.end (); p++)
     {
-      Ipv4EndPointMulticast* endP = *i;
-      ret.push_back (endP);
+      ret.insert (ret.end (), p->second.begin (), p->second.end ());
     }
   return ret;
 }
 
 
+Ipv4EndPointDemuxMulticast::EndPoints
+Ipv4EndPointDemuxMulticast::Lookup (Ipv4Address daddr, uint16_t dport, 
+                           Ipv4Address saddr, uint16_t sport,
+                           Ptr<Ipv4InterfaceMulticast> incomingInterface)
+{
+  NS_LOG_FUNCTION (this << daddr << dport << saddr << sport << incomingInterface);
+  EndPoints ret;
+  Lookup (daddr, dport, saddr, sport, incomingInterface, ret);
+  return ret;
+}
+
 /*
  * If we have an exact match, we return it.
  * Otherwise, if we find a generic match, we return it.
  * Otherwise, we return 0.
  */
-Ipv4EndPointDemuxMulticast::EndPoints
+void
 Ipv4EndPointDemuxMulticast::Lookup (Ipv4Address daddr, uint16_t dport, 
                            Ipv4Address saddr, uint16_t sport,
-                           Ptr<Ipv4InterfaceMulticast> incomingInterface)
+                           Ptr<Ipv4InterfaceMulticast> incomingInterface,
+                           EndPoints &endPoints)
 {
   NS_LOG_FUNCTION (this << daddr << dport << saddr << sport << incomingInterface);
-  
-  EndPoints retval1; // Matches exact on local port, wildcards on others
-  EndPoints retval2; // Matches exact on local port/adder, wildcards on others
-  EndPoints retval3; // Matches all but local address
-  EndPoints retval4; // Exact match on all 4
 
+  endPoints.clear ();
   NS_LOG_DEBUG ("Looking up endpoint for destination address " << daddr);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  PortMap::iterator p = m_ports.find (dport);
+  if (p == m_ports.end ())
+    {
+      NS_LOG_LOGIC ("No endpoint bound to dport " << dport);
+      return;
+    }
+
+  // Whether the packet is broadcast only depends on the packet and the
+  // interface, not on the endpoint
+  bool subnetDirected = false;
+  Ipv4Address incomingInterfaceAddr = daddr;  // may be a broadcast
+  for (uint32_t i = 0; i < incomingInterface->GetNAddresses (); i++)
+    {
+      Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
+      if (addr.GetLocal ().CombineMask (addr.GetMask ()) == daddr.CombineMask (addr.GetMask ()) &&
+          daddr.IsSubnetDirectedBroadcast (addr.GetMask ()))
+        {
+          subnetDirected = true;
+          incomingInterfaceAddr = addr.GetLocal ();
+        }
+    }
+  bool isBroadcast = (daddr.IsBroadcast () || subnetDirected == true);
+  NS_LOG_DEBUG ("dest addr " << daddr << " broadcast? " << isBroadcast);
+
+  // Rank of the matches in endPoints, from 1 (only local port matches
+  // exactly) to 4 (all 4 match); a better match empties endPoints
+  uint32_t rank = 0;
+  for (EndPointsI i = p->second.begin (); i != p->second.end (); i++) 
     {
       Ipv4EndPointMulticast* endP = *i;
 
@@ -220,14 +273,6 @@ Ipv4EndPointDemuxMulticast::Lookup (Ipv4Address daddr, uint16_t dport,
           continue;
         }
 
-      if (endP->GetLocalPort () != dport) 
-        {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                             << " because endpoint dport "
-                                             << endP->GetLocalPort ()
-                                             << " does not match packet dport " << dport);
-          continue;
-        }
       if (endP->GetBoundNetDevice ())
         {
           if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
@@ -239,20 +284,6 @@ Ipv4EndPointDemuxMulticast::Lookup (Ipv4Address daddr, uint16_t dport,
               continue;
             }
         }
-      bool subnetDirected = false;
-      Ipv4Address incomingInterfaceAddr = daddr;  // may be a broadcast
-      for (uint32_t i = 0; i < incomingInterface->GetNAddresses (); i++)
-        {
-          Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
-          if (addr.GetLocal ().CombineMask (addr.GetMask ()) == daddr.CombineMask (addr.GetMask ()) &&
-              daddr.IsSubnetDirectedBroadcast (addr.GetMask ()))
-            {
-              subnetDirected = true;
-              incomingInterfaceAddr = addr.GetLocal ();
-            }
-        }
-      bool isBroadcast = (daddr.IsBroadcast () || subnetDirected == true);
-      NS_LOG_DEBUG ("dest addr " << daddr << " broadcast? " << isBroadcast);
       bool localAddressMatchesWildCard = 
         endP->GetLocalAddress () == Ipv4Address::GetAny ();
       bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
@@ -282,38 +313,43 @@ Ipv4EndPointDemuxMulticast::Lookup (Ipv4Address daddr, uint16_t dport,
       if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
         continue;
 
-      // Now figure out which return list to add this one to
-      if (localAddressMatchesWildCard &&
-          remotePeerMatchesWildCard &&
-          remoteAddressMatchesWildCard)
-        { // Only local port matches exactly
-          retval1.push_back (endP);
-        }
-      if ((localAddressMatchesExact || (isBroadcast && localAddressMatchesWildCard))&&
-          remotePeerMatchesWildCard &&
-          remoteAddressMatchesWildCard)
-        { // Only local port and local address matches exactly
-          retval2.push_back (endP);
-        }
-      if (localAddressMatchesWildCard &&
-          remotePeerMatchesExact &&
-          remoteAddressMatchesExact)
-        { // All but local address
-          retval3.push_back (endP);
-        }
+      // Now figure out the best match this one is
+      uint32_t match = 0;
       if (localAddressMatchesExact &&
           remotePeerMatchesExact &&
           remoteAddressMatchesExact)
         { // All 4 match
-          retval4.push_back (endP);
+          match = 4;
+        }
+      else if (localAddressMatchesWildCard &&
+               remotePeerMatchesExact &&
+               remoteAddressMatchesExact)
+        { // All but local address
+          match = 3;
+        }
+      else if ((localAddressMatchesExact || (isBroadcast && localAddressMatchesWildCard)) &&
+               remotePeerMatchesWildCard &&
+               remoteAddressMatchesWildCard)
+        { // Only local port and local address matches exactly
+          match = 2;
+        }
+      else if (localAddressMatchesWildCard &&
+               remotePeerMatchesWildCard &&
+               remoteAddressMatchesWildCard)
+        { // Only local port matches exactly
+          match = 1;
         }
-    }
 
-  // Here we find the most exact match
-  if (!retval4.empty ()) return retval4;
-  if (!retval3.empty ()) return retval3;
-  if (!retval2.empty ()) return retval2;
-  return retval1;  // might be empty if no matches
+      if (match > rank)
+        {
+          endPoints.clear ();
+          rank = match;
+        }
+      if (match == rank && match != 0)
+        {
+          endPoints.push_back (endP);
+        }
+    }
 }
 
 Ipv4EndPointMulticast *
@@ -324,16 +360,17 @@ Ipv4EndPointDemuxMulticast::SimpleLookup (Ipv4Address daddr,
 {
   NS_LOG_FUNCTION (this << daddr << dport << saddr << sport);
 
+  PortMap::iterator p = m_ports.find (dport);
+  if (p == m_ports.end ())
+    {
+      return 0;
+    }
   // this code is a copy/paste version of an old BSD ip stack lookup
   // function.
   uint32_t genericity = 3;
   Ipv4EndPointMulticast *generic = 0;
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  for (EndPointsI i = p->second.begin (); i != p->second.end (); i++) 
     {
-      if ((*i)->GetLocalPort () != dport) 
-        {
-          continue;
-        }
       if ((*i)->GetLocalAddress () == daddr &&
           (*i)->GetPeerPort () == sport &&
           (*i)->GetPeerAddress () == saddr) 
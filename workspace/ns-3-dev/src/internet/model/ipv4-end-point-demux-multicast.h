@@ -22,8 +22,9 @@
 #define IPV4_END_POINT_DEMUX_H_MULTICAST
 
 #include <stdint.h>
-#include <list>
+#include <vector>
 #include "ns3/ipv4-address.h"
+#include "ns3/sgi-hashmap.h"
 #include "ipv4-interface-multicast.h"
 
 namespace ns3 {
@@ -34,10 +35,15 @@ class Ipv4EndPointMulticast;
  * \brief Demultiplexes packets to various transport layer endpoints
  *
  * This class serves as a lookup table to match partial or full information
- * about a four-tuple to an ns3::Ipv4EndPointMulticast.  It internally contains a list
- * of endpoints, and has APIs to add and find endpoints in this demux.  This
- * code is shared in common to TCP and UDP protocols in ns3.  This demux
- * sits between ns3's layer four and the socket layer
+ * about a four-tuple to an ns3::Ipv4EndPointMulticast.  It internally keeps
+ * the endpoints in buckets indexed by local port, and has APIs to add and
+ * find endpoints in this demux.  This code is shared in common to TCP and
+ * UDP protocols in ns3.  This demux sits between ns3's layer four and the
+ * socket layer
+ *
+ * Every lookup only visits the endpoints bound to the port looked up, so
+ * the cost of demultiplexing a packet does not grow with the number of
+ * sockets open on the node.
  */
 
 class Ipv4EndPointDemuxMulticast {
@@ -45,18 +51,21 @@ public:
   /**
    * \brief Container of the IPv4 endpoints.
    */
-  typedef std::list<Ipv4EndPointMulticast *> EndPoints;
+  typedef std::vector<Ipv4EndPointMulticast *> EndPoints;
 
   /**
    * \brief Iterator to the container of the IPv4 endpoints.
    */
-  typedef std::list<Ipv4EndPointMulticast *>::iterator EndPointsI;
+  typedef std::vector<Ipv4EndPointMulticast *>::iterator EndPointsI;
 
   Ipv4EndPointDemuxMulticast ();
   ~Ipv4EndPointDemuxMulticast ();
 
   /**
    * \brief Get the entire list of end points registered.
+   *
+   * The end points are grouped by local port, in no particular order.
+   *
    * \return list of Ipv4EndPointMulticast
    */
   EndPoints GetAllEndPoints (void);
@@ -100,6 +109,28 @@ public:
                     uint16_t sport,
                     Ptr<Ipv4InterfaceMulticast> incomingInterface);
 
+  /**
+   * \brief lookup for a match with all the parameters, into a caller
+   * provided container.
+   *
+   * Same as the Lookup () above, but the matches replace the content of
+   * endPoints, so a caller reusing the container does not allocate once it
+   * has grown to the number of matches.
+   *
+   * \param daddr destination address to test
+   * \param dport destination port to test
+   * \param saddr source address to test
+   * \param sport source port to test
+   * \param incomingInterface the incoming interface
+   * \param endPoints the matching IPv4EndPoints (could be 0 element)
+   */
+  void Lookup (Ipv4Address daddr, 
+               uint16_t dport, 
+               Ipv4Address saddr, 
+               uint16_t sport,
+               Ptr<Ipv4InterfaceMulticast> incomingInterface,
+               EndPoints &endPoints);
+
   /**
    * \brief simple lookup for a match with all the parameters.
    * \param daddr destination address to test
@@ -162,6 +193,33 @@ public:
 
 private:
 
+  /**
+   * \brief Hash function for the local ports.
+   */
+  struct PortHash
+  {
+    /**
+     * \brief Hash a port.
+     * \param port the port
+     * \returns the port itself
+     */
+    size_t operator() (uint16_t port) const
+    {
+      return port;
+    }
+  };
+
+  /**
+   * \brief End points bound to each local port, in allocation order.
+   */
+  typedef sgi::hash_map<uint16_t, EndPoints, PortHash> PortMap;
+
+  /**
+   * \brief Add an end point to the bucket of its local port.
+   * \param endPoint the end point
+   */
+  void Insert (Ipv4EndPointMulticast *endPoint);
+
   /**
    * \brief Allocate an ephemeral port.
    * \returns the ephemeral port
@@ -184,9 +242,14 @@ private:
   uint16_t m_portFirst;
 
   /**
-   * \brief A list of IPv4 end points.
+   * \brief The IPv4 end points, by local port.
+   */
+  PortMap m_ports;
+
+  /**
+   * \brief Number of IPv4 end points.
    */
-  EndPoints m_endPoints;
+  uint32_t m_nEndPoints;
 };
 
 } // namespace ns3
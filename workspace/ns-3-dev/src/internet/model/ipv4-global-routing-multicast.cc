@@ -80,6 +80,7 @@ Ipv4GlobalRoutingMulticast::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface);
   m_hostRoutes.push_back (route);
+  m_routeTrie.AddHostRoute (route);
 }
 
 void 
@@ -90,6 +91,7 @@ Ipv4GlobalRoutingMulticast::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, interface);
   m_hostRoutes.push_back (route);
+  m_routeTrie.AddHostRoute (route);
 }
 
 void 
@@ -105,6 +107,7 @@ Ipv4GlobalRoutingMulticast::AddNetworkRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_networkRoutes.push_back (route);
+  m_routeTrie.AddNetworkRoute (route);
 }
 
 void 
@@ -118,6 +121,7 @@ Ipv4GlobalRoutingMulticast::AddNetworkRouteTo (Ipv4Address network,
                                                         networkMask,
                                                         interface);
   m_networkRoutes.push_back (route);
+  m_routeTrie.AddNetworkRoute (route);
 }
 
 void 
@@ -136,61 +140,76 @@ Ipv4GlobalRoutingMulticast::AddASExternalRouteTo (Ipv4Address network,
 }
 
 
-Ptr<Ipv4Route>
-Ipv4GlobalRoutingMulticast::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif)
+Ipv4RoutingTableEntry *
+Ipv4GlobalRoutingMulticast::SelectRoute (const Ipv4RouteTrieMulticast::RouteSet &routes, Ptr<NetDevice> oif)
 {
-  NS_LOG_FUNCTION (this << dest << oif);
-  NS_LOG_LOGIC ("Looking for route for destination " << dest);
-  Ptr<Ipv4Route> rtentry = 0;
-  // store all available routes that bring packets to their destination
-  typedef std::vector<Ipv4RoutingTableEntry*> RouteVec_t;
-  RouteVec_t allRoutes;
-
-  NS_LOG_LOGIC ("Number of m_hostRoutes = " << m_hostRoutes.size ());
-  for (HostRoutesCI i = m_hostRoutes.begin (); 
-       i != m_hostRoutes.end (); 
-       i++) 
+  NS_LOG_FUNCTION (this << oif);
+  typedef Ipv4RouteTrieMulticast::RouteSet::const_iterator RouteSetCI;
+  // count the routes on the requested interface, if any
+  uint32_t n = routes.size ();
+  if (oif != 0)
     {
-      NS_ASSERT ((*i)->IsHost ());
-      if ((*i)->GetDest ().IsEqual (dest)) 
+      n = 0;
+      for (RouteSetCI i = routes.begin (); i != routes.end (); i++)
         {
-          if (oif != 0)
+          if (oif == m_ipv4->GetNetDevice ((*i)->GetInterface ()))
             {
-              if (oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
-                {
-                  NS_LOG_LOGIC ("Not on requested interface, skipping");
-                  continue;
-                }
+              n++;
+            }
+          else
+            {
+              NS_LOG_LOGIC ("Not on requested interface, skipping");
             }
-          allRoutes.push_back (*i);
-          NS_LOG_LOGIC (allRoutes.size () << "Found global host route" << *i); 
         }
     }
-  if (allRoutes.size () == 0) // if no host route is found
+  if (n == 0)
     {
-      NS_LOG_LOGIC ("Number of m_networkRoutes" << m_networkRoutes.size ());
-      for (NetworkRoutesI j = m_networkRoutes.begin (); 
-           j != m_networkRoutes.end (); 
-           j++) 
+      return 0;
+    }
+  // pick up one of the routes uniformly at random if random
+  // ECMP routing is enabled, or always select the first route
+  // consistently if random ECMP routing is disabled
+  uint32_t selectIndex = 0;
+  if (m_randomEcmpRouting)
+    {
+      selectIndex = m_rand->GetInteger (0, n - 1);
+    }
+  for (RouteSetCI i = routes.begin (); i != routes.end (); i++)
+    {
+      if (oif != 0 && oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
         {
-          Ipv4Mask mask = (*j)->GetDestNetworkMask ();
-          Ipv4Address entry = (*j)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry)) 
-            {
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*j)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*j);
-              NS_LOG_LOGIC (allRoutes.size () << "Found global network route" << *j);
-            }
+          continue;
+        }
+      if (selectIndex == 0)
+        {
+          return *i;
         }
+      selectIndex--;
     }
-  if (allRoutes.size () == 0)  // consider external if no host/network found
+  NS_ASSERT (false);
+  // quiet compiler.
+  return 0;
+}
+
+Ptr<Ipv4Route>
+Ipv4GlobalRoutingMulticast::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif)
+{
+  NS_LOG_FUNCTION (this << dest << oif);
+  NS_LOG_LOGIC ("Looking for route for destination " << dest);
+  Ipv4RoutingTableEntry* route = 0;
+
+  // host routes first, then network routes from the longest prefix down
+  const Ipv4RouteTrieMulticast::RouteSet *matches[Ipv4RouteTrieMulticast::MAX_MATCHES];
+  uint32_t nMatches = m_routeTrie.Lookup (dest, matches);
+  for (uint32_t i = 0; i < nMatches && route == 0; i++)
+    {
+      route = SelectRoute (*matches[i], oif);
+    }
+  if (route != 0)
+    {
+      NS_LOG_LOGIC ("Found global route" << *route);
+    }
+  else // consider external if no host/network found
     {
       for (ASExternalRoutesI k = m_ASexternalRoutes.begin ();
            k != m_ASexternalRoutes.end ();
@@ -209,40 +228,24 @@ Ipv4GlobalRoutingMulticast::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif)
                       continue;
                     }
                 }
-              allRoutes.push_back (*k);
+              route = *k;
               break;
             }
         }
     }
-  if (allRoutes.size () > 0 ) // if route(s) is found
-    {
-      // pick up one of the routes uniformly at random if random
-      // ECMP routing is enabled, or always select the first route
-      // consistently if random ECMP routing is disabled
-      uint32_t selectIndex;
-      if (m_randomEcmpRouting)
-        {
-          selectIndex = m_rand->GetInteger (0, allRoutes.size ()-1);
-        }
-      else 
-        {
-          selectIndex = 0;
-        }
-      Ipv4RoutingTableEntry* route = allRoutes.at (selectIndex); 
-      // create a Ipv4Route object from the selected routing table entry
-      rtentry = Create<Ipv4Route> ();
-      rtentry->SetDestination (route->GetDest ());
-      /// \todo handle multi-address case
-      rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
-      rtentry->SetGateway (route->GetGateway ());
-      uint32_t interfaceIdx = route->GetInterface ();
-      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
-      return rtentry;
-    }
-  else 
+  if (route == 0)
     {
       return 0;
     }
+  // create a Ipv4Route object from the selected routing table entry
+  Ptr<Ipv4Route> rtentry = Create<Ipv4Route> ();
+  rtentry->SetDestination (route->GetDest ());
+  /// \todo handle multi-address case
+  rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
+  rtentry->SetGateway (route->GetGateway ());
+  uint32_t interfaceIdx = route->GetInterface ();
+  rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
+  return rtentry;
 }
 
 uint32_t 
@@ -319,6 +322,7 @@ Ipv4GlobalRoutingMulticast::RemoveRoute (uint32_t index)
           if (tmp  == index)
             {
               NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_hostRoutes.size ());
+              m_routeTrie.Remove (*i);
               delete *i;
               m_hostRoutes.erase (i);
               NS_LOG_LOGIC ("Done removing host route " << index << "; host route remaining size = " << m_hostRoutes.size ());
@@ -336,6 +340,7 @@ Ipv4GlobalRoutingMulticast::RemoveRoute (uint32_t index)
       if (tmp == index)
         {
           NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_networkRoutes.size ());
+          m_routeTrie.Remove (*j);
           delete *j;
           m_networkRoutes.erase (j);
           NS_LOG_LOGIC ("Done removing network route " << index << "; network route remaining size = " << m_networkRoutes.size ());
@@ -374,6 +379,7 @@ void
 Ipv4GlobalRoutingMulticast::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  m_routeTrie.Clear ();
   for (HostRoutesI i = m_hostRoutes.begin (); 
        i != m_hostRoutes.end (); 
        i = m_hostRoutes.erase (i)) 
@@ -565,9 +571,7 @@ Ipv4GlobalRoutingMulticast::NotifyInterfaceUp (uint32_t i)
   NS_LOG_FUNCTION (this << i);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManagerMulticast::DeleteGlobalRoutes ();
-      GlobalRouteManagerMulticast::BuildGlobalRoutingDatabase ();
-      GlobalRouteManagerMulticast::InitializeRoutes ();
+      GlobalRouteManagerMulticast::UpdateRoutes (m_ipv4->GetObject<Node> ());
     }
 }
 
@@ -577,9 +581,7 @@ Ipv4GlobalRoutingMulticast::NotifyInterfaceDown (uint32_t i)
   NS_LOG_FUNCTION (this << i);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManagerMulticast::DeleteGlobalRoutes ();
-      GlobalRouteManagerMulticast::BuildGlobalRoutingDatabase ();
-      GlobalRouteManagerMulticast::InitializeRoutes ();
+      GlobalRouteManagerMulticast::UpdateRoutes (m_ipv4->GetObject<Node> ());
     }
 }
 
@@ -589,9 +591,7 @@ Ipv4GlobalRoutingMulticast::NotifyAddAddress (uint32_t interface, Ipv4InterfaceA
   NS_LOG_FUNCTION (this << interface << address);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManagerMulticast::DeleteGlobalRoutes ();
-      GlobalRouteManagerMulticast::BuildGlobalRoutingDatabase ();
-      GlobalRouteManagerMulticast::InitializeRoutes ();
+      GlobalRouteManagerMulticast::UpdateRoutes (m_ipv4->GetObject<Node> ());
     }
 }
 
@@ -601,9 +601,7 @@ Ipv4GlobalRoutingMulticast::NotifyRemoveAddress (uint32_t interface, Ipv4Interfa
   NS_LOG_FUNCTION (this << interface << address);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManagerMulticast::DeleteGlobalRoutes ();
-      GlobalRouteManagerMulticast::BuildGlobalRoutingDatabase ();
-      GlobalRouteManagerMulticast::InitializeRoutes ();
+      GlobalRouteManagerMulticast::UpdateRoutes (m_ipv4->GetObject<Node> ());
     }
 }
 
@@ -28,6 +28,7 @@
 #include "ns3/ipv4-multicast.h"
 #include "ns3/ipv4-routing-protocol-multicast.h"
 #include "ns3/random-variable-stream.h"
+#include "ipv4-route-trie-multicast.h"
 
 namespace ns3 {
 
@@ -258,11 +259,32 @@ private:
   /// iterator of container of Ipv4RoutingTableEntry (routes to external AS)
   typedef std::list<Ipv4RoutingTableEntry *>::iterator ASExternalRoutesI;
 
+  /**
+   * \brief Lookup in the forwarding table for destination.
+   *
+   * Host routes are preferred over network routes, and network routes are
+   * matched longest prefix first; external routes are only considered when
+   * neither matches.  Equal cost routes of the best match are chosen from
+   * according to m_randomEcmpRouting.
+   *
+   * \param dest destination address
+   * \param oif output interface if any (put 0 otherwise)
+   * \return Ipv4Route to route the packet to reach dest address
+   */
   Ptr<Ipv4Route> LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif = 0);
 
+  /**
+   * \brief Pick one of a set of equal cost routes.
+   * \param routes the routes
+   * \param oif output interface if any (put 0 otherwise)
+   * \return the route, or 0 if none of them uses oif
+   */
+  Ipv4RoutingTableEntry *SelectRoute (const Ipv4RouteTrieMulticast::RouteSet &routes, Ptr<NetDevice> oif);
+
   HostRoutes m_hostRoutes;             //!< Routes to hosts
   NetworkRoutes m_networkRoutes;       //!< Routes to networks
   ASExternalRoutes m_ASexternalRoutes; //!< External routes imported
+  Ipv4RouteTrieMulticast m_routeTrie;  //!< Longest prefix match index of m_hostRoutes and m_networkRoutes
 
   Ptr<Ipv4Multicast> m_ipv4; //!< associated IPv4 instance
 };
@@ -91,6 +91,15 @@ Ipv4L3ProtocolMulticast::GetTypeId (void)
                      "Drop ipv4 packet",
                      MakeTraceSourceAccessor (&Ipv4L3ProtocolMulticast::m_dropTrace),
                      "ns3::Ipv4L3ProtocolMulticast::DropTracedCallback")
+    .AddAttribute ("MembershipForwarding",
+                   "Copy multicast packets only onto interfaces with IGMPv3 "
+                   "listeners interested in the (S,G), and forward groups with "
+                   "listeners even without a multicast route. Interfaces without "
+                   "any IGMPv3 listener, such as router-to-router links, keep "
+                   "following the multicast routes.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4L3ProtocolMulticast::m_membershipForwarding),
+                   MakeBooleanChecker ())
     .AddAttribute ("InterfaceList",
                    "The set of Ipv4Multicast interfaces associated to this Ipv4Multicast stack.",
                    ObjectVectorValue (),
@@ -118,6 +127,7 @@ Ipv4L3ProtocolMulticast::GetTypeId (void)
 }
 
 Ipv4L3ProtocolMulticast::Ipv4L3ProtocolMulticast()
+  : m_membershipForwarding (false)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -309,6 +319,9 @@ Ipv4L3ProtocolMulticast::DoDispose (void)
   m_sockets.clear ();
   m_node = 0;
   m_routingProtocol = 0;
+  m_membershipForwardingCache.clear ();
+  m_membershipInterfaceGroups.clear ();
+  m_membershipRouteCache.clear ();
 
   for (MapFragments_t::iterator it = m_fragments.begin (); it != m_fragments.end (); it++)
     {
@@ -635,6 +648,16 @@ Ipv4L3ProtocolMulticast::Receive ( Ptr<NetDevice> device, Ptr<const Packet> p, u
                                       MakeCallback (&Ipv4L3ProtocolMulticast::RouteInputError, this)
                                       ))
     {
+      if (m_membershipForwarding && m_ipForward && ipHeader.GetDestination ().IsMulticast ())
+        {
+          // no hand-installed multicast route, fall back to IGMPv3 membership
+          Ptr<Ipv4MulticastRoute> mrtentry = LookupMembershipRoute (ipHeader.GetSource (), ipHeader.GetDestination (), interface);
+          if (mrtentry != 0)
+            {
+              IpMulticastForward (mrtentry, packet, ipHeader);
+              return;
+            }
+        }
       NS_LOG_WARN ("No route found for forwarding packet.  Drop.");
       m_dropTrace (ipHeader, packet, DROP_NO_ROUTE, m_node->GetObject<Ipv4Multicast> (), interface);
     }
@@ -677,6 +700,118 @@ Ipv4L3ProtocolMulticast::SendIgmpGeneralQuery (void)
 	igmp->SendDefaultGeneralQuery ();
 }
 
+void
+Ipv4L3ProtocolMulticast::SetMembershipForwardingState (uint32_t interface, Ipv4Address group,
+                                                       ns3::FILTER_MODE filter_mode,
+                                                       std::list<Ipv4Address> const &src_list)
+{
+  NS_LOG_FUNCTION (this << interface << group << filter_mode);
+  MembershipInterfaces_t &interfaces = m_membershipForwardingCache[group];
+  if (interfaces.find (interface) == interfaces.end ())
+    {
+      m_membershipInterfaceGroups[interface]++;
+    }
+  MembershipForwardingEntry &entry = interfaces[interface];
+  entry.m_filterMode = filter_mode;
+  entry.m_sources.clear ();
+  entry.m_sources.insert (src_list.begin (), src_list.end ());
+  m_membershipRouteCache.erase (group);
+}
+
+void
+Ipv4L3ProtocolMulticast::RemoveMembershipForwardingState (uint32_t interface, Ipv4Address group)
+{
+  NS_LOG_FUNCTION (this << interface << group);
+  MembershipForwardingCache_t::iterator it = m_membershipForwardingCache.find (group);
+  if (it == m_membershipForwardingCache.end ())
+    {
+      return;
+    }
+  if (it->second.erase (interface) > 0)
+    {
+      std::map<uint32_t, uint32_t>::iterator countIt = m_membershipInterfaceGroups.find (interface);
+      NS_ASSERT (countIt != m_membershipInterfaceGroups.end ());
+      if (--countIt->second == 0)
+        {
+          m_membershipInterfaceGroups.erase (countIt);
+        }
+    }
+  if (it->second.empty ())
+    {
+      m_membershipForwardingCache.erase (it);
+    }
+  m_membershipRouteCache.erase (group);
+}
+
+bool
+Ipv4L3ProtocolMulticast::HasMembershipForwardingState (Ipv4Address group) const
+{
+  return m_membershipForwardingCache.find (group) != m_membershipForwardingCache.end ();
+}
+
+bool
+Ipv4L3ProtocolMulticast::IsMembershipHostInterface (uint32_t interface) const
+{
+  return m_membershipInterfaceGroups.find (interface) != m_membershipInterfaceGroups.end ();
+}
+
+bool
+Ipv4L3ProtocolMulticast::IsMembershipForwarded (uint32_t interface, Ipv4Address origin, Ipv4Address group) const
+{
+  MembershipForwardingCache_t::const_iterator it = m_membershipForwardingCache.find (group);
+  if (it == m_membershipForwardingCache.end ())
+    {
+      return false;
+    }
+  MembershipInterfaces_t::const_iterator ifIt = it->second.find (interface);
+  if (ifIt == it->second.end ())
+    {
+      return false;
+    }
+  bool listed = ifIt->second.m_sources.find (origin) != ifIt->second.m_sources.end ();
+  if (ifIt->second.m_filterMode == ns3::INCLUDE)
+    {
+      return listed;
+    }
+  return !listed;
+}
+
+Ptr<Ipv4MulticastRoute>
+Ipv4L3ProtocolMulticast::LookupMembershipRoute (Ipv4Address origin, Ipv4Address group, uint32_t iif)
+{
+  NS_LOG_FUNCTION (this << origin << group << iif);
+  Ptr<Ipv4MulticastRoute> mrtentry = 0;
+  MembershipForwardingCache_t::const_iterator it = m_membershipForwardingCache.find (group);
+  if (it == m_membershipForwardingCache.end ())
+    {
+      return mrtentry;
+    }
+  // built once per (S,G,iif), dropped whenever the membership of the group changes
+  MembershipRoutes_t &routes = m_membershipRouteCache[group];
+  MembershipRoutes_t::const_iterator routeIt = routes.find (std::make_pair (origin, iif));
+  if (routeIt != routes.end ())
+    {
+      return routeIt->second;
+    }
+  for (MembershipInterfaces_t::const_iterator ifIt = it->second.begin (); ifIt != it->second.end (); ifIt++)
+    {
+      if (ifIt->first == iif || !IsMembershipForwarded (ifIt->first, origin, group))
+        {
+          continue;
+        }
+      if (mrtentry == 0)
+        {
+          mrtentry = Create<Ipv4MulticastRoute> ();
+          mrtentry->SetGroup (group);
+          mrtentry->SetOrigin (origin);
+          mrtentry->SetParent (iif);
+        }
+      mrtentry->SetOutputTtl (ifIt->first, Ipv4MulticastRoute::MAX_TTL - 1);
+    }
+  routes[std::make_pair (origin, iif)] = mrtentry;
+  return mrtentry;
+}
+
 //void
 //Ipv4L3ProtocolMulticast::IPMulticastListen (Ptr<Socket> socket,
 //											Ptr<NetDevice> device,
@@ -1075,31 +1210,80 @@ Ipv4L3ProtocolMulticast::IpMulticastForward (Ptr<Ipv4MulticastRoute> mrtentry, P
   NS_LOG_FUNCTION (this << mrtentry << p << header);
   NS_LOG_LOGIC ("Multicast forwarding logic for node: " << m_node->GetId ());
 
-  std::map<uint32_t, uint32_t> ttlMap = mrtentry->GetOutputTtlMap ();
-  std::map<uint32_t, uint32_t>::iterator mapIter;
+  // GetOutputTtlMap () returns by value; take the copy once rather than per lookup
+  const std::map<uint32_t, uint32_t> ttlMap = mrtentry->GetOutputTtlMap ();
+  if (ttlMap.empty ())
+    {
+      return;
+    }
+
+  // The decremented header is identical on every output, so check and serialize it once
+  Ipv4Header h = header;
+  h.SetTtl (header.GetTtl () - 1);
+  if (h.GetTtl () == 0)
+    {
+      NS_LOG_WARN ("TTL exceeded.  Drop.");
+      m_dropTrace (header, p, DROP_TTL_EXPIRED, m_node->GetObject<Ipv4Multicast> (), ttlMap.begin ()->first);
+      return;
+    }
+  Ptr<Packet> serialized = p->Copy ();
+  serialized->AddHeader (h);
+
+  // Groups known to IGMPv3 on this node are only copied onto listener interfaces with interested receivers,
+  // interfaces without any listener (router-to-router links) keep following the route
+  bool pruneByMembership = m_membershipForwarding && HasMembershipForwardingState (header.GetDestination ());
 
-  for (mapIter = ttlMap.begin (); mapIter != ttlMap.end (); mapIter++)
+  for (std::map<uint32_t, uint32_t>::const_iterator mapIter = ttlMap.begin (); mapIter != ttlMap.end (); mapIter++)
     {
       uint32_t interfaceId = mapIter->first;
       //uint32_t outputTtl = mapIter->second;  // Unused for now
 
-      Ptr<Packet> packet = p->Copy ();
-      Ipv4Header h = header;
-      h.SetTtl (header.GetTtl () - 1);
-      if (h.GetTtl () == 0)
+      if (pruneByMembership && IsMembershipHostInterface (interfaceId)
+          && !IsMembershipForwarded (interfaceId, header.GetSource (), header.GetDestination ()))
         {
-          NS_LOG_WARN ("TTL exceeded.  Drop.");
-          m_dropTrace (header, packet, DROP_TTL_EXPIRED, m_node->GetObject<Ipv4Multicast> (), interfaceId);
-          return;
+          NS_LOG_LOGIC ("No interested receiver on interface " << interfaceId);
+          continue;
         }
+
       NS_LOG_LOGIC ("Forward multicast via interface " << interfaceId);
-      Ptr<Ipv4Route> rtentry = Create<Ipv4Route> ();
-      rtentry->SetSource (h.GetSource ());
-      rtentry->SetDestination (h.GetDestination ());
-      rtentry->SetGateway (Ipv4Address::GetAny ());
-      rtentry->SetOutputDevice (GetNetDevice (interfaceId));
-      SendRealOut (rtentry, packet, h);
-      continue;
+      // Packet::Copy is copy-on-write, every output shares the serialized buffer
+      SendMulticastOut (interfaceId, serialized->Copy (), h);
+    }
+}
+
+void
+Ipv4L3ProtocolMulticast::SendMulticastOut (uint32_t interface,
+                                  Ptr<Packet> packet,
+                                  Ipv4Header const &ipHeader)
+{
+  NS_LOG_FUNCTION (this << interface << packet << &ipHeader);
+  Ptr<Ipv4InterfaceMulticast> outInterface = GetInterface (interface);
+  NS_LOG_LOGIC ("Send multicast via ipv4InterfaceIndex " << interface);
+
+  if (!outInterface->IsUp ())
+    {
+      NS_LOG_LOGIC ("Dropping -- outgoing interface is down: " << ipHeader.GetDestination ());
+      Ipv4Header dropHeader;
+      packet->RemoveHeader (dropHeader);
+      m_dropTrace (dropHeader, packet, DROP_INTERFACE_DOWN, m_node->GetObject<Ipv4Multicast> (), interface);
+      return;
+    }
+
+  if ( packet->GetSize () > outInterface->GetDevice ()->GetMtu () )
+    {
+      std::list<Ptr<Packet> > listFragments;
+      DoFragmentation (packet, outInterface->GetDevice ()->GetMtu (), listFragments);
+      for ( std::list<Ptr<Packet> >::iterator it = listFragments.begin (); it != listFragments.end (); it++ )
+        {
+          NS_LOG_LOGIC ("Sending fragment " << **it );
+          m_txTrace (*it, m_node->GetObject<Ipv4Multicast> (), interface);
+          outInterface->Send (*it, ipHeader.GetDestination ());
+        }
+    }
+  else
+    {
+      m_txTrace (packet, m_node->GetObject<Ipv4Multicast> (), interface);
+      outInterface->Send (packet, ipHeader.GetDestination ());
     }
 }
 
@@ -23,9 +23,11 @@
 
 #include <list>
 #include <map>
+#include <set>
 #include <vector>
 #include <stdint.h>
 #include "ns3/ipv4-address.h"
+#include "ns3/sgi-hashmap.h"
 #include "ns3/ptr.h"
 #include "ns3/net-device.h"
 #include "ns3/ipv4-multicast.h"
@@ -47,6 +49,7 @@ class Ipv4Address;
 class Ipv4Header;
 class Ipv4RoutingTableEntry;
 class Ipv4Route;
+class Ipv4MulticastRoute;
 class Node;
 class Socket;
 class Ipv4RawSocketImplMulticast;
@@ -284,6 +287,59 @@ public:
    */
   void SendIgmpGeneralQuery (void);
 
+  /**
+   * \brief Install or refresh the IGMPv3 membership forwarding state of a group on an interface.
+   *
+   * Called by IGMPv3MaintenanceState whenever its filter mode or source timers change
+   * (rfc 3376, 6.3). In INCLUDE mode traffic from the given sources is forwarded, in
+   * EXCLUDE mode traffic from every source but the given ones is forwarded.
+   *
+   * \param interface the interface index the listeners are on
+   * \param group the multicast group address
+   * \param filter_mode the router filter mode of the group
+   * \param src_list forwarded sources (INCLUDE) or blocked sources (EXCLUDE)
+   */
+  void SetMembershipForwardingState (uint32_t interface, Ipv4Address group,
+                                     ns3::FILTER_MODE filter_mode,
+                                     std::list<Ipv4Address> const &src_list);
+
+  /**
+   * \brief Prune the IGMPv3 membership forwarding state of a group on an interface.
+   * \param interface the interface index
+   * \param group the multicast group address
+   */
+  void RemoveMembershipForwardingState (uint32_t interface, Ipv4Address group);
+
+  /**
+   * \param group the multicast group address
+   * \returns true if any interface of this node has membership state for the group
+   */
+  bool HasMembershipForwardingState (Ipv4Address group) const;
+
+  /**
+   * \param interface the interface index
+   * \returns true if the interface has IGMPv3 listeners of any group
+   */
+  bool IsMembershipHostInterface (uint32_t interface) const;
+
+  /**
+   * \brief Check whether (S,G) traffic has interested receivers on an interface.
+   * \param interface the interface index
+   * \param origin the source address
+   * \param group the multicast group address
+   * \returns true if the packet should be copied onto the interface
+   */
+  bool IsMembershipForwarded (uint32_t interface, Ipv4Address origin, Ipv4Address group) const;
+
+  /**
+   * \brief Build, or take from the cache, a multicast route towards every interface but iif with interested receivers.
+   * \param origin the source address
+   * \param group the multicast group address
+   * \param iif the input interface index
+   * \returns the route, or 0 if no interface has interested receivers
+   */
+  Ptr<Ipv4MulticastRoute> LookupMembershipRoute (Ipv4Address origin, Ipv4Address group, uint32_t iif);
+
 //  /**
 //   * added by Lin Chen, for invocation from IPMulticastListen
 //   */
@@ -394,6 +450,20 @@ private:
                Ptr<Packet> packet,
                Ipv4Header const &ipHeader);
 
+  /**
+   * \brief Send an already serialized multicast packet out of an interface.
+   *
+   * Used by the multicast fan-out, which knows the output interface index
+   * and so needs neither an Ipv4Route nor a device to interface lookup.
+   * \param interface output interface index
+   * \param packet packet to send, IPv4 header already added
+   * \param ipHeader the IPv4 header carried by the packet
+   */
+  void
+  SendMulticastOut (uint32_t interface,
+                    Ptr<Packet> packet,
+                    Ipv4Header const &ipHeader);
+
   /**
    * \brief Forward a packet.
    * \param rtentry route
@@ -535,6 +605,26 @@ private:
 
   Ptr<Ipv4RoutingProtocolMulticast> m_routingProtocol; //!< Routing protocol associated with the stack
 
+  /// IGMPv3 membership forwarding state of a group on one interface
+  struct MembershipForwardingEntry
+  {
+    ns3::FILTER_MODE m_filterMode; //!< router filter mode
+    std::set<Ipv4Address> m_sources; //!< forwarded (INCLUDE) or blocked (EXCLUDE) sources
+  };
+  /// Membership forwarding states of a group, indexed by interface
+  typedef std::map<uint32_t, MembershipForwardingEntry> MembershipInterfaces_t;
+  /// Membership forwarding cache, indexed by group
+  typedef sgi::hash_map<Ipv4Address, MembershipInterfaces_t, Ipv4AddressHash> MembershipForwardingCache_t;
+
+  bool m_membershipForwarding; //!< Prune multicast forwarding by IGMPv3 membership
+  MembershipForwardingCache_t m_membershipForwardingCache; //!< IGMPv3 membership forwarding cache
+  std::map<uint32_t, uint32_t> m_membershipInterfaceGroups; //!< number of groups with listeners, indexed by interface
+  /// Membership routes of a group, indexed by source and input interface
+  typedef std::map<std::pair<Ipv4Address, uint32_t>, Ptr<Ipv4MulticastRoute> > MembershipRoutes_t;
+  /// Membership route cache, indexed by group
+  typedef sgi::hash_map<Ipv4Address, MembershipRoutes_t, Ipv4AddressHash> MembershipRouteCache_t;
+  MembershipRouteCache_t m_membershipRouteCache; //!< routes built by LookupMembershipRoute
+
   SocketList m_sockets; //!< List of IPv4 raw sockets.
 
   /**
@@ -0,0 +1,264 @@
+// -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation;
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include "ns3/ipv4-routing-table-entry.h"
+#include "ipv4-route-trie-multicast.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("Ipv4RouteTrieMulticast");
+
+namespace {
+
+/// \returns the mask of a prefix length
+uint32_t
+PrefixMask (uint32_t length)
+{
+  return length == 0 ? 0 : 0xffffffff << (32 - length);
+}
+
+/// \returns bit i of an address, counting from the most significant bit
+uint32_t
+PrefixBit (uint32_t address, uint32_t i)
+{
+  return (address >> (31 - i)) & 1;
+}
+
+/// \returns the length of the longest prefix common to two prefixes
+uint32_t
+CommonLength (uint32_t a, uint32_t aLength, uint32_t b, uint32_t bLength)
+{
+  uint32_t length = std::min (aLength, bLength);
+  uint32_t diff = a ^ b;
+  for (uint32_t i = 0; i < length; i++)
+    {
+      if (PrefixBit (diff, i))
+        {
+          return i;
+        }
+    }
+  return length;
+}
+
+} // anonymous namespace
+
+Ipv4RouteTrieMulticast::Ipv4RouteTrieMulticast ()
+  : m_root (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ipv4RouteTrieMulticast::~Ipv4RouteTrieMulticast ()
+{
+  NS_LOG_FUNCTION (this);
+  Clear ();
+}
+
+void
+Ipv4RouteTrieMulticast::AddHostRoute (Ipv4RoutingTableEntry *route)
+{
+  NS_LOG_FUNCTION (this << route);
+  NS_ASSERT (route->IsHost ());
+  TrieNode *node = Insert (route->GetDest ().Get (), 32);
+  node->m_hostRoutes.push_back (route);
+}
+
+void
+Ipv4RouteTrieMulticast::AddNetworkRoute (Ipv4RoutingTableEntry *route)
+{
+  NS_LOG_FUNCTION (this << route);
+  Ipv4Mask mask = route->GetDestNetworkMask ();
+  uint32_t length = mask.GetPrefixLength ();
+  NS_ASSERT_MSG (mask.Get () == PrefixMask (length),
+                 "Ipv4RouteTrieMulticast::AddNetworkRoute (): Mask " << mask << " is not contiguous");
+  TrieNode *node = Insert (route->GetDestNetwork ().Get () & PrefixMask (length), length);
+  node->m_networkRoutes.push_back (route);
+}
+
+Ipv4RouteTrieMulticast::TrieNode *
+Ipv4RouteTrieMulticast::Insert (uint32_t prefix, uint32_t length)
+{
+  NS_LOG_FUNCTION (this << prefix << length);
+  TrieNode **link = &m_root;
+  while (true)
+    {
+      TrieNode *node = *link;
+      if (node == 0)
+        {
+          *link = NewNode (prefix, length);
+          return *link;
+        }
+      uint32_t common = CommonLength (node->m_prefix, node->m_length, prefix, length);
+      if (common == node->m_length && common == length)
+        {
+          return node;
+        }
+      if (common == node->m_length)
+        {
+          // node is a shorter prefix of ours, descend
+          link = &node->m_child[PrefixBit (prefix, common)];
+          continue;
+        }
+      if (common == length)
+        {
+          // ours is a shorter prefix of node, put it above node
+          TrieNode *added = NewNode (prefix, length);
+          added->m_child[PrefixBit (node->m_prefix, common)] = node;
+          *link = added;
+          return added;
+        }
+      // the prefixes diverge, join them below a new node
+      TrieNode *join = NewNode (prefix & PrefixMask (common), common);
+      TrieNode *added = NewNode (prefix, length);
+      join->m_child[PrefixBit (node->m_prefix, common)] = node;
+      join->m_child[PrefixBit (prefix, common)] = added;
+      *link = join;
+      return added;
+    }
+}
+
+void
+Ipv4RouteTrieMulticast::Remove (Ipv4RoutingTableEntry *route)
+{
+  NS_LOG_FUNCTION (this << route);
+  uint32_t prefix;
+  uint32_t length;
+  if (route->IsHost ())
+    {
+      prefix = route->GetDest ().Get ();
+      length = 32;
+    }
+  else
+    {
+      length = route->GetDestNetworkMask ().GetPrefixLength ();
+      prefix = route->GetDestNetwork ().Get () & PrefixMask (length);
+    }
+//
+// Walk down to the node of the prefix, remembering the links we came
+// through so the node and a join above it can be unlinked.
+//
+  TrieNode **links[33];
+  uint32_t depth = 0;
+  TrieNode **link = &m_root;
+  while (*link != 0 && (*link)->m_length < length)
+    {
+      links[depth++] = link;
+      link = &(*link)->m_child[PrefixBit (prefix, (*link)->m_length)];
+    }
+  TrieNode *node = *link;
+  NS_ASSERT_MSG (node != 0 && node->m_length == length && node->m_prefix == prefix,
+                 "Ipv4RouteTrieMulticast::Remove (): Route not found");
+
+  RouteSet &routes = route->IsHost () ? node->m_hostRoutes : node->m_networkRoutes;
+  RouteSet::iterator i = std::find (routes.begin (), routes.end (), route);
+  NS_ASSERT_MSG (i != routes.end (), "Ipv4RouteTrieMulticast::Remove (): Route not found");
+  routes.erase (i);
+  if (!node->m_hostRoutes.empty () || !node->m_networkRoutes.empty ())
+    {
+      return;
+    }
+//
+// The node has no routes left.  Unlink it if it has at most one subtree,
+// then the same for the join above it, which may be left with one subtree.
+//
+  while (node->m_hostRoutes.empty () && node->m_networkRoutes.empty ()
+         && (node->m_child[0] == 0 || node->m_child[1] == 0))
+    {
+      *link = node->m_child[0] != 0 ? node->m_child[0] : node->m_child[1];
+      delete node;
+      if (depth == 0)
+        {
+          break;
+        }
+      link = links[--depth];
+      node = *link;
+    }
+}
+
+void
+Ipv4RouteTrieMulticast::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  Delete (m_root);
+  m_root = 0;
+}
+
+uint32_t
+Ipv4RouteTrieMulticast::Lookup (Ipv4Address dest, const RouteSet *matches[]) const
+{
+  NS_LOG_FUNCTION (this << dest);
+  uint32_t address = dest.Get ();
+//
+// Collect the nodes on the path from the root, shortest prefix first.
+//
+  const TrieNode *path[33];
+  uint32_t depth = 0;
+  const TrieNode *node = m_root;
+  while (node != 0 && (address & PrefixMask (node->m_length)) == node->m_prefix)
+    {
+      path[depth++] = node;
+      if (node->m_length == 32)
+        {
+          break;
+        }
+      node = node->m_child[PrefixBit (address, node->m_length)];
+    }
+//
+// And hand them back longest prefix first, host routes before network
+// routes.
+//
+  uint32_t n = 0;
+  while (depth > 0)
+    {
+      node = path[--depth];
+      if (!node->m_hostRoutes.empty ())
+        {
+          matches[n++] = &node->m_hostRoutes;
+        }
+      if (!node->m_networkRoutes.empty ())
+        {
+          matches[n++] = &node->m_networkRoutes;
+        }
+    }
+  return n;
+}
+
+void
+Ipv4RouteTrieMulticast::Delete (TrieNode *node)
+{
+  if (node != 0)
+    {
+      Delete (node->m_child[0]);
+      Delete (node->m_child[1]);
+      delete node;
+    }
+}
+
+Ipv4RouteTrieMulticast::TrieNode *
+Ipv4RouteTrieMulticast::NewNode (uint32_t prefix, uint32_t length)
+{
+  TrieNode *node = new TrieNode;
+  node->m_prefix = prefix;
+  node->m_length = length;
+  node->m_child[0] = 0;
+  node->m_child[1] = 0;
+  return node;
+}
+
+} // namespace ns3
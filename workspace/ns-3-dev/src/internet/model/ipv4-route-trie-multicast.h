@@ -0,0 +1,140 @@
+// -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation;
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef IPV4_ROUTE_TRIE_MULTICAST_H
+#define IPV4_ROUTE_TRIE_MULTICAST_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+class Ipv4RoutingTableEntry;
+
+/**
+ * \brief Longest prefix match index over host and network routes.
+ *
+ * A path compressed binary trie keyed on the destination prefix of the
+ * routes.  Every prefix holds the set of routes added for it, in the order
+ * they were added, so equal cost routes stay together; host routes and
+ * network routes to the same /32 are kept in separate sets because host
+ * routes are preferred.
+ *
+ * The trie only indexes the routes, it never owns or copies them.  A
+ * lookup walks at most 33 nodes and does not allocate.
+ *
+ * \see Ipv4GlobalRoutingMulticast
+ */
+class Ipv4RouteTrieMulticast
+{
+public:
+  /// Routes of one prefix, in the order they were added
+  typedef std::vector<Ipv4RoutingTableEntry *> RouteSet;
+
+  /// Most route sets a lookup can match: the host set and one network set per prefix length
+  static const uint32_t MAX_MATCHES = 34;
+
+  Ipv4RouteTrieMulticast ();
+  ~Ipv4RouteTrieMulticast ();
+
+  /**
+   * \brief Index a host route.
+   * \param route the route, which must stay valid until removed
+   */
+  void AddHostRoute (Ipv4RoutingTableEntry *route);
+
+  /**
+   * \brief Index a network route.
+   *
+   * The network mask must be contiguous.
+   *
+   * \param route the route, which must stay valid until removed
+   */
+  void AddNetworkRoute (Ipv4RoutingTableEntry *route);
+
+  /**
+   * \brief Remove a route added by AddHostRoute () or AddNetworkRoute ().
+   * \param route the route
+   */
+  void Remove (Ipv4RoutingTableEntry *route);
+
+  /**
+   * \brief Remove all routes.
+   */
+  void Clear (void);
+
+  /**
+   * \brief Find the route sets matching a destination.
+   *
+   * The sets are returned best first: the host routes to dest, then the
+   * network routes from the longest matching prefix to the shortest.
+   * Empty sets are skipped.
+   *
+   * \param dest the destination
+   * \param matches array of at least MAX_MATCHES entries to fill
+   * \returns the number of sets written to matches
+   */
+  uint32_t Lookup (Ipv4Address dest, const RouteSet *matches[]) const;
+
+private:
+  /// Copy constructor is disabled
+  Ipv4RouteTrieMulticast (const Ipv4RouteTrieMulticast &);
+  /// Assignment operator is disabled
+  Ipv4RouteTrieMulticast & operator= (const Ipv4RouteTrieMulticast &);
+
+  /**
+   * \brief A prefix of the trie.
+   *
+   * Nodes without routes only exist to join two subtrees.
+   */
+  struct TrieNode
+  {
+    uint32_t m_prefix;      //!< prefix bits, host part zeroed
+    uint32_t m_length;      //!< prefix length
+    TrieNode *m_child[2];   //!< subtrees, selected by the bit after the prefix
+    RouteSet m_hostRoutes;    //!< host routes, only at /32
+    RouteSet m_networkRoutes; //!< network routes
+  };
+
+  /**
+   * \brief Find or create the node of a prefix.
+   * \param prefix the prefix bits
+   * \param length the prefix length
+   * \returns the node
+   */
+  TrieNode *Insert (uint32_t prefix, uint32_t length);
+
+  /**
+   * \brief Delete a subtree.
+   * \param node root of the subtree
+   */
+  static void Delete (TrieNode *node);
+
+  /**
+   * \brief Create a node without routes or children.
+   * \param prefix the prefix bits
+   * \param length the prefix length
+   * \returns the node
+   */
+  static TrieNode *NewNode (uint32_t prefix, uint32_t length);
+
+  TrieNode *m_root; //!< root of the trie, 0 if empty
+};
+
+} // namespace ns3
+
+#endif /* IPV4_ROUTE_TRIE_MULTICAST_H */
@@ -128,6 +128,67 @@ Ipv4StaticRoutingMulticast::AddMulticastRoute (Ipv4Address origin,
   *route = Ipv4MulticastRoutingTableEntry::CreateMulticastRoute (origin, group, 
                                                                  inputInterface, outputInterfaces);
   m_multicastRoutes.push_back (route);
+  IndexMulticastRoute (route);
+}
+
+Ptr<Ipv4MulticastRoute>
+Ipv4StaticRoutingMulticast::CreateMulticastForwardingEntry (const Ipv4MulticastRoutingTableEntry *route)
+{
+  NS_LOG_FUNCTION (route);
+  Ptr<Ipv4MulticastRoute> mrtentry = Create<Ipv4MulticastRoute> ();
+  mrtentry->SetGroup (route->GetGroup ());
+  mrtentry->SetOrigin (route->GetOrigin ());
+  mrtentry->SetParent (route->GetInputInterface ());
+  for (uint32_t j = 0; j < route->GetNOutputInterfaces (); j++)
+    {
+      if (route->GetOutputInterface (j))
+        {
+          NS_LOG_LOGIC ("Setting output interface index " << route->GetOutputInterface (j));
+          mrtentry->SetOutputTtl (route->GetOutputInterface (j), Ipv4MulticastRoute::MAX_TTL - 1);
+        }
+    }
+  return mrtentry;
+}
+
+void
+Ipv4StaticRoutingMulticast::IndexMulticastRoute (const Ipv4MulticastRoutingTableEntry *route)
+{
+  NS_LOG_FUNCTION (this << route);
+//
+// A lookup returns the first added route that matches, so a route only
+// becomes a forwarding entry where no earlier route of its group is one.
+//
+  MulticastGroupRoutes &entries = m_multicastIndex[route->GetGroup ()];
+  Ptr<Ipv4MulticastRoute> mrtentry = 0;
+  if (entries.m_anyInterface == 0)
+    {
+      mrtentry = CreateMulticastForwardingEntry (route);
+      entries.m_anyInterface = mrtentry;
+    }
+  if (entries.m_inputInterfaces.find (route->GetInputInterface ()) == entries.m_inputInterfaces.end ())
+    {
+      if (mrtentry == 0)
+        {
+          mrtentry = CreateMulticastForwardingEntry (route);
+        }
+      entries.m_inputInterfaces[route->GetInputInterface ()] = mrtentry;
+    }
+}
+
+void
+Ipv4StaticRoutingMulticast::ReindexMulticastGroup (Ipv4Address group)
+{
+  NS_LOG_FUNCTION (this << group);
+  m_multicastIndex.erase (group);
+  for (MulticastRoutesCI i = m_multicastRoutes.begin (); 
+       i != m_multicastRoutes.end (); 
+       i++) 
+    {
+      if ((*i)->GetGroup () == group)
+        {
+          IndexMulticastRoute (*i);
+        }
+    }
 }
 
 // default multicast routes are stored as a network route
@@ -194,6 +255,7 @@ Ipv4StaticRoutingMulticast::RemoveMulticastRoute (Ipv4Address origin,
         {
           delete *i;
           m_multicastRoutes.erase (i);
+          ReindexMulticastGroup (group);
           return true;
         }
     }
@@ -211,8 +273,10 @@ Ipv4StaticRoutingMulticast::RemoveMulticastRoute (uint32_t index)
     {
       if (tmp  == index)
         {
+          Ipv4Address group = (*i)->GetGroup ();
           delete *i;
           m_multicastRoutes.erase (i);
+          ReindexMulticastGroup (group);
           return;
         }
       tmp++;
@@ -304,49 +368,31 @@ Ipv4StaticRoutingMulticast::LookupStatic (
   uint32_t    interface)
 {
   NS_LOG_FUNCTION (this << origin << " " << group << " " << interface);
-  Ptr<Ipv4MulticastRoute> mrtentry = 0;
-
-  for (MulticastRoutesI i = m_multicastRoutes.begin (); 
-       i != m_multicastRoutes.end (); 
-       i++) 
-    {
-      Ipv4MulticastRoutingTableEntry *route = *i;
 //
 // We've been passed an origin address, a multicast group address and an 
-// interface index.  We have to decide if the current route in the list is
-// a match.
-//
-// The first case is the restrictive case where the origin, group and index
-// matches.
+// interface index.  A route matches on the group and, unless the interface
+// is Ipv4Multicast::IF_ANY, on the input interface; the first added route
+// that matches wins.  Source specific (SSM) matching on the origin is
+// skipped for now.  The index holds that winner for every group and input
+// interface.
 //
-      if (origin == route->GetOrigin () && group == route->GetGroup ())
-        {
-          // Skipping this case (SSM) for now
-          NS_LOG_LOGIC ("Found multicast source specific route" << *i);
-        }
-      if (group == route->GetGroup ())
-        {
-          if (interface == Ipv4Multicast::IF_ANY || 
-              interface == route->GetInputInterface ())
-            {
-              NS_LOG_LOGIC ("Found multicast route" << *i);
-              mrtentry = Create<Ipv4MulticastRoute> ();
-              mrtentry->SetGroup (route->GetGroup ());
-              mrtentry->SetOrigin (route->GetOrigin ());
-              mrtentry->SetParent (route->GetInputInterface ());
-              for (uint32_t j = 0; j < route->GetNOutputInterfaces (); j++)
-                {
-                  if (route->GetOutputInterface (j))
-                    {
-                      NS_LOG_LOGIC ("Setting output interface index " << route->GetOutputInterface (j));
-                      mrtentry->SetOutputTtl (route->GetOutputInterface (j), Ipv4MulticastRoute::MAX_TTL - 1);
-                    }
-                }
-              return mrtentry;
-            }
-        }
+  MulticastIndex::const_iterator i = m_multicastIndex.find (group);
+  if (i == m_multicastIndex.end ())
+    {
+      return 0;
     }
-  return mrtentry;
+  if (interface == Ipv4Multicast::IF_ANY)
+    {
+      NS_LOG_LOGIC ("Found multicast route" << i->second.m_anyInterface);
+      return i->second.m_anyInterface;
+    }
+  std::map<uint32_t, Ptr<Ipv4MulticastRoute> >::const_iterator j = i->second.m_inputInterfaces.find (interface);
+  if (j == i->second.m_inputInterfaces.end ())
+    {
+      return 0;
+    }
+  NS_LOG_LOGIC ("Found multicast route" << j->second);
+  return j->second;
 }
 
 uint32_t 
@@ -599,6 +645,7 @@ Ipv4StaticRoutingMulticast::DoDispose (void)
     {
       delete (*i);
     }
+  m_multicastIndex.clear ();
   m_ipv4 = 0;
   Ipv4RoutingProtocolMulticast::DoDispose ();
 }
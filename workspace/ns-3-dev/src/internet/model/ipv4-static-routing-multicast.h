@@ -23,9 +23,12 @@
 #define IPV4_STATIC_ROUTING_MULTICAST_H
 
 #include <list>
+#include <map>
 #include <utility>
 #include <stdint.h>
 #include "ns3/ipv4-address.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/sgi-hashmap.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/socket.h"
 #include "ns3/ptr.h"
@@ -399,6 +402,41 @@ private:
   /// Iterator for container for the multicast routes
   typedef std::list<Ipv4MulticastRoutingTableEntry *>::iterator MulticastRoutesI;
 
+  /**
+   * \brief The forwarding entries of one multicast group.
+   *
+   * Holds, ready to hand out, the route a lookup for the group returns:
+   * the first added route of the group for lookups on any interface, and
+   * the first added route per input interface otherwise.
+   */
+  struct MulticastGroupRoutes
+  {
+    Ptr<Ipv4MulticastRoute> m_anyInterface;                          //!< route for Ipv4Multicast::IF_ANY
+    std::map<uint32_t, Ptr<Ipv4MulticastRoute> > m_inputInterfaces;  //!< route per input interface
+  };
+
+  /// Multicast forwarding entries by group
+  typedef sgi::hash_map<Ipv4Address, MulticastGroupRoutes, Ipv4AddressHash> MulticastIndex;
+
+  /**
+   * \brief Build the forwarding entry of a multicast route.
+   * \param route the multicast route
+   * \return the forwarding entry
+   */
+  static Ptr<Ipv4MulticastRoute> CreateMulticastForwardingEntry (const Ipv4MulticastRoutingTableEntry *route);
+
+  /**
+   * \brief Index a multicast route added after all the others.
+   * \param route the multicast route
+   */
+  void IndexMulticastRoute (const Ipv4MulticastRoutingTableEntry *route);
+
+  /**
+   * \brief Rebuild the forwarding entries of a group from m_multicastRoutes.
+   * \param group the multicast group
+   */
+  void ReindexMulticastGroup (Ipv4Address group);
+
   /**
    * \brief Lookup in the forwarding table for destination.
    * \param dest destination address
@@ -435,6 +473,11 @@ private:
    */
   MulticastRoutes m_multicastRoutes;
 
+  /**
+   * \brief the multicast forwarding entries, by group, of m_multicastRoutes.
+   */
+  MulticastIndex m_multicastIndex;
+
   /**
    * \brief Ipv4Multicast reference.
    */
@@ -338,11 +338,16 @@ UdpL4ProtocolMulticast::Receive (Ptr<Packet> packet,
     }
 
   NS_LOG_DEBUG ("Looking up dst " << header.GetDestination () << " port " << udpHeader.GetDestinationPort ()); 
-  Ipv4EndPointDemuxMulticast::EndPoints endPoints =
-    m_endPoints->Lookup (header.GetDestination (), udpHeader.GetDestinationPort (),
-                         header.GetSource (), udpHeader.GetSourcePort (), interface);
+  // Borrow the lookup buffer, a socket receiving from ForwardUp () may send
+  // and get back here before we are done with it
+  Ipv4EndPointDemuxMulticast::EndPoints endPoints;
+  endPoints.swap (m_rxEndPoints);
+  m_endPoints->Lookup (header.GetDestination (), udpHeader.GetDestinationPort (),
+                       header.GetSource (), udpHeader.GetSourcePort (), interface,
+                       endPoints);
   if (endPoints.empty ())
     {
+      endPoints.swap (m_rxEndPoints);
       if (this->GetObject<Ipv6L3Protocol> () != 0)
         {
           NS_LOG_LOGIC ("  No Ipv4Multicast endpoints matched on UdpL4ProtocolMulticast, trying Ipv6 "<<this);
@@ -360,12 +365,17 @@ UdpL4ProtocolMulticast::Receive (Ptr<Packet> packet,
     }
 
   packet->RemoveHeader(udpHeader);
+  // A multicast datagram matches every socket bound to its port.  The
+  // copies share the packet buffer, and the last socket gets the packet
+  // itself, so a single receiver costs no copy at all.
   for (Ipv4EndPointDemuxMulticast::EndPointsI endPoint = endPoints.begin ();
        endPoint != endPoints.end (); endPoint++)
     {
-      (*endPoint)->ForwardUp (packet->Copy (), header, udpHeader.GetSourcePort (), 
+      Ptr<Packet> p = (endPoint + 1 == endPoints.end ()) ? packet : packet->Copy ();
+      (*endPoint)->ForwardUp (p, header, udpHeader.GetSourcePort (), 
                               interface);
     }
+  endPoints.swap (m_rxEndPoints);
   return IpL4ProtocolMulticast::RX_OK;
 }
 
@@ -22,6 +22,7 @@
 #define UDP_L4_PROTOCOL_H_MULTICAST
 
 #include <stdint.h>
+#include <vector>
 
 #include "ns3/packet.h"
 #include "ns3/ipv4-address.h"
@@ -235,6 +236,7 @@ private:
   Ptr<Node> m_node; //!< the node this stack is associated with
   Ipv4EndPointDemuxMulticast *m_endPoints; //!< A list of IPv4 end points.
   Ipv6EndPointDemux *m_endPoints6; //!< A list of IPv6 end points.
+  std::vector<Ipv4EndPointMulticast *> m_rxEndPoints; //!< Buffer reused by the IPv4 end point lookups
 
   /**
    * \brief Copy constructor
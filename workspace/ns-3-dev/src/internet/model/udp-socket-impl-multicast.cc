@@ -38,6 +38,10 @@
 #include "udp-l4-protocol-multicast.h"
 #include "ipv4-end-point-multicast.h"
 #include "ipv6-end-point.h"
+#include "ipv4-l3-protocol-multicast.h"
+#include "igmpv3-l4-protocol.h"
+#include "ipsec.h"
+#include <algorithm>
 #include <limits>
 
 namespace ns3 {
@@ -359,6 +363,7 @@ UdpSocketImplMulticast::Close (void)
       return -1;
     }
   Ipv6LeaveGroup ();
+  MulticastLeaveAllGroups ();
   m_shutdownRecv = true;
   m_shutdownSend = true;
   DeallocateEndPoint ();
@@ -896,30 +901,152 @@ int
 UdpSocketImplMulticast::MulticastJoinGroup (uint32_t interface, const Address &groupAddress)
 {
   NS_LOG_FUNCTION (interface << groupAddress);
-  /*
-   1) sanity check interface
-   2) sanity check that it has not been called yet on this interface/group
-   3) determine address family of groupAddress
-   4) locally store a list of (interface, groupAddress)
-   5) call ipv4->MulticastJoinGroup () or Ipv6->MulticastJoinGroup ()
-  */
-  return 0;
+  if (!Ipv4Address::IsMatchingType (groupAddress))
+    {
+      m_errno = ERROR_AFNOSUPPORT;
+      return -1;
+    }
+  Ipv4Address group = Ipv4Address::ConvertFrom (groupAddress);
+  // an any-source join is an EXCLUDE membership with no sources (rfc 3376, 3.1)
+  return IPMulticastListen (interface, group, ns3::EXCLUDE, std::list<Ipv4Address> (),
+                            GsamConfig::GetSingleton ()->IsGroupAddressSecureGroup (group));
 } 
 
 int 
 UdpSocketImplMulticast::MulticastLeaveGroup (uint32_t interface, const Address &groupAddress) 
 {
   NS_LOG_FUNCTION (interface << groupAddress);
-  /*
-   1) sanity check interface
-   2) determine address family of groupAddress
-   3) delete from local list of (interface, groupAddress); raise a LOG_WARN
-      if not already present (but return 0) 
-   5) call ipv4->MulticastLeaveGroup () or Ipv6->MulticastLeaveGroup ()
-  */
+  if (!Ipv4Address::IsMatchingType (groupAddress))
+    {
+      m_errno = ERROR_AFNOSUPPORT;
+      return -1;
+    }
+  return IPMulticastListen (interface, Ipv4Address::ConvertFrom (groupAddress),
+                            ns3::INCLUDE, std::list<Ipv4Address> ());
+}
+
+int
+UdpSocketImplMulticast::IPMulticastListen (uint32_t interfaceIndex,
+                                           Ipv4Address group,
+                                           ns3::FILTER_MODE filterMode,
+                                           const std::list<Ipv4Address> &srcList,
+                                           bool isSecureGroup)
+{
+  NS_LOG_FUNCTION (this << interfaceIndex << group << filterMode << isSecureGroup);
+  if (!group.IsMulticast ())
+    {
+      m_errno = ERROR_INVAL;
+      return -1;
+    }
+  Ptr<Ipv4InterfaceMulticast> interface = GetMembershipInterface (interfaceIndex, group);
+  if (interface == 0)
+    {
+      return -1;
+    }
+
+  if (m_socketStates == 0)
+    {
+      m_socketStates = Igmpv3L4Protocol::GetIgmp (m_node)->GetManager ()->GetSocketStateManager (this);
+    }
+  Ptr<IGMPv3SocketState> state = m_socketStates->GetSocketState (this, interface, group);
+  bool leave = (filterMode == ns3::INCLUDE) && srcList.empty ();
+
+  if (state == 0)
+    {
+      if (leave)
+        {
+          NS_LOG_WARN ("Leaving group " << group << " which was not joined on interface " << interfaceIndex);
+          return 0;
+        }
+      state = m_socketStates->CreateSocketState (group, filterMode, srcList);
+      interface->IPMulticastListen (state, isSecureGroup);
+    }
+  else if (leave)
+    {
+      state->UnSubscribeIGMP ();
+      m_socketStates->Remove (state);
+    }
+  else
+    {
+      state->StateChange (filterMode, srcList);
+    }
   return 0;
 }
 
+Ptr<Ipv4InterfaceMulticast>
+UdpSocketImplMulticast::GetMembershipInterface (uint32_t interfaceIndex, Ipv4Address group)
+{
+  NS_LOG_FUNCTION (this << interfaceIndex << group);
+  Ptr<Ipv4L3ProtocolMulticast> ipv4 = m_node->GetObject<Ipv4L3ProtocolMulticast> ();
+  if (ipv4 == 0)
+    {
+      m_errno = ERROR_AFNOSUPPORT;
+      return 0;
+    }
+  if (interfaceIndex == Ipv4Multicast::IF_ANY)
+    {
+      // like setsockopt (IP_ADD_MEMBERSHIP) with INADDR_ANY, use the
+      // interface the group is routed out of
+      Ipv4Header header;
+      header.SetDestination (group);
+      Socket::SocketErrno errno_;
+      Ptr<Ipv4Route> route;
+      if (ipv4->GetRoutingProtocol () != 0)
+        {
+          route = ipv4->GetRoutingProtocol ()->RouteOutput (Ptr<Packet> (), header, 0, errno_);
+        }
+      if (route == 0)
+        {
+          NS_LOG_LOGIC ("No route to group " << group);
+          m_errno = ERROR_NOROUTETOHOST;
+          return 0;
+        }
+      return ipv4->GetInterface (ipv4->GetInterfaceForDevice (route->GetOutputDevice ()));
+    }
+  if (interfaceIndex >= ipv4->GetNInterfaces ())
+    {
+      m_errno = ERROR_INVAL;
+      return 0;
+    }
+  return ipv4->GetInterface (interfaceIndex);
+}
+
+bool
+UdpSocketImplMulticast::IsMulticastSourceAllowed (const Ipv4Header &header,
+                                                  Ptr<Ipv4InterfaceMulticast> incomingInterface) const
+{
+  Ptr<IGMPv3SocketState> state =
+    m_socketStates->GetSocketState (const_cast<UdpSocketImplMulticast *> (this), incomingInterface, header.GetDestination ());
+  if (state == 0)
+    {
+      // not a member on this interface, nothing to filter
+      return true;
+    }
+  std::list<Ipv4Address> const &sources = state->GetSrcList ();
+  bool listed = std::find (sources.begin (), sources.end (), header.GetSource ()) != sources.end ();
+  return (state->GetFilterMode () == ns3::INCLUDE) == listed;
+}
+
+void
+UdpSocketImplMulticast::MulticastLeaveAllGroups (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_socketStates == 0)
+    {
+      return;
+    }
+  // copy, Remove () changes the list
+  std::list<Ptr<IGMPv3SocketState> > states = m_socketStates->GetSocketStates ();
+  for (std::list<Ptr<IGMPv3SocketState> >::iterator it = states.begin (); it != states.end (); it++)
+    {
+      (*it)->UnSubscribeIGMP ();
+      m_socketStates->Remove (*it);
+    }
+  // the igmp manager keeps the socket alive until its memberships are gone
+  Igmpv3L4Protocol::GetIgmp (m_node)->GetManager ()->RemoveSocketStateManager (this);
+  m_socketStates = 0;
+}
+
 void
 UdpSocketImplMulticast::BindToNetDevice (Ptr<NetDevice> netdevice)
 {
@@ -973,6 +1100,13 @@ UdpSocketImplMulticast::ForwardUp (Ptr<Packet> packet, Ipv4Header header, uint16
       return;
     }
 
+  if (m_socketStates != 0 && header.GetDestination ().IsMulticast ()
+      && !IsMulticastSourceAllowed (header, incomingInterface))
+    {
+      NS_LOG_LOGIC ("Source " << header.GetSource () << " filtered out of group " << header.GetDestination ());
+      return;
+    }
+
   // Should check via getsockopt ()..
   if (IsRecvPktInfo ())
     {
@@ -21,6 +21,7 @@
 #define UDP_SOCKET_IMPL_H_MULTICAST
 
 #include <stdint.h>
+#include <list>
 #include <queue>
 #include "ns3/callback.h"
 #include "ns3/traced-callback.h"
@@ -29,6 +30,7 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/udp-socket.h"
 #include "ns3/ipv4-interface-multicast.h"
+#include "ns3/igmpv3.h"
 #include "icmpv4.h"
 
 namespace ns3 {
@@ -47,6 +49,13 @@ class Ipv6Interface;
  * 
  * This class subclasses ns3::UdpSocket, and provides a socket interface
  * to ns3's implementation of UDP.
+ *
+ * Multicast group membership goes through the node's IGMPv3 socket states,
+ * so joining a group from a UDP socket sends the IGMPv3 (or, for secure
+ * groups, S-IGMP) reports a raw socket listening on it would.  Datagrams
+ * to a group the socket joined on the incoming interface are subject to
+ * the source filter of that membership; datagrams to other groups are
+ * delivered as before.
  */
 
 class UdpSocketImplMulticast : public UdpSocket
@@ -96,6 +105,27 @@ public:
   virtual int GetPeerName (Address &address) const;
   virtual int MulticastJoinGroup (uint32_t interfaceIndex, const Address &groupAddress);
   virtual int MulticastLeaveGroup (uint32_t interfaceIndex, const Address &groupAddress);
+
+  /**
+   * \brief Set the source filter of a group membership (rfc 3376, 3.1).
+   *
+   * INCLUDE with an empty source list leaves the group, any other filter
+   * joins it or changes the filter of the existing membership.
+   *
+   * \param interfaceIndex the IPv4 interface, Ipv4Multicast::IF_ANY to use
+   *        the interface the route to the group goes out of
+   * \param group the multicast group address
+   * \param filterMode the filter mode
+   * \param srcList the sources the filter mode applies to
+   * \param isSecureGroup whether the group is secured by GSAM, only used
+   *        when the interface did not hold the group yet
+   * \returns 0 on success, -1 on failure
+   */
+  int IPMulticastListen (uint32_t interfaceIndex,
+                         Ipv4Address group,
+                         ns3::FILTER_MODE filterMode,
+                         const std::list<Ipv4Address> &srcList,
+                         bool isSecureGroup = false);
   virtual void BindToNetDevice (Ptr<NetDevice> netdevice);
   virtual bool SetAllowBroadcast (bool allowBroadcast);
   virtual bool GetAllowBroadcast () const;
@@ -210,6 +240,28 @@ private:
    */
   void ForwardIcmp6 (Ipv6Address icmpSource, uint8_t icmpTtl, uint8_t icmpType, uint8_t icmpCode, uint32_t icmpInfo);
 
+  /**
+   * \brief Get the IPv4 interface of a multicast membership.
+   * \param interfaceIndex the interface index given by the application
+   * \param group the multicast group address
+   * \returns the interface, 0 if there is none
+   */
+  Ptr<Ipv4InterfaceMulticast> GetMembershipInterface (uint32_t interfaceIndex, Ipv4Address group);
+
+  /**
+   * \brief Check the source filter of the membership a datagram is received on.
+   * \param header the IPv4 header of the datagram
+   * \param incomingInterface the incoming interface
+   * \returns false if the socket joined the group on the interface and
+   *          filters out the source
+   */
+  bool IsMulticastSourceAllowed (const Ipv4Header &header, Ptr<Ipv4InterfaceMulticast> incomingInterface) const;
+
+  /**
+   * \brief Leave all the multicast groups joined by the socket.
+   */
+  void MulticastLeaveAllGroups (void);
+
   // Connections to other layers of TCP/IP
   Ipv4EndPointMulticast*       m_endPoint;   //!< the IPv4 endpoint
   Ipv6EndPoint*       m_endPoint6;  //!< the IPv6 endpoint
@@ -217,6 +269,7 @@ private:
   Ptr<UdpL4ProtocolMulticast> m_udp;         //!< the associated UDP L4 protocol
   Callback<void, Ipv4Address,uint8_t,uint8_t,uint8_t,uint32_t> m_icmpCallback;  //!< ICMP callback
   Callback<void, Ipv6Address,uint8_t,uint8_t,uint8_t,uint32_t> m_icmpCallback6; //!< ICMPv6 callback
+  Ptr<IGMPv3SocketStateManager> m_socketStates; //!< IGMPv3 memberships, 0 until the first join
 
   Address m_defaultAddress; //!< Default address
   uint16_t m_defaultPort;   //!< Default port